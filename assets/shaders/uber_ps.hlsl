@@ -1,14 +1,67 @@
+// Permutations are selected through FEATURE_* defines (see shader_permutations.hpp).
+#ifndef FEATURE_ALBEDO_TEXTURE
+#define FEATURE_ALBEDO_TEXTURE 0
+#endif
+#ifndef FEATURE_NORMAL_MAP
+#define FEATURE_NORMAL_MAP 0
+#endif
+#ifndef FEATURE_ALPHA_TEST
+#define FEATURE_ALPHA_TEST 0
+#endif
+
+#define ALPHA_CUTOFF 0.5
+
 struct PSInput
 {
     float2 uv : TEXCOORD;
     float3 normal : NORMAL0;
+#if FEATURE_NORMAL_MAP
+    float3 worldPosition : POSITION0;
+#endif
 };
 
 Texture2D AlbedoTexture : register(t0);
+Texture2D NormalTexture : register(t1);
+// The albedo view only covers the mips streamed in so far, nothing more detailed can be sampled.
 SamplerState AlbedoSampler : register(s0);
 
+#if FEATURE_NORMAL_MAP
+// Builds the tangent frame from screen-space derivatives, so the vertex format doesn't need tangents.
+float3 PerturbNormal(float3 normal, float3 position, float2 uv)
+{
+    float3 dp1 = ddx(position);
+    float3 dp2 = ddy(position);
+    float2 duv1 = ddx(uv);
+    float2 duv2 = ddy(uv);
+
+    float3 dp2perp = cross(dp2, normal);
+    float3 dp1perp = cross(normal, dp1);
+    float3 tangent = dp2perp * duv1.x + dp1perp * duv2.x;
+    float3 bitangent = dp2perp * duv1.y + dp1perp * duv2.y;
+    float invMax = rsqrt(max(dot(tangent, tangent), dot(bitangent, bitangent)));
+
+    float3 tangentNormal = NormalTexture.Sample(AlbedoSampler, uv).xyz * 2.0 - 1.0;
+    return normalize(mul(tangentNormal, float3x3(tangent * invMax, bitangent * invMax, normal)));
+}
+#endif
+
 float4 main(PSInput input) : SV_TARGET
 {
-    return float4(input.uv.x, input.uv.y, 0.0, 1.0);
-    //return AlbedoTexture.Sample(AlbedoSampler, input.uv);
+#if FEATURE_ALBEDO_TEXTURE
+    float4 color = AlbedoTexture.Sample(AlbedoSampler, input.uv);
+#else
+    float4 color = float4(input.uv.x, input.uv.y, 0.0, 1.0);
+#endif
+
+#if FEATURE_ALPHA_TEST
+    clip(color.a - ALPHA_CUTOFF);
+#endif
+
+#if FEATURE_NORMAL_MAP
+    float3 normal = PerturbNormal(normalize(input.normal), input.worldPosition, input.uv);
+    const float3 lightDirection = normalize(float3(0.5, 1.0, -0.5));
+    color.rgb *= 0.25 + 0.75 * saturate(dot(normal, lightDirection));
+#endif
+
+    return color;
 }
\ No newline at end of file
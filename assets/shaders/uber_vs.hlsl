@@ -1,29 +1,64 @@
+#ifndef FEATURE_NORMAL_MAP
+#define FEATURE_NORMAL_MAP 0
+#endif
+
+// Util::QuantizedVertex: unorm position within the mesh bounds, octahedral normal, half uv.
 struct VSInput
 {
-    float3 position : POSITION;
-    float3 normal : NORMAL;
+    float4 position : POSITION;
+    float2 normal : NORMAL;
     float2 uv : TEXCOORD;
+    uint instanceID : SV_InstanceID;
 };
 
 struct VSOutput
 {
     float2 uv : TEXCOORD;
     float3 normal : NORMAL0;
+#if FEATURE_NORMAL_MAP
+    float3 worldPosition : POSITION0;
+#endif
     float4 position : SV_POSITION;
 };
 
-cbuffer ModelViewProjectionCB : register(b0)
+cbuffer ViewProjectionCB : register(b0)
 {
-    matrix MVP;
+    matrix ViewProjection;
 };
 
+cbuffer PositionDequantizeCB : register(b1)
+{
+    float3 PositionOffset;
+    float3 PositionScale;
+};
+
+// World matrix per instance, indexed with SV_InstanceID.
+StructuredBuffer<float4x4> Instances : register(t0, space1);
+
+float3 DecodeOctahedral(float2 encoded)
+{
+    float3 normal = float3(encoded, 1.0f - abs(encoded.x) - abs(encoded.y));
+    float fold = saturate(-normal.z);
+    normal.xy += (normal.xy >= 0.0f) ? -fold : fold;
+    return normalize(normal);
+}
+
 VSOutput main(VSInput input)
 {
     VSOutput result;
 
-    result.position = mul(MVP, float4(input.position, 1.0f));
-    result.normal = input.normal; // TODO: multiply with inverse transpose
+    float3 position = PositionOffset + input.position.xyz * PositionScale;
+    float3 normal = DecodeOctahedral(input.normal);
+
+    float4x4 world = Instances[input.instanceID];
+    float4 worldPosition = mul(world, float4(position, 1.0f));
+
+    result.position = mul(ViewProjection, worldPosition);
+    result.normal = normalize(mul((float3x3)world, normal)); // instances are uniformly scaled, no inverse transpose needed
     result.uv = input.uv;
+#if FEATURE_NORMAL_MAP
+    result.worldPosition = worldPosition.xyz;
+#endif
 
     return result;
 }
\ No newline at end of file
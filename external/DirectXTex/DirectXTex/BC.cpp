@@ -11,6 +11,10 @@
 
 #include "DirectXTexP.h"
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
 // Experiemental encoding variants, not enabled by default
 //#define COLOR_WEIGHTS
 //#define COLOR_AVG_0WEIGHTS
@@ -717,6 +721,459 @@ namespace
         pBC->bitmap = 0x00000000;
     }
 #endif // COLOR_WEIGHTS
+
+    //-------------------------------------------------------------------------------------
+    // Single blocks of the batched encoders that take the reference path
+    inline void LoadBlock(
+        _Out_writes_(NUM_PIXELS_PER_BLOCK) XMVECTOR *pColor,
+        _In_reads_(NUM_PIXELS_PER_BLOCK) const uint32_t *pPixels) noexcept
+    {
+        for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+            pColor[i] = XMLoadUByteN4(reinterpret_cast<const XMUBYTEN4*>(&pPixels[i]));
+    }
+
+    inline bool HasColorKey(_In_reads_(NUM_PIXELS_PER_BLOCK) const uint32_t *pPixels, float threshold) noexcept
+    {
+        for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+        {
+            if (static_cast<float>(pPixels[i] >> 24) * (1.0f / 255.0f) < threshold)
+                return true;
+        }
+        return false;
+    }
+
+#if defined(__AVX2__) || defined(_XM_SSE_INTRINSICS_)
+    //-------------------------------------------------------------------------------------
+    // Batched BC1-3 color encoder (BC_FLAGS_FAST_RGB)
+    //
+    // Encodes one block per SIMD lane, 8 blocks at once with AVX2 and 4 with SSE2. Instead of
+    // OptimizeRGB's root finding, the endpoints are the extremes of the block along its principal
+    // axis, refined by least squares fits to the chosen indices. Always uses 4-color mode.
+    //-------------------------------------------------------------------------------------
+#if defined(__AVX2__)
+    constexpr size_t BATCH_LANES = 8;
+
+    using FloatLanes = __m256;
+    using IntLanes = __m256i;
+
+    inline FloatLanes LaneLoad(const float* p) noexcept { return _mm256_load_ps(p); }
+    inline void LaneStore(float* p, FloatLanes a) noexcept { _mm256_store_ps(p, a); }
+    inline FloatLanes LaneSplat(float f) noexcept { return _mm256_set1_ps(f); }
+    inline FloatLanes LaneAdd(FloatLanes a, FloatLanes b) noexcept { return _mm256_add_ps(a, b); }
+    inline FloatLanes LaneSub(FloatLanes a, FloatLanes b) noexcept { return _mm256_sub_ps(a, b); }
+    inline FloatLanes LaneMul(FloatLanes a, FloatLanes b) noexcept { return _mm256_mul_ps(a, b); }
+    inline FloatLanes LaneDiv(FloatLanes a, FloatLanes b) noexcept { return _mm256_div_ps(a, b); }
+    inline FloatLanes LaneMin(FloatLanes a, FloatLanes b) noexcept { return _mm256_min_ps(a, b); }
+    inline FloatLanes LaneMax(FloatLanes a, FloatLanes b) noexcept { return _mm256_max_ps(a, b); }
+    inline FloatLanes LaneLess(FloatLanes a, FloatLanes b) noexcept { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    inline FloatLanes LaneSelect(FloatLanes mask, FloatLanes a, FloatLanes b) noexcept { return _mm256_blendv_ps(b, a, mask); }
+    inline IntLanes LaneToInt(FloatLanes a) noexcept { return _mm256_cvttps_epi32(a); }
+    inline FloatLanes LaneToFloat(IntLanes a) noexcept { return _mm256_cvtepi32_ps(a); }
+    inline IntLanes LaneMaskToInt(FloatLanes mask) noexcept { return _mm256_castps_si256(mask); }
+
+    inline IntLanes LaneSplatInt(int32_t i) noexcept { return _mm256_set1_epi32(i); }
+    inline IntLanes LaneAdd(IntLanes a, IntLanes b) noexcept { return _mm256_add_epi32(a, b); }
+    inline IntLanes LaneOr(IntLanes a, IntLanes b) noexcept { return _mm256_or_si256(a, b); }
+    inline IntLanes LaneXor(IntLanes a, IntLanes b) noexcept { return _mm256_xor_si256(a, b); }
+    inline IntLanes LaneAnd(IntLanes a, IntLanes b) noexcept { return _mm256_and_si256(a, b); }
+    inline IntLanes LaneShiftLeft(IntLanes a, int count) noexcept { return _mm256_sll_epi32(a, _mm_cvtsi32_si128(count)); }
+    inline IntLanes LaneShiftRight(IntLanes a, int count) noexcept { return _mm256_srl_epi32(a, _mm_cvtsi32_si128(count)); }
+    inline IntLanes LaneEqual(IntLanes a, IntLanes b) noexcept { return _mm256_cmpeq_epi32(a, b); }
+    inline IntLanes LaneLess(IntLanes a, IntLanes b) noexcept { return _mm256_cmpgt_epi32(b, a); }
+    inline IntLanes LaneSelect(IntLanes mask, IntLanes a, IntLanes b) noexcept { return _mm256_blendv_epi8(b, a, mask); }
+    inline IntLanes LaneLoad(const int32_t* p) noexcept { return _mm256_load_si256(reinterpret_cast<const IntLanes*>(p)); }
+    inline void LaneStore(int32_t* p, IntLanes a) noexcept { _mm256_store_si256(reinterpret_cast<IntLanes*>(p), a); }
+#else
+    constexpr size_t BATCH_LANES = 4;
+
+    using FloatLanes = __m128;
+    using IntLanes = __m128i;
+
+    inline FloatLanes LaneLoad(const float* p) noexcept { return _mm_load_ps(p); }
+    inline void LaneStore(float* p, FloatLanes a) noexcept { _mm_store_ps(p, a); }
+    inline FloatLanes LaneSplat(float f) noexcept { return _mm_set1_ps(f); }
+    inline FloatLanes LaneAdd(FloatLanes a, FloatLanes b) noexcept { return _mm_add_ps(a, b); }
+    inline FloatLanes LaneSub(FloatLanes a, FloatLanes b) noexcept { return _mm_sub_ps(a, b); }
+    inline FloatLanes LaneMul(FloatLanes a, FloatLanes b) noexcept { return _mm_mul_ps(a, b); }
+    inline FloatLanes LaneDiv(FloatLanes a, FloatLanes b) noexcept { return _mm_div_ps(a, b); }
+    inline FloatLanes LaneMin(FloatLanes a, FloatLanes b) noexcept { return _mm_min_ps(a, b); }
+    inline FloatLanes LaneMax(FloatLanes a, FloatLanes b) noexcept { return _mm_max_ps(a, b); }
+    inline FloatLanes LaneLess(FloatLanes a, FloatLanes b) noexcept { return _mm_cmplt_ps(a, b); }
+    inline FloatLanes LaneSelect(FloatLanes mask, FloatLanes a, FloatLanes b) noexcept { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+    inline IntLanes LaneToInt(FloatLanes a) noexcept { return _mm_cvttps_epi32(a); }
+    inline FloatLanes LaneToFloat(IntLanes a) noexcept { return _mm_cvtepi32_ps(a); }
+    inline IntLanes LaneMaskToInt(FloatLanes mask) noexcept { return _mm_castps_si128(mask); }
+
+    inline IntLanes LaneSplatInt(int32_t i) noexcept { return _mm_set1_epi32(i); }
+    inline IntLanes LaneAdd(IntLanes a, IntLanes b) noexcept { return _mm_add_epi32(a, b); }
+    inline IntLanes LaneOr(IntLanes a, IntLanes b) noexcept { return _mm_or_si128(a, b); }
+    inline IntLanes LaneXor(IntLanes a, IntLanes b) noexcept { return _mm_xor_si128(a, b); }
+    inline IntLanes LaneAnd(IntLanes a, IntLanes b) noexcept { return _mm_and_si128(a, b); }
+    inline IntLanes LaneShiftLeft(IntLanes a, int count) noexcept { return _mm_sll_epi32(a, _mm_cvtsi32_si128(count)); }
+    inline IntLanes LaneShiftRight(IntLanes a, int count) noexcept { return _mm_srl_epi32(a, _mm_cvtsi32_si128(count)); }
+    inline IntLanes LaneEqual(IntLanes a, IntLanes b) noexcept { return _mm_cmpeq_epi32(a, b); }
+    inline IntLanes LaneLess(IntLanes a, IntLanes b) noexcept { return _mm_cmplt_epi32(a, b); }
+    inline IntLanes LaneSelect(IntLanes mask, IntLanes a, IntLanes b) noexcept { return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b)); }
+    inline IntLanes LaneLoad(const int32_t* p) noexcept { return _mm_load_si128(reinterpret_cast<const IntLanes*>(p)); }
+    inline void LaneStore(int32_t* p, IntLanes a) noexcept { _mm_store_si128(reinterpret_cast<IntLanes*>(p), a); }
+#endif
+
+    // RGBA of BATCH_LANES blocks scaled to [0, 1], as planes[channel][pixel][block].
+    typedef float BatchPlanes[4][NUM_PIXELS_PER_BLOCK][BATCH_LANES];
+
+    void LoadBatch(
+        _Out_ BatchPlanes& planes,
+        _In_reads_(count * NUM_PIXELS_PER_BLOCK) const uint32_t *pPixels,
+        size_t count) noexcept
+    {
+        assert(count > 0 && count <= BATCH_LANES);
+
+        XM_ALIGNED_DATA(32) int32_t Pixel[NUM_PIXELS_PER_BLOCK][BATCH_LANES];
+
+        for (size_t lane = 0; lane < BATCH_LANES; ++lane)
+        {
+            // Unused lanes repeat the last block, their results are dropped
+            const uint32_t *pBlock = pPixels + std::min(lane, count - 1) * NUM_PIXELS_PER_BLOCK;
+
+            for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+                Pixel[i][lane] = static_cast<int32_t>(pBlock[i]);
+        }
+
+        const IntLanes mask = LaneSplatInt(0xff);
+        const FloatLanes scale = LaneSplat(1.0f / 255.0f);
+        for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+        {
+            const IntLanes pixel = LaneLoad(Pixel[i]);
+            for (size_t c = 0; c < 4; ++c)
+            {
+                const IntLanes channel = LaneAnd(LaneShiftRight(pixel, static_cast<int>(c * 8)), mask);
+                LaneStore(planes[c][i], LaneMul(LaneToFloat(channel), scale));
+            }
+        }
+    }
+
+    // Quantizes weighted endpoints to 5:6:5. Returns them packed, pDecoded gets the weighted
+    // color the decoder reconstructs from it.
+    IntLanes QuantizeEndpoint(
+        _Out_writes_(3) FloatLanes *pDecoded,
+        _In_reads_(3) const FloatLanes *pEndpoint,
+        _In_reads_(3) const FloatLanes *pWeight,
+        _In_reads_(3) const FloatLanes *pWeightInv) noexcept
+    {
+        static const float s_Scale[3] = { 31.0f, 63.0f, 31.0f };
+        static const int s_Shift[3] = { 0, 6, 5 };
+
+        IntLanes packed = LaneSplatInt(0);
+        for (size_t c = 0; c < 3; ++c)
+        {
+            const FloatLanes scale = LaneSplat(s_Scale[c]);
+
+            FloatLanes value = LaneMul(pEndpoint[c], pWeightInv[c]);
+            value = LaneMin(LaneMax(value, LaneSplat(0.0f)), LaneSplat(1.0f));
+
+            const IntLanes quantized = LaneToInt(LaneAdd(LaneMul(value, scale), LaneSplat(0.5f)));
+            pDecoded[c] = LaneMul(LaneMul(LaneToFloat(quantized), LaneSplat(1.0f / s_Scale[c])), pWeight[c]);
+            packed = LaneOr(LaneShiftLeft(packed, s_Shift[c]), quantized);
+        }
+
+        return packed;
+    }
+
+    // Picks the closest of the four colors from A to B for every pixel and returns the summed
+    // squared error. The colors are on a line, so the closest is the rounded projection onto it.
+    // Steps count from A (0) to B (3), they become indices only when the block is written.
+    FloatLanes SelectSteps(
+        _Out_writes_(NUM_PIXELS_PER_BLOCK) IntLanes *pStep,
+        _In_reads_(NUM_PIXELS_PER_BLOCK) const FloatLanes (*pColor)[3],
+        _In_reads_(3) const FloatLanes *pA,
+        _In_reads_(3) const FloatLanes *pB) noexcept
+    {
+        const FloatLanes Dir[3] = { LaneSub(pB[0], pA[0]), LaneSub(pB[1], pA[1]), LaneSub(pB[2], pA[2]) };
+        const FloatLanes fDir = LaneAdd(LaneAdd(LaneMul(Dir[0], Dir[0]), LaneMul(Dir[1], Dir[1])), LaneMul(Dir[2], Dir[2]));
+        const FloatLanes scale = LaneSelect(LaneLess(LaneSplat(FLT_MIN), fDir),
+            LaneDiv(LaneSplat(3.0f), LaneMax(fDir, LaneSplat(FLT_MIN))), LaneSplat(0.0f));
+
+        FloatLanes error = LaneSplat(0.0f);
+        for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+        {
+            const FloatLanes Diff[3] = { LaneSub(pColor[i][0], pA[0]), LaneSub(pColor[i][1], pA[1]), LaneSub(pColor[i][2], pA[2]) };
+            FloatLanes fDot = LaneMul(LaneAdd(LaneAdd(LaneMul(Diff[0], Dir[0]), LaneMul(Diff[1], Dir[1])), LaneMul(Diff[2], Dir[2])), scale);
+            fDot = LaneMin(LaneMax(fDot, LaneSplat(0.0f)), LaneSplat(3.0f));
+
+            const IntLanes iStep = LaneToInt(LaneAdd(fDot, LaneSplat(0.5f)));
+            const FloatLanes t = LaneMul(LaneToFloat(iStep), LaneSplat(1.0f / 3.0f));
+
+            const FloatLanes dr = LaneSub(Diff[0], LaneMul(Dir[0], t));
+            const FloatLanes dg = LaneSub(Diff[1], LaneMul(Dir[1], t));
+            const FloatLanes db = LaneSub(Diff[2], LaneMul(Dir[2], t));
+
+            pStep[i] = iStep;
+            error = LaneAdd(error, LaneAdd(LaneAdd(LaneMul(dr, dr), LaneMul(dg, dg)), LaneMul(db, db)));
+        }
+
+        return error;
+    }
+
+    // Least squares endpoints for the given steps. Lanes where every pixel is on the same step
+    // have no unique solution and keep their endpoints.
+    void FitEndpoints(
+        _Inout_updates_(3) FloatLanes *pA,
+        _Inout_updates_(3) FloatLanes *pB,
+        _In_reads_(NUM_PIXELS_PER_BLOCK) const FloatLanes (*pColor)[3],
+        _In_reads_(NUM_PIXELS_PER_BLOCK) const IntLanes *pStep) noexcept
+    {
+        FloatLanes fAA = LaneSplat(0.0f);
+        FloatLanes fBB = LaneSplat(0.0f);
+        FloatLanes fAB = LaneSplat(0.0f);
+        FloatLanes XA[3] = { fAA, fAA, fAA };
+        FloatLanes XB[3] = { fAA, fAA, fAA };
+
+        for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+        {
+            // Weights of A and B in the color of the step
+            const FloatLanes v = LaneMul(LaneToFloat(pStep[i]), LaneSplat(1.0f / 3.0f));
+            const FloatLanes w = LaneSub(LaneSplat(1.0f), v);
+
+            fAA = LaneAdd(fAA, LaneMul(w, w));
+            fBB = LaneAdd(fBB, LaneMul(v, v));
+            fAB = LaneAdd(fAB, LaneMul(w, v));
+            for (size_t c = 0; c < 3; ++c)
+            {
+                XA[c] = LaneAdd(XA[c], LaneMul(w, pColor[i][c]));
+                XB[c] = LaneAdd(XB[c], LaneMul(v, pColor[i][c]));
+            }
+        }
+
+        const FloatLanes det = LaneSub(LaneMul(fAA, fBB), LaneMul(fAB, fAB));
+        const FloatLanes solvable = LaneLess(LaneSplat(1e-4f), det);
+        const FloatLanes invDet = LaneDiv(LaneSplat(1.0f), LaneSelect(solvable, det, LaneSplat(1.0f)));
+
+        for (size_t c = 0; c < 3; ++c)
+        {
+            const FloatLanes A = LaneMul(LaneSub(LaneMul(fBB, XA[c]), LaneMul(fAB, XB[c])), invDet);
+            const FloatLanes B = LaneMul(LaneSub(LaneMul(fAA, XB[c]), LaneMul(fAB, XA[c])), invDet);
+            pA[c] = LaneSelect(solvable, A, pA[c]);
+            pB[c] = LaneSelect(solvable, B, pB[c]);
+        }
+    }
+
+    void EncodeBC1Lanes(
+        _Out_writes_(BATCH_LANES) D3DX_BC1 *pBC,
+        _In_ const BatchPlanes& planes,
+        uint32_t flags) noexcept
+    {
+        const bool bUniform = (flags & BC_FLAGS_UNIFORM) != 0;
+        const FloatLanes Weight[3] = {
+            LaneSplat(bUniform ? 1.0f : g_Luminance.r), LaneSplat(1.0f), LaneSplat(bUniform ? 1.0f : g_Luminance.b) };
+        const FloatLanes WeightInv[3] = {
+            LaneSplat(bUniform ? 1.0f : g_LuminanceInv.r), LaneSplat(1.0f), LaneSplat(bUniform ? 1.0f : g_LuminanceInv.b) };
+
+        FloatLanes Color[NUM_PIXELS_PER_BLOCK][3];
+        FloatLanes Mean[3] = { LaneSplat(0.0f), LaneSplat(0.0f), LaneSplat(0.0f) };
+
+        for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+        {
+            for (size_t c = 0; c < 3; ++c)
+            {
+                Color[i][c] = LaneMul(LaneLoad(planes[c][i]), Weight[c]);
+                Mean[c] = LaneAdd(Mean[c], Color[i][c]);
+            }
+        }
+
+        for (size_t c = 0; c < 3; ++c)
+            Mean[c] = LaneMul(Mean[c], LaneSplat(1.0f / 16.0f));
+
+        // Covariance: rr, rg, rb, gg, gb, bb
+        FloatLanes Cov[6] = { LaneSplat(0.0f), LaneSplat(0.0f), LaneSplat(0.0f), LaneSplat(0.0f), LaneSplat(0.0f), LaneSplat(0.0f) };
+
+        for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+        {
+            const FloatLanes dr = LaneSub(Color[i][0], Mean[0]);
+            const FloatLanes dg = LaneSub(Color[i][1], Mean[1]);
+            const FloatLanes db = LaneSub(Color[i][2], Mean[2]);
+
+            Cov[0] = LaneAdd(Cov[0], LaneMul(dr, dr));
+            Cov[1] = LaneAdd(Cov[1], LaneMul(dr, dg));
+            Cov[2] = LaneAdd(Cov[2], LaneMul(dr, db));
+            Cov[3] = LaneAdd(Cov[3], LaneMul(dg, dg));
+            Cov[4] = LaneAdd(Cov[4], LaneMul(dg, db));
+            Cov[5] = LaneAdd(Cov[5], LaneMul(db, db));
+        }
+
+        // Principal axis by power iteration, starting from the covariance column of the channel
+        // that varies most (the bounding box diagonal can be orthogonal to the axis).
+        FloatLanes Axis[3] = { Cov[0], Cov[1], Cov[2] };
+        {
+            const FloatLanes greenMost = LaneLess(Cov[0], Cov[3]);
+            const FloatLanes largest = LaneMax(Cov[0], Cov[3]);
+            Axis[0] = LaneSelect(greenMost, Cov[1], Axis[0]);
+            Axis[1] = LaneSelect(greenMost, Cov[3], Axis[1]);
+            Axis[2] = LaneSelect(greenMost, Cov[4], Axis[2]);
+
+            const FloatLanes blueMost = LaneLess(largest, Cov[5]);
+            Axis[0] = LaneSelect(blueMost, Cov[2], Axis[0]);
+            Axis[1] = LaneSelect(blueMost, Cov[4], Axis[1]);
+            Axis[2] = LaneSelect(blueMost, Cov[5], Axis[2]);
+        }
+
+        for (size_t iteration = 0; iteration < 4; ++iteration)
+        {
+            const FloatLanes x = LaneAdd(LaneAdd(LaneMul(Cov[0], Axis[0]), LaneMul(Cov[1], Axis[1])), LaneMul(Cov[2], Axis[2]));
+            const FloatLanes y = LaneAdd(LaneAdd(LaneMul(Cov[1], Axis[0]), LaneMul(Cov[3], Axis[1])), LaneMul(Cov[4], Axis[2]));
+            const FloatLanes z = LaneAdd(LaneAdd(LaneMul(Cov[2], Axis[0]), LaneMul(Cov[4], Axis[1])), LaneMul(Cov[5], Axis[2]));
+
+            // Rescale so the largest component is 1, nearly flat blocks would underflow otherwise
+            const FloatLanes zero = LaneSplat(0.0f);
+            FloatLanes largest = LaneMax(LaneMax(x, LaneSub(zero, x)), LaneMax(y, LaneSub(zero, y)));
+            largest = LaneMax(largest, LaneMax(z, LaneSub(zero, z)));
+            const FloatLanes scale = LaneDiv(LaneSplat(1.0f), LaneMax(largest, LaneSplat(FLT_MIN)));
+
+            Axis[0] = LaneMul(x, scale);
+            Axis[1] = LaneMul(y, scale);
+            Axis[2] = LaneMul(z, scale);
+        }
+
+        // Endpoints at the extremes of the block along the axis, the mean for single color blocks
+        FloatLanes tMin = LaneSplat(0.0f);
+        FloatLanes tMax = LaneSplat(0.0f);
+
+        for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+        {
+            const FloatLanes t = LaneAdd(LaneAdd(
+                LaneMul(LaneSub(Color[i][0], Mean[0]), Axis[0]),
+                LaneMul(LaneSub(Color[i][1], Mean[1]), Axis[1])),
+                LaneMul(LaneSub(Color[i][2], Mean[2]), Axis[2]));
+            tMin = LaneMin(tMin, t);
+            tMax = LaneMax(tMax, t);
+        }
+
+        const FloatLanes fAxis = LaneAdd(LaneAdd(LaneMul(Axis[0], Axis[0]), LaneMul(Axis[1], Axis[1])), LaneMul(Axis[2], Axis[2]));
+        const FloatLanes invAxis = LaneSelect(LaneLess(LaneSplat(FLT_MIN), fAxis),
+            LaneDiv(LaneSplat(1.0f), LaneMax(fAxis, LaneSplat(FLT_MIN))), LaneSplat(0.0f));
+        tMin = LaneMul(tMin, invAxis);
+        tMax = LaneMul(tMax, invAxis);
+
+        FloatLanes A[3], B[3];
+        for (size_t c = 0; c < 3; ++c)
+        {
+            A[c] = LaneAdd(Mean[c], LaneMul(Axis[c], tMax));
+            B[c] = LaneAdd(Mean[c], LaneMul(Axis[c], tMin));
+        }
+
+        FloatLanes DecodedA[3], DecodedB[3];
+        IntLanes wColorA = QuantizeEndpoint(DecodedA, A, Weight, WeightInv);
+        IntLanes wColorB = QuantizeEndpoint(DecodedB, B, Weight, WeightInv);
+
+        IntLanes Step[NUM_PIXELS_PER_BLOCK];
+        const FloatLanes error = SelectSteps(Step, Color, DecodedA, DecodedB);
+
+        // Refit the endpoints to the steps once, keeping the fit per block only if the error drops.
+        // Further fits rarely gain more than a few hundredths of a dB.
+        {
+            FitEndpoints(A, B, Color, Step);
+
+            const IntLanes wFitA = QuantizeEndpoint(DecodedA, A, Weight, WeightInv);
+            const IntLanes wFitB = QuantizeEndpoint(DecodedB, B, Weight, WeightInv);
+
+            IntLanes FitStep[NUM_PIXELS_PER_BLOCK];
+            const FloatLanes fitError = SelectSteps(FitStep, Color, DecodedA, DecodedB);
+
+            const IntLanes better = LaneMaskToInt(LaneLess(fitError, error));
+            wColorA = LaneSelect(better, wFitA, wColorA);
+            wColorB = LaneSelect(better, wFitB, wColorB);
+
+            for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+                Step[i] = LaneSelect(better, FitStep[i], Step[i]);
+        }
+
+        // Steps 0, 1, 2, 3 are indices 0, 2, 3, 1
+        IntLanes bitmap = LaneSplatInt(0);
+        for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+        {
+            IntLanes index = LaneAdd(Step[i], LaneSplatInt(1));
+            index = LaneSelect(LaneEqual(Step[i], LaneSplatInt(3)), LaneSplatInt(1), index);
+            index = LaneSelect(LaneEqual(Step[i], LaneSplatInt(0)), LaneSplatInt(0), index);
+            bitmap = LaneOr(bitmap, LaneShiftLeft(index, static_cast<int>(i * 2)));
+        }
+
+        // 4-color mode needs rgb[0] > rgb[1]. Swapping the endpoints swaps indices 0/1 and 2/3.
+        const IntLanes swap = LaneLess(wColorA, wColorB);
+        const IntLanes color0 = LaneSelect(swap, wColorB, wColorA);
+        const IntLanes color1 = LaneSelect(swap, wColorA, wColorB);
+        bitmap = LaneXor(bitmap, LaneAnd(swap, LaneSplatInt(0x55555555)));
+        bitmap = LaneSelect(LaneEqual(wColorA, wColorB), LaneSplatInt(0), bitmap);
+
+        XM_ALIGNED_DATA(32) int32_t Color0[BATCH_LANES];
+        XM_ALIGNED_DATA(32) int32_t Color1[BATCH_LANES];
+        XM_ALIGNED_DATA(32) int32_t Bitmap[BATCH_LANES];
+        LaneStore(Color0, color0);
+        LaneStore(Color1, color1);
+        LaneStore(Bitmap, bitmap);
+
+        for (size_t lane = 0; lane < BATCH_LANES; ++lane)
+        {
+            pBC[lane].rgb[0] = static_cast<uint16_t>(Color0[lane]);
+            pBC[lane].rgb[1] = static_cast<uint16_t>(Color1[lane]);
+            pBC[lane].bitmap = static_cast<uint32_t>(Bitmap[lane]);
+        }
+    }
+
+    // BC3 alpha from the block's minimum and maximum, always in 8-value mode.
+    void EncodeBC3AlphaLanes(
+        _Out_writes_(BATCH_LANES) D3DX_BC3 *pBC,
+        _In_ const BatchPlanes& planes) noexcept
+    {
+        FloatLanes Alpha[NUM_PIXELS_PER_BLOCK];
+        FloatLanes fMin = LaneSplat(255.0f);
+        FloatLanes fMax = LaneSplat(0.0f);
+
+        for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+        {
+            Alpha[i] = LaneToFloat(LaneToInt(LaneAdd(LaneMul(LaneLoad(planes[3][i]), LaneSplat(255.0f)), LaneSplat(0.5f))));
+            fMin = LaneMin(fMin, Alpha[i]);
+            fMax = LaneMax(fMax, Alpha[i]);
+        }
+
+        // alpha[0] is the maximum, steps 0..7 from it towards the minimum are indices 0, 2..7, 1
+        const FloatLanes range = LaneSub(fMax, fMin);
+        const FloatLanes scale = LaneSelect(LaneLess(LaneSplat(0.0f), range),
+            LaneDiv(LaneSplat(7.0f), LaneMax(range, LaneSplat(1.0f))), LaneSplat(0.0f));
+
+        IntLanes Bitmap[2] = { LaneSplatInt(0), LaneSplatInt(0) };
+        for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+        {
+            const IntLanes iStep = LaneToInt(LaneAdd(LaneMul(LaneSub(fMax, Alpha[i]), scale), LaneSplat(0.5f)));
+
+            IntLanes index = LaneAdd(iStep, LaneSplatInt(1));
+            index = LaneSelect(LaneEqual(iStep, LaneSplatInt(7)), LaneSplatInt(1), index);
+            index = LaneSelect(LaneEqual(iStep, LaneSplatInt(0)), LaneSplatInt(0), index);
+
+            Bitmap[i >> 3] = LaneOr(Bitmap[i >> 3], LaneShiftLeft(index, static_cast<int>((i & 7) * 3)));
+        }
+
+        XM_ALIGNED_DATA(32) int32_t AlphaA[BATCH_LANES];
+        XM_ALIGNED_DATA(32) int32_t AlphaB[BATCH_LANES];
+        XM_ALIGNED_DATA(32) int32_t Bits[2][BATCH_LANES];
+        LaneStore(AlphaA, LaneToInt(fMax));
+        LaneStore(AlphaB, LaneToInt(fMin));
+        LaneStore(Bits[0], Bitmap[0]);
+        LaneStore(Bits[1], Bitmap[1]);
+
+        for (size_t lane = 0; lane < BATCH_LANES; ++lane)
+        {
+            pBC[lane].alpha[0] = static_cast<uint8_t>(AlphaA[lane]);
+            pBC[lane].alpha[1] = static_cast<uint8_t>(AlphaB[lane]);
+
+            for (size_t iSet = 0; iSet < 2; ++iSet)
+            {
+                const auto dw = static_cast<uint32_t>(Bits[iSet][lane]);
+                pBC[lane].bitmap[0 + iSet * 3] = static_cast<uint8_t>(dw);
+                pBC[lane].bitmap[1 + iSet * 3] = static_cast<uint8_t>(dw >> 8);
+                pBC[lane].bitmap[2 + iSet * 3] = static_cast<uint8_t>(dw >> 16);
+            }
+        }
+    }
+#endif // __AVX2__ || _XM_SSE_INTRINSICS_
 }
 
 
@@ -1139,3 +1596,136 @@ void DirectX::D3DXEncodeBC3(uint8_t *pBC, const XMVECTOR *pColor, uint32_t flags
         pBC3->bitmap[2 + iSet * 3] = reinterpret_cast<uint8_t *>(&dw)[2];
     }
 }
+
+
+//-------------------------------------------------------------------------------------
+// Batched BC1-3 Compression
+//-------------------------------------------------------------------------------------
+_Use_decl_annotations_
+void DirectX::D3DXEncodeBC1Batch(uint8_t *pBC, const uint32_t *pPixels, size_t count, float threshold, uint32_t flags) noexcept
+{
+    assert(pBC && pPixels);
+    static_assert(sizeof(D3DX_BC1) == 8, "D3DX_BC1 should be 8 bytes");
+
+    auto pBC1 = reinterpret_cast<D3DX_BC1 *>(pBC);
+    flags &= ~(BC_FLAGS_DITHER_RGB | BC_FLAGS_DITHER_A);
+
+#if defined(__AVX2__) || defined(_XM_SSE_INTRINSICS_)
+    XM_ALIGNED_DATA(32) BatchPlanes planes;
+    D3DX_BC1 Block[BATCH_LANES];
+
+    for (size_t iFirst = 0; iFirst < count; iFirst += BATCH_LANES)
+    {
+        const size_t nBlocks = std::min(BATCH_LANES, count - iFirst);
+        LoadBatch(planes, pPixels + iFirst * NUM_PIXELS_PER_BLOCK, nBlocks);
+        EncodeBC1Lanes(Block, planes, flags);
+
+        for (size_t iBlock = 0; iBlock < nBlocks; ++iBlock)
+        {
+            // Transparent pixels need 3-color mode, those blocks take the reference encoder
+            const uint32_t *pBlock = pPixels + (iFirst + iBlock) * NUM_PIXELS_PER_BLOCK;
+            if (HasColorKey(pBlock, threshold))
+            {
+                XMVECTOR temp[NUM_PIXELS_PER_BLOCK];
+                LoadBlock(temp, pBlock);
+                D3DXEncodeBC1(reinterpret_cast<uint8_t *>(&pBC1[iFirst + iBlock]), temp, threshold, flags);
+            }
+            else
+            {
+                pBC1[iFirst + iBlock] = Block[iBlock];
+            }
+        }
+    }
+#else
+    XMVECTOR temp[NUM_PIXELS_PER_BLOCK];
+    for (size_t iBlock = 0; iBlock < count; ++iBlock)
+    {
+        LoadBlock(temp, pPixels + iBlock * NUM_PIXELS_PER_BLOCK);
+        D3DXEncodeBC1(reinterpret_cast<uint8_t *>(&pBC1[iBlock]), temp, threshold, flags);
+    }
+#endif
+}
+
+_Use_decl_annotations_
+void DirectX::D3DXEncodeBC2Batch(uint8_t *pBC, const uint32_t *pPixels, size_t count, uint32_t flags) noexcept
+{
+    assert(pBC && pPixels);
+    static_assert(sizeof(D3DX_BC2) == 16, "D3DX_BC2 should be 16 bytes");
+
+    auto pBC2 = reinterpret_cast<D3DX_BC2 *>(pBC);
+    flags &= ~(BC_FLAGS_DITHER_RGB | BC_FLAGS_DITHER_A);
+
+#if defined(__AVX2__) || defined(_XM_SSE_INTRINSICS_)
+    XM_ALIGNED_DATA(32) BatchPlanes planes;
+    D3DX_BC1 Block[BATCH_LANES];
+
+    for (size_t iFirst = 0; iFirst < count; iFirst += BATCH_LANES)
+    {
+        const size_t nBlocks = std::min(BATCH_LANES, count - iFirst);
+        LoadBatch(planes, pPixels + iFirst * NUM_PIXELS_PER_BLOCK, nBlocks);
+        EncodeBC1Lanes(Block, planes, flags);
+
+        for (size_t iBlock = 0; iBlock < nBlocks; ++iBlock)
+        {
+            D3DX_BC2 *pBlock = &pBC2[iFirst + iBlock];
+            const uint32_t *pBlockPixels = pPixels + (iFirst + iBlock) * NUM_PIXELS_PER_BLOCK;
+
+            // 4-bit alpha part, rounded like D3DXEncodeBC2 without dithering
+            pBlock->bitmap[0] = 0;
+            pBlock->bitmap[1] = 0;
+            for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+            {
+                const uint32_t u = ((pBlockPixels[i] >> 24) * 15 + 127) / 255;
+                pBlock->bitmap[i >> 3] >>= 4;
+                pBlock->bitmap[i >> 3] |= (u << 28);
+            }
+
+            pBlock->bc1 = Block[iBlock];
+        }
+    }
+#else
+    XMVECTOR temp[NUM_PIXELS_PER_BLOCK];
+    for (size_t iBlock = 0; iBlock < count; ++iBlock)
+    {
+        LoadBlock(temp, pPixels + iBlock * NUM_PIXELS_PER_BLOCK);
+        D3DXEncodeBC2(reinterpret_cast<uint8_t *>(&pBC2[iBlock]), temp, flags);
+    }
+#endif
+}
+
+_Use_decl_annotations_
+void DirectX::D3DXEncodeBC3Batch(uint8_t *pBC, const uint32_t *pPixels, size_t count, uint32_t flags) noexcept
+{
+    assert(pBC && pPixels);
+    static_assert(sizeof(D3DX_BC3) == 16, "D3DX_BC3 should be 16 bytes");
+
+    auto pBC3 = reinterpret_cast<D3DX_BC3 *>(pBC);
+    flags &= ~(BC_FLAGS_DITHER_RGB | BC_FLAGS_DITHER_A);
+
+#if defined(__AVX2__) || defined(_XM_SSE_INTRINSICS_)
+    XM_ALIGNED_DATA(32) BatchPlanes planes;
+    D3DX_BC1 Block[BATCH_LANES];
+    D3DX_BC3 AlphaBlock[BATCH_LANES];
+
+    for (size_t iFirst = 0; iFirst < count; iFirst += BATCH_LANES)
+    {
+        const size_t nBlocks = std::min(BATCH_LANES, count - iFirst);
+        LoadBatch(planes, pPixels + iFirst * NUM_PIXELS_PER_BLOCK, nBlocks);
+        EncodeBC1Lanes(Block, planes, flags);
+        EncodeBC3AlphaLanes(AlphaBlock, planes);
+
+        for (size_t iBlock = 0; iBlock < nBlocks; ++iBlock)
+        {
+            pBC3[iFirst + iBlock] = AlphaBlock[iBlock];
+            pBC3[iFirst + iBlock].bc1 = Block[iBlock];
+        }
+    }
+#else
+    XMVECTOR temp[NUM_PIXELS_PER_BLOCK];
+    for (size_t iBlock = 0; iBlock < count; ++iBlock)
+    {
+        LoadBlock(temp, pPixels + iBlock * NUM_PIXELS_PER_BLOCK);
+        D3DXEncodeBC3(reinterpret_cast<uint8_t *>(&pBC3[iBlock]), temp, flags);
+    }
+#endif
+}
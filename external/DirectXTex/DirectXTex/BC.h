@@ -45,6 +45,18 @@ namespace DirectX
 
         BC_FLAGS_FORCE_BC7_MODE6 = 0x100000,
         // BC7 should only use mode 6; skip other modes
+
+        BC_FLAGS_FAST_RGB = 0x200000,
+        // BC1-3 from 8-bit RGBA use the batched encoders; faster, lower quality and no dithering
+
+        BC_FLAGS_FAST_BC7 = 0x400000,
+        // BC7 tries only modes 1, 3, 5, 6 & 7 and the best ranked partitions, with least-squares endpoint refinement
+
+        BC_FLAGS_FAST_BC6H = 0x800000,
+        // BC6H uses the batched encoder: principal axis endpoints, one shape for the two region modes, no endpoint perturbation
+
+        BC_FLAGS_BATCHED_BC4_5 = 0x4000000,
+        // BC4 & BC5 use the batched encoders, which write the same blocks as the single block ones
     };
 
     //-------------------------------------------------------------------------------------
@@ -342,4 +354,22 @@ namespace DirectX
     void D3DXEncodeBC6HS(_Out_writes_(16) uint8_t *pBC, _In_reads_(NUM_PIXELS_PER_BLOCK) const XMVECTOR *pColor, _In_ uint32_t flags) noexcept;
     void D3DXEncodeBC7(_Out_writes_(16) uint8_t *pBC, _In_reads_(NUM_PIXELS_PER_BLOCK) const XMVECTOR *pColor, _In_ uint32_t flags) noexcept;
 
+    void D3DXEncodeBC1Batch(_Out_writes_(count * 8) uint8_t *pBC, _In_reads_(count * NUM_PIXELS_PER_BLOCK) const uint32_t *pPixels, _In_ size_t count, _In_ float threshold, _In_ uint32_t flags) noexcept;
+    void D3DXEncodeBC2Batch(_Out_writes_(count * 16) uint8_t *pBC, _In_reads_(count * NUM_PIXELS_PER_BLOCK) const uint32_t *pPixels, _In_ size_t count, _In_ uint32_t flags) noexcept;
+    void D3DXEncodeBC3Batch(_Out_writes_(count * 16) uint8_t *pBC, _In_reads_(count * NUM_PIXELS_PER_BLOCK) const uint32_t *pPixels, _In_ size_t count, _In_ uint32_t flags) noexcept;
+        // Encode count blocks of R8G8B8A8 pixels (16 per block, in row order) with the SIMD encoder that
+        // handles several blocks at once; BC1 blocks with transparent pixels use D3DXEncodeBC1. No dithering.
+
+    void D3DXEncodeBC6HUBatch(_Out_writes_(count * 16) uint8_t *pBC, _In_reads_(count * NUM_PIXELS_PER_BLOCK) const XMVECTOR *pColor, _In_ size_t count, _In_ uint32_t flags) noexcept;
+    void D3DXEncodeBC6HSBatch(_Out_writes_(count * 16) uint8_t *pBC, _In_reads_(count * NUM_PIXELS_PER_BLOCK) const XMVECTOR *pColor, _In_ size_t count, _In_ uint32_t flags) noexcept;
+        // Encode count blocks (16 pixels each, in row order), four at a time in the lanes of an XMVECTOR;
+        // two region modes only try the shape that splits the block best
+
+    void D3DXEncodeBC4UBatch(_Out_writes_(count * 8) uint8_t *pBC, _In_reads_(count * NUM_PIXELS_PER_BLOCK) const XMVECTOR *pColor, _In_ size_t count, _In_ uint32_t flags) noexcept;
+    void D3DXEncodeBC4SBatch(_Out_writes_(count * 8) uint8_t *pBC, _In_reads_(count * NUM_PIXELS_PER_BLOCK) const XMVECTOR *pColor, _In_ size_t count, _In_ uint32_t flags) noexcept;
+    void D3DXEncodeBC5UBatch(_Out_writes_(count * 16) uint8_t *pBC, _In_reads_(count * NUM_PIXELS_PER_BLOCK) const XMVECTOR *pColor, _In_ size_t count, _In_ uint32_t flags) noexcept;
+    void D3DXEncodeBC5SBatch(_Out_writes_(count * 16) uint8_t *pBC, _In_reads_(count * NUM_PIXELS_PER_BLOCK) const XMVECTOR *pColor, _In_ size_t count, _In_ uint32_t flags) noexcept;
+        // Encode count blocks (16 pixels each, in row order), four channels at a time in the lanes of an XMVECTOR;
+        // the result is identical to D3DXEncodeBC4U/S and D3DXEncodeBC5U/S block by block
+
 } // namespace
@@ -375,6 +375,234 @@ namespace
             pBC->SetIndex(i, uBestIndex);
         }
     }
+
+
+    //------------------------------------------------------------------------------
+    // Batched encoding
+    //
+    // BC4_LANES single channel blocks are fit and indexed at once, one per XMVECTOR lane. The lanes
+    // repeat the float operations of FindEndPointsBC4U/S, OptimizeAlpha and FindClosestUNORM/SNORM in
+    // the same order, so every block is bit for bit the one the scalar encoders write. That only holds
+    // while the compiler keeps that order, which is why the projects build this file with /fp:precise.
+    //------------------------------------------------------------------------------
+    constexpr size_t BC4_LANES = 4;
+
+    inline void QuantizeEndPoint(_In_ float fVal, _Out_ uint8_t& endpoint) noexcept
+    {
+        endpoint = static_cast<uint8_t>(fVal * 255.0f);
+    }
+
+    inline void QuantizeEndPoint(_In_ float fVal, _Out_ int8_t& endpoint) noexcept
+    {
+        FloatToSNorm(fVal, &endpoint);
+    }
+
+    // OptimizeAlpha for every lane, bSix selects the lanes that use 6 interpolated values. A lane stops
+    // moving its endpoints on the iteration the scalar loop would break out of.
+    template <bool bRange> void OptimizeAlphaLanes(
+        _Out_ XMVECTOR* pX,
+        _Out_ XMVECTOR* pY,
+        _In_reads_(NUM_PIXELS_PER_BLOCK) const XMVECTOR pPoints[],
+        _In_ FXMVECTOR bSix) noexcept
+    {
+        const XMVECTOR vMinValue = XMVectorReplicate((bRange) ? -1.0f : 0.0f);
+        const XMVECTOR vMaxValue = g_XMOne;
+        const XMVECTOR vHalf = g_XMOneHalf;
+        const XMVECTOR vSteps = XMVectorSelect(XMVectorReplicate(7.0f), XMVectorReplicate(5.0f), bSix);
+        const XMVECTOR vMinStep = XMVectorReplicate(6.0f);
+        const XMVECTOR vMaxStep = XMVectorReplicate(7.0f);
+
+        // Find Min and Max points, as starting point
+        XMVECTOR fX = vMaxValue;
+        XMVECTOR fY = vMinValue;
+        for (size_t iPoint = 0; iPoint < NUM_PIXELS_PER_BLOCK; iPoint++)
+        {
+            const XMVECTOR p = pPoints[iPoint];
+            const XMVECTOR bLess = XMVectorLess(p, fX);
+            const XMVECTOR bGreater = XMVectorGreater(p, fY);
+            fX = XMVectorSelect(fX, p, XMVectorSelect(bLess, XMVectorAndInt(bLess, XMVectorGreater(p, vMinValue)), bSix));
+            fY = XMVectorSelect(fY, p, XMVectorSelect(bGreater, XMVectorAndInt(bGreater, XMVectorLess(p, vMaxValue)), bSix));
+        }
+        fY = XMVectorSelect(fY, vMaxValue, XMVectorAndInt(bSix, XMVectorEqual(fX, fY)));
+
+        // Use Newton's Method to find local minima of sum-of-squares error.
+        XMVECTOR bActive = XMVectorTrueInt();
+        for (size_t iIteration = 0; iIteration < 8; iIteration++)
+        {
+            bActive = XMVectorAndCInt(bActive, XMVectorLess(XMVectorSubtract(fY, fX), XMVectorReplicate(1.0f / 256.0f)));
+            if (XMVector4EqualInt(bActive, XMVectorFalseInt()))
+                break;
+
+            const XMVECTOR fScale = XMVectorDivide(vSteps, XMVectorSubtract(fY, fX));
+
+            XMVECTOR dX = g_XMZero;
+            XMVECTOR dY = g_XMZero;
+            XMVECTOR d2X = g_XMZero;
+            XMVECTOR d2Y = g_XMZero;
+
+            for (size_t iPoint = 0; iPoint < NUM_PIXELS_PER_BLOCK; iPoint++)
+            {
+                const XMVECTOR p = pPoints[iPoint];
+                const XMVECTOR fDot = XMVectorMultiply(XMVectorSubtract(p, fX), fScale);
+
+                const XMVECTOR vLowStep = XMVectorSelect(g_XMZero, vMinStep,
+                    XMVectorAndInt(bSix, XMVectorLessOrEqual(p, XMVectorMultiply(XMVectorAdd(fX, vMinValue), vHalf))));
+                const XMVECTOR vHighStep = XMVectorSelect(vSteps, vMaxStep,
+                    XMVectorAndInt(bSix, XMVectorGreaterOrEqual(p, XMVectorMultiply(XMVectorAdd(fY, vMaxValue), vHalf))));
+                XMVECTOR vStep = XMVectorTruncate(XMVectorAdd(fDot, vHalf));
+                vStep = XMVectorSelect(vStep, vHighStep, XMVectorGreaterOrEqual(fDot, vSteps));
+                vStep = XMVectorSelect(vStep, vLowStep, XMVectorLessOrEqual(fDot, g_XMZero));
+
+                // pC[iStep] and pD[iStep], zero for the steps past cSteps so those points add nothing
+                const XMVECTOR bInRange = XMVectorLessOrEqual(vStep, vSteps);
+                const XMVECTOR c = XMVectorSelect(g_XMZero, XMVectorDivide(XMVectorSubtract(vSteps, vStep), vSteps), bInRange);
+                const XMVECTOR d = XMVectorSelect(g_XMZero, XMVectorDivide(vStep, vSteps), bInRange);
+
+                const XMVECTOR fDiff = XMVectorSubtract(XMVectorAdd(XMVectorMultiply(c, fX), XMVectorMultiply(d, fY)), p);
+
+                dX = XMVectorAdd(dX, XMVectorMultiply(c, fDiff));
+                d2X = XMVectorAdd(d2X, XMVectorMultiply(c, c));
+
+                dY = XMVectorAdd(dY, XMVectorMultiply(d, fDiff));
+                d2Y = XMVectorAdd(d2Y, XMVectorMultiply(d, d));
+            }
+
+            // Move endpoints
+            XMVECTOR fNewX = XMVectorSelect(fX, XMVectorSubtract(fX, XMVectorDivide(dX, d2X)), XMVectorGreater(d2X, g_XMZero));
+            XMVECTOR fNewY = XMVectorSelect(fY, XMVectorSubtract(fY, XMVectorDivide(dY, d2Y)), XMVectorGreater(d2Y, g_XMZero));
+
+            const XMVECTOR bSwap = XMVectorGreater(fNewX, fNewY);
+            fX = XMVectorSelect(fX, XMVectorSelect(fNewX, fNewY, bSwap), bActive);
+            fY = XMVectorSelect(fY, XMVectorSelect(fNewY, fNewX, bSwap), bActive);
+
+            const XMVECTOR vLimit = XMVectorReplicate(1.0f / 64.0f);
+            bActive = XMVectorAndCInt(bActive, XMVectorAndInt(XMVectorLess(XMVectorMultiply(dX, dX), vLimit),
+                XMVectorLess(XMVectorMultiply(dY, dY), vLimit)));
+        }
+
+        *pX = XMVectorSelect(XMVectorSelect(fX, vMaxValue, XMVectorGreater(fX, vMaxValue)), vMinValue, XMVectorLess(fX, vMinValue));
+        *pY = XMVectorSelect(XMVectorSelect(fY, vMaxValue, XMVectorGreater(fY, vMaxValue)), vMinValue, XMVectorLess(fY, vMinValue));
+    }
+
+    // FindEndPointsBC4U/S followed by FindClosestUNORM/SNORM, the lanes of theTexels hold one block each
+    template <bool bRange, class BC4> void EncodeBC4Lanes(
+        _In_reads_(NUM_PIXELS_PER_BLOCK) const XMVECTOR theTexels[],
+        _In_reads_(BC4_LANES) BC4* const pBC[]) noexcept
+    {
+        const XMVECTOR vMinNorm = XMVectorReplicate((bRange) ? -1.0f : 0.0f);
+
+        // Find max/min of input texels
+        XMVECTOR vBlockMax = theTexels[0];
+        XMVECTOR vBlockMin = theTexels[0];
+        for (size_t i = 0; i < BLOCK_SIZE; ++i)
+        {
+            vBlockMin = XMVectorSelect(vBlockMin, theTexels[i], XMVectorLess(theTexels[i], vBlockMin));
+            vBlockMax = XMVectorSelect(vBlockMax, theTexels[i], XMVectorGreater(theTexels[i], vBlockMax));
+        }
+
+        // Lanes with boundary values use 4 interpolated color values, see FindEndPointsBC4U
+        const XMVECTOR bUsing4BlockCodec = XMVectorOrInt(XMVectorEqual(vBlockMin, vMinNorm), XMVectorEqual(vBlockMax, g_XMOne));
+
+        XMVECTOR vStart, vEnd;
+        OptimizeAlphaLanes<bRange>(&vStart, &vEnd, theTexels, bUsing4BlockCodec);
+
+        XMFLOAT4A start, end;
+        XMUINT4 using4BlockCodec;
+        XMStoreFloat4A(&start, vStart);
+        XMStoreFloat4A(&end, vEnd);
+        XMStoreUInt4(&using4BlockCodec, bUsing4BlockCodec);
+
+        XMVECTOR rGradient[8];
+        for (size_t l = 0; l < BC4_LANES; ++l)
+        {
+            memset(pBC[l], 0, sizeof(BC4));
+            const float fStart = reinterpret_cast<const float*>(&start)[l];
+            const float fEnd = reinterpret_cast<const float*>(&end)[l];
+            if (!reinterpret_cast<const uint32_t*>(&using4BlockCodec)[l])
+            {
+                QuantizeEndPoint(fEnd, pBC[l]->red_0);
+                QuantizeEndPoint(fStart, pBC[l]->red_1);
+            }
+            else
+            {
+                QuantizeEndPoint(fStart, pBC[l]->red_0);
+                QuantizeEndPoint(fEnd, pBC[l]->red_1);
+            }
+        }
+
+        for (size_t i = 0; i < 8; ++i)
+        {
+            rGradient[i] = XMVectorSet(pBC[0]->DecodeFromIndex(i), pBC[1]->DecodeFromIndex(i),
+                pBC[2]->DecodeFromIndex(i), pBC[3]->DecodeFromIndex(i));
+        }
+
+        // The 3 bit indices of 8 pixels sum up to at most 2^24 - 1, which a float holds exactly
+        const XMVECTOR vStartDelta = XMVectorReplicate(100000.0f);
+        XMVECTOR vIndices[2] = { g_XMZero, g_XMZero };
+        for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+        {
+            XMVECTOR vBestIndex = g_XMZero;
+            XMVECTOR vBestDelta = vStartDelta;
+            for (size_t uIndex = 0; uIndex < 8; uIndex++)
+            {
+                const XMVECTOR vCurrentDelta = XMVectorAbs(XMVectorSubtract(rGradient[uIndex], theTexels[i]));
+                const XMVECTOR bCloser = XMVectorLess(vCurrentDelta, vBestDelta);
+                vBestIndex = XMVectorSelect(vBestIndex, XMVectorReplicate(float(uIndex)), bCloser);
+                vBestDelta = XMVectorSelect(vBestDelta, vCurrentDelta, bCloser);
+            }
+
+            vIndices[i / 8] = XMVectorAdd(vIndices[i / 8], XMVectorScale(vBestIndex, float(1u << (3 * (i % 8)))));
+        }
+
+        XMUINT4 indices[2];
+        XMStoreUInt4(&indices[0], XMConvertVectorFloatToUInt(vIndices[0], 0));
+        XMStoreUInt4(&indices[1], XMConvertVectorFloatToUInt(vIndices[1], 0));
+        for (size_t l = 0; l < BC4_LANES; ++l)
+        {
+            pBC[l]->data |= (uint64_t(reinterpret_cast<const uint32_t*>(&indices[0])[l]) << 16)
+                | (uint64_t(reinterpret_cast<const uint32_t*>(&indices[1])[l]) << 40);
+        }
+    }
+
+    // Encodes count blocks of uChannels channels, each channel a BC4 block of its own: BC4 is the red
+    // channel, BC5 red then green. Unused lanes of the last step encode into a scratch block.
+    template <bool bRange, class BC4> void EncodeBC4Batch(
+        _Out_writes_(count * uChannels * sizeof(BC4)) uint8_t *pBC,
+        _In_reads_(count * NUM_PIXELS_PER_BLOCK) const XMVECTOR *pColor,
+        _In_ size_t count,
+        _In_ size_t uChannels) noexcept
+    {
+        const size_t uTotal = count * uChannels;
+        for (size_t uFirst = 0; uFirst < uTotal; uFirst += BC4_LANES)
+        {
+            BC4 scratch[BC4_LANES];
+            BC4* pLanes[BC4_LANES];
+            float theTexels[BC4_LANES][NUM_PIXELS_PER_BLOCK];
+            for (size_t l = 0; l < BC4_LANES; ++l)
+            {
+                const size_t uBlock = std::min(uFirst + l, uTotal - 1);
+                pLanes[l] = (uFirst + l < uTotal) ? reinterpret_cast<BC4*>(pBC + uBlock * sizeof(BC4)) : &scratch[l];
+
+                const XMVECTOR *pPixels = pColor + (uBlock / uChannels) * NUM_PIXELS_PER_BLOCK;
+                const size_t uChannel = uBlock % uChannels;
+                for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+                {
+                    XMFLOAT4A clr;
+                    XMStoreFloat4A(&clr, pPixels[i]);
+                    theTexels[l][i] = uChannel ? clr.y : clr.x;
+                }
+            }
+
+            XMVECTOR vTexels[NUM_PIXELS_PER_BLOCK];
+            for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+            {
+                vTexels[i] = XMVectorSet(theTexels[0][i], theTexels[1][i], theTexels[2][i], theTexels[3][i]);
+            }
+
+            EncodeBC4Lanes<bRange>(vTexels, pLanes);
+        }
+    }
+
 }
 
 
@@ -560,3 +788,39 @@ void DirectX::D3DXEncodeBC5S(uint8_t *pBC, const XMVECTOR *pColor, uint32_t flag
     FindClosestSNORM(pBCR, theTexelsU);
     FindClosestSNORM(pBCG, theTexelsV);
 }
+
+
+//-------------------------------------------------------------------------------------
+// Batched BC4 and BC5 Compression
+//-------------------------------------------------------------------------------------
+_Use_decl_annotations_
+void DirectX::D3DXEncodeBC4UBatch(uint8_t *pBC, const XMVECTOR *pColor, size_t count, uint32_t flags) noexcept
+{
+    UNREFERENCED_PARAMETER(flags);
+    assert(pBC && pColor);
+    EncodeBC4Batch<false, BC4_UNORM>(pBC, pColor, count, 1);
+}
+
+_Use_decl_annotations_
+void DirectX::D3DXEncodeBC4SBatch(uint8_t *pBC, const XMVECTOR *pColor, size_t count, uint32_t flags) noexcept
+{
+    UNREFERENCED_PARAMETER(flags);
+    assert(pBC && pColor);
+    EncodeBC4Batch<true, BC4_SNORM>(pBC, pColor, count, 1);
+}
+
+_Use_decl_annotations_
+void DirectX::D3DXEncodeBC5UBatch(uint8_t *pBC, const XMVECTOR *pColor, size_t count, uint32_t flags) noexcept
+{
+    UNREFERENCED_PARAMETER(flags);
+    assert(pBC && pColor);
+    EncodeBC4Batch<false, BC4_UNORM>(pBC, pColor, count, 2);
+}
+
+_Use_decl_annotations_
+void DirectX::D3DXEncodeBC5SBatch(uint8_t *pBC, const XMVECTOR *pColor, size_t count, uint32_t flags) noexcept
+{
+    UNREFERENCED_PARAMETER(flags);
+    assert(pBC && pColor);
+    EncodeBC4Batch<true, BC4_SNORM>(pBC, pColor, count, 2);
+}
@@ -669,6 +669,10 @@ namespace
         void Decode(_In_ bool bSigned, _Out_writes_(NUM_PIXELS_PER_BLOCK) HDRColorA* pOut) const noexcept;
         void Encode(_In_ bool bSigned, _In_reads_(NUM_PIXELS_PER_BLOCK) const HDRColorA* const pIn) noexcept;
 
+        // Encodes count blocks, c_BatchLanes at a time
+        static void EncodeBatch(_In_ bool bSigned, _Out_writes_(count) D3DX_BC6H* pBlocks,
+            _In_reads_(count * NUM_PIXELS_PER_BLOCK) const HDRColorA* pIn, _In_ size_t count) noexcept;
+
     private:
     #pragma warning(push)
     #pragma warning(disable : 4480)
@@ -764,6 +768,13 @@ namespace
         static constexpr uint8_t c_NumModes = 14;
         static constexpr uint8_t c_NumModeInfo = 32;
 
+        // EncodeBatch: blocks per XMVECTOR, the first single region mode, how far it refines the axis
+        // and how much worse a split may look than the single region result and still be fit
+        static constexpr size_t c_BatchLanes = 4;
+        static constexpr uint8_t c_FirstSingleRegionMode = 10;
+        static constexpr size_t c_PowerIterations = 4;
+        static constexpr float c_SplitErrMargin = 4.0f;
+
         static const ModeDescriptor ms_aDesc[c_NumModes][82];
         static const ModeInfo ms_aInfo[c_NumModes];
         static const int ms_aModeToInfo[c_NumModeInfo];
@@ -864,6 +875,13 @@ namespace
         void FixEndpointPBits(_In_ const EncodeParams* pEP, _In_reads_(BC7_MAX_REGIONS) const LDREndPntPair *pOrigEndpoints, _Out_writes_(BC7_MAX_REGIONS) LDREndPntPair *pFixedEndpoints) noexcept;
         float Refine(_In_ const EncodeParams* pEP, _In_ size_t uShape, _In_ size_t uRotation, _In_ size_t uIndexMode) noexcept;
 
+        void EncodeFast(_Inout_ EncodeParams* pEP, _In_ bool bHasAlpha) noexcept;
+        size_t SelectShapes(_In_ const EncodeParams* pEP, _Out_writes_(c_FastShapes) size_t auShapes[]) const noexcept;
+        void FitEndPoints(_In_ const EncodeParams* pEP, _In_ size_t uShape,
+            _In_reads_(NUM_PIXELS_PER_BLOCK) const size_t aIndices[], _In_reads_(NUM_PIXELS_PER_BLOCK) const size_t aIndices2[],
+            _Out_writes_(BC7_MAX_REGIONS) LDREndPntPair aEndPts[]) const noexcept;
+        float RefineFast(_In_ const EncodeParams* pEP, _In_ size_t uShape) noexcept;
+
         float MapColors(_In_ const EncodeParams* pEP, _In_reads_(np) const LDRColorA aColors[], _In_ size_t np, _In_ size_t uIndexMode,
             _In_ const LDREndPntPair& endPts, _In_ float fMinErr) const noexcept;
         static float RoughMSE(_Inout_ EncodeParams* pEP, _In_ size_t uShape, _In_ size_t uIndexMode) noexcept;
@@ -871,6 +889,12 @@ namespace
     private:
         static constexpr uint8_t c_NumModes = 8;
 
+        // BC_FLAGS_FAST_BC7 refines this many of the best ranked partitions per mode
+        static constexpr size_t c_FastShapes = 2;
+
+        // and refits the endpoints at most this many times
+        static constexpr size_t c_FastRefits = 2;
+
         static const ModeInfo ms_aInfo[c_NumModes];
     };
 }
@@ -1635,6 +1659,51 @@ namespace
     }
 
 
+    //-------------------------------------------------------------------------------------
+    // Squared error left over when the pixels are fitted by the line along their principal
+    // axis. Takes the sums of the pixels and of their outer products (one row per channel),
+    // the axis is found with a few power iterations of the covariance matrix.
+    float EstimateLineError(
+        size_t np,
+        FXMVECTOR sum,
+        _In_reads_(BC7_NUM_CHANNELS) const XMVECTOR aProducts[]) noexcept
+    {
+        if (np < 3)
+            return 0.0f;
+
+        const XMVECTOR mean = XMVectorScale(sum, 1.0f / float(np));
+        XMVECTOR aCov[BC7_NUM_CHANNELS];
+        aCov[0] = XMVectorNegativeMultiplySubtract(sum, XMVectorSplatX(mean), aProducts[0]);
+        aCov[1] = XMVectorNegativeMultiplySubtract(sum, XMVectorSplatY(mean), aProducts[1]);
+        aCov[2] = XMVectorNegativeMultiplySubtract(sum, XMVectorSplatZ(mean), aProducts[2]);
+        aCov[3] = XMVectorNegativeMultiplySubtract(sum, XMVectorSplatW(mean), aProducts[3]);
+
+        const float fTrace = XMVectorGetX(aCov[0]) + XMVectorGetY(aCov[1]) + XMVectorGetZ(aCov[2]) + XMVectorGetW(aCov[3]);
+        if (fTrace <= 0.0f)
+            return 0.0f;
+
+        // Starting from the sum of the rows avoids an axis orthogonal to the answer for the usual blocks
+        XMVECTOR axis = XMVectorAdd(XMVectorAdd(aCov[0], aCov[1]), XMVectorAdd(aCov[2], aCov[3]));
+        XMVECTOR lambda = g_XMZero;
+        for (size_t iter = 0; iter < 4; ++iter)
+        {
+            const float fLength = XMVectorGetX(XMVector4Dot(axis, axis));
+            if (fLength <= 0.0f)
+                break;
+            axis = XMVectorScale(axis, 1.0f / sqrtf(fLength));
+
+            XMVECTOR next = XMVectorMultiply(aCov[0], XMVectorSplatX(axis));
+            next = XMVectorMultiplyAdd(aCov[1], XMVectorSplatY(axis), next);
+            next = XMVectorMultiplyAdd(aCov[2], XMVectorSplatZ(axis), next);
+            next = XMVectorMultiplyAdd(aCov[3], XMVectorSplatW(axis), next);
+            lambda = XMVector4Dot(axis, next);
+            axis = next;
+        }
+
+        return std::max(0.0f, fTrace - XMVectorGetX(lambda));
+    }
+
+
     void FillWithErrorColors(_Out_writes_(NUM_PIXELS_PER_BLOCK) HDRColorA* pOut) noexcept
     {
         for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
@@ -2559,6 +2628,258 @@ float D3DX_BC6H::RoughMSE(EncodeParams* pEP) const noexcept
 }
 
 
+//-------------------------------------------------------------------------------------
+// Batched BC6H encoding (BC_FLAGS_FAST_BC6H)
+//
+// The endpoints of a block come from the principal axis of its pixels and every pixel takes the
+// nearest palette entry. Both run on c_BatchLanes blocks at once, one block per XMVECTOR lane;
+// quantizing, the fit check of the transformed modes and emitting the bits stay per block.
+// The two region modes get a single shape, ranked in the lanes, and no endpoint perturbation.
+//-------------------------------------------------------------------------------------
+_Use_decl_annotations_
+void D3DX_BC6H::EncodeBatch(bool bSigned, D3DX_BC6H* pBlocks, const HDRColorA* pIn, size_t count) noexcept
+{
+    assert(pBlocks && pIn);
+    static_assert(c_BatchLanes == 4, "lanes are filled as XMVECTOR components");
+
+    const XMVECTOR vMin = XMVectorReplicate(bSigned ? -float(F16MAX) : 0.0f);
+    const XMVECTOR vMax = XMVectorReplicate(float(F16MAX));
+
+    for (size_t uFirst = 0; uFirst < count; uFirst += c_BatchLanes)
+    {
+        // Unused lanes repeat the last block, nothing is written for them
+        const size_t uLanes = std::min(c_BatchLanes, count - uFirst);
+        const HDRColorA* aLaneIn[c_BatchLanes];
+        for (size_t l = 0; l < c_BatchLanes; ++l)
+        {
+            aLaneIn[l] = pIn + (uFirst + std::min(l, uLanes - 1)) * NUM_PIXELS_PER_BLOCK;
+        }
+
+        EncodeParams aEP[c_BatchLanes] = {
+            EncodeParams(aLaneIn[0], bSigned), EncodeParams(aLaneIn[1], bSigned),
+            EncodeParams(aLaneIn[2], bSigned), EncodeParams(aLaneIn[3], bSigned) };
+
+        XMVECTOR aR[NUM_PIXELS_PER_BLOCK], aG[NUM_PIXELS_PER_BLOCK], aB[NUM_PIXELS_PER_BLOCK];
+        XMVECTOR vMeanR = g_XMZero, vMeanG = g_XMZero, vMeanB = g_XMZero;
+        for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+        {
+            aR[i] = XMVectorSet(float(aEP[0].aIPixels[i].r), float(aEP[1].aIPixels[i].r), float(aEP[2].aIPixels[i].r), float(aEP[3].aIPixels[i].r));
+            aG[i] = XMVectorSet(float(aEP[0].aIPixels[i].g), float(aEP[1].aIPixels[i].g), float(aEP[2].aIPixels[i].g), float(aEP[3].aIPixels[i].g));
+            aB[i] = XMVectorSet(float(aEP[0].aIPixels[i].b), float(aEP[1].aIPixels[i].b), float(aEP[2].aIPixels[i].b), float(aEP[3].aIPixels[i].b));
+            vMeanR = XMVectorAdd(vMeanR, aR[i]);
+            vMeanG = XMVectorAdd(vMeanG, aG[i]);
+            vMeanB = XMVectorAdd(vMeanB, aB[i]);
+        }
+        vMeanR = XMVectorScale(vMeanR, 1.0f / float(NUM_PIXELS_PER_BLOCK));
+        vMeanG = XMVectorScale(vMeanG, 1.0f / float(NUM_PIXELS_PER_BLOCK));
+        vMeanB = XMVectorScale(vMeanB, 1.0f / float(NUM_PIXELS_PER_BLOCK));
+
+        XMVECTOR vRR = g_XMZero, vGG = g_XMZero, vBB = g_XMZero;
+        XMVECTOR vRG = g_XMZero, vRB = g_XMZero, vGB = g_XMZero;
+        for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+        {
+            const XMVECTOR dr = XMVectorSubtract(aR[i], vMeanR);
+            const XMVECTOR dg = XMVectorSubtract(aG[i], vMeanG);
+            const XMVECTOR db = XMVectorSubtract(aB[i], vMeanB);
+            vRR = XMVectorMultiplyAdd(dr, dr, vRR);
+            vGG = XMVectorMultiplyAdd(dg, dg, vGG);
+            vBB = XMVectorMultiplyAdd(db, db, vBB);
+            vRG = XMVectorMultiplyAdd(dr, dg, vRG);
+            vRB = XMVectorMultiplyAdd(dr, db, vRB);
+            vGB = XMVectorMultiplyAdd(dg, db, vGB);
+        }
+
+        // Power iteration, starting from the covariance column of the channel that varies most
+        const XMVECTOR bRLargest = XMVectorAndInt(XMVectorGreaterOrEqual(vRR, vGG), XMVectorGreaterOrEqual(vRR, vBB));
+        const XMVECTOR bGLargest = XMVectorGreaterOrEqual(vGG, vBB);
+        XMVECTOR vAxisR = XMVectorSelect(XMVectorSelect(vRB, vRG, bGLargest), vRR, bRLargest);
+        XMVECTOR vAxisG = XMVectorSelect(XMVectorSelect(vGB, vGG, bGLargest), vRG, bRLargest);
+        XMVECTOR vAxisB = XMVectorSelect(XMVectorSelect(vBB, vGB, bGLargest), vRB, bRLargest);
+        for (size_t uIter = 0; ; ++uIter)
+        {
+            // A solid block has no axis, both of its endpoints end up at the mean
+            const XMVECTOR vLengthSq = XMVectorMultiplyAdd(vAxisR, vAxisR, XMVectorMultiplyAdd(vAxisG, vAxisG, XMVectorMultiply(vAxisB, vAxisB)));
+            const XMVECTOR bValid = XMVectorGreater(vLengthSq, g_XMEpsilon);
+            const XMVECTOR vScale = XMVectorSelect(g_XMZero, XMVectorReciprocalSqrt(XMVectorSelect(g_XMOne, vLengthSq, bValid)), bValid);
+            vAxisR = XMVectorMultiply(vAxisR, vScale);
+            vAxisG = XMVectorMultiply(vAxisG, vScale);
+            vAxisB = XMVectorMultiply(vAxisB, vScale);
+            if (uIter == c_PowerIterations)
+                break;
+
+            const XMVECTOR vNextR = XMVectorMultiplyAdd(vRR, vAxisR, XMVectorMultiplyAdd(vRG, vAxisG, XMVectorMultiply(vRB, vAxisB)));
+            const XMVECTOR vNextG = XMVectorMultiplyAdd(vRG, vAxisR, XMVectorMultiplyAdd(vGG, vAxisG, XMVectorMultiply(vGB, vAxisB)));
+            const XMVECTOR vNextB = XMVectorMultiplyAdd(vRB, vAxisR, XMVectorMultiplyAdd(vGB, vAxisG, XMVectorMultiply(vBB, vAxisB)));
+            vAxisR = vNextR;
+            vAxisG = vNextG;
+            vAxisB = vNextB;
+        }
+
+        // Endpoints at the extreme projections onto the axis
+        XMVECTOR vTMin = g_XMZero, vTMax = g_XMZero;
+        for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+        {
+            const XMVECTOR t = XMVectorMultiplyAdd(XMVectorSubtract(aR[i], vMeanR), vAxisR,
+                XMVectorMultiplyAdd(XMVectorSubtract(aG[i], vMeanG), vAxisG, XMVectorMultiply(XMVectorSubtract(aB[i], vMeanB), vAxisB)));
+            vTMin = XMVectorMin(vTMin, t);
+            vTMax = XMVectorMax(vTMax, t);
+        }
+
+        XMFLOAT4 aEndPts[6];
+        XMStoreFloat4(&aEndPts[0], XMVectorRound(XMVectorClamp(XMVectorMultiplyAdd(vAxisR, vTMin, vMeanR), vMin, vMax)));
+        XMStoreFloat4(&aEndPts[1], XMVectorRound(XMVectorClamp(XMVectorMultiplyAdd(vAxisG, vTMin, vMeanG), vMin, vMax)));
+        XMStoreFloat4(&aEndPts[2], XMVectorRound(XMVectorClamp(XMVectorMultiplyAdd(vAxisB, vTMin, vMeanB), vMin, vMax)));
+        XMStoreFloat4(&aEndPts[3], XMVectorRound(XMVectorClamp(XMVectorMultiplyAdd(vAxisR, vTMax, vMeanR), vMin, vMax)));
+        XMStoreFloat4(&aEndPts[4], XMVectorRound(XMVectorClamp(XMVectorMultiplyAdd(vAxisG, vTMax, vMeanG), vMin, vMax)));
+        XMStoreFloat4(&aEndPts[5], XMVectorRound(XMVectorClamp(XMVectorMultiplyAdd(vAxisB, vTMax, vMeanB), vMin, vMax)));
+        const float* pEndPts = reinterpret_cast<const float*>(aEndPts);
+        for (size_t l = 0; l < c_BatchLanes; ++l)
+        {
+            INTEndPntPair& endPts = aEP[l].aUnqEndPts[0][0];
+            endPts.A = INTColor(int(pEndPts[l]), int(pEndPts[4 + l]), int(pEndPts[8 + l]));
+            endPts.B = INTColor(int(pEndPts[12 + l]), int(pEndPts[16 + l]), int(pEndPts[20 + l]));
+        }
+
+        for (uint8_t uMode = c_FirstSingleRegionMode; uMode < c_NumModes; ++uMode)
+        {
+            INTEndPntPair aQntEndPts[c_BatchLanes][BC6H_MAX_REGIONS];
+            INTColor aPalette[c_BatchLanes][BC6H_MAX_INDICES];
+            for (size_t l = 0; l < c_BatchLanes; ++l)
+            {
+                aEP[l].uMode = uMode;
+                pBlocks->QuantizeEndPts(&aEP[l], aQntEndPts[l]);
+                pBlocks->GeneratePaletteQuantized(&aEP[l], aQntEndPts[l][0], aPalette[l]);
+            }
+
+            const size_t uNumIndices = size_t(1) << ms_aInfo[uMode].uIndexPrec;
+            XMVECTOR aPalR[BC6H_MAX_INDICES], aPalG[BC6H_MAX_INDICES], aPalB[BC6H_MAX_INDICES];
+            for (size_t j = 0; j < uNumIndices; ++j)
+            {
+                aPalR[j] = XMVectorSet(float(aPalette[0][j].r), float(aPalette[1][j].r), float(aPalette[2][j].r), float(aPalette[3][j].r));
+                aPalG[j] = XMVectorSet(float(aPalette[0][j].g), float(aPalette[1][j].g), float(aPalette[2][j].g), float(aPalette[3][j].g));
+                aPalB[j] = XMVectorSet(float(aPalette[0][j].b), float(aPalette[1][j].b), float(aPalette[2][j].b), float(aPalette[3][j].b));
+            }
+
+            // Nearest palette entry, the first one on a tie like AssignIndices
+            XMFLOAT4 aLaneIndices[NUM_PIXELS_PER_BLOCK];
+            XMVECTOR vTotErr = g_XMZero;
+            for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+            {
+                XMVECTOR vBestErr = g_XMFltMax;
+                XMVECTOR vBestIndex = g_XMZero;
+                for (size_t j = 0; j < uNumIndices; ++j)
+                {
+                    const XMVECTOR dr = XMVectorSubtract(aR[i], aPalR[j]);
+                    const XMVECTOR dg = XMVectorSubtract(aG[i], aPalG[j]);
+                    const XMVECTOR db = XMVectorSubtract(aB[i], aPalB[j]);
+                    const XMVECTOR vErr = XMVectorMultiplyAdd(dr, dr, XMVectorMultiplyAdd(dg, dg, XMVectorMultiply(db, db)));
+                    const XMVECTOR bCloser = XMVectorLess(vErr, vBestErr);
+                    vBestErr = XMVectorSelect(vBestErr, vErr, bCloser);
+                    vBestIndex = XMVectorSelect(vBestIndex, XMVectorReplicate(float(j)), bCloser);
+                }
+                vTotErr = XMVectorAdd(vTotErr, vBestErr);
+                XMStoreFloat4(&aLaneIndices[i], vBestIndex);
+            }
+
+            XMFLOAT4 totErr;
+            XMStoreFloat4(&totErr, vTotErr);
+            for (size_t l = 0; l < uLanes; ++l)
+            {
+                const float fErr = reinterpret_cast<const float*>(&totErr)[l];
+                if (fErr >= aEP[l].fBestErr)
+                    continue;
+
+                size_t aIndices[NUM_PIXELS_PER_BLOCK];
+                for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+                {
+                    aIndices[i] = size_t(reinterpret_cast<const float*>(&aLaneIndices[i])[l]);
+                }
+
+                SwapIndices(&aEP[l], aQntEndPts[l], aIndices);
+                if (ms_aInfo[uMode].bTransformed)
+                    TransformForward(aQntEndPts[l]);
+                if (EndPointsFit(&aEP[l], aQntEndPts[l]))
+                {
+                    aEP[l].fBestErr = fErr;
+                    pBlocks[uFirst + l].EmitBlock(&aEP[l], aQntEndPts[l], aIndices);
+                }
+            }
+        }
+
+        // Rank the two region shapes by the squared distance of the pixels to the means of their regions.
+        // The centred sums of the whole block are zero, so region 0's sums are minus those of region 1.
+        XMVECTOR vTotSq = g_XMZero;
+        for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+        {
+            aR[i] = XMVectorSubtract(aR[i], vMeanR);
+            aG[i] = XMVectorSubtract(aG[i], vMeanG);
+            aB[i] = XMVectorSubtract(aB[i], vMeanB);
+            vTotSq = XMVectorMultiplyAdd(aR[i], aR[i], XMVectorMultiplyAdd(aG[i], aG[i], XMVectorMultiplyAdd(aB[i], aB[i], vTotSq)));
+        }
+
+        XMVECTOR vBestSplitErr = g_XMFltMax;
+        XMVECTOR vBestShape = g_XMZero;
+        for (size_t uShape = 0; uShape < BC6H_MAX_SHAPES; ++uShape)
+        {
+            XMVECTOR vSumR = g_XMZero, vSumG = g_XMZero, vSumB = g_XMZero;
+            size_t np = 0;
+            for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+            {
+                if (g_aPartitionTable[1][uShape][i])
+                {
+                    vSumR = XMVectorAdd(vSumR, aR[i]);
+                    vSumG = XMVectorAdd(vSumG, aG[i]);
+                    vSumB = XMVectorAdd(vSumB, aB[i]);
+                    ++np;
+                }
+            }
+            assert(np > 0 && np < NUM_PIXELS_PER_BLOCK);
+
+            const XMVECTOR vSumSq = XMVectorMultiplyAdd(vSumR, vSumR, XMVectorMultiplyAdd(vSumG, vSumG, XMVectorMultiply(vSumB, vSumB)));
+            const float fScale = 1.0f / float(np) + 1.0f / float(NUM_PIXELS_PER_BLOCK - np);
+            const XMVECTOR vErr = XMVectorNegativeMultiplySubtract(vSumSq, XMVectorReplicate(fScale), vTotSq);
+            const XMVECTOR bBetter = XMVectorLess(vErr, vBestSplitErr);
+            vBestSplitErr = XMVectorSelect(vBestSplitErr, vErr, bBetter);
+            vBestShape = XMVectorSelect(vBestShape, XMVectorReplicate(float(uShape)), bBetter);
+        }
+
+        // Only the best shape is fit, and only for blocks the split could improve on. The distance to the
+        // means overstates what lines through the regions leave, hence the margin.
+        XMFLOAT4 bestSplitErr, bestShape;
+        XMStoreFloat4(&bestSplitErr, vBestSplitErr);
+        XMStoreFloat4(&bestShape, vBestShape);
+        for (size_t l = 0; l < uLanes; ++l)
+        {
+            EncodeParams& EP = aEP[l];
+            if (reinterpret_cast<const float*>(&bestSplitErr)[l] >= c_SplitErrMargin * EP.fBestErr)
+                continue;
+
+            EP.uMode = 0;
+            EP.uShape = static_cast<uint8_t>(reinterpret_cast<const float*>(&bestShape)[l]);
+            pBlocks->RoughMSE(&EP);
+
+            for (EP.uMode = 0; EP.uMode < c_FirstSingleRegionMode; ++EP.uMode)
+            {
+                INTEndPntPair aQntEndPts[BC6H_MAX_REGIONS];
+                size_t aIndices[NUM_PIXELS_PER_BLOCK];
+                float aTotErr[BC6H_MAX_REGIONS];
+                pBlocks->QuantizeEndPts(&EP, aQntEndPts);
+                pBlocks->AssignIndices(&EP, aQntEndPts, aIndices, aTotErr);
+                SwapIndices(&EP, aQntEndPts, aIndices);
+                if (ms_aInfo[EP.uMode].bTransformed)
+                    TransformForward(aQntEndPts);
+
+                const float fErr = aTotErr[0] + aTotErr[1];
+                if (fErr < EP.fBestErr && EndPointsFit(&EP, aQntEndPts))
+                {
+                    EP.fBestErr = fErr;
+                    pBlocks[uFirst + l].EmitBlock(&EP, aQntEndPts, aIndices);
+                }
+            }
+        }
+    }
+}
+
 //-------------------------------------------------------------------------------------
 // BC7 Compression
 //-------------------------------------------------------------------------------------
@@ -2800,6 +3121,12 @@ void D3DX_BC7::Encode(uint32_t flags, const HDRColorA* const pIn) noexcept
 
     const bool bHasAlpha = (alphaMask != 0xFF);
 
+    if (flags & BC_FLAGS_FAST_BC7)
+    {
+        EncodeFast(&EP, bHasAlpha);
+        return;
+    }
+
     for (EP.uMode = 0; EP.uMode < 8 && fMSEBest > 0; ++EP.uMode)
     {
         if (!(flags & BC_FLAGS_USE_3SUBSETS) && (EP.uMode == 0 || EP.uMode == 2))
@@ -3597,6 +3924,259 @@ float D3DX_BC7::RoughMSE(EncodeParams* pEP, size_t uShape, size_t uIndexMode) no
 }
 
 
+//-------------------------------------------------------------------------------------
+// Fast BC7 encoding (BC_FLAGS_FAST_BC7)
+//
+// Tries only the modes that win most blocks, refines the best ranked partitions instead of
+// a quarter of them, and replaces the per channel endpoint search with least squares fits.
+//-------------------------------------------------------------------------------------
+_Use_decl_annotations_
+void D3DX_BC7::EncodeFast(EncodeParams* pEP, bool bHasAlpha) noexcept
+{
+    assert(pEP);
+
+    // Opaque blocks: mode 6 (one subset, 4-bit indices), modes 3 and 1 (two subsets, 2 and 3-bit indices).
+    // Blocks with alpha: mode 6, mode 5 (separate alpha indices, no rotation) and mode 7 (two subsets).
+    static const uint8_t s_aOpaqueModes[] = { 6, 3, 1, 0xFF };
+    static const uint8_t s_aAlphaModes[] = { 6, 5, 7, 0xFF };
+
+    D3DX_BC7 final = *this;
+    float fMSEBest = FLT_MAX;
+
+    for (const uint8_t* pMode = bHasAlpha ? s_aAlphaModes : s_aOpaqueModes; *pMode != 0xFF && fMSEBest > 0; ++pMode)
+    {
+        pEP->uMode = *pMode;
+
+        size_t auShapes[c_FastShapes];
+        const size_t uShapes = SelectShapes(pEP, auShapes);
+
+        for (size_t i = 0; i < uShapes && fMSEBest > 0; ++i)
+        {
+            RoughMSE(pEP, auShapes[i], 0);
+
+            const float fMSE = RefineFast(pEP, auShapes[i]);
+            if (fMSE < fMSEBest)
+            {
+                final = *this;
+                fMSEBest = fMSE;
+            }
+        }
+    }
+
+    *this = final;
+}
+
+_Use_decl_annotations_
+size_t D3DX_BC7::SelectShapes(const EncodeParams* pEP, size_t auShapes[]) const noexcept
+{
+    assert(pEP);
+    assert(pEP->uMode < c_NumModes);
+    _Analysis_assume_(pEP->uMode < c_NumModes);
+
+    const uint8_t uPartitions = ms_aInfo[pEP->uMode].uPartitions;
+    if (uPartitions == 0)
+    {
+        auShapes[0] = 0;
+        return 1;
+    }
+
+    // Only two subset modes are used, the second subset's sums are the block's minus the first's
+    assert(uPartitions == 1);
+
+    XMVECTOR aPixels[NUM_PIXELS_PER_BLOCK];
+    XMVECTOR blockSum = g_XMZero;
+    XMVECTOR aBlockProducts[BC7_NUM_CHANNELS] = { g_XMZero, g_XMZero, g_XMZero, g_XMZero };
+    for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+    {
+        aPixels[i] = XMLoadUByte4(reinterpret_cast<const XMUBYTE4*>(&pEP->aLDRPixels[i]));
+        blockSum = XMVectorAdd(blockSum, aPixels[i]);
+        aBlockProducts[0] = XMVectorMultiplyAdd(aPixels[i], XMVectorSplatX(aPixels[i]), aBlockProducts[0]);
+        aBlockProducts[1] = XMVectorMultiplyAdd(aPixels[i], XMVectorSplatY(aPixels[i]), aBlockProducts[1]);
+        aBlockProducts[2] = XMVectorMultiplyAdd(aPixels[i], XMVectorSplatZ(aPixels[i]), aBlockProducts[2]);
+        aBlockProducts[3] = XMVectorMultiplyAdd(aPixels[i], XMVectorSplatW(aPixels[i]), aBlockProducts[3]);
+    }
+
+    float afErr[c_FastShapes];
+    size_t uCount = 0;
+
+    const size_t uShapes = size_t(1) << ms_aInfo[pEP->uMode].uPartitionBits;
+    for (size_t uShape = 0; uShape < uShapes; ++uShape)
+    {
+        size_t np = 0;
+        XMVECTOR sum = g_XMZero;
+        XMVECTOR aProducts[BC7_NUM_CHANNELS] = { g_XMZero, g_XMZero, g_XMZero, g_XMZero };
+        for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+        {
+            if (g_aPartitionTable[1][uShape][i] == 0)
+            {
+                np++;
+                sum = XMVectorAdd(sum, aPixels[i]);
+                aProducts[0] = XMVectorMultiplyAdd(aPixels[i], XMVectorSplatX(aPixels[i]), aProducts[0]);
+                aProducts[1] = XMVectorMultiplyAdd(aPixels[i], XMVectorSplatY(aPixels[i]), aProducts[1]);
+                aProducts[2] = XMVectorMultiplyAdd(aPixels[i], XMVectorSplatZ(aPixels[i]), aProducts[2]);
+                aProducts[3] = XMVectorMultiplyAdd(aPixels[i], XMVectorSplatW(aPixels[i]), aProducts[3]);
+            }
+        }
+
+        float fErr = EstimateLineError(np, sum, aProducts);
+        for (size_t ch = 0; ch < BC7_NUM_CHANNELS; ++ch)
+            aProducts[ch] = XMVectorSubtract(aBlockProducts[ch], aProducts[ch]);
+        fErr += EstimateLineError(NUM_PIXELS_PER_BLOCK - np, XMVectorSubtract(blockSum, sum), aProducts);
+
+        // Insert into the sorted list of the best c_FastShapes
+        size_t j = uCount;
+        if (uCount < c_FastShapes)
+            uCount++;
+        else if (fErr >= afErr[c_FastShapes - 1])
+            continue;
+        else
+            j = c_FastShapes - 1;
+
+        for (; j > 0 && afErr[j - 1] > fErr; --j)
+        {
+            afErr[j] = afErr[j - 1];
+            auShapes[j] = auShapes[j - 1];
+        }
+        afErr[j] = fErr;
+        auShapes[j] = uShape;
+    }
+
+    return uCount;
+}
+
+_Use_decl_annotations_
+void D3DX_BC7::FitEndPoints(const EncodeParams* pEP, size_t uShape, const size_t aIndices[], const size_t aIndices2[], LDREndPntPair aEndPts[]) const noexcept
+{
+    assert(pEP);
+    assert(uShape < BC7_MAX_SHAPES);
+    _Analysis_assume_(uShape < BC7_MAX_SHAPES);
+    assert(pEP->uMode < c_NumModes);
+    _Analysis_assume_(pEP->uMode < c_NumModes);
+
+    const uint8_t uPartitions = ms_aInfo[pEP->uMode].uPartitions;
+    assert(uPartitions < BC7_MAX_REGIONS);
+    _Analysis_assume_(uPartitions < BC7_MAX_REGIONS);
+
+    const uint8_t uIndexPrec = ms_aInfo[pEP->uMode].uIndexPrec;
+    const uint8_t uIndexPrec2 = ms_aInfo[pEP->uMode].uIndexPrec2;
+    const int* aWeights = (uIndexPrec == 2) ? g_aWeights2 : ((uIndexPrec == 3) ? g_aWeights3 : g_aWeights4);
+    const int* aWeights2 = (uIndexPrec2 == 2) ? g_aWeights2 : ((uIndexPrec2 == 3) ? g_aWeights3 : g_aWeights4);
+
+    // Least squares for A and B with the indices fixed, all channels at once. Alpha has its
+    // own weights when the mode has separate alpha indices.
+    for (size_t p = 0; p <= uPartitions; ++p)
+    {
+        XMVECTOR aa = g_XMZero;
+        XMVECTOR ab = g_XMZero;
+        XMVECTOR bb = g_XMZero;
+        XMVECTOR ax = g_XMZero;
+        XMVECTOR bx = g_XMZero;
+        XMVECTOR sum = g_XMZero;
+        float np = 0.0f;
+
+        for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+        {
+            if (g_aPartitionTable[uPartitions][uShape][i] != p)
+                continue;
+
+            const float wc = float(aWeights[aIndices[i]]) * (1.0f / float(BC67_WEIGHT_MAX));
+            const float wa = uIndexPrec2 ? float(aWeights2[aIndices2[i]]) * (1.0f / float(BC67_WEIGHT_MAX)) : wc;
+            const XMVECTOR w = XMVectorSelect(XMVectorReplicate(wa), XMVectorReplicate(wc), g_XMSelect1110);
+            const XMVECTOR iw = XMVectorSubtract(g_XMOne, w);
+            const XMVECTOR x = XMLoadUByte4(reinterpret_cast<const XMUBYTE4*>(&pEP->aLDRPixels[i]));
+
+            aa = XMVectorMultiplyAdd(iw, iw, aa);
+            ab = XMVectorMultiplyAdd(iw, w, ab);
+            bb = XMVectorMultiplyAdd(w, w, bb);
+            ax = XMVectorMultiplyAdd(iw, x, ax);
+            bx = XMVectorMultiplyAdd(w, x, bx);
+            sum = XMVectorAdd(sum, x);
+            np += 1.0f;
+        }
+
+        // Channels whose pixels all share one weight can't be solved, both endpoints take the mean
+        const XMVECTOR det = XMVectorNegativeMultiplySubtract(ab, ab, XMVectorMultiply(aa, bb));
+        const XMVECTOR solvable = XMVectorGreater(det, XMVectorReplicate(1e-4f));
+        const XMVECTOR rdet = XMVectorDivide(g_XMOne, XMVectorSelect(g_XMOne, det, solvable));
+        const XMVECTOR mean = XMVectorScale(sum, 1.0f / std::max(np, 1.0f));
+
+        XMVECTOR a = XMVectorMultiply(XMVectorNegativeMultiplySubtract(ab, bx, XMVectorMultiply(bb, ax)), rdet);
+        XMVECTOR b = XMVectorMultiply(XMVectorNegativeMultiplySubtract(ab, ax, XMVectorMultiply(aa, bx)), rdet);
+        a = XMVectorRound(XMVectorClamp(XMVectorSelect(mean, a, solvable), g_XMZero, g_UByteMax));
+        b = XMVectorRound(XMVectorClamp(XMVectorSelect(mean, b, solvable), g_XMZero, g_UByteMax));
+
+        XMFLOAT4 fa, fb;
+        XMStoreFloat4(&fa, a);
+        XMStoreFloat4(&fb, b);
+        aEndPts[p].A = LDRColorA(uint8_t(fa.x), uint8_t(fa.y), uint8_t(fa.z), uint8_t(fa.w));
+        aEndPts[p].B = LDRColorA(uint8_t(fb.x), uint8_t(fb.y), uint8_t(fb.z), uint8_t(fb.w));
+    }
+}
+
+_Use_decl_annotations_
+float D3DX_BC7::RefineFast(const EncodeParams* pEP, size_t uShape) noexcept
+{
+    assert(pEP);
+    assert(uShape < BC7_MAX_SHAPES);
+    _Analysis_assume_(uShape < BC7_MAX_SHAPES);
+    assert(pEP->uMode < c_NumModes);
+    _Analysis_assume_(pEP->uMode < c_NumModes);
+
+    const size_t uPartitions = ms_aInfo[pEP->uMode].uPartitions;
+    assert(uPartitions < BC7_MAX_REGIONS);
+    _Analysis_assume_(uPartitions < BC7_MAX_REGIONS);
+
+    LDREndPntPair aEndPts[BC7_MAX_REGIONS];
+    LDREndPntPair aQntEndPts[BC7_MAX_REGIONS] = {};
+    LDREndPntPair aBestEndPts[BC7_MAX_REGIONS];
+    size_t aIdx[NUM_PIXELS_PER_BLOCK];
+    size_t aIdx2[NUM_PIXELS_PER_BLOCK];
+    size_t aBestIdx[NUM_PIXELS_PER_BLOCK];
+    size_t aBestIdx2[NUM_PIXELS_PER_BLOCK];
+    float aErr[BC7_MAX_REGIONS];
+
+    for (size_t p = 0; p <= uPartitions; p++)
+    {
+        aQntEndPts[p].A = Quantize(pEP->aEndPts[uShape][p].A, ms_aInfo[pEP->uMode].RGBAPrecWithP);
+        aQntEndPts[p].B = Quantize(pEP->aEndPts[uShape][p].B, ms_aInfo[pEP->uMode].RGBAPrecWithP);
+    }
+    FixEndpointPBits(pEP, aQntEndPts, aBestEndPts);
+    AssignIndices(pEP, uShape, 0, aBestEndPts, aBestIdx, aBestIdx2, aErr);
+
+    float fBestErr = 0;
+    for (size_t p = 0; p <= uPartitions; p++)
+        fBestErr += aErr[p];
+
+    for (size_t iter = 0; iter < c_FastRefits && fBestErr > 0; ++iter)
+    {
+        LDREndPntPair aFitEndPts[BC7_MAX_REGIONS];
+        FitEndPoints(pEP, uShape, aBestIdx, aBestIdx2, aFitEndPts);
+
+        for (size_t p = 0; p <= uPartitions; p++)
+        {
+            aQntEndPts[p].A = Quantize(aFitEndPts[p].A, ms_aInfo[pEP->uMode].RGBAPrecWithP);
+            aQntEndPts[p].B = Quantize(aFitEndPts[p].B, ms_aInfo[pEP->uMode].RGBAPrecWithP);
+        }
+        FixEndpointPBits(pEP, aQntEndPts, aEndPts);
+        AssignIndices(pEP, uShape, 0, aEndPts, aIdx, aIdx2, aErr);
+
+        float fErr = 0;
+        for (size_t p = 0; p <= uPartitions; p++)
+            fErr += aErr[p];
+        if (fErr >= fBestErr)
+            break;
+
+        fBestErr = fErr;
+        memcpy(aBestEndPts, aEndPts, sizeof(aBestEndPts));
+        memcpy(aBestIdx, aIdx, sizeof(aBestIdx));
+        memcpy(aBestIdx2, aIdx2, sizeof(aBestIdx2));
+    }
+
+    EmitBlock(pEP, uShape, 0, 0, aBestEndPts, aBestIdx, aBestIdx2);
+    return fBestErr;
+}
+
+
 //=====================================================================================
 // Entry points
 //=====================================================================================
@@ -3638,6 +4218,22 @@ void DirectX::D3DXEncodeBC6HS(uint8_t *pBC, const XMVECTOR *pColor, uint32_t fla
     reinterpret_cast<D3DX_BC6H*>(pBC)->Encode(true, reinterpret_cast<const HDRColorA*>(pColor));
 }
 
+_Use_decl_annotations_
+void DirectX::D3DXEncodeBC6HUBatch(uint8_t *pBC, const XMVECTOR *pColor, size_t count, uint32_t flags) noexcept
+{
+    UNREFERENCED_PARAMETER(flags);
+    assert(pBC && pColor);
+    D3DX_BC6H::EncodeBatch(false, reinterpret_cast<D3DX_BC6H*>(pBC), reinterpret_cast<const HDRColorA*>(pColor), count);
+}
+
+_Use_decl_annotations_
+void DirectX::D3DXEncodeBC6HSBatch(uint8_t *pBC, const XMVECTOR *pColor, size_t count, uint32_t flags) noexcept
+{
+    UNREFERENCED_PARAMETER(flags);
+    assert(pBC && pColor);
+    D3DX_BC6H::EncodeBatch(true, reinterpret_cast<D3DX_BC6H*>(pBC), reinterpret_cast<const HDRColorA*>(pColor), count);
+}
+
 
 //-------------------------------------------------------------------------------------
 // BC7 Compression
@@ -835,12 +835,24 @@ namespace DirectX
         TEX_COMPRESS_BC7_QUICK = 0x100000,
         // Minimal modes (usually mode 6) for BC7 compression
 
+        TEX_COMPRESS_BC1_3_FAST = 0x200000,
+        // Vectorized BC1-3 encoder for R8G8B8A8 sources, several blocks at once; lower quality than the default, no dithering
+
+        TEX_COMPRESS_BC7_FAST = 0x400000,
+        // Restricted mode and partition search for BC7 compress, far faster than the default at a small quality cost; overrides BC7_QUICK and BC7_USE_3SUBSETS
+
+        TEX_COMPRESS_BC6H_FAST = 0x800000,
+        // Reduced search BC6H encoder that handles several blocks at once; far faster than the default at some quality cost
+
         TEX_COMPRESS_SRGB_IN = 0x1000000,
         TEX_COMPRESS_SRGB_OUT = 0x2000000,
         TEX_COMPRESS_SRGB = (TEX_COMPRESS_SRGB_IN | TEX_COMPRESS_SRGB_OUT),
         // if the input format type is IsSRGB(), then SRGB_IN is on by default
         // if the output format type is IsSRGB(), then SRGB_OUT is on by default
 
+        TEX_COMPRESS_BC4_5_BATCHED = 0x4000000,
+        // Vectorized BC4/BC5 encoder that handles several blocks at once; same results as the default
+
         TEX_COMPRESS_PARALLEL = 0x10000000,
         // Compress is free to use multithreading to improve performance (by default it does not use multithreading)
     };
@@ -31,7 +31,12 @@ namespace
         static_assert(static_cast<int>(TEX_COMPRESS_UNIFORM) == static_cast<int>(BC_FLAGS_UNIFORM), "TEX_COMPRESS_* flags should match BC_FLAGS_*");
         static_assert(static_cast<int>(TEX_COMPRESS_BC7_USE_3SUBSETS) == static_cast<int>(BC_FLAGS_USE_3SUBSETS), "TEX_COMPRESS_* flags should match BC_FLAGS_*");
         static_assert(static_cast<int>(TEX_COMPRESS_BC7_QUICK) == static_cast<int>(BC_FLAGS_FORCE_BC7_MODE6), "TEX_COMPRESS_* flags should match BC_FLAGS_*");
-        return (compress & (BC_FLAGS_DITHER_RGB | BC_FLAGS_DITHER_A | BC_FLAGS_UNIFORM | BC_FLAGS_USE_3SUBSETS | BC_FLAGS_FORCE_BC7_MODE6));
+        static_assert(static_cast<int>(TEX_COMPRESS_BC1_3_FAST) == static_cast<int>(BC_FLAGS_FAST_RGB), "TEX_COMPRESS_* flags should match BC_FLAGS_*");
+        static_assert(static_cast<int>(TEX_COMPRESS_BC7_FAST) == static_cast<int>(BC_FLAGS_FAST_BC7), "TEX_COMPRESS_* flags should match BC_FLAGS_*");
+        static_assert(static_cast<int>(TEX_COMPRESS_BC6H_FAST) == static_cast<int>(BC_FLAGS_FAST_BC6H), "TEX_COMPRESS_* flags should match BC_FLAGS_*");
+        static_assert(static_cast<int>(TEX_COMPRESS_BC4_5_BATCHED) == static_cast<int>(BC_FLAGS_BATCHED_BC4_5), "TEX_COMPRESS_* flags should match BC_FLAGS_*");
+        return (compress & (BC_FLAGS_DITHER_RGB | BC_FLAGS_DITHER_A | BC_FLAGS_UNIFORM | BC_FLAGS_USE_3SUBSETS | BC_FLAGS_FORCE_BC7_MODE6
+            | BC_FLAGS_FAST_RGB | BC_FLAGS_FAST_BC7 | BC_FLAGS_FAST_BC6H | BC_FLAGS_BATCHED_BC4_5));
     }
 
     constexpr TEX_FILTER_FLAGS GetSRGBFlags(_In_ TEX_COMPRESS_FLAGS compress) noexcept
@@ -373,6 +378,257 @@ namespace
 #endif // _OPENMP
 
 
+    //-------------------------------------------------------------------------------------
+    // Blocks are gathered into runs of this many for the batch encoders
+    constexpr size_t BLOCKS_PER_RUN = 32;
+
+    // Batched BC1-3 compression (TEX_COMPRESS_BC1_3_FAST) reads 8-bit RGBA directly, so only
+    // sources that need no conversion qualify. Batched BC4/BC5 (TEX_COMPRESS_BC4_5_BATCHED) and BC6H
+    // (TEX_COMPRESS_BC6H_FAST) compression converts like CompressBC and takes any source.
+    // Everything else takes CompressBC.
+    bool UseBatchedCompress(const Image& image, const Image& result, uint32_t bcflags, TEX_FILTER_FLAGS srgb) noexcept
+    {
+        switch (result.format)
+        {
+        case DXGI_FORMAT_BC4_UNORM:
+        case DXGI_FORMAT_BC4_SNORM:
+        case DXGI_FORMAT_BC5_UNORM:
+        case DXGI_FORMAT_BC5_SNORM:
+            return (bcflags & BC_FLAGS_BATCHED_BC4_5) != 0;
+
+        case DXGI_FORMAT_BC6H_UF16:
+        case DXGI_FORMAT_BC6H_SF16:
+            return (bcflags & BC_FLAGS_FAST_BC6H) != 0;
+
+        default:
+            break;
+        }
+
+        if (!(bcflags & BC_FLAGS_FAST_RGB)
+            || (bcflags & (BC_FLAGS_DITHER_RGB | BC_FLAGS_DITHER_A))
+            || srgb != TEX_FILTER_DEFAULT)
+            return false;
+
+        switch (result.format)
+        {
+        case DXGI_FORMAT_BC1_UNORM:
+        case DXGI_FORMAT_BC1_UNORM_SRGB:
+        case DXGI_FORMAT_BC2_UNORM:
+        case DXGI_FORMAT_BC2_UNORM_SRGB:
+        case DXGI_FORMAT_BC3_UNORM:
+        case DXGI_FORMAT_BC3_UNORM_SRGB:
+            break;
+
+        default:
+            return false;
+        }
+
+        return (image.format == DXGI_FORMAT_R8G8B8A8_UNORM || image.format == DXGI_FORMAT_R8G8B8A8_UNORM_SRGB)
+            && (IsSRGB(image.format) == IsSRGB(result.format));
+    }
+
+    // Replicates pixels for a partial block in place, same as CompressBC: only the top left pw x ph
+    // pixels of block were loaded, the rest is filled from them
+    template<typename T>
+    void ReplicateBlockEdges(_Inout_updates_(NUM_PIXELS_PER_BLOCK) T* block, size_t pw, size_t ph) noexcept
+    {
+        static const size_t uSrc[] = { 0, 0, 0, 1 };
+
+        for (size_t t = 0; t < ph; ++t)
+        {
+            for (size_t s = pw; s < 4; ++s)
+            {
+                block[(t << 2) | s] = block[(t << 2) | uSrc[s]];
+            }
+        }
+
+        for (size_t t = ph; t < 4; ++t)
+        {
+            for (size_t s = 0; s < 4; ++s)
+            {
+                block[(t << 2) | s] = block[(uSrc[t] << 2) | s];
+            }
+        }
+    }
+
+    // Loads the run of count blocks starting at pixel (x, y) for the batch encoders that take XMVECTORs,
+    // replicating pixels for partial blocks the same as CompressBC
+    bool LoadBlocks(
+        const Image& image,
+        size_t x,
+        size_t y,
+        size_t count,
+        _Out_writes_(count * NUM_PIXELS_PER_BLOCK) XMVECTOR* pixels) noexcept
+    {
+        const size_t sbpp = (BitsPerPixel(image.format) + 7) / 8;
+        const size_t ph = std::min<size_t>(4, image.height - y);
+        const size_t pw = std::min<size_t>(count * 4, image.width - x);
+
+        // Only the rows and pixels inside the image are loaded
+        XMVECTOR row[BLOCKS_PER_RUN * 4];
+        assert(count <= BLOCKS_PER_RUN);
+        for (size_t t = 0; t < ph; ++t)
+        {
+            const uint8_t *sptr = image.pixels + (y + t) * image.rowPitch + x * sbpp;
+            if (!LoadScanline(row, pw, sptr, image.rowPitch - x * sbpp, image.format))
+                return false;
+
+            for (size_t iBlock = 0; iBlock < count; ++iBlock)
+            {
+                const size_t bw = std::min<size_t>(4, pw - iBlock * 4);
+                for (size_t s = 0; s < bw; ++s)
+                {
+                    pixels[iBlock * NUM_PIXELS_PER_BLOCK + t * 4 + s] = row[iBlock * 4 + s];
+                }
+            }
+        }
+
+        for (size_t iBlock = 0; iBlock < count; ++iBlock)
+        {
+            const size_t bw = std::min<size_t>(4, pw - iBlock * 4);
+            if (bw != 4 || ph != 4)
+                ReplicateBlockEdges(pixels + iBlock * NUM_PIXELS_PER_BLOCK, bw, ph);
+        }
+
+        return true;
+    }
+
+    HRESULT CompressBC_Batched(
+        const Image& image,
+        const Image& result,
+        uint32_t bcflags,
+        TEX_FILTER_FLAGS srgb,
+        float threshold,
+        bool parallel,
+        const std::function<bool __cdecl(size_t, size_t)>& statusCallback) noexcept
+    {
+        if (!image.pixels || !result.pixels)
+            return E_POINTER;
+
+        assert(image.width == result.width);
+        assert(image.height == result.height);
+
+        BC_ENCODE pfEncode;
+        size_t blocksize;
+        TEX_FILTER_FLAGS cflags;
+        if (!DetermineEncoderSettings(result.format, pfEncode, blocksize, cflags))
+            return HRESULT_E_NOT_SUPPORTED;
+
+        // Everything but BC1-3 is loaded and converted like CompressBC does
+        const bool converted = (result.format == DXGI_FORMAT_BC4_UNORM || result.format == DXGI_FORMAT_BC4_SNORM
+            || result.format == DXGI_FORMAT_BC5_UNORM || result.format == DXGI_FORMAT_BC5_SNORM
+            || result.format == DXGI_FORMAT_BC6H_UF16 || result.format == DXGI_FORMAT_BC6H_SF16);
+        if (converted && BitsPerPixel(image.format) < 8)
+            return HRESULT_E_NOT_SUPPORTED;
+        const size_t nbWidth = std::max<size_t>(1, (image.width + 3) / 4);
+        const size_t nbHeight = std::max<size_t>(1, (image.height + 3) / 4);
+
+        size_t progress = 0;
+        bool abort = false;
+        bool failed = false;
+
+    #ifdef _OPENMP
+    #pragma omp parallel for if (parallel) shared(progress)
+    #else
+        UNREFERENCED_PARAMETER(parallel);
+    #endif
+        for (int nbh = 0; nbh < static_cast<int>(nbHeight); ++nbh)
+        {
+        #ifdef _OPENMP
+        #pragma omp flush (abort)
+        #endif
+            if (abort)
+                continue;
+
+            const size_t y = size_t(nbh) * 4;
+            const size_t ph = std::min<size_t>(4, image.height - y);
+            uint8_t *pDest = result.pixels + size_t(nbh) * result.rowPitch;
+
+            uint32_t pixels[BLOCKS_PER_RUN * NUM_PIXELS_PER_BLOCK];
+            XM_ALIGNED_DATA(16) XMVECTOR vectors[BLOCKS_PER_RUN * NUM_PIXELS_PER_BLOCK];
+            for (size_t nbw = 0; nbw < nbWidth; nbw += BLOCKS_PER_RUN)
+            {
+                const size_t count = std::min(BLOCKS_PER_RUN, nbWidth - nbw);
+                uint8_t *dptr = pDest + nbw * blocksize;
+                if (converted)
+                {
+                    if (!LoadBlocks(image, nbw * 4, y, count, vectors))
+                    {
+                        failed = abort = true;
+                    #ifdef _OPENMP
+                    #pragma omp flush (abort)
+                    #endif
+                        break;
+                    }
+
+                    ConvertScanline(vectors, count * NUM_PIXELS_PER_BLOCK, result.format, image.format, cflags | srgb);
+
+                    switch (result.format)
+                    {
+                    case DXGI_FORMAT_BC4_UNORM:     D3DXEncodeBC4UBatch(dptr, vectors, count, bcflags); break;
+                    case DXGI_FORMAT_BC4_SNORM:     D3DXEncodeBC4SBatch(dptr, vectors, count, bcflags); break;
+                    case DXGI_FORMAT_BC5_UNORM:     D3DXEncodeBC5UBatch(dptr, vectors, count, bcflags); break;
+                    case DXGI_FORMAT_BC5_SNORM:     D3DXEncodeBC5SBatch(dptr, vectors, count, bcflags); break;
+                    case DXGI_FORMAT_BC6H_UF16:     D3DXEncodeBC6HUBatch(dptr, vectors, count, bcflags); break;
+                    default:                        D3DXEncodeBC6HSBatch(dptr, vectors, count, bcflags); break;
+                    }
+                    continue;
+                }
+
+                for (size_t iBlock = 0; iBlock < count; ++iBlock)
+                {
+                    const size_t x = (nbw + iBlock) * 4;
+                    const size_t pw = std::min<size_t>(4, image.width - x);
+
+                    // Only the pixels inside the image are read, partial blocks get the rest replicated
+                    uint32_t *block = pixels + iBlock * NUM_PIXELS_PER_BLOCK;
+                    for (size_t t = 0; t < ph; ++t)
+                    {
+                        auto sptr = reinterpret_cast<const uint32_t*>(image.pixels + (y + t) * image.rowPitch) + x;
+                        for (size_t s = 0; s < pw; ++s)
+                        {
+                            block[t * 4 + s] = sptr[s];
+                        }
+                    }
+
+                    if (pw != 4 || ph != 4)
+                        ReplicateBlockEdges(block, pw, ph);
+                }
+
+                switch (result.format)
+                {
+                case DXGI_FORMAT_BC1_UNORM:
+                case DXGI_FORMAT_BC1_UNORM_SRGB:    D3DXEncodeBC1Batch(dptr, pixels, count, threshold, bcflags); break;
+                case DXGI_FORMAT_BC2_UNORM:
+                case DXGI_FORMAT_BC2_UNORM_SRGB:    D3DXEncodeBC2Batch(dptr, pixels, count, bcflags); break;
+                default:                            D3DXEncodeBC3Batch(dptr, pixels, count, bcflags); break;
+                }
+            }
+
+            if (statusCallback)
+            {
+            #ifdef _OPENMP
+            #pragma omp atomic
+            #endif
+                progress += 4;
+
+                if (!statusCallback(progress, image.height))
+                {
+                    abort = true;
+                #ifdef _OPENMP
+                #pragma omp flush (abort)
+                #endif
+                }
+            }
+        }
+
+        if (failed)
+            return E_FAIL;
+
+        return (abort) ? E_ABORT : S_OK;
+    }
+
+
     //-------------------------------------------------------------------------------------
     DXGI_FORMAT DefaultDecompress(_In_ DXGI_FORMAT format) noexcept
     {
@@ -697,7 +953,11 @@ HRESULT DirectX::CompressEx(
     }
 
     // Compress single image
-    if (options.flags & TEX_COMPRESS_PARALLEL)
+    if (UseBatchedCompress(srcImage, *img, GetBCFlags(options.flags), GetSRGBFlags(options.flags)))
+    {
+        hr = CompressBC_Batched(srcImage, *img, GetBCFlags(options.flags), GetSRGBFlags(options.flags), options.threshold, (options.flags & TEX_COMPRESS_PARALLEL) != 0, statusCallback);
+    }
+    else if (options.flags & TEX_COMPRESS_PARALLEL)
     {
     #ifndef _OPENMP
         hr = E_NOTIMPL;
@@ -803,7 +1063,11 @@ HRESULT DirectX::CompressEx(
             return E_FAIL;
         }
 
-        if (options.flags & TEX_COMPRESS_PARALLEL)
+        if (UseBatchedCompress(src, dest[index], GetBCFlags(options.flags), GetSRGBFlags(options.flags)))
+        {
+            hr = CompressBC_Batched(src, dest[index], GetBCFlags(options.flags), GetSRGBFlags(options.flags), options.threshold, (options.flags & TEX_COMPRESS_PARALLEL) != 0, nullptr);
+        }
+        else if (options.flags & TEX_COMPRESS_PARALLEL)
         {
         #ifndef _OPENMP
             hr = E_NOTIMPL;
@@ -0,0 +1,63 @@
+#pragma once
+
+// Read-only bytes of an asset, valid as long as the archive (or the storage it was read into) lives.
+struct AssetSpan
+{
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+};
+
+// A single file packing many assets. The table of contents is sorted by name hash and payloads start
+// 64-byte aligned, optionally LZ compressed per entry when that saves enough. Open() maps the whole file
+// once, so reading an uncompressed entry is a lookup returning a pointer into the mapping: no file
+// handles, no copies, and the OS pages in only what gets touched.
+class AssetArchive
+{
+public:
+	AssetArchive();
+	~AssetArchive();
+
+	// Packs every file below directory. Entries are named by their path as given, e.g. building from
+	// L"assets" stores L"assets/shaders/uber_ps.hlsl", so lookups can use the loose file path unchanged.
+	static bool Build(const std::wstring& archivePath, const std::wstring& directory, bool compress = true);
+
+	bool Open(const std::wstring& archivePath);
+	void Close();
+	bool IsOpen() const { return _data != nullptr; }
+
+	bool Contains(const std::wstring& filePath) const;
+
+	// Uncompressed entries point straight into the mapping, compressed ones are decompressed into storage.
+	bool Read(const std::wstring& filePath, AssetSpan& span, std::vector<uint8_t>& storage) const;
+
+	UINT GetEntryCount() const { return _entryCount; }
+
+	// Lowercase with forward slashes and without a leading "./", Windows paths aren't case sensitive.
+	static std::string NormalizeName(const std::wstring& filePath);
+
+private:
+	struct Entry;
+
+	HANDLE _file;
+	HANDLE _mapping;
+	const uint8_t* _data;
+	size_t _size;
+
+	const Entry* _entries;
+	UINT _entryCount;
+	const char* _names;
+
+	const Entry* Find(const std::wstring& filePath) const;
+};
+
+namespace Util
+{
+	// Loaders read through ReadAsset(): from the mounted archive when it has the file, from disk otherwise.
+	// Mount once at startup, before any loader threads run.
+	bool MountAssetArchive(const std::wstring& archivePath);
+	bool ReadAsset(const std::wstring& filePath, AssetSpan& span, std::vector<uint8_t>& storage);
+
+	// LZ77 with LZ4 style sequences and a 64KB window. Fast to decode, used for archive entries.
+	void CompressLz(const uint8_t* input, size_t size, std::vector<uint8_t>& output);
+	bool DecompressLz(const uint8_t* input, size_t size, uint8_t* output, size_t outputSize);
+}
\ No newline at end of file
@@ -0,0 +1,17 @@
+#pragma once
+
+// CPU benchmarks for the engine's hot paths, run with "DiaBolic.exe --bench [name]".
+// They don't need a window or a GPU; the few that need a device use WARP, and skip that part when there is none.
+namespace Bench
+{
+	// Runs the named benchmark, or every benchmark when the name is empty.
+	// Returns false when no benchmark with that name exists, or when one of the checks a benchmark makes fails.
+	bool Run(const std::string& name);
+
+	// Runs the scene's CPU work for frameCount frames of a scenario ("grid", "orbit" or "crowd") without a
+	// device: the scene, culling and LOD selection run as in the renderer, the draws go to a
+	// RecordingCommandContext instead of a command list. The Renderer itself doesn't run, its frames are
+	// measured with "--frames <count> --warp".
+	// Frame time statistics go to stdout and outputPath. Returns false for an unknown scenario.
+	bool RunHeadless(UINT frameCount, const std::string& scenario, const std::wstring& outputPath);
+}
\ No newline at end of file
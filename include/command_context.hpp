@@ -0,0 +1,138 @@
+#pragma once
+
+// The commands a frame records, so the pipelines don't call ID3D12GraphicsCommandList2 themselves.
+// D3D12CommandContext forwards to a command list. RecordingCommandContext packs the commands into a
+// byte stream without a device, for the benchmarks and for checking what a frame submits.
+// Resources, pipeline states and heaps are passed through as pointers and never dereferenced, so
+// recording works with null pointers as well.
+class CommandContext
+{
+public:
+	virtual ~CommandContext() {}
+
+	virtual void SetPipelineState(ID3D12PipelineState* pipelineState) = 0;
+	virtual void SetGraphicsRootSignature(ID3D12RootSignature* rootSignature) = 0;
+	virtual void SetGraphicsRoot32BitConstants(UINT rootParameter, UINT count, const void* data, UINT offset) = 0;
+	virtual void SetGraphicsRootDescriptorTable(UINT rootParameter, D3D12_GPU_DESCRIPTOR_HANDLE baseDescriptor) = 0;
+	virtual void SetGraphicsRootShaderResourceView(UINT rootParameter, D3D12_GPU_VIRTUAL_ADDRESS address) = 0;
+	virtual void SetDescriptorHeap(ID3D12DescriptorHeap* heap) = 0;
+	virtual void SetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY topology) = 0;
+	virtual void SetVertexBuffer(const D3D12_VERTEX_BUFFER_VIEW& view) = 0;
+	virtual void SetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW& view) = 0;
+	virtual void SetViewport(const D3D12_VIEWPORT& viewport) = 0;
+	virtual void SetScissorRect(const D3D12_RECT& rect) = 0;
+	virtual void SetRenderTarget(D3D12_CPU_DESCRIPTOR_HANDLE renderTarget, D3D12_CPU_DESCRIPTOR_HANDLE depthStencil) = 0;
+	virtual void ClearRenderTarget(D3D12_CPU_DESCRIPTOR_HANDLE renderTarget, const float color[4]) = 0;
+	virtual void ClearDepth(D3D12_CPU_DESCRIPTOR_HANDLE depthStencil, float depth) = 0;
+	virtual void TransitionResource(ID3D12Resource* resource, D3D12_RESOURCE_STATES before, D3D12_RESOURCE_STATES after) = 0;
+	virtual void DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex, INT baseVertex, UINT startInstance) = 0;
+	virtual void CopyTextureRegion(const D3D12_TEXTURE_COPY_LOCATION& destination, const D3D12_TEXTURE_COPY_LOCATION& source) = 0;
+};
+
+class D3D12CommandContext : public CommandContext
+{
+public:
+	// The command list has to outlive the context.
+	explicit D3D12CommandContext(ID3D12GraphicsCommandList2* commandList);
+
+	void SetPipelineState(ID3D12PipelineState* pipelineState) override;
+	void SetGraphicsRootSignature(ID3D12RootSignature* rootSignature) override;
+	void SetGraphicsRoot32BitConstants(UINT rootParameter, UINT count, const void* data, UINT offset) override;
+	void SetGraphicsRootDescriptorTable(UINT rootParameter, D3D12_GPU_DESCRIPTOR_HANDLE baseDescriptor) override;
+	void SetGraphicsRootShaderResourceView(UINT rootParameter, D3D12_GPU_VIRTUAL_ADDRESS address) override;
+	void SetDescriptorHeap(ID3D12DescriptorHeap* heap) override;
+	void SetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY topology) override;
+	void SetVertexBuffer(const D3D12_VERTEX_BUFFER_VIEW& view) override;
+	void SetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW& view) override;
+	void SetViewport(const D3D12_VIEWPORT& viewport) override;
+	void SetScissorRect(const D3D12_RECT& rect) override;
+	void SetRenderTarget(D3D12_CPU_DESCRIPTOR_HANDLE renderTarget, D3D12_CPU_DESCRIPTOR_HANDLE depthStencil) override;
+	void ClearRenderTarget(D3D12_CPU_DESCRIPTOR_HANDLE renderTarget, const float color[4]) override;
+	void ClearDepth(D3D12_CPU_DESCRIPTOR_HANDLE depthStencil, float depth) override;
+	void TransitionResource(ID3D12Resource* resource, D3D12_RESOURCE_STATES before, D3D12_RESOURCE_STATES after) override;
+	void DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex, INT baseVertex, UINT startInstance) override;
+	void CopyTextureRegion(const D3D12_TEXTURE_COPY_LOCATION& destination, const D3D12_TEXTURE_COPY_LOCATION& source) override;
+
+private:
+	ID3D12GraphicsCommandList2* _commandList;
+};
+
+// Every command is a 4 byte header (command, payload size) followed by its payload, padded to 4 bytes.
+// Reset() keeps the memory, so recording a frame after the first one doesn't allocate.
+class RecordingCommandContext : public CommandContext
+{
+public:
+	enum class Command : uint16_t
+	{
+		SetPipelineState,
+		SetGraphicsRootSignature,
+		SetGraphicsRoot32BitConstants,
+		SetGraphicsRootDescriptorTable,
+		SetGraphicsRootShaderResourceView,
+		SetDescriptorHeap,
+		SetPrimitiveTopology,
+		SetVertexBuffer,
+		SetIndexBuffer,
+		SetViewport,
+		SetScissorRect,
+		SetRenderTarget,
+		ClearRenderTarget,
+		ClearDepth,
+		TransitionResource,
+		DrawIndexedInstanced,
+		CopyTextureRegion,
+		Count
+	};
+
+	RecordingCommandContext();
+
+	void SetPipelineState(ID3D12PipelineState* pipelineState) override;
+	void SetGraphicsRootSignature(ID3D12RootSignature* rootSignature) override;
+	void SetGraphicsRoot32BitConstants(UINT rootParameter, UINT count, const void* data, UINT offset) override;
+	void SetGraphicsRootDescriptorTable(UINT rootParameter, D3D12_GPU_DESCRIPTOR_HANDLE baseDescriptor) override;
+	void SetGraphicsRootShaderResourceView(UINT rootParameter, D3D12_GPU_VIRTUAL_ADDRESS address) override;
+	void SetDescriptorHeap(ID3D12DescriptorHeap* heap) override;
+	void SetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY topology) override;
+	void SetVertexBuffer(const D3D12_VERTEX_BUFFER_VIEW& view) override;
+	void SetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW& view) override;
+	void SetViewport(const D3D12_VIEWPORT& viewport) override;
+	void SetScissorRect(const D3D12_RECT& rect) override;
+	void SetRenderTarget(D3D12_CPU_DESCRIPTOR_HANDLE renderTarget, D3D12_CPU_DESCRIPTOR_HANDLE depthStencil) override;
+	void ClearRenderTarget(D3D12_CPU_DESCRIPTOR_HANDLE renderTarget, const float color[4]) override;
+	void ClearDepth(D3D12_CPU_DESCRIPTOR_HANDLE depthStencil, float depth) override;
+	void TransitionResource(ID3D12Resource* resource, D3D12_RESOURCE_STATES before, D3D12_RESOURCE_STATES after) override;
+	void DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex, INT baseVertex, UINT startInstance) override;
+	void CopyTextureRegion(const D3D12_TEXTURE_COPY_LOCATION& destination, const D3D12_TEXTURE_COPY_LOCATION& source) override;
+
+	void Reset();
+
+	// Records the stream again into another context, a D3D12CommandContext submits what was captured.
+	void Replay(CommandContext& context) const;
+
+	UINT GetCommandCount() const { return _commandCount; }
+	UINT GetCommandCount(Command command) const { return _commandCounts[static_cast<size_t>(command)]; }
+	size_t GetSize() const { return _size; }
+	const uint8_t* GetData() const { return _stream.data(); }
+
+private:
+	struct Header
+	{
+		Command command;
+		uint16_t size;
+	};
+
+	std::vector<uint8_t> _stream; // grows, only the first _size bytes are recorded commands
+	size_t _size;
+	UINT _commandCount;
+	UINT _commandCounts[static_cast<size_t>(Command::Count)];
+
+	// Appends a header with room for the payload and returns where the payload goes, zeroed.
+	uint8_t* Append(Command command, size_t size);
+
+	// Copies the payload as a whole, only for types without padding bytes.
+	template<typename T>
+	void Write(Command command, const T& payload)
+	{
+		memcpy(Append(command, sizeof(T)), &payload, sizeof(T));
+	}
+};
\ No newline at end of file
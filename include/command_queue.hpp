@@ -8,6 +8,8 @@ public:
 
 	Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> GetCommandList();
 	uint64_t ExecuteCommandList(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList);
+	// Executes the lists in order with one submission and one fence value, for lists recorded in parallel.
+	uint64_t ExecuteCommandLists(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2>* commandLists, UINT count);
 
 	uint64_t Signal();
 	bool IsFenceComplete(uint64_t fenceValue);
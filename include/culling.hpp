@@ -0,0 +1,33 @@
+#pragma once
+
+namespace Culling
+{
+	// Planes are stored as (normal, distance) with the normal pointing inwards and normalized,
+	// so dot(plane.xyz, point) + plane.w is the signed distance to the plane.
+	struct Frustum
+	{
+		DirectX::XMFLOAT4 planes[6];
+	};
+
+	// Bounding spheres as structure-of-arrays, e.g. straight out of InstanceTransforms.
+	struct SphereSet
+	{
+		const float* centerX;
+		const float* centerY;
+		const float* centerZ;
+		const float* radius;
+		UINT count;
+	};
+
+	// Extracts the frustum planes of a (row-vector, D3D style) view projection matrix.
+	Frustum ExtractFrustum(DirectX::FXMMATRIX viewProjection);
+
+	// Writes the indices of all spheres in [begin, end) that intersect the frustum to visible,
+	// which needs room for end - begin (+ 8 for the vector path) entries. Returns the number written.
+	UINT CullSpheres(const Frustum& frustum, const SphereSet& spheres, UINT begin, UINT end, UINT* visible);
+	UINT CullSpheresScalar(const Frustum& frustum, const SphereSet& spheres, UINT begin, UINT end, UINT* visible);
+
+	// Splits the set into chunks that are culled as jobs (see Jobs::ParallelFor) and compacted into one list.
+	// Small sets are culled on the calling thread, queuing jobs would cost more than it saves.
+	void CullSpheresParallel(const Frustum& frustum, const SphereSet& spheres, std::vector<UINT>& visible);
+}
\ No newline at end of file
@@ -1,9 +1,14 @@
 #pragma once
 
+struct ShaderDesc;
+
 namespace Util
 {
     void GetHardwareAdapter(IDXGIFactory1* pFactory, IDXGIAdapter1** ppAdapter, bool requestHighPerformanceAdapter);
 
+    // Default ShaderCompiler for the ShaderCache, built on D3DCompile.
+    bool CompileShader(const ShaderDesc& desc, const std::string& source, std::vector<uint8_t>& bytecode, std::string& errors);
+
     inline void ThrowIfFailed(HRESULT hr)
     {
         if (FAILED(hr))
@@ -0,0 +1,48 @@
+#pragma once
+
+// Scratch memory for data that only lives for a frame: culling lists, LOD offsets, upload lists.
+// Every thread bumps through its own arena, so allocating is an add without locks, and there are
+// FRAME_COUNT arenas per thread that take turns. Memory from frame N stays valid until frame
+// N + FRAME_COUNT starts, which covers work that finishes while the next frame is already being built.
+// An arena that ran out of space grows to this frame's total at its next rewind, so once the
+// workload has been seen the heap isn't touched anymore.
+namespace FrameMemory
+{
+	// Starts a new frame. Each thread's arena for it is rewound on that thread's first allocation.
+	void BeginFrame();
+
+	// Never returns null and is never freed on its own, the whole arena is rewound at once.
+	void* Allocate(size_t size, size_t alignment);
+}
+
+// STL allocator on top of FrameMemory, for containers that don't outlive their frame.
+template<typename T>
+class FrameAllocator
+{
+public:
+	using value_type = T;
+
+	FrameAllocator() = default;
+	template<typename U>
+	FrameAllocator(const FrameAllocator<U>&) {}
+
+	T* allocate(size_t count) { return static_cast<T*>(FrameMemory::Allocate(count * sizeof(T), alignof(T))); }
+	void deallocate(T*, size_t) {}
+
+	template<typename U>
+	bool operator==(const FrameAllocator<U>&) const { return true; }
+	template<typename U>
+	bool operator!=(const FrameAllocator<U>&) const { return false; }
+};
+
+template<typename T>
+using FrameVector = std::vector<T, FrameAllocator<T>>;
+
+namespace Util
+{
+	// Calls to the global operator new so far, across all threads. The benchmarks check with it
+	// that frame code runs without heap allocations once it is warmed up. Only builds that define
+	// COUNT_HEAP_ALLOCATIONS (the Debug configurations) replace operator new to count, elsewhere this stays 0.
+	uint64_t GetHeapAllocationCount();
+	bool IsCountingHeapAllocations();
+}
\ No newline at end of file
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "job_system.hpp"
+
+class CommandContext;
+class CommandQueue;
+
+// Screenshots and frame recording without stalling the renderer. A captured frame's back buffer is
+// copied into one of RING_SIZE READBACK buffers by the frame's own command list. The buffer is only
+// mapped once the frame's fence has passed, by a job that also encodes and writes the image.
+// When every buffer is still in use, a single capture waits for the next frame and recorded frames
+// are dropped; the render thread never waits.
+class FrameCapture
+{
+public:
+	static constexpr UINT RING_SIZE = FRAME_COUNT + 1;
+
+	FrameCapture(Microsoft::WRL::ComPtr<ID3D12Device2>& device, UINT width, UINT height, DXGI_FORMAT format);
+	~FrameCapture();
+
+	// Captures the next frame into filePath, the extension picks the format (see Encode()).
+	void Request(const std::wstring& filePath);
+
+	// Captures every frame into directory as frame_000000<extension> and so on, e.g. extension ".tga".
+	void StartRecording(const std::wstring& directory, const std::wstring& extension);
+	void StopRecording();
+
+	// Records the copy of the back buffer, which is in state and is left in it, if a capture is due
+	// and a readback buffer is free. Submitted() takes the fence value of the list it went into.
+	void RecordCopy(CommandContext& context, ID3D12Resource* backBuffer, D3D12_RESOURCE_STATES state);
+	void Submitted(uint64_t fenceValue);
+
+	// Starts the encode job of every copy the GPU finished. Doesn't wait for anything.
+	void Update(CommandQueue& queue);
+
+	// Waits for the encode jobs that are running. Copies still in flight are left alone.
+	void WaitForEncodes();
+
+	void Report(FILE* file) const;
+
+	// CPU side of a capture, usable without a device: copies the rows out of a mapped readback
+	// buffer laid out as footprint and writes them as .dds, .tga or .hdr (converted to float).
+	static bool EncodeReadback(const uint8_t* data, const D3D12_PLACED_SUBRESOURCE_FOOTPRINT& footprint, const std::wstring& filePath);
+	static bool Encode(const DirectX::Image& image, const std::wstring& filePath);
+
+private:
+	enum class SlotState : UINT
+	{
+		Free,
+		Copying, // recorded, waiting for the GPU
+		Encoding // mapped by a job
+	};
+
+	struct Slot
+	{
+		Microsoft::WRL::ComPtr<ID3D12Resource> buffer;
+		std::atomic<SlotState> state;
+		uint64_t fenceValue;
+		std::wstring filePath;
+	};
+
+	D3D12_PLACED_SUBRESOURCE_FOOTPRINT _footprint;
+	Slot _slots[RING_SIZE];
+	UINT _nextSlot;
+	UINT _recordedSlot; // waiting for Submitted(), RING_SIZE when there is none
+
+	std::wstring _requestedPath;
+	std::wstring _recordingDirectory;
+	std::wstring _recordingExtension;
+	bool _recording;
+	UINT _recordedFrameCount;
+
+	Jobs::Counter _encodes;
+	std::atomic<UINT> _capturedCount;
+	std::atomic<UINT> _failedCount;
+	std::atomic<uint64_t> _encodeMicroseconds;
+	UINT _droppedCount;
+
+	bool AcquireSlot(UINT& slot);
+};
\ No newline at end of file
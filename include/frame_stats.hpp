@@ -0,0 +1,38 @@
+#pragma once
+
+// CPU time per stage of every recorded frame, summarized as mean, percentiles and max. Used by the
+// fixed-length benchmark runs, whose JSON output is meant to be compared between builds.
+class FrameStats
+{
+public:
+	struct Summary
+	{
+		double mean = 0.0;
+		double p50 = 0.0;
+		double p95 = 0.0;
+		double p99 = 0.0;
+		double max = 0.0;
+	};
+
+	// One column per stage, the whole frame gets its own.
+	explicit FrameStats(const std::vector<std::string>& stageNames, UINT expectedFrameCount = 0);
+
+	// Milliseconds per stage in the order given to the constructor.
+	void AddFrame(const double* stageMilliseconds, double frameMilliseconds);
+
+	UINT GetFrameCount() const { return static_cast<UINT>(_frameMilliseconds.size()); }
+	Summary SummarizeFrames() const;
+	Summary SummarizeStage(UINT stage) const;
+
+	void Report(FILE* file) const;
+
+	// { "scenario": ..., "frames": n, "frame": { "mean": ... }, "stages": { "<name>": { ... } } }
+	bool WriteJson(const std::wstring& filePath, const std::string& scenario) const;
+
+private:
+	std::vector<std::string> _stageNames;
+	std::vector<std::vector<double>> _stageMilliseconds;
+	std::vector<double> _frameMilliseconds;
+
+	static Summary Summarize(std::vector<double> milliseconds);
+};
\ No newline at end of file
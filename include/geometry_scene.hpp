@@ -0,0 +1,56 @@
+#pragma once
+
+#include "mesh_lod.hpp"
+
+class InstanceTransforms;
+class TransformHierarchy;
+class CommandContext;
+struct Camera;
+
+// The CPU side of the geometry pass: spins the instances, culls them against the camera, picks a LOD
+// per visible instance and writes their world matrices grouped by LOD. Nothing in here talks to
+// D3D12, GeometryPipeline uploads and draws the result and the headless benchmark runs it on its own.
+// The draws go through a CommandContext, so the headless run records the same ones.
+class GeometryScene
+{
+public:
+	GeometryScene();
+	~GeometryScene();
+
+	// Builds the cube and its LOD chain. The mesh comes back with the chain's indices, ready for upload.
+	void CreateMesh(Util::MeshData& mesh);
+
+	// A block of gridSize^3 spinning cubes in front of the camera.
+	void CreateInstances(UINT gridSize = 10);
+
+	// Updates the camera matrices and writes up to GetInstanceCount() world matrices to instanceData.
+	void Update(float deltaTime, Camera& camera, float aspectRatio, UINT viewportHeight, DirectX::XMFLOAT4X4* instanceData);
+
+	UINT GetInstanceCount() const;
+	UINT GetVisibleCount() const { return static_cast<UINT>(_visibleInstances.size()); }
+	// View depth of the closest visible instance's center, for picking texture mips.
+	float GetNearestVisibleDepth() const { return _nearestVisibleDepth; }
+
+	// Index ranges of the mesh's LOD levels, and how many of this frame's visible instances use each one.
+	const std::vector<Util::MeshLod>& GetLods() const { return _lods; }
+	const std::vector<UINT>& GetLodInstanceCounts() const { return _lodInstanceCounts; }
+
+	// One instanced draw per LOD with visible instances, each binding its range of the world matrices
+	// Update() wrote (at instanceData on the GPU) as a root shader resource view.
+	void RecordDraws(CommandContext& context, UINT instanceRootParameter, D3D12_GPU_VIRTUAL_ADDRESS instanceData) const;
+
+private:
+	std::vector<Util::MeshLod> _lods;
+	std::vector<UINT> _lodInstanceCounts;
+	std::vector<UINT> _visibleInstanceLods;
+
+	std::unique_ptr<InstanceTransforms> _instances;
+	std::vector<UINT> _visibleInstances;
+	float _nearestVisibleDepth;
+
+	// Scene graph. The root node is the model matrix the vertex shader applies, the instances are placed
+	// below it by a separate tree (grid, one node per layer, one node per cube).
+	std::unique_ptr<TransformHierarchy> _hierarchy;
+	UINT _root;
+	std::vector<UINT> _nodeInstances; // instance of each node, INVALID_NODE for nodes that only group others
+};
\ No newline at end of file
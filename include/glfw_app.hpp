@@ -3,7 +3,8 @@
 class Application
 {
 public:
-	Application(UINT width, UINT height, std::string name);
+	// A hidden window still gets a swap chain, for runs that render without anyone watching.
+	Application(UINT width, UINT height, std::string name, bool visible = true);
 	~Application();
 
 	void Update();
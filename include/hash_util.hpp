@@ -0,0 +1,39 @@
+#pragma once
+
+namespace Util
+{
+	// 64-bit FNV-1a. Stable between runs and machines, so the results can be used as on-disk keys.
+	constexpr uint64_t HASH_SEED = 14695981039346656037ull;
+	constexpr uint64_t HASH_PRIME = 1099511628211ull;
+
+	inline uint64_t HashBytes(const void* data, size_t size, uint64_t hash = HASH_SEED)
+	{
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < size; ++i)
+		{
+			hash ^= bytes[i];
+			hash *= HASH_PRIME;
+		}
+		return hash;
+	}
+
+	inline uint64_t HashString(const char* string, uint64_t hash = HASH_SEED)
+	{
+		// Hash the terminator too, so "ab" + "c" differs from "a" + "bc".
+		return string ? HashBytes(string, strlen(string) + 1, hash) : HashBytes("", 1, hash);
+	}
+
+	template<typename T>
+	inline uint64_t HashValue(const T& value, uint64_t hash = HASH_SEED)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "Only plain values can be hashed bytewise.");
+		return HashBytes(&value, sizeof(T), hash);
+	}
+
+	inline std::string HashToString(uint64_t hash)
+	{
+		char buffer[17];
+		snprintf(buffer, sizeof(buffer), "%016llx", static_cast<unsigned long long>(hash));
+		return std::string(buffer);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "culling.hpp"
+
+// Per-object transforms stored as structure-of-arrays, so the per-frame update can process
+// four instances per SIMD register instead of building one XMMATRIX at a time.
+class InstanceTransforms
+{
+public:
+	InstanceTransforms();
+	~InstanceTransforms();
+
+	// Returns the instance index.
+	UINT Add(const DirectX::XMFLOAT3& position, float scale, float angle, float angularVelocity);
+	void Clear();
+
+	// Moves an instance, the new position is used from the next Update() on.
+	void SetPosition(UINT instance, const DirectX::XMFLOAT3& position);
+
+	// Advances every instance's spin and rebuilds all world matrices.
+	void Update(float deltaTime);
+
+	UINT GetCount() const { return _count; }
+	const DirectX::XMFLOAT4X4* GetWorldMatrices() const { return _worldMatrices.data(); }
+
+	// World space bounding spheres, laid out for Culling::CullSpheres.
+	Culling::SphereSet GetBoundingSpheres() const;
+
+	// Radius of the mesh's bounding sphere before scaling (a unit cube by default).
+	void SetLocalBoundingRadius(float radius) { _localBoundingRadius = radius; }
+
+	// Instances all spin around the same axis, which lets the rotation be expanded per matrix element.
+	void SetRotationAxis(DirectX::FXMVECTOR axis);
+
+private:
+	UINT _count;
+
+	// Padded to a multiple of 4 so the update loop never needs a scalar tail.
+	std::vector<float> _positionX;
+	std::vector<float> _positionY;
+	std::vector<float> _positionZ;
+	std::vector<float> _scale;
+	std::vector<float> _boundingRadius;
+	std::vector<float> _angle;
+	std::vector<float> _angularVelocity;
+
+	std::vector<DirectX::XMFLOAT4X4> _worldMatrices;
+	DirectX::XMFLOAT3 _rotationAxis;
+	float _localBoundingRadius;
+};
\ No newline at end of file
@@ -0,0 +1,46 @@
+#pragma once
+
+// One pool of worker threads for everything that runs in parallel: asset loading, texture
+// processing, culling, shader compiles and command list recording. Every worker owns a deque, jobs started on a worker go to
+// the back of its own deque and it takes them back from there (newest first, still warm in cache),
+// idle workers steal the oldest jobs from the front of the others. The pool starts on first use
+// with one worker less than there are cores, a thread in Wait() runs the jobs it waits for too.
+namespace Jobs
+{
+	// Fence style: counts the jobs started with it that haven't finished yet.
+	// A job that starts children with its own counter keeps the counter from reaching zero until
+	// they are done as well, which is how parents wait for children without blocking a worker.
+	class Counter
+	{
+	public:
+		Counter() : _pending(0) {}
+		Counter(const Counter&) = delete;
+		Counter& operator=(const Counter&) = delete;
+
+		bool IsDone() const { return _pending.load(std::memory_order_acquire) == 0; }
+
+	private:
+		friend class Scheduler;
+		std::atomic<UINT> _pending;
+	};
+
+	// Queues the function. When a counter is given it is incremented now and decremented once the
+	// function returned, the counter has to outlive the job. Jobs must not throw.
+	void Run(std::function<void()> function, Counter* counter = nullptr);
+
+	// Runs queued jobs of the counter until it reaches zero, so waiting inside a job doesn't stall a worker.
+	// Only the counter's own jobs (and the children started with it): a frame waiting on its culling
+	// never picks up a texture cook that takes a hundred times longer.
+	void Wait(const Counter& counter);
+
+	// Runs one queued job of the counter on the calling thread, for loops that wait on more than the
+	// counter. Returns false when none of its jobs was queued.
+	bool RunPending(const Counter& counter);
+
+	// Calls function(begin, end) over [0, count) in ranges of at most grainSize and returns when all
+	// are done. Ranges get split in halves, so thieves take big pieces and the fan-out is a tree.
+	void ParallelFor(UINT count, UINT grainSize, const std::function<void(UINT begin, UINT end)>& function);
+
+	// Threads that run jobs: the workers and the caller of Wait().
+	UINT GetThreadCount();
+}
\ No newline at end of file
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "resource_util.hpp"
+
+namespace Util
+{
+	struct MeshData
+	{
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> indices;
+
+		// 0xFFFF is reserved as the strip cut value, so 16-bit indices can address 65535 vertices.
+		bool Needs32BitIndices() const { return vertices.size() > 0xFFFF; }
+		DXGI_FORMAT GetIndexFormat() const { return Needs32BitIndices() ? DXGI_FORMAT_R32_UINT : DXGI_FORMAT_R16_UINT; }
+		UINT GetIndexSize() const { return Needs32BitIndices() ? sizeof(uint32_t) : sizeof(uint16_t); }
+
+		// Index data in the format returned by GetIndexFormat(), ready for upload.
+		std::vector<uint8_t> GetIndexData() const;
+	};
+
+	// Loads a mesh, preferring its cooked binary under cache/meshes when that is newer than the source.
+	// Otherwise the source (.obj) is imported, optimized and cooked for the next run.
+	bool LoadMesh(const std::wstring& filePath, MeshData& mesh);
+
+	// Streams a Wavefront OBJ into Util::Vertex. Polygons are fanned into triangles and
+	// identical position/uv/normal combinations share a vertex.
+	bool ImportObj(const std::wstring& filePath, MeshData& mesh);
+
+	bool SaveCookedMesh(const std::wstring& filePath, const MeshData& mesh);
+	bool LoadCookedMesh(const std::wstring& filePath, MeshData& mesh);
+
+	// Runs the vertex cache, overdraw and vertex fetch optimizations, in that order.
+	void OptimizeMesh(MeshData& mesh);
+
+	// Reorders triangles for the post-transform vertex cache (Forsyth's linear-speed algorithm).
+	void OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount);
+
+	// Reorders clusters of triangles so outward facing ones come first, while keeping the
+	// cache-friendly order within each cluster.
+	void OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices);
+
+	// Renumbers vertices in order of first use so the vertex fetch walks memory linearly.
+	void OptimizeVertexFetch(std::vector<uint32_t>& indices, std::vector<Vertex>& vertices);
+
+	// Average cache miss ratio: transformed vertices per triangle with a FIFO cache of the given size.
+	// 0.5 is the optimum for a regular grid, 3.0 means every vertex is transformed again.
+	float ComputeACMR(const std::vector<uint32_t>& indices, size_t vertexCount, UINT cacheSize = 16);
+
+	// UV units per mesh space unit, averaged over the surface: sqrt(uv area / surface area).
+	// Multiplied with a texture's size it gives the texel density used for mip estimates.
+	float ComputeUvDensity(const MeshData& mesh);
+}
\ No newline at end of file
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "mesh.hpp"
+
+namespace Util
+{
+	constexpr UINT MESHLET_MAX_VERTICES = 64;
+	constexpr UINT MESHLET_MAX_TRIANGLES = 124;
+
+	struct Meshlet
+	{
+		uint32_t vertexOffset;   // into MeshletData::vertices
+		uint32_t triangleOffset; // into MeshletData::triangles, three local indices per triangle
+		uint32_t vertexCount;
+		uint32_t triangleCount;
+
+		// Bounding sphere and normal cone, see IsMeshletBackfacing().
+		DirectX::XMFLOAT3 center;
+		float radius;
+		DirectX::XMFLOAT3 coneAxis;
+		float coneCutoff;
+	};
+
+	struct MeshletData
+	{
+		std::vector<Meshlet> meshlets;
+		std::vector<uint32_t> vertices; // mesh vertex indices
+		std::vector<uint8_t> triangles; // meshlet local vertex indices
+	};
+
+	// Greedily packs triangles in index order, so run the vertex cache optimization first.
+	void BuildMeshlets(const uint32_t* indices, size_t indexCount, const std::vector<Vertex>& vertices, MeshletData& meshlets);
+
+	// True when every triangle of the meshlet faces away from the view position.
+	bool IsMeshletBackfacing(const Meshlet& meshlet, DirectX::FXMVECTOR viewPosition);
+
+	// Simplifies with quadric error metrics through edge collapses. The result indexes the original
+	// vertices, UV seams and open borders are kept in place. Stops at targetIndexCount or once the
+	// next collapse would exceed targetError (relative to the mesh extent). resultError receives the
+	// reached error in the same units.
+	std::vector<uint32_t> SimplifyMesh(const std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices,
+		size_t targetIndexCount, float targetError, float* resultError = nullptr);
+
+	struct MeshLod
+	{
+		uint32_t indexOffset;
+		uint32_t indexCount;
+		float error; // largest measured distance from the full mesh, in mesh space units
+	};
+
+	struct LodChain
+	{
+		std::vector<uint32_t> indices;     // all levels back to back, sharing the mesh's vertices
+		std::vector<MeshLod> lods;         // lods[0] is the full mesh
+		std::vector<MeshletData> meshlets; // one set per level
+	};
+
+	// Halves the triangle count per level until maxLods is reached or simplification stalls. Each
+	// level's error is measured against the full mesh at points spread over its triangles.
+	void GenerateLodChain(const MeshData& mesh, LodChain& chain, UINT maxLods = 8);
+
+	// Builds the chains of many meshes at once, one job per mesh.
+	void GenerateLodChains(const std::vector<const MeshData*>& meshes, std::vector<LodChain>& chains, UINT maxLods = 8);
+
+	// Picks the coarsest level whose error stays below pixelThreshold pixels on screen.
+	// projectionScale is projection._22 * screenHeight / 2, viewDepth is in mesh space units.
+	UINT SelectLod(const std::vector<MeshLod>& lods, float viewDepth, float projectionScale, float pixelThreshold = 1.0f);
+}
\ No newline at end of file
@@ -24,6 +24,17 @@
 #include <string>
 #include <memory>
 #include <queue>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <cstring>
+#include <type_traits>
+#include <chrono>
+#include <thread>
+#include <condition_variable>
+#include <future>
 #include <stdlib.h>
 #include <stdio.h>
 
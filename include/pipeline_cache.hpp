@@ -0,0 +1,46 @@
+#pragma once
+
+// Deduplicates root signatures and pipeline state objects by a stable hash of their description,
+// and persists compiled pipelines between runs through an ID3D12PipelineLibrary.
+class PipelineCache
+{
+public:
+	PipelineCache(Microsoft::WRL::ComPtr<ID3D12Device2>& device, const std::wstring& libraryPath);
+	~PipelineCache();
+
+	Microsoft::WRL::ComPtr<ID3D12RootSignature> GetRootSignature(const Microsoft::WRL::ComPtr<ID3DBlob>& serializedSignature);
+	// Thread-safe. Pipelines are created outside the lock, so different ones compile in parallel.
+	Microsoft::WRL::ComPtr<ID3D12PipelineState> GetPipelineState(const D3D12_PIPELINE_STATE_STREAM_DESC& desc);
+
+	// Writes the pipeline library to disk if new pipelines were added since it was loaded.
+	void Save();
+
+	// Hashes everything the stream points to (shader bytecode, input layout, ...), not the pointers themselves.
+	// Root signatures are identified by the hash of their serialized blob, which the caller has to provide.
+	static uint64_t HashPipelineStream(const D3D12_PIPELINE_STATE_STREAM_DESC& desc,
+		const std::unordered_map<ID3D12RootSignature*, uint64_t>& rootSignatureHashes);
+
+	UINT GetHitCount() const { return _hitCount; }
+	UINT GetLibraryHitCount() const { return _libraryHitCount; }
+	UINT GetMissCount() const { return _missCount; }
+
+private:
+	void OpenLibrary();
+
+	Microsoft::WRL::ComPtr<ID3D12Device2> _device;
+	Microsoft::WRL::ComPtr<ID3D12PipelineLibrary1> _library;
+	std::vector<char> _libraryData; // has to outlive _library, which references it directly
+	std::wstring _libraryPath;
+	bool _libraryDirty;
+
+	std::mutex _mutex;
+	std::unordered_map<uint64_t, Microsoft::WRL::ComPtr<ID3D12RootSignature>> _rootSignatures;
+	std::unordered_map<ID3D12RootSignature*, uint64_t> _rootSignatureHashes;
+	std::unordered_map<uint64_t, Microsoft::WRL::ComPtr<ID3D12PipelineState>> _pipelineStates;
+	// Pipelines being loaded or compiled outside _mutex, later requests for the same hash wait on these.
+	std::unordered_map<uint64_t, std::shared_future<Microsoft::WRL::ComPtr<ID3D12PipelineState>>> _pendingPipelineStates;
+
+	UINT _hitCount;
+	UINT _libraryHitCount;
+	UINT _missCount;
+};
\ No newline at end of file
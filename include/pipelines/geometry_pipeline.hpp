@@ -1,6 +1,11 @@
 #pragma once
 
+#include "vertex_quantization.hpp"
+#include "geometry_scene.hpp"
+
 class Renderer;
+class ShaderPermutations;
+class CommandContext;
 struct Camera;
 
 class GeometryPipeline
@@ -9,8 +14,25 @@ public:
 	GeometryPipeline(Renderer& renderer, std::shared_ptr<Camera>& camera);
 	~GeometryPipeline();
 
-	void PopulateCommandlist(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2>& commandList);
+	// What PopulateCommandlist() binds for the draws, as plain values.
+	struct DrawBindings
+	{
+		ID3D12PipelineState* pipelineState;
+		ID3D12RootSignature* rootSignature;
+		D3D12_VERTEX_BUFFER_VIEW vertexBufferView;
+		D3D12_INDEX_BUFFER_VIEW indexBufferView;
+		Util::PositionQuantization positionQuantization;
+		ID3D12DescriptorHeap* srvHeap;
+		D3D12_GPU_DESCRIPTOR_HANDLE textureTable;
+		D3D12_GPU_VIRTUAL_ADDRESS instanceData; // this frame's slice of the instance buffer
+	};
+
+	void PopulateCommandlist(CommandContext& context);
 	void Update(float deltaTime);
+
+	// The commands PopulateCommandlist() records. Static so the device-free benchmarks record the same
+	// ones with null bindings.
+	static void RecordDraws(CommandContext& context, const DrawBindings& bindings, const GeometryScene& scene, const Camera& camera);
 private:
 	Renderer& _renderer;
 	std::shared_ptr<Camera> _camera;
@@ -18,16 +40,43 @@ private:
 	Microsoft::WRL::ComPtr<ID3D12RootSignature> _rootSignature;
 	Microsoft::WRL::ComPtr<ID3D12PipelineState> _pipelineState;
 
+	// Uber shader variants and the pipeline states built from them, keyed by ShaderFeatures.
+	std::unique_ptr<ShaderPermutations> _vertexShaders;
+	std::unique_ptr<ShaderPermutations> _pixelShaders;
+	std::unordered_map<uint32_t, Microsoft::WRL::ComPtr<ID3D12PipelineState>> _pipelineStates;
+
 	// Temporarily just store these here. Usually these should be part of a model resource
 	Microsoft::WRL::ComPtr<ID3D12Resource> _vertexBuffer;
 	D3D12_VERTEX_BUFFER_VIEW _vertexBufferView;
+	Util::PositionQuantization _positionQuantization;
 	Microsoft::WRL::ComPtr<ID3D12Resource> _IndexBuffer;
 	D3D12_INDEX_BUFFER_VIEW _indexBufferView;
 	int _indexCount;
-	Microsoft::WRL::ComPtr<ID3D12Resource> _albedoTexture;
-	D3D12_SHADER_RESOURCE_VIEW_DESC _albedoTextureView;
-	D3D12_CPU_DESCRIPTOR_HANDLE _albedoTextureHandle;
 
+	// Instances, culling and LOD selection, the visible world matrices go into one slice of
+	// _instanceBuffer per frame in flight.
+	std::unique_ptr<GeometryScene> _scene;
+	Microsoft::WRL::ComPtr<ID3D12Resource> _instanceBuffer;
+	uint8_t* _instanceBufferData;
+	UINT _maxInstanceCount;
+
+	// Streamed in by the renderer's TextureStreamer, drawn with the base permutation until resident.
+	// Every frame in flight has its own texture table (albedo, normal map) in the SRV heap, so the albedo
+	// view can move to newly resident mips while the GPU still reads the other frame's table.
+	UINT _albedoTexture;
+	UINT _albedoViewVersions[FRAME_COUNT]; // TextureStreamer::GetViewVersion() of each frame's albedo view, UINT_MAX for a null view
+	float _albedoUvDensity;
+	Microsoft::WRL::ComPtr<ID3D12PipelineState> _albedoPipelineState;
+
+	// Initialization steps, run by the renderer's startup graph. CreatePipelineStates() needs
+	// CreatePipeline(), the others only need the renderer objects they use and run alongside.
 	void CreatePipeline();
-	void InitializeAssets();
+	void CreatePipelineStates();
+	void UploadMesh();
+	void RequestTextures();
+	void CreateInstances();
+
+	Microsoft::WRL::ComPtr<ID3D12PipelineState> GetPipelineState(uint32_t features);
+
+	friend class Renderer;
 };
\ No newline at end of file
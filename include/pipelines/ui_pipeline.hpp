@@ -1,6 +1,7 @@
 #pragma once
 
 class Renderer;
+class CommandContext;
 
 class UIPipeline
 {
@@ -8,7 +9,7 @@ public:
 	UIPipeline(Renderer& renderer);
 	~UIPipeline();
 
-	void PopulateCommandlist(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2>& commandList);
+	void PopulateCommandlist(CommandContext& context);
 	void Update(float deltaTime);
 private:
 	Renderer& _renderer;
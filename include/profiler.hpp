@@ -0,0 +1,44 @@
+#pragma once
+
+// Nested CPU zones, recorded per thread into a ring buffer that only its own thread writes to:
+// a zone costs two timestamp reads and one store, without locks or allocations. When a ring is full
+// the oldest zones get overwritten, so the export holds the last RING_SIZE zones of every thread.
+//
+// Binary format (little endian), all times in timestamp ticks:
+//   "DBPF", uint32 version, double ticks per second
+//   uint32 name count, per name: uint16 length, characters
+//   uint32 thread count, per thread: uint32 thread id, uint16 name length, characters, uint32 zone count,
+//   per zone: uint32 name index, uint32 depth, uint64 start, uint64 duration
+namespace Profiler
+{
+	// Zones are kept per thread, older ones get overwritten once a thread recorded this many.
+	constexpr UINT RING_SIZE = 1 << 15;
+
+	// Only the pointer is stored, so names have to outlive the profiler (string literals do).
+	void BeginZone(const char* name);
+	void EndZone();
+
+	// Shown as the thread's name in the trace viewer.
+	void SetThreadName(const char* name);
+
+	// Both exports can run while other threads keep recording, zones overwritten during the copy are left out.
+	// Chrome trace JSON opens in chrome://tracing or ui.perfetto.dev.
+	bool WriteChromeTrace(const std::wstring& filePath);
+	bool WriteBinary(const std::wstring& filePath);
+}
+
+class ProfileZone
+{
+public:
+	explicit ProfileZone(const char* name) { Profiler::BeginZone(name); }
+	~ProfileZone() { Profiler::EndZone(); }
+
+	ProfileZone(const ProfileZone&) = delete;
+	ProfileZone& operator=(const ProfileZone&) = delete;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+// Times the rest of the enclosing scope.
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
\ No newline at end of file
@@ -4,12 +4,19 @@ class Application;
 class GeometryPipeline;
 class UIPipeline;
 class CommandQueue;
+class PipelineCache;
+class ShaderCache;
+class TextureStreamer;
+class FrameCapture;
+class CommandContext;
 struct Camera;
 
 class Renderer
 {
 public:
-	Renderer(std::shared_ptr<Application> app);
+	// The WARP software device renders on the CPU, for machines without a GPU. It presents without
+	// vsync, so frame times measure the work instead of the refresh rate.
+	Renderer(std::shared_ptr<Application> app, bool useWarpDevice = false);
 	~Renderer();
 
     void Update(float deltaTime);
@@ -17,6 +24,17 @@ public:
 
     void Flush();
 
+    // Screenshots and recordings of the presented frames.
+    FrameCapture& GetFrameCapture() { return *_frameCapture; }
+
+    // The commands around the passes of a frame. Render() records them on its command lists, the
+    // device-free benchmarks record the same ones with null handles.
+    static void RecordClear(CommandContext& context, ID3D12Resource* renderTarget, D3D12_CPU_DESCRIPTOR_HANDLE rtvHandle,
+        D3D12_CPU_DESCRIPTOR_HANDLE dsvHandle);
+    static void RecordPassSetup(CommandContext& context, D3D12_CPU_DESCRIPTOR_HANDLE rtvHandle, D3D12_CPU_DESCRIPTOR_HANDLE dsvHandle,
+        const D3D12_VIEWPORT& viewport, const D3D12_RECT& scissorRect);
+    static void RecordPresentTransition(CommandContext& context, ID3D12Resource* renderTarget);
+
 private:
     std::shared_ptr<Application> _app;
     std::shared_ptr<Camera> _camera;
@@ -31,11 +49,16 @@ private:
     CD3DX12_VIEWPORT _viewport;
     CD3DX12_RECT _scissorRect;
 
+    Microsoft::WRL::ComPtr<IDXGIFactory4> _factory;
     Microsoft::WRL::ComPtr<IDXGISwapChain3> _swapChain;
     Microsoft::WRL::ComPtr<ID3D12Device2> _device;
 
     std::unique_ptr<CommandQueue> _directCommandQueue;
     std::unique_ptr<CommandQueue> _copyCommandQueue;
+    std::unique_ptr<PipelineCache> _pipelineCache;
+    std::unique_ptr<ShaderCache> _shaderCache;
+    std::unique_ptr<TextureStreamer> _textureStreamer;
+    std::unique_ptr<FrameCapture> _frameCapture;
 
     Microsoft::WRL::ComPtr<ID3D12Resource> _renderTargets[FRAME_COUNT];
     Microsoft::WRL::ComPtr<ID3D12Resource> _depthBuffer;
@@ -47,10 +70,13 @@ private:
 
     UINT _frameIndex;
     uint64_t _fenceValues[FRAME_COUNT] = {};
-    const float clearColor[4] = { 255.0f / 255.0f, 182.0f / 255.0f, 193.0f / 255.0f, 1.0f }; // pink :)
     bool _useWarpDevice;
 
-    void InitializeGraphics();
+    // Startup steps, see the task graph in the constructor for what depends on what.
+    void CreateDevice();
+    void CreateSwapChain();
+    void CreateDescriptorHeaps();
+    void CreateRenderTargets();
     void CreateDepthBuffer();
 
     // friend classes
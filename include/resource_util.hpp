@@ -27,6 +27,12 @@ namespace Util
 		size_t numElements, size_t elementSize, const void* bufferData, 
 		D3D12_RESOURCE_FLAGS flags = D3D12_RESOURCE_FLAG_NONE);
 
+	// Decodes DDS, HDR, TGA or anything WIC understands. Throws when the file can't be read.
+	void LoadScratchImage(const std::wstring& filePath, DirectX::TexMetadata& metadata, DirectX::ScratchImage& scratchImage);
+	// Same for a file already in memory, filePath only picks the decoder by its extension.
+	void LoadScratchImage(const std::wstring& filePath, const uint8_t* data, size_t size,
+		DirectX::TexMetadata& metadata, DirectX::ScratchImage& scratchImage);
+
 	void LoadTextureFromFile(Microsoft::WRL::ComPtr<ID3D12Device> device, 
 		Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList,
 		ID3D12Resource** pDestinationResource, ID3D12Resource** pIntermediateResource,
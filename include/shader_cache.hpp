@@ -0,0 +1,56 @@
+#pragma once
+
+struct ShaderDefine
+{
+	std::string name;
+	std::string value;
+};
+
+struct ShaderDesc
+{
+	std::wstring filePath;
+	std::string entryPoint;
+	std::string profile;
+	std::vector<ShaderDefine> defines;
+	UINT flags = 0;
+};
+
+using ShaderBytecode = std::shared_ptr<const std::vector<uint8_t>>;
+
+// Turns HLSL source into bytecode. Returns false and fills in errors when compilation fails.
+// Pluggable so the cache can run without d3dcompiler (e.g. a stub that echoes the source).
+using ShaderCompiler = std::function<bool(const ShaderDesc& desc, const std::string& source,
+	std::vector<uint8_t>& bytecode, std::string& errors)>;
+
+// Caches compiled shaders in memory and on disk, keyed by the shader's source, the sources it includes,
+// its defines, entry point, profile and compile flags. Cache misses are compiled in parallel.
+class ShaderCache
+{
+public:
+	ShaderCache(const std::wstring& cacheDirectory, ShaderCompiler compiler);
+	~ShaderCache();
+
+	ShaderBytecode GetShader(const ShaderDesc& desc);
+	std::vector<ShaderBytecode> GetShaders(const std::vector<ShaderDesc>& descs);
+
+	uint64_t HashShader(const ShaderDesc& desc, const std::string& source) const;
+
+	UINT GetMemoryHitCount() const { return _memoryHitCount; }
+	UINT GetDiskHitCount() const { return _diskHitCount; }
+	UINT GetCompileCount() const { return _compileCount; }
+
+private:
+	std::wstring _cacheDirectory;
+	ShaderCompiler _compiler;
+
+	std::mutex _mutex;
+	std::unordered_map<uint64_t, ShaderBytecode> _shaders;
+
+	std::atomic<UINT> _memoryHitCount;
+	std::atomic<UINT> _diskHitCount;
+	std::atomic<UINT> _compileCount;
+
+	ShaderBytecode FindShader(uint64_t hash);
+	ShaderBytecode CompileShader(const ShaderDesc& desc, const std::string& source, uint64_t hash);
+	std::wstring GetCachePath(uint64_t hash) const;
+};
\ No newline at end of file
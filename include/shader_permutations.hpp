@@ -0,0 +1,48 @@
+#pragma once
+
+#include "shader_cache.hpp"
+
+// Feature bits of the uber shaders. Each bit maps to a FEATURE_* define, so every combination
+// compiles to its own specialized variant instead of branching on material data in the shader.
+enum ShaderFeature : uint32_t
+{
+	SHADER_FEATURE_NONE = 0,
+	SHADER_FEATURE_ALBEDO_TEXTURE = 1 << 0,
+	SHADER_FEATURE_NORMAL_MAP = 1 << 1,
+	SHADER_FEATURE_ALPHA_TEST = 1 << 2,
+
+	SHADER_FEATURE_COUNT = 3
+};
+using ShaderFeatures = uint32_t;
+
+struct Material
+{
+	ShaderFeatures features = SHADER_FEATURE_NONE;
+};
+
+// Compiles permutations of one shader on demand, i.e. only once a material asks for them.
+class ShaderPermutations
+{
+public:
+	ShaderPermutations(ShaderCache& shaderCache, const ShaderDesc& baseDesc, ShaderFeatures supportedFeatures);
+	~ShaderPermutations();
+
+	ShaderBytecode Get(ShaderFeatures features);
+
+	// Features the shader doesn't react to are masked off, so they don't produce duplicate variants.
+	ShaderFeatures Resolve(ShaderFeatures features) const { return features & _supportedFeatures; }
+
+	size_t GetLiveCount() const { return _permutations.size(); }
+	size_t GetPossibleCount() const;
+	void Report(FILE* stream) const;
+
+	static std::vector<ShaderDefine> GetDefines(ShaderFeatures features);
+	static const char* GetFeatureName(ShaderFeature feature);
+
+private:
+	ShaderCache& _shaderCache;
+	ShaderDesc _baseDesc;
+	ShaderFeatures _supportedFeatures;
+
+	std::unordered_map<ShaderFeatures, ShaderBytecode> _permutations;
+};
\ No newline at end of file
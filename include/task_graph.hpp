@@ -0,0 +1,56 @@
+#pragma once
+
+#include "job_system.hpp"
+
+// Work with dependencies on top of the job system: a task starts once everything it depends on has
+// finished, so independent tasks overlap on the workers. Every task is timed, Report() shows where
+// the time went and how much the overlap saved over running the tasks one after another.
+class TaskGraph
+{
+public:
+	TaskGraph();
+	~TaskGraph();
+
+	// Only the name's pointer is stored (string literals are fine). Dependencies are ids returned
+	// by earlier calls, so the graph can't have cycles.
+	UINT Add(const char* name, std::function<void()> function, std::initializer_list<UINT> dependencies = {});
+
+	// Same, but the task runs on the thread calling Run(). For work tied to that thread, like
+	// creating a swap chain for the window whose messages it pumps.
+	UINT AddOnCallingThread(const char* name, std::function<void()> function, std::initializer_list<UINT> dependencies = {});
+
+	// Runs every task and returns once all are done. When tasks throw, the ones that depend on them
+	// (and everything not started yet) are skipped and the first exception is rethrown here.
+	void Run();
+
+	void Report(FILE* file, const char* title) const;
+
+private:
+	struct Task
+	{
+		const char* name;
+		std::function<void()> function;
+		bool onCallingThread;
+		std::vector<UINT> dependents;
+		UINT dependencyCount;
+		std::atomic<UINT> remainingDependencies;
+		bool skipped;
+		double startMilliseconds;
+		double endMilliseconds;
+	};
+
+	std::vector<std::unique_ptr<Task>> _tasks;
+	std::chrono::steady_clock::time_point _start;
+	double _totalMilliseconds;
+
+	std::atomic<UINT> _unfinishedTasks;
+	std::atomic<bool> _failed;
+	std::mutex _mutex;
+	std::exception_ptr _exception;
+	std::vector<UINT> _callingThreadTasks; // ready to run, guarded by _mutex
+	Jobs::Counter _jobs; // the tasks running on the pool, Run() only helps with those
+
+	UINT AddTask(const char* name, std::function<void()>&& function, std::initializer_list<UINT> dependencies, bool onCallingThread);
+	void Schedule(UINT task);
+	void Execute(UINT task);
+};
\ No newline at end of file
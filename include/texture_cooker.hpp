@@ -0,0 +1,27 @@
+#pragma once
+
+namespace Util
+{
+	struct TextureCookStats
+	{
+		UINT cooked = 0;
+		UINT skipped = 0; // unchanged since the last cook
+		UINT failed = 0;
+		double megapixels = 0.0; // top mip pixels of the cooked textures
+		double seconds = 0.0;
+	};
+
+	// Block compression format for a source: BC6H for HDR, BC5 for normal maps (named *_n or *_normal),
+	// BC3 when the alpha channel is used and BC1 otherwise.
+	DXGI_FORMAT SelectCookedFormat(const std::wstring& sourcePath, const DirectX::ScratchImage& image);
+
+	// Decodes a source image, builds the full mip chain and block compresses it into a DDS, the compression
+	// split into jobs over bands of block rows. Returns the cooked texture's metadata, throws when the source
+	// can't be decoded or compressed.
+	DirectX::TexMetadata CookTexture(const std::wstring& sourcePath, const uint8_t* data, size_t size, const std::wstring& cookedPath);
+
+	// Cooks every texture below sourceDirectory into outputDirectory, keeping the relative paths but
+	// with a .dds extension. A manifest of source content hashes in outputDirectory skips the textures
+	// that haven't changed since the last cook. One job per texture, so it runs on all cores.
+	TextureCookStats CookTextures(const std::wstring& sourceDirectory, const std::wstring& outputDirectory);
+}
\ No newline at end of file
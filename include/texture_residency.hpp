@@ -0,0 +1,66 @@
+#pragma once
+
+// Decides which mips of which textures should be in memory. Every frame the visible objects
+// request the mip they would sample, estimated on the CPU from their view depth and UV density,
+// and Update() moves the resident mips towards those requests while staying within the memory
+// budget. Under pressure mips go in least recently used order: first the ones finer than anything
+// requested, then the finest mips of the textures still in view. A texture's coarsest mip stays
+// once loaded, so there's always something to sample. Only bookkeeping, the caller does the I/O.
+class TextureResidency
+{
+public:
+	static constexpr UINT INVALID_TEXTURE = UINT_MAX;
+
+	struct Change
+	{
+		UINT texture;
+		UINT fromMip; // most detailed resident mip, the mip count when nothing was resident
+		UINT toMip;   // smaller than fromMip means mips have to be loaded, larger means they can be freed
+	};
+
+	explicit TextureResidency(UINT64 memoryBudget);
+	~TextureResidency();
+
+	// mipSizes[0] is the most detailed mip, in bytes. Nothing is resident until it gets requested.
+	UINT AddTexture(UINT width, UINT height, const std::vector<UINT64>& mipSizes);
+
+	// The mip a surface samples when a pixel covers about one texel of it: the texture's size times
+	// the UV density (see Util::ComputeUvDensity()) gives texels per world unit, projectionScale / viewDepth
+	// pixels per world unit. projectionScale is projection._22 * screenHeight / 2, like for Util::SelectLod().
+	static UINT EstimateMip(UINT textureSize, UINT mipCount, float uvDensity, float viewDepth, float projectionScale);
+
+	// Starts a frame, requests from the previous one no longer count.
+	void BeginFrame();
+	// Objects sharing a texture can all request it, the most detailed request wins.
+	void RequestMip(UINT texture, UINT mip);
+	void RequestForObject(UINT texture, float uvDensity, float viewDepth, float projectionScale);
+
+	// Applies this frame's requests and the budget. changes receives every texture whose resident mip moved.
+	void Update(std::vector<Change>& changes);
+
+	void SetBudget(UINT64 memoryBudget) { _budget = memoryBudget; }
+	UINT64 GetBudget() const { return _budget; }
+	UINT64 GetResidentBytes() const { return _residentBytes; }
+
+	UINT GetResidentMip(UINT texture) const { return _textures[texture].residentMip; }
+	UINT GetRequestedMip(UINT texture) const { return _textures[texture].requestedMip; }
+	UINT GetMipCount(UINT texture) const { return _textures[texture].mipCount; }
+	UINT GetCount() const { return static_cast<UINT>(_textures.size()); }
+
+private:
+	struct Texture
+	{
+		UINT size; // the larger of width and height
+		UINT mipCount;
+		std::vector<UINT64> chainSizes; // bytes of mips [i, mipCount), chainSizes[mipCount] == 0
+		UINT residentMip;
+		UINT requestedMip; // == mipCount when not requested this frame
+		UINT targetMip;    // only used during Update()
+		UINT64 lastUsedFrame;
+	};
+
+	std::vector<Texture> _textures;
+	UINT64 _budget;
+	UINT64 _residentBytes;
+	UINT64 _frame;
+};
\ No newline at end of file
@@ -0,0 +1,169 @@
+#pragma once
+
+#include "job_system.hpp"
+#include "texture_residency.hpp"
+
+class CommandQueue;
+
+// Loads cooked DDS textures in the background: jobs parse them with DirectXTex and
+// stage every mip in an upload buffer, Update() then records the copies
+// on the copy queue. Mips go out smallest first across all textures, so everything gets a blurry
+// version quickly and sharpens over the next frames. Update() never waits on the GPU, disk or decode.
+//
+// How many mips each texture keeps is up to a TextureResidency: only the coarsest mip loads until
+// RequestMip() asks for more, and textures that aren't requested lose their finest mips when the
+// memory budget runs out. Changing the mips a texture keeps loads it again into a resource with just
+// those mips, which replaces the old one once it has caught up.
+class TextureStreamer
+{
+public:
+	static constexpr UINT INVALID_TEXTURE = UINT_MAX;
+
+	// memoryBudget is the number of bytes of mips the residency keeps, see TextureResidency.
+	TextureStreamer(Microsoft::WRL::ComPtr<ID3D12Device2>& device, CommandQueue& copyCommandQueue,
+		UINT64 memoryBudget = 256 * 1024 * 1024);
+	~TextureStreamer();
+
+	// Queues the file for loading, a DDS cooked by the build (see Util::CookTextures()). A missing file is
+	// reported and the texture never becomes resident. Sample it through CreateShaderResourceView() once IsResident().
+	UINT Request(const std::wstring& filePath);
+
+	// The mip the texture will be sampled at this frame, applied by the next Update(). The most
+	// detailed request between two updates wins, see TextureResidency.
+	void RequestMip(UINT texture, UINT mip);
+	void RequestForObject(UINT texture, float uvDensity, float viewDepth, float projectionScale);
+
+	// Retires finished copies, applies the mip requests and records new copies, up to uploadBudget bytes per call.
+	// Call once per frame: replaced resources are released FRAME_COUNT calls later, once no frame can still read them.
+	void Update(UINT64 uploadBudget = 8 * 1024 * 1024);
+
+	// False until at least the smallest mip can be sampled.
+	bool IsResident(UINT texture) const;
+	// The most detailed mip whose copy the GPU has finished.
+	UINT GetResidentMip(UINT texture) const;
+	bool IsFullyResident(UINT texture) const;
+
+	// Writes a view of the resident mips only (MostDetailedMip = GetResidentMip()), so nothing can sample
+	// a mip the copy queue is still writing. Rewrite it whenever GetViewVersion() changes, into a descriptor
+	// the GPU isn't reading anymore. The texture has to be resident.
+	void CreateShaderResourceView(UINT texture, D3D12_CPU_DESCRIPTOR_HANDLE srvHandle) const;
+	// Changes whenever the resident mips or the resource behind them change.
+	UINT GetViewVersion(UINT texture) const { return _textures[texture].viewVersion; }
+
+	const TextureResidency& GetResidency() const { return _residency; }
+
+	// Request to first mip and request to last mip, in milliseconds.
+	void Report(FILE* file) const;
+
+private:
+	struct Texture
+	{
+		std::wstring filePath;
+		UINT mipCount;    // of the whole chain in the file, 0 until it was parsed
+		UINT residentMip; // == mipCount while nothing is resident
+		UINT viewVersion;
+		bool loading;     // a load job for this texture is running
+		bool failed;
+		std::chrono::steady_clock::time_point requestTime;
+		bool firstMipReported;
+		bool allMipsReported;
+
+		// The resource holds mips [firstMip, mipCount) of the file, resource mip 0 is firstMip.
+		Microsoft::WRL::ComPtr<ID3D12Resource> resource;
+		UINT firstMip;
+
+		// A load with different mips, it replaces resource once its copies have caught up (see Update()).
+		Microsoft::WRL::ComPtr<ID3D12Resource> pendingResource;
+		UINT pendingFirstMip;
+		UINT pendingResidentMip;
+
+		// Filled in once the file was parsed.
+		UINT residencyTexture;
+		UINT width;
+		UINT height;
+		DXGI_FORMAT format;
+	};
+
+	// One mip staged by a job, waiting for Update() to copy it.
+	struct MipUpload
+	{
+		UINT texture;
+		UINT mip; // of the file's chain
+		UINT64 size;
+		Microsoft::WRL::ComPtr<ID3D12Resource> resource; // destination, its subresource is mip - firstMip
+		UINT firstMip;
+		Microsoft::WRL::ComPtr<ID3D12Resource> uploadBuffer; // shared by all mips of a load
+		D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint;
+	};
+
+	// Smallest first; equal sizes (the tail of block compressed chains) go by mip, smaller ones first.
+	struct MipUploadOrder
+	{
+		bool operator()(const MipUpload& a, const MipUpload& b) const
+		{
+			return a.size != b.size ? a.size > b.size : a.mip < b.mip;
+		}
+	};
+
+	struct UploadBatch
+	{
+		uint64_t fenceValue;
+		std::vector<MipUpload> uploads;
+	};
+
+	struct RetiredResource
+	{
+		UINT64 releaseUpdate;
+		Microsoft::WRL::ComPtr<ID3D12Resource> resource;
+	};
+
+	// Power of two buckets: [0, 1), [1, 2), [2, 4) ... milliseconds, the last one is open ended.
+	struct LatencyHistogram
+	{
+		static constexpr UINT BUCKET_COUNT = 16;
+		UINT buckets[BUCKET_COUNT] = {};
+		UINT count = 0;
+		double totalMilliseconds = 0.0;
+
+		void Add(double milliseconds);
+		void Report(FILE* file, const char* name) const;
+	};
+
+	Microsoft::WRL::ComPtr<ID3D12Device2> _device;
+	CommandQueue& _copyCommandQueue;
+
+	// Only touched on the thread calling Request() and Update(), jobs get copies of what they need.
+	std::vector<Texture> _textures;
+	std::vector<UINT> _residencyTextures; // texture of each TextureResidency entry
+	TextureResidency _residency;
+	std::vector<TextureResidency::Change> _residencyChanges;
+	std::queue<UploadBatch> _batchesInFlight;
+	std::queue<RetiredResource> _retiredResources;
+	UINT64 _updateCount;
+	LatencyHistogram _firstMipLatency;
+	LatencyHistogram _fullLatency;
+
+	// Shared with the jobs.
+	std::mutex _mutex;
+	struct LoadRequest
+	{
+		UINT texture;
+		std::wstring filePath;
+		UINT firstMip; // clamped to what the format allows, UINT_MAX for the coarsest possible
+	};
+	std::priority_queue<MipUpload, std::vector<MipUpload>, MipUploadOrder> _uploadQueue;
+	struct LoadedTexture
+	{
+		UINT texture;
+		Microsoft::WRL::ComPtr<ID3D12Resource> resource; // null when loading failed
+		UINT firstMip;
+		DirectX::TexMetadata metadata; // of the whole file
+		std::vector<UINT64> mipSizes;  // of the whole chain
+	};
+	std::vector<LoadedTexture> _loadedTextures;
+	Jobs::Counter _pendingLoads;
+
+	void StartLoad(UINT texture, UINT firstMip);
+	void Load(const LoadRequest& request);
+	static UINT ClampFirstMip(UINT firstMip, UINT width, UINT height, UINT mipCount, DXGI_FORMAT format);
+};
\ No newline at end of file
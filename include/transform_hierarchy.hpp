@@ -0,0 +1,62 @@
+#pragma once
+
+// Parent/child transforms stored as structure-of-arrays and kept sorted by depth, so every parent
+// comes before its children. Update() only visits the nodes that changed and the subtrees below them,
+// and recomputes their world matrices in storage order.
+class TransformHierarchy
+{
+public:
+	static constexpr UINT INVALID_NODE = UINT_MAX;
+
+	TransformHierarchy();
+	~TransformHierarchy();
+
+	// The parent has to exist already. Returns a handle that stays valid across SortByDepth().
+	UINT AddNode(UINT parent, const DirectX::XMFLOAT3& translation, const DirectX::XMFLOAT4& rotation, float scale);
+
+	// Reorders the nodes so they are grouped per depth level. Call once after building the scene.
+	void SortByDepth();
+
+	void SetLocalTranslation(UINT node, const DirectX::XMFLOAT3& translation);
+	void SetLocalRotation(UINT node, const DirectX::XMFLOAT4& rotation);
+	void SetLocalScale(UINT node, float scale);
+
+	// Propagates dirty flags down the hierarchy and recomputes the affected world matrices.
+	// Returns the number of world matrices that were recomputed.
+	UINT Update();
+
+	// Handles of the nodes the last Update() recomputed, parents before children.
+	const std::vector<UINT>& GetUpdatedNodes() const { return _updatedNodes; }
+
+	const DirectX::XMFLOAT4X4& GetWorld(UINT node) const { return _world[_handleToIndex[node]]; }
+	UINT GetCount() const { return static_cast<UINT>(_parent.size()); }
+
+private:
+	// Local transform, indexed by storage position.
+	std::vector<float> _translationX;
+	std::vector<float> _translationY;
+	std::vector<float> _translationZ;
+	std::vector<DirectX::XMFLOAT4> _rotation;
+	std::vector<float> _scale;
+
+	std::vector<UINT> _parent;
+	std::vector<uint16_t> _depth;
+	std::vector<uint8_t> _dirty;
+	std::vector<DirectX::XMFLOAT4X4> _world;
+
+	// Handles given out by AddNode() map to storage positions, which change when sorting.
+	std::vector<UINT> _handleToIndex;
+	std::vector<UINT> _indexToHandle;
+
+	// Children of each node, rebuilt lazily after nodes were added or reordered.
+	std::vector<UINT> _childStart;
+	std::vector<UINT> _children;
+	bool _childrenValid;
+
+	// Nodes changed since the last Update(), grown into their subtrees when it runs.
+	std::vector<UINT> _dirtyNodes;
+	std::vector<UINT> _updatedNodes;
+
+	void MarkDirty(UINT index);
+	void BuildChildren();
+};
\ No newline at end of file
@@ -0,0 +1,44 @@
+#pragma once
+
+// A screen space quad of the UI pass: a rectangle in pixels, the atlas region it shows (UVs in [0, 1])
+// and a tint. The atlas holds coverage, so the quad's color is the tint with its alpha scaled by coverage.
+struct UIQuad
+{
+	float x0, y0, x1, y1;
+	float u0, v0, u1, v1;
+	uint32_t color; // R8G8B8A8, red in the lowest byte like DXGI_FORMAT_R8G8B8A8_UNORM
+};
+
+// CPU rasterizer for the UI pass, for golden image tests and as a fallback without a GPU.
+// The target is split into tiles, every quad is binned to the tiles it touches (keeping the draw
+// order) and the tiles are rasterized as jobs. Quads are alpha blended over the target, the atlas
+// is sampled nearest at pixel centers. With AVX2, eight pixels of a row are blended at once.
+class UIRasterizer
+{
+public:
+	static constexpr UINT TILE_SIZE = 64;
+
+	UIRasterizer(UINT width, UINT height);
+	~UIRasterizer();
+
+	// Clears the target to clearColor and draws the quads in order. The atlas has to be R8_UNORM.
+	void Rasterize(const UIQuad* quads, UINT quadCount, const DirectX::Image& atlas, uint32_t clearColor);
+
+	// Same result on the calling thread without vector code, the reference for the fast path.
+	void RasterizeScalar(const UIQuad* quads, UINT quadCount, const DirectX::Image& atlas, uint32_t clearColor);
+
+	// R8G8B8A8_UNORM, a single image.
+	const DirectX::ScratchImage& GetImage() const { return _image; }
+
+	// Writes the target as TGA when the path ends in .tga and as DDS otherwise.
+	bool Save(const std::wstring& filePath) const;
+
+private:
+	DirectX::ScratchImage _image;
+	UINT _tileCountX;
+	UINT _tileCountY;
+	std::vector<std::vector<UINT>> _tileQuads; // quad indices per tile, in draw order
+
+	void BinQuads(const UIQuad* quads, UINT quadCount);
+	void RasterizeTile(UINT tile, const UIQuad* quads, const DirectX::Image& atlas, uint32_t clearColor, bool vectorized);
+};
\ No newline at end of file
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "resource_util.hpp"
+
+namespace Util
+{
+	// 16 bytes instead of the 32 of Util::Vertex:
+	//   position  R16G16B16A16_UNORM, relative to the mesh bounds (w is padding)
+	//   normal    R16G16_SNORM, octahedral encoded
+	//   uv        R16G16_FLOAT
+	struct QuantizedVertex
+	{
+		uint16_t position[4];
+		int16_t normal[2];
+		uint16_t uv[2];
+	};
+	static_assert(sizeof(QuantizedVertex) == 16, "QuantizedVertex has to match its input layout.");
+
+	// position = offset + unorm * scale. Laid out like the PositionDequantizeCB root constants.
+	struct PositionQuantization
+	{
+		DirectX::XMFLOAT3 offset;
+		float padding0;
+		DirectX::XMFLOAT3 scale;
+		float padding1;
+	};
+
+	// Fits the quantization grid to the bounding box of the vertices.
+	PositionQuantization ComputePositionQuantization(const std::vector<Vertex>& vertices);
+
+	// Encodes count vertices, four at a time where possible.
+	void QuantizeVertices(const Vertex* vertices, size_t count, const PositionQuantization& quantization, QuantizedVertex* output);
+	std::vector<QuantizedVertex> QuantizeVertices(const std::vector<Vertex>& vertices, const PositionQuantization& quantization);
+
+	// Reference decoders, matching what the vertex shader does.
+	Vertex DequantizeVertex(const QuantizedVertex& vertex, const PositionQuantization& quantization);
+
+	extern const D3D12_INPUT_ELEMENT_DESC QUANTIZED_VERTEX_INPUT_LAYOUT[3];
+}
\ No newline at end of file
@@ -3,6 +3,12 @@
 #include "glfw_app.hpp"
 #include "renderer.hpp"
 #include "dialogue_sample.hpp"
+#include "benchmarks.hpp"
+#include "asset_archive.hpp"
+#include "texture_cooker.hpp"
+#include "profiler.hpp"
+#include "frame_stats.hpp"
+#include "frame_capture.hpp"
 
 #include <memory>
 #include <chrono>
@@ -11,25 +17,134 @@ std::shared_ptr<Application> g_app;
 std::shared_ptr<Renderer> g_renderer;
 std::unique_ptr<DialogueSample> g_sample;
 
-int main()
+int main(int argc, char* argv[])
 {
+	// CPU benchmarks run without creating a window or device.
+	if (argc > 1 && std::string(argv[1]) == "--bench")
+	{
+		return Bench::Run(argc > 2 ? argv[2] : "") ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	// The scene's CPU work for a fixed number of frames without window, device or Renderer. Still a Windows
+	// build like the rest. --frames <count> --warp below covers the Renderer itself without a GPU.
+	// Usage: --headless [frames] [grid|orbit|crowd], statistics go to frame_stats.json.
+	if (argc > 1 && std::string(argv[1]) == "--headless")
+	{
+		UINT frameCount = argc > 2 ? static_cast<UINT>(std::stoul(argv[2])) : 1000;
+		std::string scenario = argc > 3 ? argv[3] : "grid";
+		return Bench::RunHeadless(frameCount, scenario, L"frame_stats.json") ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	// Converts the source textures into the block compressed DDS files the renderer streams.
+	if (argc > 1 && std::string(argv[1]) == "--cook")
+	{
+		Util::TextureCookStats stats = Util::CookTextures(L"assets/textures", L"assets/cooked/textures");
+		printf("Cooked %u, unchanged %u, failed %u: %.1f megapixels in %.2f s (%.1f MP/s)\n", stats.cooked, stats.skipped, stats.failed,
+			stats.megapixels, stats.seconds, stats.seconds > 0.0 ? stats.megapixels / stats.seconds : 0.0);
+		return stats.failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	// Packs the loose assets into the archive that gets mounted below.
+	if (argc > 1 && std::string(argv[1]) == "--pack")
+	{
+		return AssetArchive::Build(L"assets.pak", L"assets") ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	// Zones are always recorded, --profile writes them out when the window closes.
+	const bool profile = argc > 1 && std::string(argv[1]) == "--profile";
+	Profiler::SetThreadName("Main");
+
+	// --frames <count> closes after that many frames and writes per-stage statistics to frame_stats.json.
+	// With --warp after the count, the Renderer runs on the WARP software device in a hidden window.
+	const UINT frameLimit = argc > 2 && std::string(argv[1]) == "--frames" ? static_cast<UINT>(std::stoul(argv[2])) : 0;
+	const bool warp = frameLimit > 0 && argc > 3 && std::string(argv[3]) == "--warp";
+	FrameStats frameStats({ "Application::Update", "DialogueSample::Update", "Renderer::Update", "Renderer::Render" }, frameLimit);
+
+	// Without an archive everything is read from the loose files under assets/.
+	Util::MountAssetArchive(L"assets.pak");
+
 	// TODO: input parameters for application window
-	g_app = std::make_shared<Application>(1920, 1080, "DiaBolic");
-	g_renderer = std::make_shared<Renderer>(g_app);
+	g_app = std::make_shared<Application>(1920, 1080, "DiaBolic", !warp);
+	g_renderer = std::make_shared<Renderer>(g_app, warp);
 	g_sample = std::make_unique<DialogueSample>(g_renderer);
 
+	// --capture <file> saves the first frame as .dds, .tga or .hdr, --record <directory> [extension]
+	// saves every frame (.tga unless given). Both are encoded on job threads while frames keep going.
+	if (argc > 2 && std::string(argv[1]) == "--capture")
+	{
+		std::string path = argv[2];
+		g_renderer->GetFrameCapture().Request(std::wstring(path.begin(), path.end()));
+	}
+	if (argc > 2 && std::string(argv[1]) == "--record")
+	{
+		std::string directory = argv[2];
+		std::string extension = argc > 3 ? argv[3] : ".tga";
+		g_renderer->GetFrameCapture().StartRecording(std::wstring(directory.begin(), directory.end()),
+			std::wstring(extension.begin(), extension.end()));
+	}
+
 	std::chrono::high_resolution_clock::duration deltaTime(0);
 	std::chrono::high_resolution_clock::time_point previousFrameTime = std::chrono::high_resolution_clock::now();
 
 	while (!g_app->ShouldClose())
 	{
+		PROFILE_ZONE("Frame");
+
 		auto currentFrameTime = std::chrono::high_resolution_clock::now();
 		deltaTime = currentFrameTime - previousFrameTime;
 		previousFrameTime = currentFrameTime;
 
-		g_app->Update();
-		g_sample->Update();
-		g_renderer->Update(deltaTime.count() * 1e-9);
-		g_renderer->Render();
+		// Milliseconds since the previous call, for the frame statistics.
+		double stageMilliseconds[4];
+		auto stageStart = currentFrameTime;
+		auto endStage = [&stageStart](double& milliseconds)
+		{
+			auto now = std::chrono::high_resolution_clock::now();
+			milliseconds = std::chrono::duration<double, std::milli>(now - stageStart).count();
+			stageStart = now;
+		};
+
+		{
+			PROFILE_ZONE("Application::Update");
+			g_app->Update();
+			endStage(stageMilliseconds[0]);
+		}
+		{
+			PROFILE_ZONE("DialogueSample::Update");
+			g_sample->Update();
+			endStage(stageMilliseconds[1]);
+		}
+		{
+			PROFILE_ZONE("Renderer::Update");
+			g_renderer->Update(deltaTime.count() * 1e-9);
+			endStage(stageMilliseconds[2]);
+		}
+		{
+			PROFILE_ZONE("Renderer::Render");
+			g_renderer->Render();
+			endStage(stageMilliseconds[3]);
+		}
+
+		if (frameLimit > 0)
+		{
+			std::chrono::duration<double, std::milli> frameTime = stageStart - currentFrameTime;
+			frameStats.AddFrame(stageMilliseconds, frameTime.count());
+			if (frameStats.GetFrameCount() == frameLimit)
+			{
+				break;
+			}
+		}
+	}
+
+	if (frameLimit > 0)
+	{
+		frameStats.Report(stdout);
+		frameStats.WriteJson(L"frame_stats.json", warp ? "warp" : "window");
+	}
+
+	if (profile)
+	{
+		bool written = Profiler::WriteChromeTrace(L"profile.json") && Profiler::WriteBinary(L"profile.bin");
+		printf(written ? "Wrote profile.json and profile.bin\n" : "Failed to write the profile\n");
 	}
 }
\ No newline at end of file
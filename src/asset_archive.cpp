@@ -0,0 +1,511 @@
+#include "pch.hpp"
+
+#include "asset_archive.hpp"
+
+#include "hash_util.hpp"
+
+#ifndef _SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING
+#define _SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING
+#endif
+#include <experimental/filesystem>
+#include <algorithm>
+#include <fstream>
+
+namespace fs = std::experimental::filesystem;
+
+namespace
+{
+    constexpr uint32_t ARCHIVE_MAGIC = 0x4B415044; // "DPAK"
+    constexpr uint32_t ARCHIVE_VERSION = 1;
+    constexpr uint64_t ARCHIVE_ALIGNMENT = 64;
+
+    constexpr uint32_t ENTRY_FLAG_COMPRESSED = 0x1;
+
+    struct ArchiveHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t entryCount;
+        uint32_t alignment;
+        uint64_t entriesOffset;
+        uint64_t namesOffset;
+        uint64_t namesSize;
+    };
+
+    // LZ sequences: a token with the literal count in the high and the match length - MIN_MATCH in the
+    // low nibble (15 means more length bytes follow, each adding up to 255), the literals, then a
+    // 16-bit little endian offset. The last sequence has literals only.
+    constexpr size_t LZ_MIN_MATCH = 4;
+    constexpr size_t LZ_MAX_OFFSET = 0xFFFF;
+    constexpr UINT LZ_HASH_BITS = 14;
+
+    void WriteLength(std::vector<uint8_t>& output, size_t length)
+    {
+        for (; length >= 255; length -= 255)
+        {
+            output.push_back(255);
+        }
+        output.push_back(static_cast<uint8_t>(length));
+    }
+
+    bool ReadLength(const uint8_t*& input, const uint8_t* end, size_t& length)
+    {
+        uint8_t value;
+        do
+        {
+            if (input == end)
+            {
+                return false;
+            }
+            value = *input++;
+            length += value;
+        } while (value == 255);
+        return true;
+    }
+
+    void WriteSequence(std::vector<uint8_t>& output, const uint8_t* literals, size_t literalCount, size_t offset, size_t matchLength)
+    {
+        size_t matchCode = matchLength >= LZ_MIN_MATCH ? matchLength - LZ_MIN_MATCH : 0;
+        output.push_back(static_cast<uint8_t>((std::min<size_t>(literalCount, 15) << 4) | std::min<size_t>(matchCode, 15)));
+        if (literalCount >= 15)
+        {
+            WriteLength(output, literalCount - 15);
+        }
+        output.insert(output.end(), literals, literals + literalCount);
+
+        if (matchLength > 0)
+        {
+            output.push_back(static_cast<uint8_t>(offset));
+            output.push_back(static_cast<uint8_t>(offset >> 8));
+            if (matchCode >= 15)
+            {
+                WriteLength(output, matchCode - 15);
+            }
+        }
+    }
+
+    uint32_t Load32(const uint8_t* data)
+    {
+        uint32_t value;
+        memcpy(&value, data, sizeof(value));
+        return value;
+    }
+
+    bool ReadLooseFile(const std::wstring& filePath, std::vector<uint8_t>& contents)
+    {
+        std::ifstream file(fs::path(filePath), std::ios::binary | std::ios::ate);
+        if (!file)
+        {
+            return false;
+        }
+        contents.resize(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        return static_cast<bool>(file.read(reinterpret_cast<char*>(contents.data()), contents.size()));
+    }
+
+    std::unique_ptr<AssetArchive> g_mountedArchive;
+}
+
+struct AssetArchive::Entry
+{
+    uint64_t nameHash;
+    uint32_t nameOffset; // into the name block, not terminated
+    uint32_t nameLength;
+    uint64_t offset;     // from the start of the archive, ARCHIVE_ALIGNMENT aligned
+    uint64_t storedSize;
+    uint64_t size;
+    uint32_t flags;
+    uint32_t reserved;
+};
+
+AssetArchive::AssetArchive()
+    : _file(INVALID_HANDLE_VALUE)
+    , _mapping(nullptr)
+    , _data(nullptr)
+    , _size(0)
+    , _entries(nullptr)
+    , _entryCount(0)
+    , _names(nullptr)
+{
+}
+
+AssetArchive::~AssetArchive()
+{
+    Close();
+}
+
+bool AssetArchive::Build(const std::wstring& archivePath, const std::wstring& directory, bool compress)
+{
+    std::vector<std::wstring> filePaths;
+    for (const fs::directory_entry& entry : fs::recursive_directory_iterator(fs::path(directory)))
+    {
+        if (fs::is_regular_file(entry.status()))
+        {
+            filePaths.push_back(entry.path().wstring());
+        }
+    }
+    std::sort(filePaths.begin(), filePaths.end());
+
+    fs::path outputPath(archivePath);
+    if (outputPath.has_parent_path())
+    {
+        fs::create_directories(outputPath.parent_path());
+    }
+
+    // Same as the other caches: write a temporary first, a half written archive must never be mounted.
+    fs::path tempPath = outputPath;
+    tempPath += L".tmp";
+    std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+    if (!file)
+    {
+        return false;
+    }
+
+    ArchiveHeader header = {};
+    header.magic = ARCHIVE_MAGIC;
+    header.version = ARCHIVE_VERSION;
+    header.entryCount = static_cast<uint32_t>(filePaths.size());
+    header.alignment = static_cast<uint32_t>(ARCHIVE_ALIGNMENT);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    std::vector<Entry> entries;
+    std::string names;
+    std::vector<uint8_t> contents;
+    std::vector<uint8_t> compressed;
+    uint64_t offset = sizeof(header);
+    const char padding[ARCHIVE_ALIGNMENT] = {};
+    for (const std::wstring& filePath : filePaths)
+    {
+        if (!ReadLooseFile(filePath, contents))
+        {
+            return false;
+        }
+
+        std::string name = NormalizeName(filePath);
+        Entry entry = {};
+        entry.nameHash = Util::HashBytes(name.data(), name.size());
+        entry.nameOffset = static_cast<uint32_t>(names.size());
+        entry.nameLength = static_cast<uint32_t>(name.size());
+        entry.size = contents.size();
+        names += name;
+
+        // Only worth a decompression on every load when it saves at least an eighth.
+        const std::vector<uint8_t>* payload = &contents;
+        if (compress && !contents.empty())
+        {
+            Util::CompressLz(contents.data(), contents.size(), compressed);
+            if (compressed.size() < contents.size() - contents.size() / 8)
+            {
+                payload = &compressed;
+                entry.flags |= ENTRY_FLAG_COMPRESSED;
+            }
+        }
+
+        uint64_t alignedOffset = (offset + ARCHIVE_ALIGNMENT - 1) & ~(ARCHIVE_ALIGNMENT - 1);
+        file.write(padding, static_cast<std::streamsize>(alignedOffset - offset));
+        file.write(reinterpret_cast<const char*>(payload->data()), payload->size());
+        entry.offset = alignedOffset;
+        entry.storedSize = payload->size();
+        offset = alignedOffset + payload->size();
+
+        entries.push_back(entry);
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.nameHash < b.nameHash; });
+
+    uint64_t alignedOffset = (offset + ARCHIVE_ALIGNMENT - 1) & ~(ARCHIVE_ALIGNMENT - 1);
+    file.write(padding, static_cast<std::streamsize>(alignedOffset - offset));
+    header.entriesOffset = alignedOffset;
+    header.namesOffset = alignedOffset + entries.size() * sizeof(Entry);
+    header.namesSize = names.size();
+    file.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(Entry));
+    file.write(names.data(), names.size());
+
+    file.seekp(0);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    if (!file)
+    {
+        return false;
+    }
+    file.close();
+
+    std::error_code error;
+    fs::rename(tempPath, outputPath, error);
+    return !error;
+}
+
+bool AssetArchive::Open(const std::wstring& archivePath)
+{
+    Close();
+
+    _file = CreateFileW(archivePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (_file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(_file, &fileSize) || static_cast<uint64_t>(fileSize.QuadPart) < sizeof(ArchiveHeader))
+    {
+        Close();
+        return false;
+    }
+
+    _mapping = CreateFileMappingW(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (_mapping)
+    {
+        _data = static_cast<const uint8_t*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+    }
+    if (!_data)
+    {
+        Close();
+        return false;
+    }
+    _size = static_cast<size_t>(fileSize.QuadPart);
+
+    // Validate everything lookups rely on once, so Read() can trust the table.
+    ArchiveHeader header;
+    memcpy(&header, _data, sizeof(header));
+    bool valid = header.magic == ARCHIVE_MAGIC && header.version == ARCHIVE_VERSION &&
+        header.entriesOffset % alignof(Entry) == 0 &&
+        header.entriesOffset <= _size && header.entryCount <= (_size - header.entriesOffset) / sizeof(Entry) &&
+        header.namesOffset <= _size && header.namesSize <= _size - header.namesOffset;
+
+    _entries = reinterpret_cast<const Entry*>(_data + header.entriesOffset);
+    _entryCount = header.entryCount;
+    _names = reinterpret_cast<const char*>(_data + header.namesOffset);
+    for (UINT i = 0; valid && i < _entryCount; ++i)
+    {
+        const Entry& entry = _entries[i];
+        valid = entry.offset <= _size && entry.storedSize <= _size - entry.offset &&
+            static_cast<uint64_t>(entry.nameOffset) + entry.nameLength <= header.namesSize &&
+            ((entry.flags & ENTRY_FLAG_COMPRESSED) || entry.storedSize == entry.size) &&
+            (i == 0 || _entries[i - 1].nameHash <= entry.nameHash);
+    }
+
+    if (!valid)
+    {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void AssetArchive::Close()
+{
+    if (_data)
+    {
+        UnmapViewOfFile(_data);
+    }
+    if (_mapping)
+    {
+        CloseHandle(_mapping);
+    }
+    if (_file != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(_file);
+    }
+
+    _file = INVALID_HANDLE_VALUE;
+    _mapping = nullptr;
+    _data = nullptr;
+    _size = 0;
+    _entries = nullptr;
+    _entryCount = 0;
+    _names = nullptr;
+}
+
+bool AssetArchive::Contains(const std::wstring& filePath) const
+{
+    return Find(filePath) != nullptr;
+}
+
+bool AssetArchive::Read(const std::wstring& filePath, AssetSpan& span, std::vector<uint8_t>& storage) const
+{
+    const Entry* entry = Find(filePath);
+    if (!entry)
+    {
+        return false;
+    }
+
+    const uint8_t* payload = _data + entry->offset;
+    if (!(entry->flags & ENTRY_FLAG_COMPRESSED))
+    {
+        span.data = payload;
+        span.size = static_cast<size_t>(entry->size);
+        return true;
+    }
+
+    storage.resize(static_cast<size_t>(entry->size));
+    if (!Util::DecompressLz(payload, static_cast<size_t>(entry->storedSize), storage.data(), storage.size()))
+    {
+        return false;
+    }
+    span.data = storage.data();
+    span.size = storage.size();
+    return true;
+}
+
+std::string AssetArchive::NormalizeName(const std::wstring& filePath)
+{
+    std::string name;
+    name.reserve(filePath.size());
+    for (wchar_t character : filePath)
+    {
+        if (character == L'\\')
+        {
+            character = L'/';
+        }
+        else if (character >= L'A' && character <= L'Z')
+        {
+            character = character - L'A' + L'a';
+        }
+        name.push_back(static_cast<char>(character));
+    }
+
+    while (name.compare(0, 2, "./") == 0)
+    {
+        name.erase(0, 2);
+    }
+    return name;
+}
+
+const AssetArchive::Entry* AssetArchive::Find(const std::wstring& filePath) const
+{
+    if (!_entries)
+    {
+        return nullptr;
+    }
+
+    std::string name = NormalizeName(filePath);
+    uint64_t hash = Util::HashBytes(name.data(), name.size());
+
+    // Binary search by hash, the names only settle collisions.
+    const Entry* end = _entries + _entryCount;
+    const Entry* entry = std::lower_bound(_entries, end, hash, [](const Entry& a, uint64_t b) { return a.nameHash < b; });
+    for (; entry != end && entry->nameHash == hash; ++entry)
+    {
+        if (entry->nameLength == name.size() && memcmp(_names + entry->nameOffset, name.data(), name.size()) == 0)
+        {
+            return entry;
+        }
+    }
+    return nullptr;
+}
+
+bool Util::MountAssetArchive(const std::wstring& archivePath)
+{
+    auto archive = std::make_unique<AssetArchive>();
+    if (!archive->Open(archivePath))
+    {
+        return false;
+    }
+    g_mountedArchive = std::move(archive);
+    return true;
+}
+
+bool Util::ReadAsset(const std::wstring& filePath, AssetSpan& span, std::vector<uint8_t>& storage)
+{
+    if (g_mountedArchive && g_mountedArchive->Read(filePath, span, storage))
+    {
+        return true;
+    }
+
+    if (!ReadLooseFile(filePath, storage))
+    {
+        return false;
+    }
+    span.data = storage.data();
+    span.size = storage.size();
+    return true;
+}
+
+void Util::CompressLz(const uint8_t* input, size_t size, std::vector<uint8_t>& output)
+{
+    output.clear();
+    output.reserve(size + size / 255 + 16);
+
+    // Most recent position of each hashed 4-byte sequence, greedy matching against it.
+    std::vector<uint32_t> table(size_t(1) << LZ_HASH_BITS, UINT32_MAX);
+    size_t anchor = 0;
+    size_t position = 0;
+    while (position + LZ_MIN_MATCH <= size)
+    {
+        uint32_t sequence = Load32(input + position);
+        uint32_t slot = (sequence * 2654435761u) >> (32 - LZ_HASH_BITS);
+        size_t candidate = table[slot];
+        table[slot] = static_cast<uint32_t>(position);
+
+        if (candidate == UINT32_MAX || position - candidate > LZ_MAX_OFFSET || Load32(input + candidate) != sequence)
+        {
+            position++;
+            continue;
+        }
+
+        size_t matchLength = LZ_MIN_MATCH;
+        while (position + matchLength < size && input[candidate + matchLength] == input[position + matchLength])
+        {
+            matchLength++;
+        }
+
+        WriteSequence(output, input + anchor, position - anchor, position - candidate, matchLength);
+        position += matchLength;
+        anchor = position;
+    }
+
+    WriteSequence(output, input + anchor, size - anchor, 0, 0);
+}
+
+bool Util::DecompressLz(const uint8_t* input, size_t size, uint8_t* output, size_t outputSize)
+{
+    // Every length and offset is checked, a corrupt archive must fail instead of writing out of bounds.
+    const uint8_t* end = input + size;
+    size_t written = 0;
+    while (input < end)
+    {
+        uint8_t token = *input++;
+        size_t literalCount = token >> 4;
+        if (literalCount == 15 && !ReadLength(input, end, literalCount))
+        {
+            return false;
+        }
+        if (literalCount > static_cast<size_t>(end - input) || literalCount > outputSize - written)
+        {
+            return false;
+        }
+        memcpy(output + written, input, literalCount);
+        input += literalCount;
+        written += literalCount;
+
+        if (input == end)
+        {
+            break; // the last sequence has no match
+        }
+
+        if (end - input < 2)
+        {
+            return false;
+        }
+        size_t offset = input[0] | (static_cast<size_t>(input[1]) << 8);
+        input += 2;
+        size_t matchLength = token & 15;
+        if (matchLength == 15 && !ReadLength(input, end, matchLength))
+        {
+            return false;
+        }
+        matchLength += LZ_MIN_MATCH;
+        if (offset == 0 || offset > written || matchLength > outputSize - written)
+        {
+            return false;
+        }
+
+        // Byte by byte, the match may overlap what it produces (runs).
+        const uint8_t* source = output + written - offset;
+        for (size_t i = 0; i < matchLength; ++i)
+        {
+            output[written + i] = source[i];
+        }
+        written += matchLength;
+    }
+    return written == outputSize;
+}
\ No newline at end of file
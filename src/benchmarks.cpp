@@ -0,0 +1,2636 @@
+#include "pch.hpp"
+
+#include "benchmarks.hpp"
+
+#include "instance_transforms.hpp"
+#include "culling.hpp"
+#include "transform_hierarchy.hpp"
+#include "mesh.hpp"
+#include "vertex_quantization.hpp"
+#include "mesh_lod.hpp"
+#include "texture_residency.hpp"
+#include "asset_archive.hpp"
+#include "job_system.hpp"
+#include "task_graph.hpp"
+#include "frame_allocator.hpp"
+#include "profiler.hpp"
+#include "geometry_scene.hpp"
+#include "frame_stats.hpp"
+#include "camera.hpp"
+#include "dialogue_sample.hpp"
+#include "command_context.hpp"
+#include "ui_rasterizer.hpp"
+#include "frame_capture.hpp"
+#include "pipeline_cache.hpp"
+#include "shader_cache.hpp"
+#include "shader_permutations.hpp"
+#include "texture_streamer.hpp"
+#include "texture_cooker.hpp"
+#include "command_queue.hpp"
+#include "renderer.hpp"
+#include "pipelines/geometry_pipeline.hpp"
+
+#ifndef _SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING
+#define _SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING
+#endif
+#include <experimental/filesystem>
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <future>
+#include <set>
+#include <psapi.h>
+
+namespace fs = std::experimental::filesystem;
+
+using namespace DirectX;
+
+namespace
+{
+    using Clock = std::chrono::high_resolution_clock;
+
+    // Average milliseconds per call over enough iterations to run for at least ~100ms.
+    template<typename Function>
+    double MeasureMilliseconds(Function&& function)
+    {
+        function(); // warm up caches and lazy allocations
+
+        UINT iterations = 0;
+        auto start = Clock::now();
+        std::chrono::duration<double, std::milli> elapsed(0);
+        do
+        {
+            function();
+            iterations++;
+            elapsed = Clock::now() - start;
+        } while (elapsed.count() < 100.0);
+
+        return elapsed.count() / iterations;
+    }
+
+    bool InstanceUpdate()
+    {
+        printf("%10s %14s %14s %12s\n", "instances", "soa simd (ms)", "scalar (ms)", "ns/instance");
+
+        for (UINT count : { 1u, 10u, 100u, 1000u, 10000u, 100000u })
+        {
+            InstanceTransforms instances;
+            for (UINT i = 0; i < count; ++i)
+            {
+                instances.Add(XMFLOAT3(static_cast<float>(i % 100), static_cast<float>(i / 100), 0.0f), 0.5f, i * 0.1f, 1.0f);
+            }
+            double soaTime = MeasureMilliseconds([&]() { instances.Update(1.0f / 60.0f); });
+
+            // Baseline: what GeometryPipeline::Update did for its single cube, once per object.
+            std::vector<float> angles(count, 0.0f);
+            std::vector<XMFLOAT4X4> matrices(count);
+            const XMVECTOR axis = XMVectorSet(0, 1, 1, 0);
+            double scalarTime = MeasureMilliseconds([&]()
+            {
+                for (UINT i = 0; i < count; ++i)
+                {
+                    angles[i] = XMScalarModAngle(angles[i] + 1.0f / 60.0f);
+                    XMMATRIX world = XMMatrixScaling(0.5f, 0.5f, 0.5f) * XMMatrixRotationAxis(axis, angles[i]) *
+                        XMMatrixTranslation(static_cast<float>(i % 100), static_cast<float>(i / 100), 0.0f);
+                    XMStoreFloat4x4(&matrices[i], world);
+                }
+            });
+
+            printf("%10u %14.4f %14.4f %12.2f\n", count, soaTime, scalarTime, soaTime * 1e6 / count);
+        }
+
+        return true;
+    }
+
+    bool FrustumCulling()
+    {
+        // Objects scattered in a 200 unit cube around a camera with a 45 degree fov, roughly 5% survive.
+        XMMATRIX view = XMMatrixLookAtLH(XMVectorSet(0, 0, -10, 1), XMVectorSet(0, 0, 0, 1), XMVectorSet(0, 1, 0, 0));
+        XMMATRIX projection = XMMatrixPerspectiveFovLH(XMConvertToRadians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+        Culling::Frustum frustum = Culling::ExtractFrustum(view * projection);
+
+        printf("%10s %10s %16s %16s %16s\n", "objects", "visible", "scalar (obj/ms)", "simd (obj/ms)", "parallel (obj/ms)");
+
+        // The odd counts leave a tail that isn't a whole 8-wide batch.
+        bool identical = true;
+        for (UINT count : { 1000u, 1003u, 10000u, 10007u, 100000u, 1000000u, 1000005u })
+        {
+            std::vector<float> x(count), y(count), z(count), radius(count, 0.87f);
+            uint32_t seed = 12345;
+            auto random = [&seed]() { seed = seed * 1664525u + 1013904223u; return (seed >> 8) * (200.0f / 16777216.0f) - 100.0f; };
+            for (UINT i = 0; i < count; ++i)
+            {
+                x[i] = random();
+                y[i] = random();
+                z[i] = random();
+            }
+            Culling::SphereSet spheres = { x.data(), y.data(), z.data(), radius.data(), count };
+
+            std::vector<UINT> scalarVisible(count + 8);
+            std::vector<UINT> simdVisible(count + 8);
+            std::vector<UINT> parallelVisible;
+            UINT visibleCount = 0;
+            UINT simdCount = 0;
+            double scalarTime = MeasureMilliseconds([&]() { visibleCount = Culling::CullSpheresScalar(frustum, spheres, 0, count, scalarVisible.data()); });
+            double simdTime = MeasureMilliseconds([&]() { simdCount = Culling::CullSpheres(frustum, spheres, 0, count, simdVisible.data()); });
+            double parallelTime = MeasureMilliseconds([&]() { Culling::CullSpheresParallel(frustum, spheres, parallelVisible); });
+
+            // All three have to find the same spheres, the order within a list doesn't matter.
+            scalarVisible.resize(visibleCount);
+            simdVisible.resize(simdCount);
+            std::sort(scalarVisible.begin(), scalarVisible.end());
+            std::sort(simdVisible.begin(), simdVisible.end());
+            std::sort(parallelVisible.begin(), parallelVisible.end());
+            bool same = simdVisible == scalarVisible && parallelVisible == scalarVisible;
+            identical &= same;
+
+            printf("%10u %10u %16.0f %16.0f %16.0f%s\n", count, visibleCount, count / scalarTime, count / simdTime, count / parallelTime,
+                same ? "" : "  RESULTS DIFFER");
+        }
+        printf("  simd and parallel results %s the scalar ones\n", identical ? "match" : "DIFFER FROM");
+
+        return identical;
+    }
+
+    bool HierarchyUpdate()
+    {
+        // 100k nodes with random parents (so depths vary), 1% of them moved every frame.
+        const UINT nodeCount = 100000;
+        const UINT movedCount = nodeCount / 100;
+
+        uint32_t seed = 4711;
+        auto random = [&seed]() { seed = seed * 1664525u + 1013904223u; return seed >> 8; };
+
+        TransformHierarchy hierarchy;
+        const XMFLOAT4 identity(0.0f, 0.0f, 0.0f, 1.0f);
+        hierarchy.AddNode(TransformHierarchy::INVALID_NODE, XMFLOAT3(0.0f, 0.0f, 0.0f), identity, 1.0f);
+        for (UINT i = 1; i < nodeCount; ++i)
+        {
+            // Uniformly random parents give a random recursive tree: logarithmic depth, mostly small subtrees.
+            UINT parent = random() % i;
+            hierarchy.AddNode(parent, XMFLOAT3(1.0f, 0.0f, 0.0f), identity, 1.0f);
+        }
+        hierarchy.SortByDepth();
+        hierarchy.Update();
+
+        std::vector<UINT> moved(movedCount);
+        UINT recomputed = 0;
+        float offset = 0.0f;
+        double partialTime = MeasureMilliseconds([&]()
+        {
+            offset += 0.01f;
+            for (UINT& node : moved)
+            {
+                node = random() % nodeCount;
+                hierarchy.SetLocalTranslation(node, XMFLOAT3(1.0f, offset, 0.0f));
+            }
+            recomputed = hierarchy.Update();
+        });
+
+        double fullTime = MeasureMilliseconds([&]()
+        {
+            offset += 0.01f;
+            hierarchy.SetLocalTranslation(0, XMFLOAT3(0.0f, offset, 0.0f));
+            hierarchy.Update();
+        });
+
+        // Sorting again marks every node dirty, so this recomputes the whole hierarchy. The dirty updates
+        // before it must not have missed any node.
+        hierarchy.SetLocalTranslation(random() % nodeCount, XMFLOAT3(1.0f, -offset, 0.0f));
+        hierarchy.Update();
+        std::vector<XMFLOAT4X4> incremental(nodeCount);
+        for (UINT node = 0; node < nodeCount; ++node)
+        {
+            incremental[node] = hierarchy.GetWorld(node);
+        }
+        hierarchy.SortByDepth();
+        hierarchy.Update();
+        bool matches = true;
+        for (UINT node = 0; node < nodeCount; ++node)
+        {
+            matches &= memcmp(&incremental[node], &hierarchy.GetWorld(node), sizeof(XMFLOAT4X4)) == 0;
+        }
+
+        printf("%u nodes, %u moved per frame (%u world matrices recomputed incl. subtrees)\n", nodeCount, movedCount, recomputed);
+        printf("  dirty update: %.4f ms\n", partialTime);
+        printf("  full update:  %.4f ms\n", fullTime);
+        printf("  dirty updates %s a full recompute\n", matches ? "match" : "DIFFER FROM");
+
+        return matches;
+    }
+
+    // Every triangle as the bytes of its three vertices, rotated to start at the smallest one so the winding is
+    // kept, then sorted. Equal for meshes that draw the same triangles, whatever the vertex and index order.
+    std::vector<std::string> GetTriangleSet(const Util::MeshData& mesh)
+    {
+        std::vector<std::string> triangles(mesh.indices.size() / 3);
+        for (size_t triangle = 0; triangle < triangles.size(); ++triangle)
+        {
+            std::string corners[3];
+            for (size_t corner = 0; corner < 3; ++corner)
+            {
+                const Util::Vertex& vertex = mesh.vertices[mesh.indices[triangle * 3 + corner]];
+                corners[corner].assign(reinterpret_cast<const char*>(&vertex), sizeof(Util::Vertex));
+            }
+            size_t first = std::min_element(std::begin(corners), std::end(corners)) - std::begin(corners);
+            triangles[triangle] = corners[first] + corners[(first + 1) % 3] + corners[(first + 2) % 3];
+        }
+        std::sort(triangles.begin(), triangles.end());
+        return triangles;
+    }
+
+    bool MeshImport()
+    {
+        // A 512x512 quad grid written as OBJ with rows of quads in scrambled order, so the
+        // optimizer has some actual work to do.
+        const UINT gridSize = 512;
+        fs::path objPath = fs::temp_directory_path() / "diabolic_bench_grid.obj";
+        {
+            std::ofstream obj(objPath);
+            for (UINT y = 0; y <= gridSize; ++y)
+            {
+                for (UINT x = 0; x <= gridSize; ++x)
+                {
+                    obj << "v " << x << " " << y << " 0\nvt " << x / float(gridSize) << " " << y / float(gridSize) << "\n";
+                }
+            }
+            obj << "vn 0 0 -1\n";
+
+            uint32_t seed = 1;
+            std::vector<UINT> rows(gridSize);
+            for (UINT y = 0; y < gridSize; ++y)
+            {
+                rows[y] = y;
+            }
+            for (UINT y = gridSize - 1; y > 0; --y)
+            {
+                seed = seed * 1664525u + 1013904223u;
+                std::swap(rows[y], rows[(seed >> 8) % (y + 1)]);
+            }
+            for (UINT y : rows)
+            {
+                for (UINT x = 0; x < gridSize; ++x)
+                {
+                    UINT v0 = y * (gridSize + 1) + x + 1;
+                    UINT v1 = v0 + 1;
+                    UINT v2 = v1 + gridSize + 1;
+                    UINT v3 = v0 + gridSize + 1;
+                    obj << "f " << v0 << "/" << v0 << "/1 " << v1 << "/" << v1 << "/1 " << v2 << "/" << v2 << "/1 " << v3 << "/" << v3 << "/1\n";
+                }
+            }
+        }
+
+        Util::MeshData mesh;
+        auto start = Clock::now();
+        bool imported = Util::ImportObj(objPath.wstring(), mesh);
+        std::chrono::duration<double, std::milli> importTime = Clock::now() - start;
+        if (!imported)
+        {
+            fprintf(stderr, "Failed to import %s\n", objPath.string().c_str());
+            return false;
+        }
+
+        float acmrBefore = Util::ComputeACMR(mesh.indices, mesh.vertices.size());
+        std::vector<std::string> trianglesBefore = GetTriangleSet(mesh);
+        start = Clock::now();
+        Util::OptimizeMesh(mesh);
+        std::chrono::duration<double, std::milli> optimizeTime = Clock::now() - start;
+        float acmrAfter = Util::ComputeACMR(mesh.indices, mesh.vertices.size());
+        bool sameTriangles = GetTriangleSet(mesh) == trianglesBefore;
+
+        fs::path cookedPath = fs::temp_directory_path() / "diabolic_bench_grid.mesh";
+        Util::SaveCookedMesh(cookedPath.wstring(), mesh);
+        Util::MeshData loaded;
+        bool loadedCooked = false;
+        double cookedTime = MeasureMilliseconds([&]() { loadedCooked = Util::LoadCookedMesh(cookedPath.wstring(), loaded); });
+        bool roundTrip = loadedCooked && loaded.indices == mesh.indices && loaded.vertices.size() == mesh.vertices.size() &&
+            memcmp(loaded.vertices.data(), mesh.vertices.data(), mesh.vertices.size() * sizeof(Util::Vertex)) == 0;
+
+        // 0xFFFF is the strip cut value: 65535 vertices still fit 16-bit indices, one more needs 32-bit.
+        bool indexWidths = true;
+        for (size_t vertexCount : { size_t(3), size_t(0xFFFF), size_t(0x10000), size_t(0x20000) })
+        {
+            Util::MeshData sized;
+            sized.vertices.resize(vertexCount);
+            sized.indices = { 0, static_cast<uint32_t>(vertexCount - 1), 1 };
+            bool wide = vertexCount > 0xFFFF;
+            std::vector<uint8_t> indexData = sized.GetIndexData();
+            uint32_t last = 0;
+            memcpy(&last, indexData.data() + sized.GetIndexSize(), sized.GetIndexSize());
+            indexWidths &= sized.Needs32BitIndices() == wide && sized.GetIndexFormat() == (wide ? DXGI_FORMAT_R32_UINT : DXGI_FORMAT_R16_UINT) &&
+                indexData.size() == 3 * (wide ? 4 : 2) && last == vertexCount - 1;
+        }
+
+        printf("%zu vertices, %zu triangles, %s indices\n", mesh.vertices.size(), mesh.indices.size() / 3,
+            mesh.Needs32BitIndices() ? "32-bit" : "16-bit");
+        printf("  obj import:    %.2f ms (%.1f MB)\n", importTime.count(), fs::file_size(objPath) / (1024.0 * 1024.0));
+        printf("  optimize:      %.2f ms\n", optimizeTime.count());
+        printf("  cooked load:   %.2f ms\n", cookedTime);
+        printf("  ACMR (fifo 16): %.3f -> %.3f\n", acmrBefore, acmrAfter);
+
+        bool passed = true;
+        auto check = [&passed](const char* step, bool ok)
+        {
+            printf("  %-36s %s\n", step, ok ? "ok" : "FAILED");
+            passed &= ok;
+        };
+        check("optimize keeps the triangles", sameTriangles);
+        check("optimize doesn't raise the ACMR", acmrAfter <= acmrBefore);
+        check("16-bit indices up to 65535 vertices", indexWidths);
+        check("cooked round trip is exact", roundTrip);
+
+        fs::remove(objPath);
+        fs::remove(cookedPath);
+
+        return passed;
+    }
+
+    bool VertexQuantization()
+    {
+        // Random vertices in a 100 unit box, unit normals in every direction and uvs in [0, 4).
+        const size_t count = 1000000;
+        uint32_t seed = 99;
+        auto random = [&seed]() { seed = seed * 1664525u + 1013904223u; return (seed >> 8) / 16777216.0f; };
+
+        std::vector<Util::Vertex> vertices(count);
+        for (Util::Vertex& vertex : vertices)
+        {
+            vertex.position = XMFLOAT3(random() * 100.0f - 50.0f, random() * 100.0f - 50.0f, random() * 100.0f - 50.0f);
+            XMStoreFloat3(&vertex.normals, XMVector3Normalize(XMVectorSet(random() * 2.0f - 1.0f, random() * 2.0f - 1.0f, random() * 2.0f - 1.0f, 0.0f)));
+            vertex.uv = XMFLOAT2(random() * 4.0f, random() * 4.0f);
+        }
+
+        Util::PositionQuantization quantization = Util::ComputePositionQuantization(vertices);
+        std::vector<Util::QuantizedVertex> quantized(count);
+        double encodeTime = MeasureMilliseconds([&]() { Util::QuantizeVertices(vertices.data(), count, quantization, quantized.data()); });
+
+        // Round trip, every error has to stay within what the formats can represent.
+        float maxPositionError = 0.0f;
+        float maxNormalAngle = 0.0f;
+        float maxUvError = 0.0f;
+        for (size_t i = 0; i < count; ++i)
+        {
+            Util::Vertex decoded = Util::DequantizeVertex(quantized[i], quantization);
+            XMVECTOR positionError = XMVectorAbs(XMVectorSubtract(XMLoadFloat3(&decoded.position), XMLoadFloat3(&vertices[i].position)));
+            maxPositionError = std::max(maxPositionError, XMVectorGetX(XMVectorMax(positionError, XMVectorMax(XMVectorSplatY(positionError), XMVectorSplatZ(positionError)))));
+            // For small angles the chord length equals the angle, without acos' precision loss near 1.
+            maxNormalAngle = std::max(maxNormalAngle, XMVectorGetX(XMVector3Length(XMVectorSubtract(XMLoadFloat3(&decoded.normals), XMLoadFloat3(&vertices[i].normals)))));
+            maxUvError = std::max(maxUvError, std::max(fabsf(decoded.uv.x - vertices[i].uv.x), fabsf(decoded.uv.y - vertices[i].uv.y)));
+        }
+
+        // Half a quantization step, with a little slack for float rounding.
+        const float positionBound = std::max(quantization.scale.x, std::max(quantization.scale.y, quantization.scale.z)) / 65535.0f * 0.5f * 1.01f;
+        const float normalBound = XMConvertToRadians(0.01f);
+        const float uvBound = 4.0f / 2048.0f; // half has 11 significant bits
+        bool passed = maxPositionError <= positionBound && maxNormalAngle <= normalBound && maxUvError <= uvBound;
+
+        printf("%zu vertices, %zu -> %zu bytes per vertex (%.1f -> %.1f MB)\n", count, sizeof(Util::Vertex), sizeof(Util::QuantizedVertex),
+            count * sizeof(Util::Vertex) / (1024.0 * 1024.0), count * sizeof(Util::QuantizedVertex) / (1024.0 * 1024.0));
+        printf("  encode: %.2f ms (%.0f vertices/ms)\n", encodeTime, count / encodeTime);
+        printf("  max position error: %.6f (bound %.6f)\n", maxPositionError, positionBound);
+        printf("  max normal error:   %.5f deg (bound %.5f)\n", XMConvertToDegrees(maxNormalAngle), XMConvertToDegrees(normalBound));
+        printf("  max uv error:       %.6f (bound %.6f)\n", maxUvError, uvBound);
+        printf("  round trip %s\n", passed ? "passed" : "FAILED");
+
+        return passed;
+    }
+
+    // Rolling terrain of size x size quads, the kind of dense mesh LODs are made for.
+    Util::MeshData CreateTerrain(UINT size, float frequency)
+    {
+        Util::MeshData mesh;
+        for (UINT y = 0; y <= size; ++y)
+        {
+            for (UINT x = 0; x <= size; ++x)
+            {
+                float height = sinf(x * frequency) * cosf(y * frequency * 1.3f) * 4.0f;
+                mesh.vertices.emplace_back(XMFLOAT3(static_cast<float>(x), static_cast<float>(y), height), XMFLOAT3(0.0f, 0.0f, -1.0f),
+                    XMFLOAT2(x / static_cast<float>(size), y / static_cast<float>(size)));
+            }
+        }
+        for (UINT y = 0; y < size; ++y)
+        {
+            for (UINT x = 0; x < size; ++x)
+            {
+                uint32_t v0 = y * (size + 1) + x;
+                uint32_t v1 = v0 + 1;
+                uint32_t v2 = v1 + size + 1;
+                uint32_t v3 = v0 + size + 1;
+                mesh.indices.insert(mesh.indices.end(), { v0, v1, v2, v0, v2, v3 });
+            }
+        }
+        Util::OptimizeMesh(mesh);
+        return mesh;
+    }
+
+    // Exact point to triangle distance: to the plane when the projection lands inside, else to the nearest edge.
+    double DistanceToTriangle(const double p[3], const XMFLOAT3& a, const XMFLOAT3& b, const XMFLOAT3& c)
+    {
+        const double corners[3][3] = { { a.x, a.y, a.z }, { b.x, b.y, b.z }, { c.x, c.y, c.z } };
+        auto sub = [](const double* u, const double* v, double* out) { out[0] = u[0] - v[0]; out[1] = u[1] - v[1]; out[2] = u[2] - v[2]; };
+        auto dot = [](const double* u, const double* v) { return u[0] * v[0] + u[1] * v[1] + u[2] * v[2]; };
+
+        double e0[3], e1[3], normal[3], offset[3];
+        sub(corners[1], corners[0], e0);
+        sub(corners[2], corners[0], e1);
+        normal[0] = e0[1] * e1[2] - e0[2] * e1[1];
+        normal[1] = e0[2] * e1[0] - e0[0] * e1[2];
+        normal[2] = e0[0] * e1[1] - e0[1] * e1[0];
+        sub(p, corners[0], offset);
+        double area = dot(normal, normal);
+        if (area > 0.0)
+        {
+            double d00 = dot(e0, e0), d01 = dot(e0, e1), d11 = dot(e1, e1);
+            double d20 = dot(offset, e0), d21 = dot(offset, e1);
+            double v = (d11 * d20 - d01 * d21) / area;
+            double w = (d00 * d21 - d01 * d20) / area;
+            if (v >= 0.0 && w >= 0.0 && v + w <= 1.0)
+            {
+                return fabs(dot(offset, normal)) / sqrt(area);
+            }
+        }
+
+        double best = DBL_MAX;
+        for (int edge = 0; edge < 3; ++edge)
+        {
+            const double* from = corners[edge];
+            const double* to = corners[(edge + 1) % 3];
+            double direction[3], toPoint[3];
+            sub(to, from, direction);
+            sub(p, from, toPoint);
+            double lengthSquared = dot(direction, direction);
+            double t = lengthSquared > 0.0 ? std::min(std::max(dot(toPoint, direction) / lengthSquared, 0.0), 1.0) : 0.0;
+            double closest[3] = { from[0] + direction[0] * t, from[1] + direction[1] * t, from[2] + direction[2] * t };
+            double gap[3];
+            sub(p, closest, gap);
+            best = std::min(best, dot(gap, gap));
+        }
+        return sqrt(best);
+    }
+
+    // Largest distance from points spread over the simplified triangles to the full terrain. The
+    // height difference bounds the distance, so only the grid cells within it need an exact test.
+    double MeasureTerrainDistance(const Util::MeshData& terrain, UINT size, const uint32_t* indices, size_t indexCount)
+    {
+        std::vector<XMFLOAT3> grid((size + 1) * (size + 1));
+        for (const Util::Vertex& vertex : terrain.vertices)
+        {
+            grid[static_cast<UINT>(vertex.position.y) * (size + 1) + static_cast<UINT>(vertex.position.x)] = vertex.position;
+        }
+
+        const int SUBDIVISIONS = 4;
+        double maxDistance = 0.0;
+        for (size_t i = 0; i + 2 < indexCount; i += 3)
+        {
+            const XMFLOAT3& a = terrain.vertices[indices[i + 0]].position;
+            const XMFLOAT3& b = terrain.vertices[indices[i + 1]].position;
+            const XMFLOAT3& c = terrain.vertices[indices[i + 2]].position;
+            for (int u = 0; u <= SUBDIVISIONS; ++u)
+            {
+                for (int v = 0; u + v <= SUBDIVISIONS; ++v)
+                {
+                    // The corners are vertices of the full mesh.
+                    int w = SUBDIVISIONS - u - v;
+                    if (u == SUBDIVISIONS || v == SUBDIVISIONS || w == SUBDIVISIONS)
+                    {
+                        continue;
+                    }
+                    double p[3] = {
+                        (a.x * u + b.x * v + c.x * w) / static_cast<double>(SUBDIVISIONS),
+                        (a.y * u + b.y * v + c.y * w) / static_cast<double>(SUBDIVISIONS),
+                        (a.z * u + b.z * v + c.z * w) / static_cast<double>(SUBDIVISIONS) };
+
+                    int cellX = std::min(static_cast<int>(p[0]), static_cast<int>(size) - 1);
+                    int cellY = std::min(static_cast<int>(p[1]), static_cast<int>(size) - 1);
+                    double fx = p[0] - cellX, fy = p[1] - cellY;
+                    const float z00 = grid[cellY * (size + 1) + cellX].z, z10 = grid[cellY * (size + 1) + cellX + 1].z;
+                    const float z01 = grid[(cellY + 1) * (size + 1) + cellX].z, z11 = grid[(cellY + 1) * (size + 1) + cellX + 1].z;
+                    double height = fx >= fy ? z00 + fx * (z10 - z00) + fy * (z11 - z10) : z00 + fy * (z01 - z00) + fx * (z11 - z01);
+                    double distance = fabs(p[2] - height);
+
+                    int radius = static_cast<int>(ceil(distance));
+                    for (int y = std::max(cellY - radius, 0); y <= std::min(cellY + radius, static_cast<int>(size) - 1); ++y)
+                    {
+                        for (int x = std::max(cellX - radius, 0); x <= std::min(cellX + radius, static_cast<int>(size) - 1); ++x)
+                        {
+                            const XMFLOAT3& q0 = grid[y * (size + 1) + x];
+                            const XMFLOAT3& q1 = grid[y * (size + 1) + x + 1];
+                            const XMFLOAT3& q2 = grid[(y + 1) * (size + 1) + x + 1];
+                            const XMFLOAT3& q3 = grid[(y + 1) * (size + 1) + x];
+                            distance = std::min(distance, std::min(DistanceToTriangle(p, q0, q1, q2), DistanceToTriangle(p, q0, q2, q3)));
+                        }
+                    }
+                    maxDistance = std::max(maxDistance, distance);
+                }
+            }
+        }
+        return maxDistance;
+    }
+
+    bool LodGeneration()
+    {
+        Util::MeshData terrain = CreateTerrain(512, 0.05f);
+        Util::LodChain chain;
+        auto start = Clock::now();
+        Util::GenerateLodChain(terrain, chain);
+        std::chrono::duration<double, std::milli> chainTime = Clock::now() - start;
+
+        printf("%zu triangle terrain, chain built in %.1f ms (%.0f triangles/ms)\n",
+            terrain.indices.size() / 3, chainTime.count(), terrain.indices.size() / 3 / chainTime.count());
+        printf("%6s %10s %12s %12s %10s %10s\n", "level", "triangles", "error", "measured", "meshlets", "tri/mlet");
+
+        // Every level has to be coarser than the one before, and its error can't shrink. The error
+        // also has to cover the distance to the full terrain, measured here independently.
+        bool consistent = true;
+        bool bounded = true;
+        for (size_t level = 0; level < chain.lods.size(); ++level)
+        {
+            const Util::MeshLod& lod = chain.lods[level];
+            const Util::MeshletData& meshlets = chain.meshlets[level];
+            double measured = MeasureTerrainDistance(terrain, 512, chain.indices.data() + lod.indexOffset, lod.indexCount);
+            printf("%6zu %10u %12.5f %12.5f %10zu %10.1f\n", level, lod.indexCount / 3, lod.error, measured, meshlets.meshlets.size(),
+                lod.indexCount / 3.0 / std::max<size_t>(meshlets.meshlets.size(), 1));
+            if (level > 0)
+            {
+                consistent &= lod.indexCount < chain.lods[level - 1].indexCount && lod.error >= chain.lods[level - 1].error;
+            }
+            bounded &= measured <= lod.error + 1e-3;
+        }
+
+        // Looking at the underside, most meshlets should be rejected by their cones.
+        UINT backfacing = 0;
+        for (const Util::Meshlet& meshlet : chain.meshlets[0].meshlets)
+        {
+            backfacing += Util::IsMeshletBackfacing(meshlet, XMVectorSet(256.0f, 256.0f, -200.0f, 1.0f)) ? 1 : 0;
+        }
+        printf("  cone culled from below: %u of %zu meshlets\n", backfacing, chain.meshlets[0].meshlets.size());
+        printf("  error chain %s\n", consistent ? "consistent" : "INCONSISTENT");
+        printf("  measured distance %s\n", bounded ? "within the errors" : "EXCEEDS AN ERROR");
+
+        // Many smaller meshes, serial versus one job each.
+        std::vector<Util::MeshData> meshes;
+        for (UINT i = 0; i < 16; ++i)
+        {
+            meshes.push_back(CreateTerrain(128, 0.03f + i * 0.01f));
+        }
+        std::vector<const Util::MeshData*> meshPointers;
+        for (const Util::MeshData& mesh : meshes)
+        {
+            meshPointers.push_back(&mesh);
+        }
+
+        std::vector<Util::LodChain> chains(meshes.size());
+        start = Clock::now();
+        for (size_t i = 0; i < meshes.size(); ++i)
+        {
+            Util::GenerateLodChain(meshes[i], chains[i]);
+        }
+        std::chrono::duration<double, std::milli> serialTime = Clock::now() - start;
+
+        start = Clock::now();
+        Util::GenerateLodChains(meshPointers, chains);
+        std::chrono::duration<double, std::milli> parallelTime = Clock::now() - start;
+        printf("  %zu meshes: serial %.1f ms, parallel %.1f ms\n", meshes.size(), serialTime.count(), parallelTime.count());
+
+        // The higher frequencies curve more between the kept vertices.
+        bool meshesBounded = true;
+        for (size_t i = 0; i < meshes.size(); ++i)
+        {
+            for (const Util::MeshLod& lod : chains[i].lods)
+            {
+                meshesBounded &= MeasureTerrainDistance(meshes[i], 128, chains[i].indices.data() + lod.indexOffset, lod.indexCount) <= lod.error + 1e-3;
+            }
+        }
+        printf("  measured distance of the %zu meshes %s\n", meshes.size(), meshesBounded ? "within the errors" : "EXCEEDS AN ERROR");
+
+        return consistent && bounded && meshesBounded;
+    }
+
+    // Mip sizes of a full chain, bytesPerBlock per 4x4 block (8 for BC1, 64 for RGBA8).
+    std::vector<UINT64> GetMipSizes(UINT size, UINT64 bytesPerBlock)
+    {
+        std::vector<UINT64> mipSizes;
+        for (UINT mipSize = size; ; mipSize /= 2)
+        {
+            UINT64 blocks = std::max<UINT64>((mipSize + 3) / 4, 1);
+            mipSizes.push_back(blocks * blocks * bytesPerBlock);
+            if (mipSize == 1)
+            {
+                break;
+            }
+        }
+        return mipSizes;
+    }
+
+    bool TextureResidencySimulation()
+    {
+        std::vector<TextureResidency::Change> changes;
+        bool passed = true;
+
+        // Three 1024x1024 RGBA8 textures, the budget fits two full chains and some. Requesting a third
+        // has to take the mips of the least recently used texture, not the ones in view.
+        {
+            std::vector<UINT64> mipSizes = GetMipSizes(1024, 64);
+            UINT64 chainSize = 0;
+            for (UINT64 size : mipSizes)
+            {
+                chainSize += size;
+            }
+
+            TextureResidency residency(chainSize * 2 + chainSize / 8);
+            UINT a = residency.AddTexture(1024, 1024, mipSizes);
+            UINT b = residency.AddTexture(1024, 1024, mipSizes);
+            UINT c = residency.AddTexture(1024, 1024, mipSizes);
+
+            residency.BeginFrame();
+            residency.RequestMip(a, 0);
+            residency.Update(changes);
+            residency.BeginFrame();
+            residency.RequestMip(b, 0);
+            residency.Update(changes);
+            bool ok = residency.GetResidentMip(a) == 0 && residency.GetResidentMip(b) == 0;
+
+            residency.BeginFrame();
+            residency.RequestMip(b, 0);
+            residency.RequestMip(c, 0);
+            residency.Update(changes);
+            ok &= residency.GetResidentMip(b) == 0 && residency.GetResidentMip(c) == 0 &&
+                residency.GetResidentMip(a) > 0 && residency.GetResidentBytes() <= residency.GetBudget();
+
+            // A coarser request keeps the finer mips while there is room for them.
+            residency.BeginFrame();
+            residency.RequestMip(c, 3);
+            residency.Update(changes);
+            ok &= residency.GetResidentMip(c) == 0 && changes.empty();
+
+            // A closer object's request wins, and the estimate goes one mip coarser per doubled distance.
+            ok &= TextureResidency::EstimateMip(1024, 11, 1.0f, 8.0f, 1024.0f) == 3 &&
+                TextureResidency::EstimateMip(1024, 11, 1.0f, 16.0f, 1024.0f) == 4 &&
+                TextureResidency::EstimateMip(1024, 11, 1.0f, 0.5f, 1024.0f) == 0 &&
+                TextureResidency::EstimateMip(1024, 11, 1.0f, 1e9f, 1024.0f) == 10;
+            residency.BeginFrame();
+            residency.RequestForObject(a, 1.0f, 16.0f, 1024.0f);
+            residency.RequestForObject(a, 1.0f, 8.0f, 1024.0f);
+            ok &= residency.GetRequestedMip(a) == 3;
+            printf("eviction order and estimates %s\n", ok ? "ok" : "FAILED");
+            passed &= ok;
+        }
+
+        // A camera flying over a field of objects, each with one of the textures.
+        const UINT textureCount = 512;
+        const UINT objectCount = 8192;
+        const UINT frameCount = 600;
+        const float projectionScale = 1.0f / tanf(XMConvertToRadians(22.5f)) * 1080.0f * 0.5f;
+
+        std::vector<UINT> textureSizes(textureCount);
+        std::vector<std::vector<UINT64>> textureMips(textureCount);
+        UINT64 totalBytes = 0;
+        uint32_t random = 12345;
+        auto nextRandom = [&random]() { random = random * 1664525u + 1013904223u; return random >> 8; };
+        for (UINT i = 0; i < textureCount; ++i)
+        {
+            textureSizes[i] = 256u << (nextRandom() % 5);
+            textureMips[i] = GetMipSizes(textureSizes[i], nextRandom() % 2 ? 8 : 16);
+            for (UINT64 size : textureMips[i])
+            {
+                totalBytes += size;
+            }
+        }
+
+        // Between one and eight world units per texture repeat.
+        std::vector<XMFLOAT2> objectPositions(objectCount);
+        std::vector<UINT> objectTextures(objectCount);
+        std::vector<float> objectUvDensities(objectCount);
+        for (UINT i = 0; i < objectCount; ++i)
+        {
+            objectPositions[i] = XMFLOAT2(static_cast<float>(nextRandom() % 400) - 200.0f, static_cast<float>(nextRandom() % 4000));
+            objectTextures[i] = nextRandom() % textureCount;
+            objectUvDensities[i] = 1.0f / (1u << (nextRandom() % 4));
+        }
+
+        printf("%zu textures, %.1f MB with all mips, %u objects, %u frames\n",
+            static_cast<size_t>(textureCount), totalBytes / (1024.0 * 1024.0), objectCount, frameCount);
+        printf("%12s %10s %12s %12s %12s %12s %12s %10s\n", "budget (MB)", "ms/frame", "needed (MB)", "peak (MB)", "loaded MB/f", "freed MB/f", "satisfied", "in budget");
+
+        for (UINT64 budgetMegabytes : { 2ull, 8ull, 32ull, 256ull })
+        {
+            TextureResidency residency(budgetMegabytes * 1024 * 1024);
+            for (UINT i = 0; i < textureCount; ++i)
+            {
+                residency.AddTexture(textureSizes[i], textureSizes[i], textureMips[i]);
+            }
+
+            UINT64 neededBytes = 0;
+            UINT64 peakBytes = 0;
+            UINT64 loadedBytes = 0;
+            UINT64 freedBytes = 0;
+            UINT64 requests = 0;
+            UINT64 satisfied = 0;
+            bool inBudget = true;
+            std::chrono::duration<double, std::milli> updateTime(0);
+            for (UINT frame = 0; frame < frameCount; ++frame)
+            {
+                // Looking down +z, everything up to 300 units ahead within a 90 degree cone is visible.
+                float cameraZ = frame * 3.0f;
+                auto start = Clock::now();
+                residency.BeginFrame();
+                for (UINT i = 0; i < objectCount; ++i)
+                {
+                    float depth = objectPositions[i].y - cameraZ;
+                    if (depth > 1.0f && depth < 300.0f && fabsf(objectPositions[i].x) < depth)
+                    {
+                        residency.RequestForObject(objectTextures[i], objectUvDensities[i], depth, projectionScale);
+                    }
+                }
+                residency.Update(changes);
+                updateTime += Clock::now() - start;
+
+                for (const TextureResidency::Change& change : changes)
+                {
+                    // Reconstruct the byte counts from the mip sizes.
+                    const std::vector<UINT64>& mips = textureMips[change.texture];
+                    UINT low = std::min(change.fromMip, change.toMip);
+                    UINT high = std::max(change.fromMip, change.toMip);
+                    UINT64 bytes = 0;
+                    for (UINT mip = low; mip < high; ++mip)
+                    {
+                        bytes += mips[mip];
+                    }
+                    (change.toMip < change.fromMip ? loadedBytes : freedBytes) += bytes;
+                }
+
+                for (UINT i = 0; i < textureCount; ++i)
+                {
+                    if (residency.GetRequestedMip(i) < residency.GetMipCount(i))
+                    {
+                        for (UINT mip = residency.GetRequestedMip(i); mip < residency.GetMipCount(i); ++mip)
+                        {
+                            neededBytes += textureMips[i][mip];
+                        }
+                        requests++;
+                        satisfied += residency.GetResidentMip(i) <= residency.GetRequestedMip(i) ? 1 : 0;
+                    }
+                }
+                peakBytes = std::max(peakBytes, residency.GetResidentBytes());
+                inBudget &= residency.GetResidentBytes() <= residency.GetBudget();
+            }
+
+            const double megabyte = 1024.0 * 1024.0;
+            printf("%12llu %10.4f %12.1f %12.1f %12.2f %12.2f %11.1f%% %10s\n", budgetMegabytes, updateTime.count() / frameCount,
+                neededBytes / megabyte / frameCount, peakBytes / megabyte, loadedBytes / megabyte / frameCount, freedBytes / megabyte / frameCount,
+                requests > 0 ? 100.0 * satisfied / requests : 100.0, inBudget ? "yes" : "NO");
+            passed &= inBudget;
+        }
+
+        return passed;
+    }
+
+    UINT64 GetPageFaultCount()
+    {
+        PROCESS_MEMORY_COUNTERS counters = {};
+        GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+        return counters.PageFaultCount;
+    }
+
+    // Sums every 64th byte, enough to page in everything that was read.
+    uint64_t TouchBytes(const uint8_t* data, size_t size)
+    {
+        uint64_t sum = 0;
+        for (size_t i = 0; i < size; i += 64)
+        {
+            sum += data[i];
+        }
+        return sum;
+    }
+
+    bool AssetArchiveLoading()
+    {
+        // Shader-like text that compresses well and block compressed texture-like data that mostly doesn't.
+        fs::path directory = fs::temp_directory_path() / "diabolic_bench_assets";
+        fs::remove_all(directory);
+        fs::create_directories(directory / "shaders");
+        fs::create_directories(directory / "textures");
+
+        std::vector<std::wstring> filePaths;
+        UINT64 looseBytes = 0;
+        uint32_t seed = 7;
+        for (UINT i = 0; i < 400; ++i)
+        {
+            bool text = i % 4 != 0;
+            fs::path filePath = directory / (text ? "shaders" : "textures") / ("asset" + std::to_string(i) + (text ? ".hlsl" : ".dds"));
+            std::ofstream file(filePath, std::ios::binary);
+            if (text)
+            {
+                UINT lineCount = 100 + i % 700;
+                for (UINT line = 0; line < lineCount; ++line)
+                {
+                    file << "    float4 value" << line << " = Texture" << line % 8 << ".Sample(Sampler, uv * " << line * 0.25f << ");\n";
+                }
+            }
+            else
+            {
+                std::vector<uint8_t> blocks((64 + i % 448) * 1024);
+                for (size_t offset = 0; offset < blocks.size(); offset += 8)
+                {
+                    seed = seed * 1664525u + 1013904223u;
+                    uint32_t colors = seed & 0xF7DEF7DE; // smooth endpoints, noisy indices
+                    memcpy(&blocks[offset], &colors, 4);
+                    seed = seed * 1664525u + 1013904223u;
+                    memcpy(&blocks[offset + 4], &seed, 4);
+                }
+                file.write(reinterpret_cast<const char*>(blocks.data()), blocks.size());
+            }
+            file.close();
+
+            filePaths.push_back(filePath.wstring());
+            looseBytes += fs::file_size(filePath);
+        }
+
+        fs::path archivePath = fs::temp_directory_path() / "diabolic_bench_assets.pak";
+        auto start = Clock::now();
+        bool built = AssetArchive::Build(archivePath.wstring(), directory.wstring());
+        std::chrono::duration<double, std::milli> buildTime = Clock::now() - start;
+        if (!built)
+        {
+            fprintf(stderr, "Failed to build %s\n", archivePath.string().c_str());
+            return false;
+        }
+
+        // What the loaders did before: check the file exists, then open and read it.
+        uint64_t looseSum = 0;
+        UINT64 pageFaults = GetPageFaultCount();
+        start = Clock::now();
+        std::vector<uint8_t> contents;
+        for (const std::wstring& filePath : filePaths)
+        {
+            if (!fs::exists(fs::path(filePath)))
+            {
+                continue;
+            }
+            std::ifstream file(fs::path(filePath), std::ios::binary | std::ios::ate);
+            contents.resize(static_cast<size_t>(file.tellg()));
+            file.seekg(0);
+            file.read(reinterpret_cast<char*>(contents.data()), contents.size());
+            looseSum += TouchBytes(contents.data(), contents.size());
+        }
+        std::chrono::duration<double, std::milli> looseTime = Clock::now() - start;
+        UINT64 loosePageFaults = GetPageFaultCount() - pageFaults;
+
+        uint64_t archiveSum = 0;
+        UINT compressedCount = 0;
+        pageFaults = GetPageFaultCount();
+        start = Clock::now();
+        AssetArchive archive;
+        archive.Open(archivePath.wstring());
+        std::chrono::duration<double, std::milli> openTime = Clock::now() - start;
+        std::vector<uint8_t> storage;
+        for (const std::wstring& filePath : filePaths)
+        {
+            AssetSpan span;
+            storage.clear();
+            if (archive.Read(filePath, span, storage))
+            {
+                archiveSum += TouchBytes(span.data, span.size);
+                compressedCount += storage.empty() ? 0 : 1;
+            }
+        }
+        std::chrono::duration<double, std::milli> archiveTime = Clock::now() - start;
+        UINT64 archivePageFaults = GetPageFaultCount() - pageFaults;
+
+        // Every entry has to come back byte for byte.
+        bool identical = archive.GetEntryCount() == filePaths.size();
+        for (size_t i = 0; identical && i < filePaths.size(); ++i)
+        {
+            AssetSpan span;
+            std::ifstream file(fs::path(filePaths[i]), std::ios::binary);
+            contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+            identical = archive.Read(filePaths[i], span, storage) && span.size == contents.size() &&
+                memcmp(span.data, contents.data(), contents.size()) == 0;
+        }
+
+        const double megabyte = 1024.0 * 1024.0;
+        printf("%zu files, %.1f MB loose, %.1f MB packed (%u compressed), built in %.1f ms\n", filePaths.size(), looseBytes / megabyte,
+            fs::file_size(archivePath) / megabyte, compressedCount, buildTime.count());
+        printf("%10s %12s %12s %14s\n", "", "time (ms)", "file calls", "page faults");
+        printf("%10s %12.2f %12zu %14llu\n", "loose", looseTime.count(), filePaths.size() * 4, loosePageFaults);
+        printf("%10s %12.2f %12u %14llu   (open %.3f ms)\n", "archive", archiveTime.count(), 4u, archivePageFaults, openTime.count());
+        printf("  file calls: exists/open/read/close per loose file, open/size/map/view once for the archive\n");
+        printf("  warm OS file cache, the first run after a reboot shows the cold start difference\n");
+        printf("  contents %s\n", identical && looseSum == archiveSum ? "identical" : "DIFFER");
+
+        archive.Close();
+        fs::remove(archivePath);
+        fs::remove_all(directory);
+
+        return identical && looseSum == archiveSum;
+    }
+
+    // Every job of the tree starts two children on the shared counter until depth runs out.
+    void SpawnTree(UINT depth, Jobs::Counter& counter, std::atomic<UINT>& visited)
+    {
+        visited.fetch_add(1, std::memory_order_relaxed);
+        if (depth > 0)
+        {
+            Jobs::Run([depth, &counter, &visited]() { SpawnTree(depth - 1, counter, visited); }, &counter);
+            Jobs::Run([depth, &counter, &visited]() { SpawnTree(depth - 1, counter, visited); }, &counter);
+        }
+    }
+
+    bool JobSystemOverhead()
+    {
+        printf("%u threads run jobs\n", Jobs::GetThreadCount());
+        printf("%28s %10s %12s %12s\n", "", "jobs", "time (ms)", "ns/job");
+        auto report = [](const char* name, UINT jobCount, double milliseconds)
+        {
+            printf("%28s %10u %12.3f %12.1f\n", name, jobCount, milliseconds, milliseconds * 1e6 / jobCount);
+        };
+
+        // Empty jobs measure nothing but queuing, waking, stealing and retiring.
+        bool correct = true;
+        for (UINT jobCount : { 1000u, 100000u })
+        {
+            std::atomic<UINT> ran(0);
+            double time = MeasureMilliseconds([&]()
+            {
+                Jobs::Counter counter;
+                for (UINT i = 0; i < jobCount; ++i)
+                {
+                    Jobs::Run([&ran]() { ran.fetch_add(1, std::memory_order_relaxed); }, &counter);
+                }
+                Jobs::Wait(counter);
+            });
+            correct &= ran % jobCount == 0;
+            report("empty, from one thread", jobCount, time);
+        }
+
+        // Jobs spawning jobs: pushes go to the worker's own deque, the others have to steal.
+        const UINT depth = 15;
+        const UINT treeJobCount = (2u << depth) - 1;
+        std::atomic<UINT> visited(0);
+        double treeTime = MeasureMilliseconds([&]()
+        {
+            visited = 0;
+            Jobs::Counter counter;
+            Jobs::Run([&counter, &visited]() { SpawnTree(depth, counter, visited); }, &counter);
+            Jobs::Wait(counter);
+        });
+        correct &= visited == treeJobCount;
+        report("fan-out tree, depth 15", treeJobCount, treeTime);
+
+        for (UINT grainSize : { 1u, 64u, 4096u })
+        {
+            const UINT count = 1 << 20;
+            std::atomic<UINT64> sum(0);
+            double time = MeasureMilliseconds([&]()
+            {
+                sum = 0;
+                Jobs::ParallelFor(count, grainSize, [&sum](UINT begin, UINT end)
+                {
+                    sum.fetch_add(UINT64(end - begin) * (begin + end - 1) / 2, std::memory_order_relaxed);
+                });
+            });
+            correct &= sum == UINT64(count) * (count - 1) / 2;
+            char name[64];
+            snprintf(name, sizeof(name), "parallel for, grain %u", grainSize);
+            report(name, (count + grainSize - 1) / grainSize, time);
+        }
+
+        // What the engine did before: a thread or an async task per piece of work.
+        const UINT baselineCount = 256;
+        double threadTime = MeasureMilliseconds([&]()
+        {
+            std::vector<std::thread> threads;
+            for (UINT i = 0; i < baselineCount; ++i)
+            {
+                threads.emplace_back([]() {});
+            }
+            for (std::thread& thread : threads)
+            {
+                thread.join();
+            }
+        });
+        report("std::thread each", baselineCount, threadTime);
+
+        double asyncTime = MeasureMilliseconds([&]()
+        {
+            std::vector<std::future<void>> futures;
+            for (UINT i = 0; i < baselineCount; ++i)
+            {
+                futures.push_back(std::async(std::launch::async, []() {}));
+            }
+            for (std::future<void>& future : futures)
+            {
+                future.get();
+            }
+        });
+        report("std::async each", baselineCount, asyncTime);
+
+        printf("  results %s\n", correct ? "complete" : "MISSING JOBS");
+
+        // Wait() only helps with its own counter's jobs. The workers are held up, so the unrelated job
+        // queued behind the waited one stays queued until they are released.
+        std::atomic<bool> release(false);
+        Jobs::Counter blockers;
+        for (UINT i = 1; i < Jobs::GetThreadCount(); ++i)
+        {
+            Jobs::Run([&release]() { while (!release.load()) { std::this_thread::yield(); } }, &blockers);
+        }
+        const std::thread::id waitingThread = std::this_thread::get_id();
+        std::atomic<bool> waiting(true);
+        std::atomic<bool> ranWhileWaiting(false);
+        Jobs::Counter waited;
+        Jobs::Counter unrelated;
+        Jobs::Run([]() {}, &waited);
+        Jobs::Run([&]() { ranWhileWaiting = waiting && std::this_thread::get_id() == waitingThread; }, &unrelated);
+        Jobs::Wait(waited);
+        waiting = false;
+        release = true;
+        Jobs::Wait(blockers);
+        Jobs::Wait(unrelated);
+        bool isolated = !ranWhileWaiting;
+        printf("  waiting %s\n", isolated ? "ran only the waited job" : "RAN AN UNRELATED JOB");
+
+        return correct && isolated;
+    }
+
+    // What the startup graph relies on: dependencies finish first, a throwing task stops its dependents
+    // and comes back out of Run(), and calling thread tasks stay on the thread that runs the graph.
+    bool TaskGraphScheduling()
+    {
+        bool passed = true;
+        auto check = [&passed](const char* step, bool ok)
+        {
+            printf("  %-36s %s\n", step, ok ? "ok" : "FAILED");
+            passed &= ok;
+        };
+
+        // A diamond, with one side taking a while so a missing edge would show.
+        bool ordered = true;
+        for (UINT run = 0; run < 100; ++run)
+        {
+            std::atomic<UINT> sequence(0);
+            UINT order[4] = {};
+            TaskGraph graph;
+            UINT top = graph.Add("Top", [&]() { order[0] = ++sequence; });
+            UINT left = graph.Add("Left", [&]()
+            {
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+                order[1] = ++sequence;
+            }, { top });
+            UINT right = graph.Add("Right", [&]() { order[2] = ++sequence; }, { top });
+            graph.Add("Bottom", [&]() { order[3] = ++sequence; }, { left, right });
+            graph.Run();
+            ordered &= order[0] == 1 && order[1] > 1 && order[2] > 1 && order[3] == 4;
+        }
+        check("diamond in dependency order", ordered);
+
+        std::atomic<bool> dependentRan(false);
+        bool rethrown = false;
+        TaskGraph failing;
+        UINT thrower = failing.Add("Throws", []() { throw std::exception("Bench task failed."); });
+        failing.Add("Depends on it", [&dependentRan]() { dependentRan = true; }, { thrower });
+        try
+        {
+            failing.Run();
+        }
+        catch (const std::exception& exception)
+        {
+            rethrown = strcmp(exception.what(), "Bench task failed.") == 0;
+        }
+        check("exception rethrown from Run()", rethrown);
+        check("dependent of the thrower skipped", !dependentRan);
+
+        // The pool task in the middle readies the next calling thread task from a worker.
+        const std::thread::id callingThread = std::this_thread::get_id();
+        bool onCallingThread = true;
+        for (UINT run = 0; run < 100; ++run)
+        {
+            std::thread::id threads[3];
+            TaskGraph graph;
+            UINT window = graph.AddOnCallingThread("Window", [&]() { threads[0] = std::this_thread::get_id(); });
+            UINT device = graph.Add("Device", []() { std::this_thread::sleep_for(std::chrono::microseconds(50)); }, { window });
+            UINT swapChain = graph.AddOnCallingThread("Swap chain", [&]() { threads[1] = std::this_thread::get_id(); }, { device });
+            graph.AddOnCallingThread("Present", [&]() { threads[2] = std::this_thread::get_id(); }, { swapChain });
+            graph.Run();
+            onCallingThread &= threads[0] == callingThread && threads[1] == callingThread && threads[2] == callingThread;
+        }
+        check("calling thread tasks on that thread", onCallingThread);
+
+        return passed;
+    }
+
+    // The CPU side of GeometryPipeline::Update(): spin, cull, pick a LOD and group the visible instances
+    // by it. Vector is the type of the per-frame temporaries.
+    template<typename Vector>
+    void SimulateGeometryFrame(InstanceTransforms& instances, const Culling::Frustum& frustum, std::vector<UINT>& visible,
+        std::vector<XMFLOAT4X4>& instanceData)
+    {
+        const UINT lodCount = 4;
+        instances.Update(1.0f / 60.0f);
+        Culling::CullSpheresParallel(frustum, instances.GetBoundingSpheres(), visible);
+
+        Vector visibleLods(visible.size());
+        Vector lodOffsets(lodCount + 1, 0);
+        for (size_t i = 0; i < visible.size(); ++i)
+        {
+            visibleLods[i] = visible[i] % lodCount;
+            lodOffsets[visibleLods[i] + 1]++;
+        }
+        for (UINT level = 1; level <= lodCount; ++level)
+        {
+            lodOffsets[level] += lodOffsets[level - 1];
+        }
+
+        const XMFLOAT4X4* worldMatrices = instances.GetWorldMatrices();
+        for (size_t i = 0; i < visible.size(); ++i)
+        {
+            instanceData[lodOffsets[visibleLods[i]]++] = worldMatrices[visible[i]];
+        }
+    }
+
+    bool FrameAllocation()
+    {
+        XMMATRIX view = XMMatrixLookAtLH(XMVectorSet(0, 0, -10, 1), XMVectorSet(0, 0, 0, 1), XMVectorSet(0, 1, 0, 0));
+        XMMATRIX projection = XMMatrixPerspectiveFovLH(XMConvertToRadians(60.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+        Culling::Frustum frustum = Culling::ExtractFrustum(view * projection);
+
+        printf("%10s %10s %16s %16s %16s %16s\n", "instances", "visible", "vector (ms)", "allocs/frame", "arena (ms)", "allocs/frame");
+
+        bool heapFree = true;
+        for (UINT count : { 1000u, 100000u })
+        {
+            InstanceTransforms instances;
+            for (UINT i = 0; i < count; ++i)
+            {
+                instances.Add(XMFLOAT3(static_cast<float>(i % 100) - 50.0f, static_cast<float>(i / 100 % 100) - 50.0f,
+                    static_cast<float>(i / 10000) * 2.0f), 0.5f, i * 0.1f, 1.0f);
+            }
+            std::vector<UINT> visible;
+            std::vector<XMFLOAT4X4> instanceData(count);
+
+            // Warmed up first: the persistent vectors and the arenas reach their size in the first frames.
+            const UINT frameCount = 200;
+            auto run = [&](auto&& frame, double& milliseconds, double& allocationsPerFrame)
+            {
+                for (UINT i = 0; i < 10; ++i)
+                {
+                    FrameMemory::BeginFrame();
+                    frame();
+                }
+                uint64_t allocations = Util::GetHeapAllocationCount();
+                auto start = Clock::now();
+                for (UINT i = 0; i < frameCount; ++i)
+                {
+                    FrameMemory::BeginFrame();
+                    frame();
+                }
+                std::chrono::duration<double, std::milli> elapsed = Clock::now() - start;
+                milliseconds = elapsed.count() / frameCount;
+                allocationsPerFrame = static_cast<double>(Util::GetHeapAllocationCount() - allocations) / frameCount;
+            };
+
+            double vectorTime, vectorAllocations, arenaTime, arenaAllocations;
+            run([&]() { SimulateGeometryFrame<std::vector<UINT>>(instances, frustum, visible, instanceData); }, vectorTime, vectorAllocations);
+            run([&]() { SimulateGeometryFrame<FrameVector<UINT>>(instances, frustum, visible, instanceData); }, arenaTime, arenaAllocations);
+            heapFree &= arenaAllocations == 0.0;
+
+            printf("%10u %10zu %16.4f %16.1f %16.4f %16.1f\n", count, visible.size(), vectorTime, vectorAllocations, arenaTime, arenaAllocations);
+        }
+
+        // Many short containers, the pattern the arena is for.
+        const UINT listCount = 10000;
+        double vectorListTime = MeasureMilliseconds([&]()
+        {
+            for (UINT i = 0; i < listCount; ++i)
+            {
+                std::vector<UINT> list;
+                for (UINT j = 0; j < 16; ++j)
+                {
+                    list.push_back(j);
+                }
+            }
+        });
+        double arenaListTime = MeasureMilliseconds([&]()
+        {
+            FrameMemory::BeginFrame();
+            for (UINT i = 0; i < listCount; ++i)
+            {
+                FrameVector<UINT> list;
+                for (UINT j = 0; j < 16; ++j)
+                {
+                    list.push_back(j);
+                }
+            }
+        });
+        printf("  %u lists of 16 pushed: vector %.3f ms, arena %.3f ms\n", listCount, vectorListTime, arenaListTime);
+        if (!Util::IsCountingHeapAllocations())
+        {
+            printf("  heap allocations not counted, build with COUNT_HEAP_ALLOCATIONS (Debug) to check them\n");
+            return true;
+        }
+        printf("  frame code %s\n", heapFree ? "made no heap allocations" : "ALLOCATED FROM THE HEAP");
+
+        return heapFree;
+    }
+
+    bool ProfilerOverhead()
+    {
+        const UINT zoneCount = 1000000;
+        double loopTime = MeasureMilliseconds([&]()
+        {
+            for (volatile UINT i = 0; i < zoneCount; i = i + 1)
+            {
+            }
+        });
+        double zoneTime = MeasureMilliseconds([&]()
+        {
+            for (volatile UINT i = 0; i < zoneCount; i = i + 1)
+            {
+                PROFILE_ZONE("Bench zone");
+            }
+        });
+        double nestedTime = MeasureMilliseconds([&]()
+        {
+            for (volatile UINT i = 0; i < zoneCount / 4; i = i + 1)
+            {
+                PROFILE_ZONE("Bench outer");
+                PROFILE_ZONE("Bench middle");
+                PROFILE_ZONE("Bench inner");
+                PROFILE_ZONE("Bench innermost");
+            }
+        });
+        // What timing a stage with the standard clock costs.
+        double clockTime = MeasureMilliseconds([&]()
+        {
+            for (volatile UINT i = 0; i < zoneCount; i = i + 1)
+            {
+                auto start = std::chrono::high_resolution_clock::now();
+                volatile long long elapsed = (std::chrono::high_resolution_clock::now() - start).count();
+            }
+        });
+
+        double zoneNanoseconds = (zoneTime - loopTime) * 1e6 / zoneCount;
+        printf("%24s %12s\n", "", "ns/zone");
+        printf("%24s %12.1f\n", "zone", zoneNanoseconds);
+        printf("%24s %12.1f\n", "4 nested zones", (nestedTime - loopTime / 4) * 1e6 / zoneCount);
+        printf("%24s %12.1f\n", "two clock reads", (clockTime - loopTime) * 1e6 / zoneCount);
+
+        // The ring is full of bench zones by now, export it in both formats.
+        fs::path tracePath = fs::temp_directory_path() / "diabolic_bench_profile.json";
+        fs::path binaryPath = fs::temp_directory_path() / "diabolic_bench_profile.bin";
+        auto start = Clock::now();
+        bool written = Profiler::WriteChromeTrace(tracePath.wstring());
+        std::chrono::duration<double, std::milli> traceTime = Clock::now() - start;
+        start = Clock::now();
+        written &= Profiler::WriteBinary(binaryPath.wstring());
+        std::chrono::duration<double, std::milli> binaryTime = Clock::now() - start;
+
+        // Read the binary header back to check the layout.
+        char magic[4] = {};
+        uint32_t version = 0;
+        std::ifstream file(binaryPath, std::ios::binary);
+        file.read(magic, 4);
+        file.read(reinterpret_cast<char*>(&version), sizeof(version));
+        written &= memcmp(magic, "DBPF", 4) == 0 && version == 1;
+        file.close();
+
+        if (written)
+        {
+            printf("  export: chrome trace %.1f KB in %.1f ms, binary %.1f KB in %.1f ms\n", fs::file_size(tracePath) / 1024.0,
+                traceTime.count(), fs::file_size(binaryPath) / 1024.0, binaryTime.count());
+        }
+        printf("  overhead %s 50 ns per zone, export %s\n", zoneNanoseconds < 50.0 ? "under" : "OVER", written ? "ok" : "FAILED");
+
+        fs::remove(tracePath);
+        fs::remove(binaryPath);
+
+        return written && zoneNanoseconds < 50.0;
+    }
+
+    // What Renderer::Render() and GeometryPipeline::PopulateCommandlist() record for the scene, through the
+    // same functions and with null objects and handles in place of the ones the renderer creates. The
+    // frame's command lists go into one context, in the order they are executed.
+    void RecordGeometryFrame(CommandContext& context, const GeometryScene& scene, const Camera& camera, UINT width, UINT height)
+    {
+        const D3D12_CPU_DESCRIPTOR_HANDLE rtvHandle = {};
+        const D3D12_CPU_DESCRIPTOR_HANDLE dsvHandle = {};
+        Renderer::RecordClear(context, nullptr, rtvHandle, dsvHandle);
+
+        const CD3DX12_VIEWPORT viewport(0.0f, 0.0f, static_cast<float>(width), static_cast<float>(height));
+        const CD3DX12_RECT scissorRect(0, 0, static_cast<LONG>(width), static_cast<LONG>(height));
+        Renderer::RecordPassSetup(context, rtvHandle, dsvHandle, viewport, scissorRect);
+        GeometryPipeline::RecordDraws(context, GeometryPipeline::DrawBindings{}, scene, camera);
+
+        Renderer::RecordPresentTransition(context, nullptr);
+    }
+
+    bool CommandRecording()
+    {
+        printf("%10s %10s %10s %12s %12s %14s\n", "instances", "commands", "bytes", "frame (us)", "ns/command", "allocs/frame");
+        bool replayMatches = true;
+        bool heapFree = true;
+        for (UINT gridSize : { 10u, 20u, 40u })
+        {
+            Camera camera;
+            GeometryScene scene;
+            Util::MeshData mesh;
+            scene.CreateMesh(mesh);
+            scene.CreateInstances(gridSize);
+            std::vector<XMFLOAT4X4> instanceData(scene.GetInstanceCount());
+            scene.Update(1.0f / 60.0f, camera, 16.0f / 9.0f, 1080, instanceData.data());
+
+            RecordingCommandContext recorder;
+            double frameTime = MeasureMilliseconds([&]()
+            {
+                recorder.Reset();
+                RecordGeometryFrame(recorder, scene, camera, 1920, 1080);
+            });
+
+            // Recording into warm memory shouldn't allocate.
+            const UINT frameCount = 100;
+            uint64_t allocationsBefore = Util::GetHeapAllocationCount();
+            for (UINT frame = 0; frame < frameCount; ++frame)
+            {
+                recorder.Reset();
+                RecordGeometryFrame(recorder, scene, camera, 1920, 1080);
+            }
+            uint64_t allocations = Util::GetHeapAllocationCount() - allocationsBefore;
+            heapFree &= allocations == 0;
+
+            // Replaying has to reproduce the stream byte for byte.
+            RecordingCommandContext replayed;
+            recorder.Replay(replayed);
+            replayMatches &= replayed.GetSize() == recorder.GetSize() && replayed.GetCommandCount() == recorder.GetCommandCount() &&
+                memcmp(replayed.GetData(), recorder.GetData(), recorder.GetSize()) == 0;
+
+            printf("%10u %10u %10zu %12.3f %12.1f %14.1f\n", scene.GetInstanceCount(), recorder.GetCommandCount(), recorder.GetSize(),
+                frameTime * 1000.0, frameTime * 1e6 / recorder.GetCommandCount(), static_cast<double>(allocations) / frameCount);
+        }
+        printf("  replay %s\n", replayMatches ? "matches the recording" : "DIFFERS FROM THE RECORDING");
+        if (Util::IsCountingHeapAllocations())
+        {
+            printf("  recording %s\n", heapFree ? "made no heap allocations" : "ALLOCATED FROM THE HEAP");
+        }
+
+        return replayMatches && heapFree;
+    }
+
+    // Dialogue-like UI: a translucent panel per text box and lines of 16x16 glyphs from a 16x16 atlas.
+    std::vector<UIQuad> CreateDialogueQuads(UINT glyphCount, UINT width, UINT height)
+    {
+        std::vector<UIQuad> quads;
+        const UINT glyphsPerLine = 31;
+        const UINT glyphsPerBox = glyphsPerLine * 6;
+        const float glyphSize = 16.0f;
+        const float cellUv = 1.0f / 16.0f;
+        UINT glyphTotal = 0;
+        for (UINT box = 0; glyphTotal < glyphCount; ++box)
+        {
+            float boxX = static_cast<float>((box * 397) % (width - 512));
+            float boxY = static_cast<float>((box * 211) % (height - 128));
+            quads.push_back({ boxX, boxY, boxX + 512.0f, boxY + 128.0f, 0.0f, 0.0f, cellUv * 0.5f, cellUv * 0.5f, 0xC0301810 });
+
+            for (UINT glyph = 0; glyph < glyphsPerBox && glyphTotal < glyphCount; ++glyph, ++glyphTotal)
+            {
+                float x = boxX + 8.0f + (glyph % glyphsPerLine) * glyphSize;
+                float y = boxY + 8.0f + (glyph / glyphsPerLine) * glyphSize * 1.25f;
+                UINT cell = 1 + (glyph * 7 + box) % 255;
+                float u = (cell % 16) * cellUv;
+                float v = (cell / 16) * cellUv;
+                quads.push_back({ x, y, x + glyphSize, y + glyphSize, u, v, u + cellUv, v + cellUv, 0xFFFFF0E0 });
+            }
+        }
+        return quads;
+    }
+
+    bool UIRasterization()
+    {
+        // Coverage atlas: cell 0 is solid (panels), the others get a ring of a different radius each.
+        const UINT atlasSize = 256;
+        std::vector<uint8_t> atlasPixels(atlasSize * atlasSize);
+        for (UINT y = 0; y < atlasSize; ++y)
+        {
+            for (UINT x = 0; x < atlasSize; ++x)
+            {
+                UINT cell = (y / 16) * 16 + x / 16;
+                float dx = (x % 16) - 7.5f;
+                float dy = (y % 16) - 7.5f;
+                float radius = 2.0f + (cell % 6);
+                float distance = fabsf(sqrtf(dx * dx + dy * dy) - radius);
+                atlasPixels[y * atlasSize + x] = cell == 0 ? 255 : static_cast<uint8_t>(255.0f * std::max(0.0f, 1.0f - distance * 0.5f));
+            }
+        }
+        DirectX::Image atlas = { atlasSize, atlasSize, DXGI_FORMAT_R8_UNORM, atlasSize, atlasSize * atlasSize, atlasPixels.data() };
+
+        const UINT width = 1920;
+        const UINT height = 1080;
+        const uint32_t clearColor = 0xFF402010;
+        UIRasterizer rasterizer(width, height);
+        UIRasterizer reference(width, height);
+        bool identical = true;
+
+        printf("%10s %14s %14s %10s\n", "quads", "scalar (ms)", "tiled (ms)", "speedup");
+        for (UINT glyphCount : { 1000u, 4000u, 16000u })
+        {
+            std::vector<UIQuad> quads = CreateDialogueQuads(glyphCount, width, height);
+            UINT quadCount = static_cast<UINT>(quads.size());
+            double scalarTime = MeasureMilliseconds([&]() { reference.RasterizeScalar(quads.data(), quadCount, atlas, clearColor); });
+            double tiledTime = MeasureMilliseconds([&]() { rasterizer.Rasterize(quads.data(), quadCount, atlas, clearColor); });
+
+            const DirectX::Image& image = *rasterizer.GetImage().GetImage(0, 0, 0);
+            const DirectX::Image& referenceImage = *reference.GetImage().GetImage(0, 0, 0);
+            identical &= memcmp(image.pixels, referenceImage.pixels, image.slicePitch) == 0;
+
+            printf("%10u %14.3f %14.3f %9.1fx\n", quadCount, scalarTime, tiledTime, scalarTime / tiledTime);
+        }
+
+        // Golden images are stored as TGA or DDS, both have to round trip through DirectXTex.
+        fs::path tgaPath = fs::temp_directory_path() / "diabolic_bench_ui.tga";
+        fs::path ddsPath = fs::temp_directory_path() / "diabolic_bench_ui.dds";
+        bool saved = rasterizer.Save(tgaPath.wstring()) && rasterizer.Save(ddsPath.wstring());
+        DirectX::ScratchImage loaded;
+        saved &= SUCCEEDED(DirectX::LoadFromDDSFile(ddsPath.wstring().c_str(), DirectX::DDS_FLAGS_NONE, nullptr, loaded)) &&
+            memcmp(loaded.GetPixels(), rasterizer.GetImage().GetPixels(), rasterizer.GetImage().GetPixelsSize()) == 0;
+        fs::remove(tgaPath);
+        fs::remove(ddsPath);
+
+        printf("  tiled output %s the scalar reference, golden image files %s\n", identical ? "matches" : "DIFFERS FROM",
+            saved ? "ok" : "FAILED");
+
+        return identical && saved;
+    }
+
+    bool CaptureEncoding()
+    {
+        // A 1080p frame as it comes out of a readback buffer: rows padded to the D3D12 pitch alignment.
+        const UINT width = 1920;
+        const UINT height = 1080;
+        D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint = {};
+        footprint.Footprint = { DXGI_FORMAT_R8G8B8A8_UNORM, width, height, 1,
+            (width * 4 + D3D12_TEXTURE_DATA_PITCH_ALIGNMENT - 1) & ~(D3D12_TEXTURE_DATA_PITCH_ALIGNMENT - 1) };
+        std::vector<uint8_t> readback(static_cast<size_t>(footprint.Footprint.RowPitch) * height);
+        for (UINT y = 0; y < height; ++y)
+        {
+            uint32_t* row = reinterpret_cast<uint32_t*>(readback.data() + static_cast<size_t>(y) * footprint.Footprint.RowPitch);
+            for (UINT x = 0; x < width; ++x)
+            {
+                row[x] = 0xFF000000u | ((x * 255 / width) << 16) | ((y * 255 / height) << 8) | ((x ^ y) & 0xFF);
+            }
+        }
+
+        printf("%10s %12s %12s\n", "format", "encode (ms)", "size (KB)");
+        bool written = true;
+        for (const wchar_t* extension : { L".dds", L".tga", L".hdr" })
+        {
+            fs::path path = fs::temp_directory_path() / (std::wstring(L"diabolic_bench_capture") + extension);
+            double encodeTime = MeasureMilliseconds([&]()
+            {
+                written &= FrameCapture::EncodeReadback(readback.data(), footprint, path.wstring());
+            });
+            printf("%10s %12.2f %12.1f\n", fs::path(extension).string().c_str(), encodeTime, fs::file_size(path) / 1024.0);
+            if (wcscmp(extension, L".dds") == 0)
+            {
+                // The DDS is the raw frame, it has to match the readback rows exactly.
+                DirectX::ScratchImage loaded;
+                written &= SUCCEEDED(DirectX::LoadFromDDSFile(path.wstring().c_str(), DirectX::DDS_FLAGS_NONE, nullptr, loaded));
+                for (UINT y = 0; written && y < height; ++y)
+                {
+                    written &= memcmp(loaded.GetImage(0, 0, 0)->pixels + static_cast<size_t>(y) * width * 4,
+                        readback.data() + static_cast<size_t>(y) * footprint.Footprint.RowPitch, width * 4) == 0;
+                }
+            }
+            fs::remove(path);
+        }
+
+        // A recording hands every frame to a job, throughput is what decides how many frames get dropped.
+        const UINT frameCount = 16;
+        auto start = Clock::now();
+        Jobs::Counter encodes;
+        std::atomic<UINT> encoded(0);
+        for (UINT frame = 0; frame < frameCount; ++frame)
+        {
+            Jobs::Run([&, frame]()
+            {
+                fs::path path = fs::temp_directory_path() / ("diabolic_bench_recording_" + std::to_string(frame) + ".tga");
+                if (FrameCapture::EncodeReadback(readback.data(), footprint, path.wstring()))
+                {
+                    encoded++;
+                }
+                fs::remove(path);
+            }, &encodes);
+        }
+        Jobs::Wait(encodes);
+        std::chrono::duration<double> recordingTime = Clock::now() - start;
+        written &= encoded == frameCount;
+
+        printf("  recording: %u TGA frames on %u threads at %.1f frames/s\n", frameCount, Jobs::GetThreadCount(), frameCount / recordingTime.count());
+        printf("  captures %s\n", written ? "ok" : "FAILED");
+
+        return written;
+    }
+
+    struct TestTexture
+    {
+        const char* name;
+        DirectX::ScratchImage image;
+    };
+
+    // 512x512 R8G8B8A8_UNORM images that stress block compressors differently: smooth gradients,
+    // per pixel noise, hard edges between saturated colors and an alpha channel that varies.
+    std::vector<TestTexture> CreateTestTextures()
+    {
+        const UINT size = 512;
+        std::vector<TestTexture> textures(4);
+        textures[0].name = "gradient";
+        textures[1].name = "noise";
+        textures[2].name = "edges";
+        textures[3].name = "alpha";
+
+        uint32_t seed = 777;
+        auto random = [&seed]() { seed = seed * 1664525u + 1013904223u; return seed >> 24; };
+        for (size_t index = 0; index < textures.size(); ++index)
+        {
+            TestTexture& texture = textures[index];
+            texture.image.Initialize2D(DXGI_FORMAT_R8G8B8A8_UNORM, size, size, 1, 1);
+            const DirectX::Image& image = *texture.image.GetImage(0, 0, 0);
+            for (UINT y = 0; y < size; ++y)
+            {
+                uint32_t* row = reinterpret_cast<uint32_t*>(image.pixels + y * image.rowPitch);
+                for (UINT x = 0; x < size; ++x)
+                {
+                    uint32_t r = x / 2;
+                    uint32_t g = y / 2;
+                    uint32_t b = (x + y) / 4;
+                    uint32_t a = 255;
+                    if (index == 1)
+                    {
+                        r = (r + random()) / 2;
+                        g = (g + random()) / 2;
+                        b = random();
+                    }
+                    else if (index == 2)
+                    {
+                        // 8 saturated colors in 24 pixel cells, with a dark line through every third row of cells.
+                        UINT cell = (x / 24 + y / 24 * 3) % 8;
+                        r = cell & 1 ? 240 : 16;
+                        g = cell & 2 ? 240 : 16;
+                        b = cell & 4 ? 240 : 16;
+                        if ((y / 24) % 3 == 0 && y % 24 == 11)
+                        {
+                            r = g = b = 0;
+                        }
+                    }
+                    else if (index == 3)
+                    {
+                        float dx = x - size * 0.5f;
+                        float dy = y - size * 0.5f;
+                        a = static_cast<uint32_t>(std::min(255.0f, sqrtf(dx * dx + dy * dy)));
+                        a = (a + (x % 64 < 4 ? 128 : 0)) & 0xFF;
+                    }
+                    row[x] = r | (g << 8) | (b << 16) | (a << 24);
+                }
+            }
+        }
+        return textures;
+    }
+
+    // PSNR of a compressed image against its source, averaged over the channels that are compared.
+    double ComputePSNR(const DirectX::Image& compressed, const DirectX::Image& source, bool ignoreAlpha)
+    {
+        float mse = 0.0f;
+        if (FAILED(DirectX::ComputeMSE(compressed, source, mse, nullptr, ignoreAlpha ? DirectX::CMSE_IGNORE_ALPHA : DirectX::CMSE_DEFAULT)))
+        {
+            return 0.0;
+        }
+        double channelMse = mse / (ignoreAlpha ? 3.0 : 4.0);
+        return channelMse > 0.0 ? 10.0 * log10(1.0 / channelMse) : 99.0;
+    }
+
+    // Every width and height remainder mod 4, down to single pixel rows and columns, for the checks
+    // that encoders treat partial blocks like CompressBC.
+    const size_t g_partialBlockSizes[][2] = { { 13, 13 }, { 14, 6 }, { 7, 15 }, { 1, 9 }, { 9, 1 }, { 2, 3 }, { 1, 1 } };
+
+    // A width x height window from the middle of a test image, with its full mip chain when mipChain is set.
+    DirectX::ScratchImage CopyTestWindow(const DirectX::Image& full, size_t width, size_t height, bool mipChain)
+    {
+        DirectX::ScratchImage window;
+        window.Initialize2D(full.format, width, height, 1, 1);
+        DirectX::CopyRectangle(full, DirectX::Rect((full.width - width) / 2, (full.height - height) / 2, width, height), *window.GetImage(0, 0, 0),
+            DirectX::TEX_FILTER_DEFAULT, 0, 0);
+        if (!mipChain)
+        {
+            return window;
+        }
+
+        DirectX::ScratchImage mips;
+        DirectX::GenerateMipMaps(*window.GetImage(0, 0, 0), DirectX::TEX_FILTER_DEFAULT, 0, mips);
+        return mips;
+    }
+
+    // How much PSNR TEX_COMPRESS_BC1_3_FAST may give up against the reference encoder.
+    constexpr double BC1_3_FAST_PSNR_TOLERANCE = 0.5;
+
+    bool BC1Compression()
+    {
+        std::vector<TestTexture> textures = CreateTestTextures();
+
+        printf("%10s %6s %10s %10s %10s %10s %10s %10s\n", "image", "format", "ref (ms)", "fast (ms)", "ref MP/s", "fast MP/s",
+            "ref PSNR", "fast PSNR");
+        bool withinTolerance = true;
+        for (const TestTexture& texture : textures)
+        {
+            const DirectX::Image& source = *texture.image.GetImage(0, 0, 0);
+            double megapixels = source.width * source.height / 1000000.0;
+            for (DXGI_FORMAT format : { DXGI_FORMAT_BC1_UNORM, DXGI_FORMAT_BC3_UNORM })
+            {
+                // Serial on both sides, the fast path is about per block cost.
+                DirectX::ScratchImage reference;
+                DirectX::ScratchImage fast;
+                double referenceTime = MeasureMilliseconds([&]()
+                {
+                    DirectX::Compress(source, format, DirectX::TEX_COMPRESS_DEFAULT, DirectX::TEX_THRESHOLD_DEFAULT, reference);
+                });
+                double fastTime = MeasureMilliseconds([&]()
+                {
+                    DirectX::Compress(source, format, DirectX::TEX_COMPRESS_BC1_3_FAST, DirectX::TEX_THRESHOLD_DEFAULT, fast);
+                });
+
+                bool ignoreAlpha = format == DXGI_FORMAT_BC1_UNORM;
+                double referencePsnr = ComputePSNR(*reference.GetImage(0, 0, 0), source, ignoreAlpha);
+                double fastPsnr = ComputePSNR(*fast.GetImage(0, 0, 0), source, ignoreAlpha);
+                withinTolerance &= fastPsnr >= referencePsnr - BC1_3_FAST_PSNR_TOLERANCE;
+
+                printf("%10s %6s %10.2f %10.2f %10.1f %10.1f %10.2f %10.2f\n", texture.name, ignoreAlpha ? "BC1" : "BC3",
+                    referenceTime, fastTime, megapixels * 1000.0 / referenceTime, megapixels * 1000.0 / fastTime, referencePsnr, fastPsnr);
+            }
+        }
+        printf("  fast PSNR %s %.1f dB of the reference\n", withinTolerance ? "within" : "NOT WITHIN", BC1_3_FAST_PSNR_TOLERANCE);
+
+        // Partial blocks: the fast encoder has to replicate edge pixels the way CompressBC does, so each image
+        // must compress to the same blocks as a copy padded to whole blocks by that rule.
+        bool edgesMatch = true;
+        auto compareEdges = [&](const char* name, const DirectX::Image& source, DXGI_FORMAT format)
+        {
+            static const size_t uSrc[] = { 0, 0, 0, 1 };
+            auto replicate = [](size_t coordinate, size_t size)
+            {
+                size_t offset = coordinate & 3;
+                while (coordinate - (coordinate & 3) + offset >= size)
+                {
+                    offset = uSrc[offset];
+                }
+                return coordinate - (coordinate & 3) + offset;
+            };
+
+            DirectX::ScratchImage padded;
+            padded.Initialize2D(source.format, (source.width + 3) & ~size_t(3), (source.height + 3) & ~size_t(3), 1, 1);
+            const DirectX::Image& paddedImage = *padded.GetImage(0, 0, 0);
+            for (size_t y = 0; y < paddedImage.height; ++y)
+            {
+                const uint32_t* sourceRow = reinterpret_cast<const uint32_t*>(source.pixels + replicate(y, source.height) * source.rowPitch);
+                uint32_t* paddedRow = reinterpret_cast<uint32_t*>(paddedImage.pixels + y * paddedImage.rowPitch);
+                for (size_t x = 0; x < paddedImage.width; ++x)
+                {
+                    paddedRow[x] = sourceRow[replicate(x, source.width)];
+                }
+            }
+
+            DirectX::ScratchImage compressed;
+            DirectX::ScratchImage expected;
+            bool match = SUCCEEDED(DirectX::Compress(source, format, DirectX::TEX_COMPRESS_BC1_3_FAST, DirectX::TEX_THRESHOLD_DEFAULT, compressed))
+                && SUCCEEDED(DirectX::Compress(paddedImage, format, DirectX::TEX_COMPRESS_BC1_3_FAST, DirectX::TEX_THRESHOLD_DEFAULT, expected))
+                && compressed.GetPixelsSize() == expected.GetPixelsSize()
+                && memcmp(compressed.GetPixels(), expected.GetPixels(), expected.GetPixelsSize()) == 0;
+            if (!match)
+            {
+                printf("  %s %zux%zu %s: fast blocks differ from the padded image\n", name, source.width, source.height,
+                    format == DXGI_FORMAT_BC1_UNORM ? "BC1" : "BC3");
+            }
+            edgesMatch &= match;
+        };
+
+        // The noise image for BC1 and the alpha image for BC3, then a full mip chain where every level below 4x4
+        // is one partial block.
+        for (const TestTexture* texture : { &textures[1], &textures[3] })
+        {
+            const DXGI_FORMAT format = texture == &textures[1] ? DXGI_FORMAT_BC1_UNORM : DXGI_FORMAT_BC3_UNORM;
+            const DirectX::Image& full = *texture->image.GetImage(0, 0, 0);
+            for (const auto& size : g_partialBlockSizes)
+            {
+                DirectX::ScratchImage window = CopyTestWindow(full, size[0], size[1], false);
+                compareEdges(texture->name, *window.GetImage(0, 0, 0), format);
+            }
+
+            DirectX::ScratchImage mipChain = CopyTestWindow(full, 75, 43, true);
+            for (size_t mip = 0; mip < mipChain.GetMetadata().mipLevels; ++mip)
+            {
+                compareEdges(texture->name, *mipChain.GetImage(mip, 0, 0), format);
+            }
+        }
+        printf("  fast partial blocks %s\n", edgesMatch ? "match CompressBC's edge replication" : "DIFFER");
+
+        return withinTolerance && edgesMatch;
+    }
+
+    // How much PSNR TEX_COMPRESS_BC7_FAST may give up against the exhaustive reference, and the speedup
+    // it has to reach to be worth that.
+    constexpr double BC7_FAST_PSNR_TOLERANCE = 0.5;
+    constexpr double BC7_FAST_MIN_SPEEDUP = 10.0;
+
+    bool BC7Compression()
+    {
+        // The exhaustive reference takes milliseconds per block, so every tier runs on a 128x128 window
+        // from the middle of the test images and the reference is only timed once.
+        const size_t windowSize = 128;
+        std::vector<TestTexture> textures = CreateTestTextures();
+
+        printf("%10s %12s %12s %12s %9s %10s %10s %10s\n", "image", "ref (ms)", "quick (ms)", "fast (ms)", "speedup", "ref PSNR",
+            "quick PSNR", "fast PSNR");
+        bool withinTolerance = true;
+        bool fastEnough = true;
+        for (const TestTexture& texture : textures)
+        {
+            const DirectX::Image& full = *texture.image.GetImage(0, 0, 0);
+            DirectX::ScratchImage window;
+            window.Initialize2D(full.format, windowSize, windowSize, 1, 1);
+            const size_t offset = (full.width - windowSize) / 2;
+            DirectX::CopyRectangle(full, DirectX::Rect(offset, offset, windowSize, windowSize), *window.GetImage(0, 0, 0),
+                DirectX::TEX_FILTER_DEFAULT, 0, 0);
+            const DirectX::Image& source = *window.GetImage(0, 0, 0);
+
+            DirectX::ScratchImage reference;
+            DirectX::ScratchImage quick;
+            DirectX::ScratchImage fast;
+            auto start = Clock::now();
+            DirectX::Compress(source, DXGI_FORMAT_BC7_UNORM, DirectX::TEX_COMPRESS_DEFAULT, DirectX::TEX_THRESHOLD_DEFAULT, reference);
+            std::chrono::duration<double, std::milli> referenceTime = Clock::now() - start;
+            double quickTime = MeasureMilliseconds([&]()
+            {
+                DirectX::Compress(source, DXGI_FORMAT_BC7_UNORM, DirectX::TEX_COMPRESS_BC7_QUICK, DirectX::TEX_THRESHOLD_DEFAULT, quick);
+            });
+            double fastTime = MeasureMilliseconds([&]()
+            {
+                DirectX::Compress(source, DXGI_FORMAT_BC7_UNORM, DirectX::TEX_COMPRESS_BC7_FAST, DirectX::TEX_THRESHOLD_DEFAULT, fast);
+            });
+
+            double referencePsnr = ComputePSNR(*reference.GetImage(0, 0, 0), source, false);
+            double fastPsnr = ComputePSNR(*fast.GetImage(0, 0, 0), source, false);
+            withinTolerance &= fastPsnr >= referencePsnr - BC7_FAST_PSNR_TOLERANCE;
+            fastEnough &= referenceTime.count() / fastTime >= BC7_FAST_MIN_SPEEDUP;
+
+            printf("%10s %12.1f %12.1f %12.1f %8.1fx %10.2f %10.2f %10.2f\n", texture.name, referenceTime.count(), quickTime, fastTime,
+                referenceTime.count() / fastTime, referencePsnr, ComputePSNR(*quick.GetImage(0, 0, 0), source, false), fastPsnr);
+        }
+        printf("  fast PSNR %s %.1f dB of the reference\n", withinTolerance ? "within" : "NOT WITHIN", BC7_FAST_PSNR_TOLERANCE);
+        printf("  fast speedup %s %.0fx\n", fastEnough ? "at least" : "BELOW", BC7_FAST_MIN_SPEEDUP);
+
+        return withinTolerance && fastEnough;
+    }
+
+    // R32G32B32A32_FLOAT images for BC6H: a sky gradient with a sun far above 1, noise spread over
+    // several exponents and hard edges between a bright and a dark color. Only 128x128, as the
+    // reference encoder takes milliseconds per block.
+    std::vector<TestTexture> CreateHDRTestTextures()
+    {
+        const UINT size = 128;
+        std::vector<TestTexture> textures(3);
+        textures[0].name = "sky";
+        textures[1].name = "noise";
+        textures[2].name = "edges";
+
+        uint32_t seed = 777;
+        auto random = [&seed]() { seed = seed * 1664525u + 1013904223u; return (seed >> 8) / 16777216.0f; };
+        for (size_t index = 0; index < textures.size(); ++index)
+        {
+            TestTexture& texture = textures[index];
+            texture.image.Initialize2D(DXGI_FORMAT_R32G32B32A32_FLOAT, size, size, 1, 1);
+            const DirectX::Image& image = *texture.image.GetImage(0, 0, 0);
+            for (UINT y = 0; y < size; ++y)
+            {
+                float* row = reinterpret_cast<float*>(image.pixels + y * image.rowPitch);
+                for (UINT x = 0; x < size; ++x)
+                {
+                    float height = static_cast<float>(y) / size;
+                    float r = 0.2f + 0.6f * height;
+                    float g = 0.4f + 0.4f * height;
+                    float b = 1.2f - 0.5f * height;
+                    if (index == 0)
+                    {
+                        float dx = x - size * 0.7f;
+                        float dy = y - size * 0.25f;
+                        float sun = 50.0f * expf(-(dx * dx + dy * dy) / 40.0f);
+                        r += sun;
+                        g += sun;
+                        b += sun * 0.8f;
+                    }
+                    else if (index == 1)
+                    {
+                        float intensity = expf(random() * 6.0f - 3.0f);
+                        r = intensity;
+                        g = intensity * 0.5f * random();
+                        b = 0.1f + 0.2f * intensity;
+                    }
+                    else
+                    {
+                        bool bright = ((x / 7) ^ (y / 11)) & 1;
+                        r = bright ? 20.0f : 0.05f;
+                        g = bright ? 0.2f : 3.0f;
+                        b = ((x * y) % 37) / 7.0f;
+                    }
+                    float* pixel = row + x * 4;
+                    pixel[0] = r;
+                    pixel[1] = g;
+                    pixel[2] = b;
+                    pixel[3] = 1.0f;
+                }
+            }
+        }
+        return textures;
+    }
+
+    // Root mean square of the log(1 + x) error over RGB, so bright and dark pixels weigh about the same.
+    double ComputeRMSLE(const DirectX::Image& compressed, const DirectX::Image& source)
+    {
+        DirectX::ScratchImage decompressed;
+        if (FAILED(DirectX::Decompress(compressed, DXGI_FORMAT_R32G32B32A32_FLOAT, decompressed)))
+        {
+            return -1.0;
+        }
+
+        const DirectX::Image& result = *decompressed.GetImage(0, 0, 0);
+        double sum = 0.0;
+        for (size_t y = 0; y < source.height; ++y)
+        {
+            const float* sourceRow = reinterpret_cast<const float*>(source.pixels + y * source.rowPitch);
+            const float* resultRow = reinterpret_cast<const float*>(result.pixels + y * result.rowPitch);
+            for (size_t x = 0; x < source.width * 4; ++x)
+            {
+                if (x % 4 != 3)
+                {
+                    double error = log1p(std::max(resultRow[x], 0.0f)) - log1p(std::max(sourceRow[x], 0.0f));
+                    sum += error * error;
+                }
+            }
+        }
+        return sqrt(sum / (source.width * source.height * 3));
+    }
+
+    // How much RMSLE TEX_COMPRESS_BC6H_FAST may add over the reference encoder: the hard edges image loses
+    // the most, about 0.09, as only the best ranked two region shape gets fit.
+    constexpr double BC6H_FAST_RMSLE_TOLERANCE = 0.15;
+    // Speedup over the reference below which the fast tier isn't worth its quality loss.
+    constexpr double BC6H_FAST_MIN_SPEEDUP = 50.0;
+
+    bool BC6HCompression()
+    {
+        std::vector<TestTexture> textures = CreateHDRTestTextures();
+
+        printf("%10s %12s %12s %10s %10s %9s %10s %10s\n", "image", "ref (ms)", "fast (ms)", "ref MP/s", "fast MP/s", "speedup",
+            "ref RMSLE", "fast RMSLE");
+        bool withinTolerance = true;
+        bool fastEnough = true;
+        for (const TestTexture& texture : textures)
+        {
+            const DirectX::Image& source = *texture.image.GetImage(0, 0, 0);
+            double megapixels = source.width * source.height / 1000000.0;
+
+            // The reference is only timed once, it takes seconds.
+            DirectX::ScratchImage reference;
+            DirectX::ScratchImage fast;
+            auto start = Clock::now();
+            DirectX::Compress(source, DXGI_FORMAT_BC6H_UF16, DirectX::TEX_COMPRESS_DEFAULT, DirectX::TEX_THRESHOLD_DEFAULT, reference);
+            std::chrono::duration<double, std::milli> referenceTime = Clock::now() - start;
+            double fastTime = MeasureMilliseconds([&]()
+            {
+                DirectX::Compress(source, DXGI_FORMAT_BC6H_UF16, DirectX::TEX_COMPRESS_BC6H_FAST, DirectX::TEX_THRESHOLD_DEFAULT, fast);
+            });
+
+            double referenceRmsle = ComputeRMSLE(*reference.GetImage(0, 0, 0), source);
+            double fastRmsle = ComputeRMSLE(*fast.GetImage(0, 0, 0), source);
+            withinTolerance &= fastRmsle >= 0.0 && fastRmsle <= referenceRmsle + BC6H_FAST_RMSLE_TOLERANCE;
+            fastEnough &= referenceTime.count() / fastTime >= BC6H_FAST_MIN_SPEEDUP;
+
+            printf("%10s %12.1f %12.2f %10.3f %10.1f %8.0fx %10.4f %10.4f\n", texture.name, referenceTime.count(), fastTime,
+                megapixels * 1000.0 / referenceTime.count(), megapixels * 1000.0 / fastTime, referenceTime.count() / fastTime,
+                referenceRmsle, fastRmsle);
+        }
+
+        // Partial blocks and a full mip chain go through LoadBlocks' edge replication.
+        bool edgesWithinTolerance = true;
+        for (const TestTexture& texture : textures)
+        {
+            const DirectX::Image& full = *texture.image.GetImage(0, 0, 0);
+            std::vector<DirectX::ScratchImage> windows;
+            for (const auto& size : g_partialBlockSizes)
+            {
+                windows.push_back(CopyTestWindow(full, size[0], size[1], false));
+            }
+            windows.push_back(CopyTestWindow(full, 75, 43, true));
+
+            for (const DirectX::ScratchImage& window : windows)
+            {
+                DirectX::ScratchImage reference;
+                DirectX::ScratchImage fast;
+                bool compressed = SUCCEEDED(DirectX::Compress(window.GetImages(), window.GetImageCount(), window.GetMetadata(),
+                        DXGI_FORMAT_BC6H_UF16, DirectX::TEX_COMPRESS_DEFAULT, DirectX::TEX_THRESHOLD_DEFAULT, reference))
+                    && SUCCEEDED(DirectX::Compress(window.GetImages(), window.GetImageCount(), window.GetMetadata(),
+                        DXGI_FORMAT_BC6H_UF16, DirectX::TEX_COMPRESS_BC6H_FAST, DirectX::TEX_THRESHOLD_DEFAULT, fast));
+                for (size_t mip = 0; mip < window.GetMetadata().mipLevels; ++mip)
+                {
+                    const DirectX::Image& source = *window.GetImage(mip, 0, 0);
+                    double referenceRmsle = compressed ? ComputeRMSLE(*reference.GetImage(mip, 0, 0), source) : -1.0;
+                    double fastRmsle = compressed ? ComputeRMSLE(*fast.GetImage(mip, 0, 0), source) : -1.0;
+                    bool ok = fastRmsle >= 0.0 && fastRmsle <= referenceRmsle + BC6H_FAST_RMSLE_TOLERANCE;
+                    if (!ok)
+                    {
+                        printf("  %s %zux%zu: fast RMSLE %.4f, reference %.4f\n", texture.name, source.width, source.height, fastRmsle,
+                            referenceRmsle);
+                    }
+                    edgesWithinTolerance &= ok;
+                }
+            }
+        }
+        printf("  fast RMSLE %s %.2f of the reference, partial blocks %s\n", withinTolerance ? "within" : "NOT WITHIN",
+            BC6H_FAST_RMSLE_TOLERANCE, edgesWithinTolerance ? "too" : "NOT");
+        printf("  fast speedup %s %.0fx\n", fastEnough ? "at least" : "BELOW", BC6H_FAST_MIN_SPEEDUP);
+
+        return withinTolerance && edgesWithinTolerance && fastEnough;
+    }
+
+    // TEX_COMPRESS_BC4_5_BATCHED has to write the same blocks as the default encoders, so the output
+    // is compared byte for byte. BC4 takes the red channel of the test images, BC5 red and green.
+    bool BC45Compression()
+    {
+        std::vector<TestTexture> textures = CreateTestTextures();
+
+        printf("%10s %8s %10s %12s %10s %12s %9s %10s\n", "image", "format", "ref (ms)", "batched (ms)", "ref MP/s", "batched MP/s",
+            "speedup", "blocks");
+        bool identical = true;
+        for (const TestTexture& texture : textures)
+        {
+            const DirectX::Image& source = *texture.image.GetImage(0, 0, 0);
+            double megapixels = source.width * source.height / 1000000.0;
+            for (DXGI_FORMAT format : { DXGI_FORMAT_BC4_UNORM, DXGI_FORMAT_BC4_SNORM, DXGI_FORMAT_BC5_UNORM, DXGI_FORMAT_BC5_SNORM })
+            {
+                DirectX::ScratchImage reference;
+                DirectX::ScratchImage batched;
+                double referenceTime = MeasureMilliseconds([&]()
+                {
+                    DirectX::Compress(source, format, DirectX::TEX_COMPRESS_DEFAULT, DirectX::TEX_THRESHOLD_DEFAULT, reference);
+                });
+                double batchedTime = MeasureMilliseconds([&]()
+                {
+                    DirectX::Compress(source, format, DirectX::TEX_COMPRESS_BC4_5_BATCHED, DirectX::TEX_THRESHOLD_DEFAULT, batched);
+                });
+
+                bool same = reference.GetPixelsSize() == batched.GetPixelsSize() &&
+                    memcmp(reference.GetPixels(), batched.GetPixels(), reference.GetPixelsSize()) == 0;
+                identical &= same;
+
+                const char* formatName = format == DXGI_FORMAT_BC4_UNORM ? "BC4U" : format == DXGI_FORMAT_BC4_SNORM ? "BC4S" :
+                    format == DXGI_FORMAT_BC5_UNORM ? "BC5U" : "BC5S";
+                printf("%10s %8s %10.2f %12.2f %10.1f %12.1f %8.2fx %10s\n", texture.name, formatName, referenceTime, batchedTime,
+                    megapixels * 1000.0 / referenceTime, megapixels * 1000.0 / batchedTime, referenceTime / batchedTime,
+                    same ? "identical" : "MISMATCH");
+            }
+        }
+        // Partial blocks and full mip chains, where LoadBlocks has to replicate edge pixels the way CompressBC does.
+        bool edgesIdentical = true;
+        for (const TestTexture& texture : textures)
+        {
+            const DirectX::Image& full = *texture.image.GetImage(0, 0, 0);
+            std::vector<DirectX::ScratchImage> windows;
+            for (const auto& size : g_partialBlockSizes)
+            {
+                windows.push_back(CopyTestWindow(full, size[0], size[1], false));
+            }
+            windows.push_back(CopyTestWindow(full, 75, 43, true));
+            windows.push_back(CopyTestWindow(full, full.width, full.height, true));
+
+            for (const DirectX::ScratchImage& window : windows)
+            {
+                for (DXGI_FORMAT format : { DXGI_FORMAT_BC4_UNORM, DXGI_FORMAT_BC4_SNORM, DXGI_FORMAT_BC5_UNORM, DXGI_FORMAT_BC5_SNORM })
+                {
+                    DirectX::ScratchImage reference;
+                    DirectX::ScratchImage batched;
+                    bool same = SUCCEEDED(DirectX::Compress(window.GetImages(), window.GetImageCount(), window.GetMetadata(), format,
+                            DirectX::TEX_COMPRESS_DEFAULT, DirectX::TEX_THRESHOLD_DEFAULT, reference))
+                        && SUCCEEDED(DirectX::Compress(window.GetImages(), window.GetImageCount(), window.GetMetadata(), format,
+                            DirectX::TEX_COMPRESS_BC4_5_BATCHED, DirectX::TEX_THRESHOLD_DEFAULT, batched))
+                        && reference.GetPixelsSize() == batched.GetPixelsSize()
+                        && memcmp(reference.GetPixels(), batched.GetPixels(), reference.GetPixelsSize()) == 0;
+                    if (!same)
+                    {
+                        printf("  %s %zux%zu with %zu mips, format %d: batched blocks differ\n", texture.name, window.GetMetadata().width,
+                            window.GetMetadata().height, window.GetMetadata().mipLevels, static_cast<int>(format));
+                    }
+                    edgesIdentical &= same;
+                }
+            }
+        }
+        printf("  batched blocks %s\n", identical ? "identical to the reference" : "DIFFER from the reference");
+        printf("  batched partial blocks and mip chains %s\n", edgesIdentical ? "identical to the reference" : "DIFFER from the reference");
+
+        return identical && edgesIdentical;
+    }
+
+    // The software rasterizer that ships with Windows, for the checks that need a device but not a GPU.
+    bool CreateWarpDevice(Microsoft::WRL::ComPtr<ID3D12Device2>& device)
+    {
+        Microsoft::WRL::ComPtr<IDXGIFactory4> factory;
+        Microsoft::WRL::ComPtr<IDXGIAdapter> warpAdapter;
+        return SUCCEEDED(CreateDXGIFactory2(0, IID_PPV_ARGS(&factory))) && SUCCEEDED(factory->EnumWarpAdapter(IID_PPV_ARGS(&warpAdapter))) &&
+            SUCCEEDED(D3D12CreateDevice(warpAdapter.Get(), D3D_FEATURE_LEVEL_11_0, IID_PPV_ARGS(&device)));
+    }
+
+    // Fills in a blend description field by field, so whatever was in the padding before stays there.
+    void SetOpaqueBlend(D3D12_BLEND_DESC& blend)
+    {
+        blend.AlphaToCoverageEnable = FALSE;
+        blend.IndependentBlendEnable = FALSE;
+        D3D12_RENDER_TARGET_BLEND_DESC& renderTarget = blend.RenderTarget[0];
+        renderTarget.BlendEnable = FALSE;
+        renderTarget.LogicOpEnable = FALSE;
+        renderTarget.SrcBlend = D3D12_BLEND_ONE;
+        renderTarget.DestBlend = D3D12_BLEND_ZERO;
+        renderTarget.BlendOp = D3D12_BLEND_OP_ADD;
+        renderTarget.SrcBlendAlpha = D3D12_BLEND_ONE;
+        renderTarget.DestBlendAlpha = D3D12_BLEND_ZERO;
+        renderTarget.BlendOpAlpha = D3D12_BLEND_OP_ADD;
+        renderTarget.LogicOp = D3D12_LOGIC_OP_NOOP;
+        renderTarget.RenderTargetWriteMask = D3D12_COLOR_WRITE_ENABLE_ALL;
+    }
+
+    bool PipelineCaching()
+    {
+        struct BlendStream
+        {
+            CD3DX12_PIPELINE_STATE_STREAM_BLEND_DESC blend;
+            CD3DX12_PIPELINE_STATE_STREAM_PRIMITIVE_TOPOLOGY topology;
+        };
+
+        // Equal blend states have to hash the same no matter what is in the padding or in the render target
+        // entries that are ignored without independent blending. Hashing doesn't need a device.
+        bool hashesMatch;
+        bool hashesDiffer;
+        {
+            BlendStream streamA;
+            BlendStream streamB;
+            CD3DX12_BLEND_DESC& blendA = streamA.blend;
+            CD3DX12_BLEND_DESC& blendB = streamB.blend;
+            memset(&blendA, 0x00, sizeof(D3D12_BLEND_DESC));
+            memset(&blendB, 0xcd, sizeof(D3D12_BLEND_DESC));
+            SetOpaqueBlend(blendA);
+            SetOpaqueBlend(blendB);
+            streamA.topology = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+            streamB.topology = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+
+            const std::unordered_map<ID3D12RootSignature*, uint64_t> noRootSignatures;
+            D3D12_PIPELINE_STATE_STREAM_DESC descA = { sizeof(streamA), &streamA };
+            D3D12_PIPELINE_STATE_STREAM_DESC descB = { sizeof(streamB), &streamB };
+            hashesMatch = PipelineCache::HashPipelineStream(descA, noRootSignatures) == PipelineCache::HashPipelineStream(descB, noRootSignatures);
+
+            blendB.RenderTarget[0].BlendEnable = TRUE;
+            hashesDiffer = PipelineCache::HashPipelineStream(descA, noRootSignatures) != PipelineCache::HashPipelineStream(descB, noRootSignatures);
+            printf("  blend hash: padding %s, a changed field %s\n", hashesMatch ? "ignored" : "HASHED", hashesDiffer ? "hashed" : "IGNORED");
+        }
+        bool passed = hashesMatch && hashesDiffer;
+
+        // The library round trip needs a device, WARP stands in for the GPU.
+        Microsoft::WRL::ComPtr<ID3D12Device2> device;
+        if (!CreateWarpDevice(device))
+        {
+            printf("  library round trip skipped, no WARP device\n");
+            return passed;
+        }
+
+        const char shaderSource[] = "[numthreads(1, 1, 1)] void main() {}";
+        Microsoft::WRL::ComPtr<ID3DBlob> shader;
+        Microsoft::WRL::ComPtr<ID3DBlob> signature;
+        Microsoft::WRL::ComPtr<ID3DBlob> errors;
+        CD3DX12_ROOT_SIGNATURE_DESC rootSignatureDesc(0, nullptr);
+        if (FAILED(D3DCompile(shaderSource, sizeof(shaderSource) - 1, nullptr, nullptr, nullptr, "main", "cs_5_0", 0, 0, &shader, &errors)) ||
+            FAILED(D3D12SerializeRootSignature(&rootSignatureDesc, D3D_ROOT_SIGNATURE_VERSION_1, &signature, &errors)))
+        {
+            printf("  library round trip FAILED, test shader doesn't compile\n");
+            return false;
+        }
+
+        auto getPipelineState = [&](PipelineCache& cache)
+        {
+            struct ComputeStream
+            {
+                CD3DX12_PIPELINE_STATE_STREAM_ROOT_SIGNATURE rootSignature;
+                CD3DX12_PIPELINE_STATE_STREAM_CS cs;
+            } stream;
+            Microsoft::WRL::ComPtr<ID3D12RootSignature> rootSignature = cache.GetRootSignature(signature);
+            stream.rootSignature = rootSignature.Get();
+            stream.cs = CD3DX12_SHADER_BYTECODE(shader.Get());
+            D3D12_PIPELINE_STATE_STREAM_DESC desc = { sizeof(stream), &stream };
+            return cache.GetPipelineState(desc);
+        };
+
+        fs::path libraryPath = fs::temp_directory_path() / "diabolic_bench_pipelines.bin";
+        fs::remove(libraryPath);
+
+        // Several threads asking for the same new pipeline at once compile it once and all get the same object.
+        bool compiledOnce;
+        {
+            PipelineCache cache(device, libraryPath.wstring());
+            const UINT requestCount = 8;
+            std::vector<Microsoft::WRL::ComPtr<ID3D12PipelineState>> pipelineStates(requestCount);
+            Jobs::Counter counter;
+            for (UINT i = 0; i < requestCount; ++i)
+            {
+                Jobs::Run([&, i]() { pipelineStates[i] = getPipelineState(cache); }, &counter);
+            }
+            Jobs::Wait(counter);
+
+            compiledOnce = cache.GetMissCount() == 1 && cache.GetHitCount() == requestCount - 1;
+            for (const auto& pipelineState : pipelineStates)
+            {
+                compiledOnce &= pipelineState && pipelineState == pipelineStates[0];
+            }
+            printf("  %u concurrent requests: %u compiled, %u hits\n", requestCount, cache.GetMissCount(), cache.GetHitCount());
+            cache.Save();
+        }
+        passed &= compiledOnce;
+
+        if (!fs::exists(libraryPath))
+        {
+            printf("  library round trip skipped, the device has no pipeline library support\n");
+            return passed;
+        }
+
+        // A second cache over the saved file gets the pipeline from the library instead of compiling it.
+        bool loaded;
+        {
+            PipelineCache cache(device, libraryPath.wstring());
+            loaded = getPipelineState(cache) && cache.GetLibraryHitCount() == 1 && cache.GetMissCount() == 0;
+        }
+        fs::remove(libraryPath);
+        printf("  library round trip %s\n", loaded ? "ok" : "FAILED");
+
+        return passed && loaded;
+    }
+
+    bool ShaderCaching()
+    {
+        // Sources in a scratch directory, one shared include. The stub compiler echoes the source as "bytecode",
+        // so no d3dcompiler or device is needed and the output shows which source version was compiled.
+        fs::path directory = fs::temp_directory_path() / "diabolic_bench_shaders";
+        fs::path cacheDirectory = directory / "cache";
+        fs::remove_all(directory);
+        fs::create_directories(directory);
+        auto writeFile = [&](const char* name, const char* contents)
+        {
+            std::ofstream file(directory / name, std::ios::binary | std::ios::trunc);
+            file << contents;
+        };
+        writeFile("common.hlsli", "float4 Tint() { return 1; }\n");
+        writeFile("a.hlsl", "#include \"common.hlsli\"\nfloat4 main() : SV_Target { return Tint(); }\n");
+        writeFile("b.hlsl", "float4 main() : SV_Target { return 0; }\n");
+
+        std::atomic<UINT> compilerCalls(0);
+        ShaderCompiler stubCompiler = [&compilerCalls](const ShaderDesc&, const std::string& source, std::vector<uint8_t>& bytecode, std::string&)
+        {
+            compilerCalls++;
+            bytecode.assign(source.begin(), source.end());
+            return true;
+        };
+
+        ShaderDesc a = { (directory / "a.hlsl").wstring(), "main", "ps_5_0" };
+        ShaderDesc b = { (directory / "b.hlsl").wstring(), "main", "ps_5_0" };
+        bool passed = true;
+        auto check = [&passed](const char* step, bool ok)
+        {
+            printf("  %-36s %s\n", step, ok ? "ok" : "FAILED");
+            passed &= ok;
+        };
+
+        {
+            ShaderCache cache(cacheDirectory.wstring(), stubCompiler);
+            std::vector<ShaderBytecode> shaders = cache.GetShaders({ a, b });
+            check("cold: both compiled", cache.GetCompileCount() == 2 && compilerCalls == 2 && shaders[0] && shaders[1]);
+
+            ShaderBytecode again = cache.GetShader(a);
+            check("same cache: memory hit", again == shaders[0] && cache.GetMemoryHitCount() == 1 && compilerCalls == 2);
+
+            double hitTime = MeasureMilliseconds([&]() { cache.GetShader(a); });
+            printf("  memory hit (read, hash and lookup): %.2f us\n", hitTime * 1000.0);
+        }
+
+        {
+            ShaderCache cache(cacheDirectory.wstring(), stubCompiler);
+            ShaderBytecode shader = cache.GetShader(a);
+            check("new cache: disk hit", cache.GetDiskHitCount() == 1 && cache.GetCompileCount() == 0 && compilerCalls == 2);
+
+            // Editing the include has to invalidate the shader that uses it, and only that one.
+            writeFile("common.hlsli", "float4 Tint() { return 0.5; }\n");
+            std::vector<ShaderBytecode> shaders = cache.GetShaders({ a, b });
+            check("include edited: user recompiled", cache.GetCompileCount() == 1 && compilerCalls == 3 && shaders[0] != shader);
+            check("include edited: other shader cached", cache.GetDiskHitCount() == 2);
+
+            ShaderDesc defined = a;
+            defined.defines.push_back({ "ALBEDO_TEXTURE", "1" });
+            cache.GetShader(defined);
+            check("define added: recompiled", cache.GetCompileCount() == 2 && compilerCalls == 4);
+        }
+
+        // A failing compile is reported, not cached.
+        {
+            ShaderCache cache(cacheDirectory.wstring(), [](const ShaderDesc&, const std::string&, std::vector<uint8_t>&, std::string& errors)
+            {
+                errors = "stub compiler error";
+                return false;
+            });
+            writeFile("b.hlsl", "float4 main() : SV_Target { return 1; }\n");
+            bool threw = false;
+            try
+            {
+                cache.GetShader(b);
+            }
+            catch (const std::exception&)
+            {
+                threw = true;
+            }
+            check("failed compile: throws", threw && cache.GetCompileCount() == 0);
+        }
+
+        fs::remove_all(directory);
+        return passed;
+    }
+
+    bool ShaderPermutationCompiles()
+    {
+        fs::path directory = fs::temp_directory_path() / "diabolic_bench_permutations";
+        fs::remove_all(directory);
+        fs::create_directories(directory);
+        {
+            std::ofstream file(directory / "uber.hlsl", std::ios::binary | std::ios::trunc);
+            file << "float4 main() : SV_Target { return FEATURE_ALBEDO_TEXTURE; }\n";
+        }
+
+        // The stub compiler keeps the defines of every compile, in order.
+        std::mutex mutex;
+        std::vector<std::vector<ShaderDefine>> compiledDefines;
+        ShaderCompiler stubCompiler = [&](const ShaderDesc& desc, const std::string& source, std::vector<uint8_t>& bytecode, std::string&)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            compiledDefines.push_back(desc.defines);
+            bytecode.assign(source.begin(), source.end());
+            return true;
+        };
+        auto isDefined = [](const std::vector<ShaderDefine>& defines, ShaderFeature feature)
+        {
+            for (const ShaderDefine& define : defines)
+            {
+                if (define.name == ShaderPermutations::GetFeatureName(feature))
+                {
+                    return define.value == "1";
+                }
+            }
+            return false;
+        };
+
+        bool passed = true;
+        auto check = [&passed](const char* step, bool ok)
+        {
+            printf("  %-44s %s\n", step, ok ? "ok" : "FAILED");
+            passed &= ok;
+        };
+
+        // Each feature bit defines its own name to 1 and every other feature to 0.
+        bool definesMatch = true;
+        std::set<std::string> names;
+        for (uint32_t bit = 0; bit < SHADER_FEATURE_COUNT; ++bit)
+        {
+            ShaderFeature feature = static_cast<ShaderFeature>(1u << bit);
+            names.insert(ShaderPermutations::GetFeatureName(feature));
+            std::vector<ShaderDefine> defines = ShaderPermutations::GetDefines(feature);
+            definesMatch &= defines.size() == SHADER_FEATURE_COUNT;
+            for (uint32_t other = 0; other < SHADER_FEATURE_COUNT; ++other)
+            {
+                definesMatch &= isDefined(defines, static_cast<ShaderFeature>(1u << other)) == (other == bit);
+            }
+        }
+        check("every bit maps to its own define", definesMatch && names.size() == SHADER_FEATURE_COUNT);
+
+        {
+            ShaderCache cache((directory / "cache").wstring(), stubCompiler);
+            ShaderDesc desc = { (directory / "uber.hlsl").wstring(), "main", "ps_5_0" };
+            ShaderPermutations permutations(cache, desc, SHADER_FEATURE_ALBEDO_TEXTURE | SHADER_FEATURE_NORMAL_MAP);
+
+            // Alpha test isn't supported, so the third material shares the albedo permutation.
+            permutations.Get(SHADER_FEATURE_NONE);
+            permutations.Get(SHADER_FEATURE_ALBEDO_TEXTURE);
+            permutations.Get(SHADER_FEATURE_ALBEDO_TEXTURE | SHADER_FEATURE_ALPHA_TEST);
+            permutations.Get(SHADER_FEATURE_ALBEDO_TEXTURE);
+            check("only the requested permutations compiled", compiledDefines.size() == 2);
+            check("compiled with the requested defines", compiledDefines.size() == 2 &&
+                !isDefined(compiledDefines[0], SHADER_FEATURE_ALBEDO_TEXTURE) && !isDefined(compiledDefines[0], SHADER_FEATURE_NORMAL_MAP) &&
+                isDefined(compiledDefines[1], SHADER_FEATURE_ALBEDO_TEXTURE) && !isDefined(compiledDefines[1], SHADER_FEATURE_NORMAL_MAP) &&
+                !isDefined(compiledDefines[1], SHADER_FEATURE_ALPHA_TEST));
+
+            // Report() goes to a scratch file, its summary line has to count the live permutations.
+            char summary[256] = {};
+            if (FILE* file = tmpfile())
+            {
+                permutations.Report(file);
+                rewind(file);
+                if (!fgets(summary, sizeof(summary), file))
+                {
+                    summary[0] = '\0';
+                }
+                fclose(file);
+            }
+            check("report counts 2 of 4 live", permutations.GetLiveCount() == 2 && permutations.GetPossibleCount() == 4 &&
+                strstr(summary, ": 2 of 4 permutations live") != nullptr);
+        }
+
+        fs::remove_all(directory);
+        return passed;
+    }
+
+    bool TextureStreaming()
+    {
+        Microsoft::WRL::ComPtr<ID3D12Device2> device;
+        if (!CreateWarpDevice(device))
+        {
+            printf("  skipped, no WARP device\n");
+            return true;
+        }
+        CommandQueue copyQueue(device, D3D12_COMMAND_LIST_TYPE_COPY);
+
+        // Two 256x256 textures with full mip chains, the budget holds one chain and the other's coarse mips.
+        fs::path directory = fs::temp_directory_path() / "diabolic_bench_streaming";
+        fs::create_directories(directory);
+        UINT64 chainSize = 0;
+        std::wstring filePaths[2];
+        for (UINT i = 0; i < 2; ++i)
+        {
+            DirectX::ScratchImage image;
+            DirectX::ScratchImage mipChain;
+            image.Initialize2D(DXGI_FORMAT_R8G8B8A8_UNORM, 256, 256, 1, 1);
+            memset(image.GetPixels(), i == 0 ? 0x40 : 0xc0, image.GetPixelsSize());
+            DirectX::GenerateMipMaps(*image.GetImage(0, 0, 0), DirectX::TEX_FILTER_DEFAULT, 0, mipChain);
+            filePaths[i] = (directory / (i == 0 ? "a.dds" : "b.dds")).wstring();
+            DirectX::SaveToDDSFile(mipChain.GetImages(), mipChain.GetImageCount(), mipChain.GetMetadata(), DirectX::DDS_FLAGS_NONE,
+                filePaths[i].c_str());
+            chainSize = mipChain.GetPixelsSize();
+        }
+        const UINT64 budget = chainSize + chainSize / 8;
+
+        bool passed = true;
+        {
+            TextureStreamer streamer(device, copyQueue, budget);
+            UINT a = streamer.Request(filePaths[0]);
+            UINT b = streamer.Request(filePaths[1]);
+
+            // Frames as the renderer runs them: requests, then an update. Copies finish asynchronously.
+            auto runFrames = [&](UINT requested, const std::function<bool()>& done)
+            {
+                for (UINT frame = 0; frame < 5000 && !done(); ++frame)
+                {
+                    FrameMemory::BeginFrame();
+                    if (requested != TextureStreamer::INVALID_TEXTURE)
+                    {
+                        streamer.RequestMip(requested, 0);
+                    }
+                    streamer.Update();
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+                return done();
+            };
+            auto check = [&](const char* step, bool ok)
+            {
+                printf("  %-44s %s (mips %u and %u, %.0f of %.0f KB)\n", step, ok ? "ok" : "FAILED", streamer.GetResidentMip(a),
+                    streamer.GetResidentMip(b), streamer.GetResidency().GetResidentBytes() / 1024.0, budget / 1024.0);
+                passed &= ok;
+            };
+
+            bool coarse = runFrames(TextureStreamer::INVALID_TEXTURE, [&]() { return streamer.IsResident(a) && streamer.IsResident(b); });
+            check("unrequested: coarsest mips only", coarse && !streamer.IsFullyResident(a) && !streamer.IsFullyResident(b));
+
+            bool loaded = runFrames(a, [&]() { return streamer.IsFullyResident(a); });
+            check("a requested: all of a loaded", loaded);
+
+            // Only fits by dropping the mips of a, which isn't requested anymore.
+            bool evicted = runFrames(b, [&]() { return streamer.IsFullyResident(b) && streamer.GetResidentMip(a) > 0; });
+            check("b requested: b loaded, a evicted", evicted && streamer.GetResidency().GetResidentBytes() <= budget);
+
+            bool reloaded = runFrames(a, [&]() { return streamer.IsFullyResident(a) && streamer.GetResidentMip(b) > 0; });
+            check("a requested again: a reloaded, b evicted", reloaded && streamer.GetResidency().GetResidentBytes() <= budget);
+        }
+
+        fs::remove_all(directory);
+        return passed;
+    }
+
+    bool TextureCooking()
+    {
+        // Two uncompressed sources in a scratch directory, cooked three times like consecutive builds.
+        fs::path directory = fs::temp_directory_path() / "diabolic_bench_cooking";
+        fs::path sourceDirectory = directory / "textures";
+        fs::path cookedDirectory = directory / "cooked";
+        fs::remove_all(directory);
+        fs::create_directories(sourceDirectory);
+        auto writeSource = [&](const char* name, uint8_t value)
+        {
+            DirectX::ScratchImage image;
+            image.Initialize2D(DXGI_FORMAT_R8G8B8A8_UNORM, 64, 64, 1, 1);
+            memset(image.GetPixels(), value, image.GetPixelsSize());
+            DirectX::SaveToDDSFile(*image.GetImage(0, 0, 0), DirectX::DDS_FLAGS_NONE, (sourceDirectory / name).wstring().c_str());
+        };
+        writeSource("a.dds", 0x40);
+        writeSource("b.dds", 0xc0);
+
+        bool passed = true;
+        auto check = [&passed](const char* step, const Util::TextureCookStats& stats, bool ok)
+        {
+            printf("  %-36s %s (cooked %u, unchanged %u, failed %u, %.3f s)\n", step, ok ? "ok" : "FAILED", stats.cooked, stats.skipped,
+                stats.failed, stats.seconds);
+            passed &= ok;
+        };
+
+        Util::TextureCookStats first = Util::CookTextures(sourceDirectory.wstring(), cookedDirectory.wstring());
+        DirectX::TexMetadata metadata = {};
+        bool cooked = SUCCEEDED(DirectX::GetMetadataFromDDSFile((cookedDirectory / "a.dds").wstring().c_str(), DirectX::DDS_FLAGS_NONE, metadata));
+        check("first cook: both cooked", first, first.cooked == 2 && first.failed == 0 && cooked &&
+            metadata.format == DXGI_FORMAT_BC1_UNORM && metadata.mipLevels == 7);
+
+        // Nothing changed, so nothing may be rewritten either.
+        auto aTime = fs::last_write_time(cookedDirectory / "a.dds");
+        auto bTime = fs::last_write_time(cookedDirectory / "b.dds");
+        Util::TextureCookStats second = Util::CookTextures(sourceDirectory.wstring(), cookedDirectory.wstring());
+        check("second cook: both unchanged", second, second.cooked == 0 && second.skipped == 2 && second.failed == 0 &&
+            fs::last_write_time(cookedDirectory / "a.dds") == aTime && fs::last_write_time(cookedDirectory / "b.dds") == bTime);
+
+        writeSource("b.dds", 0x80);
+        Util::TextureCookStats third = Util::CookTextures(sourceDirectory.wstring(), cookedDirectory.wstring());
+        check("b edited: only b cooked", third, third.cooked == 1 && third.skipped == 1 && third.failed == 0 &&
+            fs::last_write_time(cookedDirectory / "a.dds") == aTime);
+
+        fs::remove_all(directory);
+        return passed;
+    }
+
+    struct HeadlessScenario
+    {
+        const char* name;
+        UINT gridSize;
+        float orbitSpeed; // radians per second the camera circles the block, 0 keeps the window's view
+    };
+
+    const HeadlessScenario g_headlessScenarios[] = {
+        { "grid", 10, 0.0f }, // what the window shows
+        { "orbit", 10, 0.5f }, // visibility and LODs change every frame
+        { "crowd", 40, 0.5f }, // 64000 instances, culled in parallel
+    };
+
+    struct Benchmark
+    {
+        const char* name;
+        bool (*function)();
+    };
+
+    const Benchmark g_benchmarks[] = {
+        { "instances", InstanceUpdate },
+        { "culling", FrustumCulling },
+        { "hierarchy", HierarchyUpdate },
+        { "mesh", MeshImport },
+        { "quantize", VertexQuantization },
+        { "lod", LodGeneration },
+        { "residency", TextureResidencySimulation },
+        { "archive", AssetArchiveLoading },
+        { "jobs", JobSystemOverhead },
+        { "tasks", TaskGraphScheduling },
+        { "frame", FrameAllocation },
+        { "profiler", ProfilerOverhead },
+        { "commands", CommandRecording },
+        { "ui", UIRasterization },
+        { "capture", CaptureEncoding },
+        { "bc1", BC1Compression },
+        { "bc7", BC7Compression },
+        { "bc6h", BC6HCompression },
+        { "bc45", BC45Compression },
+        { "pipelines", PipelineCaching },
+        { "shaders", ShaderCaching },
+        { "permutations", ShaderPermutationCompiles },
+        { "streaming", TextureStreaming },
+        { "cook", TextureCooking },
+    };
+}
+
+bool Bench::Run(const std::string& name)
+{
+    bool found = false;
+    std::vector<const char*> failed;
+    for (const Benchmark& benchmark : g_benchmarks)
+    {
+        if (name.empty() || name == benchmark.name)
+        {
+            printf("== %s ==\n", benchmark.name);
+            if (!benchmark.function())
+            {
+                failed.push_back(benchmark.name);
+            }
+            printf("\n");
+            found = true;
+        }
+    }
+
+    if (!found)
+    {
+        fprintf(stderr, "Unknown benchmark: %s\n", name.c_str());
+    }
+    for (const char* benchmark : failed)
+    {
+        fprintf(stderr, "Benchmark check failed: %s\n", benchmark);
+    }
+    return found && failed.empty();
+}
+
+bool Bench::RunHeadless(UINT frameCount, const std::string& scenario, const std::wstring& outputPath)
+{
+    const HeadlessScenario* selected = nullptr;
+    for (const HeadlessScenario& candidate : g_headlessScenarios)
+    {
+        if (scenario == candidate.name)
+        {
+            selected = &candidate;
+        }
+    }
+    if (!selected)
+    {
+        fprintf(stderr, "Unknown scenario: %s\n", scenario.c_str());
+        return false;
+    }
+
+    // Same setup as the renderer at 1920x1080, instance data goes to memory instead of an upload buffer.
+    const UINT width = 1920;
+    const UINT height = 1080;
+    DialogueSample sample(nullptr);
+    Camera camera;
+    GeometryScene scene;
+    Util::MeshData mesh;
+    scene.CreateMesh(mesh);
+    scene.CreateInstances(selected->gridSize);
+    std::vector<XMFLOAT4X4> instanceData(scene.GetInstanceCount());
+
+    const float spacing = 2.0f;
+    const XMVECTOR center = XMVectorSet(-1.0f, -1.0f, 10.0f + (selected->gridSize - 1) * spacing * 0.5f, 1.0f);
+    const float orbitRadius = selected->gridSize * spacing + 10.0f;
+
+    // A fixed time step keeps runs comparable, the measured times are wall clock.
+    const float deltaTime = 1.0f / 60.0f;
+    FrameStats stats({ "DialogueSample::Update", "GeometryScene::Update", "Record commands" }, frameCount);
+    RecordingCommandContext recorder;
+    UINT visibleTotal = 0;
+    UINT commandTotal = 0;
+    for (UINT frame = 0; frame < frameCount; ++frame)
+    {
+        auto frameStart = Clock::now();
+        double stageMilliseconds[3];
+
+        sample.Update();
+        auto stageEnd = Clock::now();
+        stageMilliseconds[0] = std::chrono::duration<double, std::milli>(stageEnd - frameStart).count();
+
+        auto stageStart = stageEnd;
+        FrameMemory::BeginFrame();
+        if (selected->orbitSpeed > 0.0f)
+        {
+            float angle = frame * deltaTime * selected->orbitSpeed;
+            camera.position = XMVectorAdd(center, XMVectorSet(sinf(angle) * orbitRadius, 0.0f, -cosf(angle) * orbitRadius, 0.0f));
+            camera.front = XMVectorSubtract(center, camera.position);
+        }
+        scene.Update(deltaTime, camera, static_cast<float>(width) / height, height, instanceData.data());
+        stageEnd = Clock::now();
+        stageMilliseconds[1] = std::chrono::duration<double, std::milli>(stageEnd - stageStart).count();
+
+        // The draws the renderer would submit, recorded instead of going to a command list.
+        stageStart = stageEnd;
+        recorder.Reset();
+        RecordGeometryFrame(recorder, scene, camera, width, height);
+        stageEnd = Clock::now();
+        stageMilliseconds[2] = std::chrono::duration<double, std::milli>(stageEnd - stageStart).count();
+
+        visibleTotal += scene.GetVisibleCount();
+        commandTotal += recorder.GetCommandCount();
+        stats.AddFrame(stageMilliseconds, std::chrono::duration<double, std::milli>(stageEnd - frameStart).count());
+    }
+
+    printf("Headless \"%s\": %u instances, %.0f visible and %.0f commands recorded on average, recording backend\n", selected->name,
+        scene.GetInstanceCount(), frameCount > 0 ? static_cast<double>(visibleTotal) / frameCount : 0.0,
+        frameCount > 0 ? static_cast<double>(commandTotal) / frameCount : 0.0);
+    stats.Report(stdout);
+    if (!stats.WriteJson(outputPath, selected->name))
+    {
+        fprintf(stderr, "Failed to write %s\n", fs::path(outputPath).string().c_str());
+        return false;
+    }
+    return true;
+}
\ No newline at end of file
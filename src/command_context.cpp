@@ -0,0 +1,432 @@
+#include "pch.hpp"
+
+#include "command_context.hpp"
+
+#include <algorithm>
+#include <cstddef>
+
+namespace
+{
+    // Payloads of the recorded commands. Pointers are stored as they are, the stream only lives
+    // as long as the objects it refers to. The ones with padding bytes are written field by field
+    // into the payload Append() zeroed, so the same commands always give the same bytes.
+    struct RootConstants
+    {
+        UINT rootParameter;
+        UINT count;
+        UINT offset;
+        // followed by count 32-bit values
+    };
+
+    struct RootDescriptorTable
+    {
+        UINT rootParameter;
+        D3D12_GPU_DESCRIPTOR_HANDLE baseDescriptor;
+    };
+
+    struct RootShaderResourceView
+    {
+        UINT rootParameter;
+        D3D12_GPU_VIRTUAL_ADDRESS address;
+    };
+
+    struct RenderTarget
+    {
+        D3D12_CPU_DESCRIPTOR_HANDLE renderTarget;
+        D3D12_CPU_DESCRIPTOR_HANDLE depthStencil;
+    };
+
+    struct ClearColor
+    {
+        D3D12_CPU_DESCRIPTOR_HANDLE renderTarget;
+        float color[4];
+    };
+
+    struct ClearDepthValue
+    {
+        D3D12_CPU_DESCRIPTOR_HANDLE depthStencil;
+        float depth;
+    };
+
+    struct Transition
+    {
+        ID3D12Resource* resource;
+        D3D12_RESOURCE_STATES before;
+        D3D12_RESOURCE_STATES after;
+    };
+
+    struct Draw
+    {
+        UINT indexCount;
+        UINT instanceCount;
+        UINT startIndex;
+        INT baseVertex;
+        UINT startInstance;
+    };
+
+    struct TextureCopy
+    {
+        D3D12_TEXTURE_COPY_LOCATION destination;
+        D3D12_TEXTURE_COPY_LOCATION source;
+    };
+
+    // The ones that go through Write() as a whole.
+    static_assert(sizeof(RenderTarget) == 2 * sizeof(D3D12_CPU_DESCRIPTOR_HANDLE), "RenderTarget has padding");
+    static_assert(sizeof(ClearColor) == sizeof(D3D12_CPU_DESCRIPTOR_HANDLE) + 4 * sizeof(float), "ClearColor has padding");
+    static_assert(sizeof(Transition) == sizeof(ID3D12Resource*) + 2 * sizeof(D3D12_RESOURCE_STATES), "Transition has padding");
+    static_assert(sizeof(Draw) == 5 * sizeof(UINT), "Draw has padding");
+    static_assert(sizeof(D3D12_VERTEX_BUFFER_VIEW) == 16 && sizeof(D3D12_INDEX_BUFFER_VIEW) == 16, "Buffer views have padding");
+
+    const size_t PAYLOAD_ALIGNMENT = 4;
+
+    size_t AlignPayload(size_t size)
+    {
+        return (size + PAYLOAD_ALIGNMENT - 1) & ~(PAYLOAD_ALIGNMENT - 1);
+    }
+
+    template<typename T>
+    void WriteField(uint8_t* payload, size_t offset, const T& value)
+    {
+        memcpy(payload + offset, &value, sizeof(T));
+    }
+
+    // Only the member of the union that Type selects, the rest stays zero.
+    void WriteCopyLocation(uint8_t* payload, size_t offset, const D3D12_TEXTURE_COPY_LOCATION& location)
+    {
+        WriteField(payload, offset + offsetof(D3D12_TEXTURE_COPY_LOCATION, pResource), location.pResource);
+        WriteField(payload, offset + offsetof(D3D12_TEXTURE_COPY_LOCATION, Type), location.Type);
+        if (location.Type == D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT)
+        {
+            size_t footprint = offset + offsetof(D3D12_TEXTURE_COPY_LOCATION, PlacedFootprint);
+            WriteField(payload, footprint + offsetof(D3D12_PLACED_SUBRESOURCE_FOOTPRINT, Offset), location.PlacedFootprint.Offset);
+            WriteField(payload, footprint + offsetof(D3D12_PLACED_SUBRESOURCE_FOOTPRINT, Footprint), location.PlacedFootprint.Footprint);
+        }
+        else
+        {
+            WriteField(payload, offset + offsetof(D3D12_TEXTURE_COPY_LOCATION, SubresourceIndex), location.SubresourceIndex);
+        }
+    }
+
+    template<typename T>
+    T ReadPayload(const uint8_t* payload)
+    {
+        T value;
+        memcpy(&value, payload, sizeof(T));
+        return value;
+    }
+}
+
+D3D12CommandContext::D3D12CommandContext(ID3D12GraphicsCommandList2* commandList)
+    : _commandList(commandList)
+{
+}
+
+void D3D12CommandContext::SetPipelineState(ID3D12PipelineState* pipelineState)
+{
+    _commandList->SetPipelineState(pipelineState);
+}
+
+void D3D12CommandContext::SetGraphicsRootSignature(ID3D12RootSignature* rootSignature)
+{
+    _commandList->SetGraphicsRootSignature(rootSignature);
+}
+
+void D3D12CommandContext::SetGraphicsRoot32BitConstants(UINT rootParameter, UINT count, const void* data, UINT offset)
+{
+    _commandList->SetGraphicsRoot32BitConstants(rootParameter, count, data, offset);
+}
+
+void D3D12CommandContext::SetGraphicsRootDescriptorTable(UINT rootParameter, D3D12_GPU_DESCRIPTOR_HANDLE baseDescriptor)
+{
+    _commandList->SetGraphicsRootDescriptorTable(rootParameter, baseDescriptor);
+}
+
+void D3D12CommandContext::SetGraphicsRootShaderResourceView(UINT rootParameter, D3D12_GPU_VIRTUAL_ADDRESS address)
+{
+    _commandList->SetGraphicsRootShaderResourceView(rootParameter, address);
+}
+
+void D3D12CommandContext::SetDescriptorHeap(ID3D12DescriptorHeap* heap)
+{
+    _commandList->SetDescriptorHeaps(1, &heap);
+}
+
+void D3D12CommandContext::SetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY topology)
+{
+    _commandList->IASetPrimitiveTopology(topology);
+}
+
+void D3D12CommandContext::SetVertexBuffer(const D3D12_VERTEX_BUFFER_VIEW& view)
+{
+    _commandList->IASetVertexBuffers(0, 1, &view);
+}
+
+void D3D12CommandContext::SetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW& view)
+{
+    _commandList->IASetIndexBuffer(&view);
+}
+
+void D3D12CommandContext::SetViewport(const D3D12_VIEWPORT& viewport)
+{
+    _commandList->RSSetViewports(1, &viewport);
+}
+
+void D3D12CommandContext::SetScissorRect(const D3D12_RECT& rect)
+{
+    _commandList->RSSetScissorRects(1, &rect);
+}
+
+void D3D12CommandContext::SetRenderTarget(D3D12_CPU_DESCRIPTOR_HANDLE renderTarget, D3D12_CPU_DESCRIPTOR_HANDLE depthStencil)
+{
+    _commandList->OMSetRenderTargets(1, &renderTarget, FALSE, &depthStencil);
+}
+
+void D3D12CommandContext::ClearRenderTarget(D3D12_CPU_DESCRIPTOR_HANDLE renderTarget, const float color[4])
+{
+    _commandList->ClearRenderTargetView(renderTarget, color, 0, nullptr);
+}
+
+void D3D12CommandContext::ClearDepth(D3D12_CPU_DESCRIPTOR_HANDLE depthStencil, float depth)
+{
+    _commandList->ClearDepthStencilView(depthStencil, D3D12_CLEAR_FLAG_DEPTH, depth, 0, 0, nullptr);
+}
+
+void D3D12CommandContext::TransitionResource(ID3D12Resource* resource, D3D12_RESOURCE_STATES before, D3D12_RESOURCE_STATES after)
+{
+    CD3DX12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(resource, before, after);
+    _commandList->ResourceBarrier(1, &barrier);
+}
+
+void D3D12CommandContext::DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex, INT baseVertex, UINT startInstance)
+{
+    _commandList->DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+}
+
+void D3D12CommandContext::CopyTextureRegion(const D3D12_TEXTURE_COPY_LOCATION& destination, const D3D12_TEXTURE_COPY_LOCATION& source)
+{
+    _commandList->CopyTextureRegion(&destination, 0, 0, 0, &source, nullptr);
+}
+
+RecordingCommandContext::RecordingCommandContext()
+    : _size(0)
+{
+    Reset();
+}
+
+void RecordingCommandContext::Reset()
+{
+    _size = 0;
+    _commandCount = 0;
+    memset(_commandCounts, 0, sizeof(_commandCounts));
+}
+
+uint8_t* RecordingCommandContext::Append(Command command, size_t size)
+{
+    size_t recordSize = sizeof(Header) + AlignPayload(size);
+    if (_size + recordSize > _stream.size())
+    {
+        _stream.resize(std::max<size_t>(_stream.size() * 2, _size + recordSize));
+    }
+
+    Header header = { command, static_cast<uint16_t>(size) };
+    uint8_t* record = _stream.data() + _size;
+    memcpy(record, &header, sizeof(Header));
+    memset(record + sizeof(Header), 0, recordSize - sizeof(Header));
+    _size += recordSize;
+    _commandCount++;
+    _commandCounts[static_cast<size_t>(command)]++;
+    return record + sizeof(Header);
+}
+
+void RecordingCommandContext::SetPipelineState(ID3D12PipelineState* pipelineState)
+{
+    Write(Command::SetPipelineState, pipelineState);
+}
+
+void RecordingCommandContext::SetGraphicsRootSignature(ID3D12RootSignature* rootSignature)
+{
+    Write(Command::SetGraphicsRootSignature, rootSignature);
+}
+
+void RecordingCommandContext::SetGraphicsRoot32BitConstants(UINT rootParameter, UINT count, const void* data, UINT offset)
+{
+    RootConstants constants = { rootParameter, count, offset };
+    uint8_t* payload = Append(Command::SetGraphicsRoot32BitConstants, sizeof(RootConstants) + count * sizeof(UINT));
+    memcpy(payload, &constants, sizeof(RootConstants));
+    memcpy(payload + sizeof(RootConstants), data, count * sizeof(UINT));
+}
+
+void RecordingCommandContext::SetGraphicsRootDescriptorTable(UINT rootParameter, D3D12_GPU_DESCRIPTOR_HANDLE baseDescriptor)
+{
+    uint8_t* payload = Append(Command::SetGraphicsRootDescriptorTable, sizeof(RootDescriptorTable));
+    WriteField(payload, offsetof(RootDescriptorTable, rootParameter), rootParameter);
+    WriteField(payload, offsetof(RootDescriptorTable, baseDescriptor), baseDescriptor);
+}
+
+void RecordingCommandContext::SetGraphicsRootShaderResourceView(UINT rootParameter, D3D12_GPU_VIRTUAL_ADDRESS address)
+{
+    uint8_t* payload = Append(Command::SetGraphicsRootShaderResourceView, sizeof(RootShaderResourceView));
+    WriteField(payload, offsetof(RootShaderResourceView, rootParameter), rootParameter);
+    WriteField(payload, offsetof(RootShaderResourceView, address), address);
+}
+
+void RecordingCommandContext::SetDescriptorHeap(ID3D12DescriptorHeap* heap)
+{
+    Write(Command::SetDescriptorHeap, heap);
+}
+
+void RecordingCommandContext::SetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY topology)
+{
+    Write(Command::SetPrimitiveTopology, topology);
+}
+
+void RecordingCommandContext::SetVertexBuffer(const D3D12_VERTEX_BUFFER_VIEW& view)
+{
+    Write(Command::SetVertexBuffer, view);
+}
+
+void RecordingCommandContext::SetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW& view)
+{
+    Write(Command::SetIndexBuffer, view);
+}
+
+void RecordingCommandContext::SetViewport(const D3D12_VIEWPORT& viewport)
+{
+    Write(Command::SetViewport, viewport);
+}
+
+void RecordingCommandContext::SetScissorRect(const D3D12_RECT& rect)
+{
+    Write(Command::SetScissorRect, rect);
+}
+
+void RecordingCommandContext::SetRenderTarget(D3D12_CPU_DESCRIPTOR_HANDLE renderTarget, D3D12_CPU_DESCRIPTOR_HANDLE depthStencil)
+{
+    Write(Command::SetRenderTarget, RenderTarget{ renderTarget, depthStencil });
+}
+
+void RecordingCommandContext::ClearRenderTarget(D3D12_CPU_DESCRIPTOR_HANDLE renderTarget, const float color[4])
+{
+    ClearColor clear = { renderTarget, { color[0], color[1], color[2], color[3] } };
+    Write(Command::ClearRenderTarget, clear);
+}
+
+void RecordingCommandContext::ClearDepth(D3D12_CPU_DESCRIPTOR_HANDLE depthStencil, float depth)
+{
+    uint8_t* payload = Append(Command::ClearDepth, sizeof(ClearDepthValue));
+    WriteField(payload, offsetof(ClearDepthValue, depthStencil), depthStencil);
+    WriteField(payload, offsetof(ClearDepthValue, depth), depth);
+}
+
+void RecordingCommandContext::TransitionResource(ID3D12Resource* resource, D3D12_RESOURCE_STATES before, D3D12_RESOURCE_STATES after)
+{
+    Write(Command::TransitionResource, Transition{ resource, before, after });
+}
+
+void RecordingCommandContext::DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex, INT baseVertex, UINT startInstance)
+{
+    Write(Command::DrawIndexedInstanced, Draw{ indexCount, instanceCount, startIndex, baseVertex, startInstance });
+}
+
+void RecordingCommandContext::CopyTextureRegion(const D3D12_TEXTURE_COPY_LOCATION& destination, const D3D12_TEXTURE_COPY_LOCATION& source)
+{
+    uint8_t* payload = Append(Command::CopyTextureRegion, sizeof(TextureCopy));
+    WriteCopyLocation(payload, offsetof(TextureCopy, destination), destination);
+    WriteCopyLocation(payload, offsetof(TextureCopy, source), source);
+}
+
+void RecordingCommandContext::Replay(CommandContext& context) const
+{
+    size_t position = 0;
+    while (position < _size)
+    {
+        Header header;
+        memcpy(&header, _stream.data() + position, sizeof(Header));
+        const uint8_t* payload = _stream.data() + position + sizeof(Header);
+        position += sizeof(Header) + AlignPayload(header.size);
+
+        switch (header.command)
+        {
+        case Command::SetPipelineState:
+            context.SetPipelineState(ReadPayload<ID3D12PipelineState*>(payload));
+            break;
+        case Command::SetGraphicsRootSignature:
+            context.SetGraphicsRootSignature(ReadPayload<ID3D12RootSignature*>(payload));
+            break;
+        case Command::SetGraphicsRoot32BitConstants:
+        {
+            RootConstants constants = ReadPayload<RootConstants>(payload);
+            context.SetGraphicsRoot32BitConstants(constants.rootParameter, constants.count, payload + sizeof(RootConstants), constants.offset);
+            break;
+        }
+        case Command::SetGraphicsRootDescriptorTable:
+        {
+            RootDescriptorTable table = ReadPayload<RootDescriptorTable>(payload);
+            context.SetGraphicsRootDescriptorTable(table.rootParameter, table.baseDescriptor);
+            break;
+        }
+        case Command::SetGraphicsRootShaderResourceView:
+        {
+            RootShaderResourceView view = ReadPayload<RootShaderResourceView>(payload);
+            context.SetGraphicsRootShaderResourceView(view.rootParameter, view.address);
+            break;
+        }
+        case Command::SetDescriptorHeap:
+            context.SetDescriptorHeap(ReadPayload<ID3D12DescriptorHeap*>(payload));
+            break;
+        case Command::SetPrimitiveTopology:
+            context.SetPrimitiveTopology(ReadPayload<D3D12_PRIMITIVE_TOPOLOGY>(payload));
+            break;
+        case Command::SetVertexBuffer:
+            context.SetVertexBuffer(ReadPayload<D3D12_VERTEX_BUFFER_VIEW>(payload));
+            break;
+        case Command::SetIndexBuffer:
+            context.SetIndexBuffer(ReadPayload<D3D12_INDEX_BUFFER_VIEW>(payload));
+            break;
+        case Command::SetViewport:
+            context.SetViewport(ReadPayload<D3D12_VIEWPORT>(payload));
+            break;
+        case Command::SetScissorRect:
+            context.SetScissorRect(ReadPayload<D3D12_RECT>(payload));
+            break;
+        case Command::SetRenderTarget:
+        {
+            RenderTarget target = ReadPayload<RenderTarget>(payload);
+            context.SetRenderTarget(target.renderTarget, target.depthStencil);
+            break;
+        }
+        case Command::ClearRenderTarget:
+        {
+            ClearColor clear = ReadPayload<ClearColor>(payload);
+            context.ClearRenderTarget(clear.renderTarget, clear.color);
+            break;
+        }
+        case Command::ClearDepth:
+        {
+            ClearDepthValue clear = ReadPayload<ClearDepthValue>(payload);
+            context.ClearDepth(clear.depthStencil, clear.depth);
+            break;
+        }
+        case Command::TransitionResource:
+        {
+            Transition transition = ReadPayload<Transition>(payload);
+            context.TransitionResource(transition.resource, transition.before, transition.after);
+            break;
+        }
+        case Command::DrawIndexedInstanced:
+        {
+            Draw draw = ReadPayload<Draw>(payload);
+            context.DrawIndexedInstanced(draw.indexCount, draw.instanceCount, draw.startIndex, draw.baseVertex, draw.startInstance);
+            break;
+        }
+        case Command::CopyTextureRegion:
+        {
+            TextureCopy copy = ReadPayload<TextureCopy>(payload);
+            context.CopyTextureRegion(copy.destination, copy.source);
+            break;
+        }
+        default:
+            throw std::exception("Unknown command in recorded command stream.");
+        }
+    }
+}
\ No newline at end of file
@@ -117,26 +117,35 @@ Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> CommandQueue::GetCommandList(
 // Returns the fence value to wait for for this command list.
 uint64_t CommandQueue::ExecuteCommandList(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList)
 {
-    commandList->Close();
+    return ExecuteCommandLists(&commandList, 1);
+}
 
-    ID3D12CommandAllocator* commandAllocator;
-    UINT dataSize = sizeof(commandAllocator);
-    ThrowIfFailed(commandList->GetPrivateData(__uuidof(ID3D12CommandAllocator), &dataSize, &commandAllocator));
+uint64_t CommandQueue::ExecuteCommandLists(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2>* commandLists, UINT count)
+{
+    std::vector<ID3D12CommandList*> ppCommandLists(count);
+    std::vector<ID3D12CommandAllocator*> commandAllocators(count);
+    for (UINT i = 0; i < count; ++i)
+    {
+        commandLists[i]->Close();
 
-    ID3D12CommandList* const ppCommandLists[] = {
-        commandList.Get()
-    };
+        UINT dataSize = sizeof(commandAllocators[i]);
+        ThrowIfFailed(commandLists[i]->GetPrivateData(__uuidof(ID3D12CommandAllocator), &dataSize, &commandAllocators[i]));
+        ppCommandLists[i] = commandLists[i].Get();
+    }
 
-    _commandQueue->ExecuteCommandLists(1, ppCommandLists);
+    _commandQueue->ExecuteCommandLists(count, ppCommandLists.data());
     uint64_t fenceValue = Signal();
 
-    _commandAllocatorQueue.emplace(CommandAllocatorEntry{ fenceValue, commandAllocator });
-    _commandListQueue.push(commandList);
+    for (UINT i = 0; i < count; ++i)
+    {
+        _commandAllocatorQueue.emplace(CommandAllocatorEntry{ fenceValue, commandAllocators[i] });
+        _commandListQueue.push(commandLists[i]);
 
-    // The ownership of the command allocator has been transferred to the ComPtr
-    // in the command allocator queue. It is safe to release the reference 
-    // in this temporary COM pointer here.
-    commandAllocator->Release();
+        // The ownership of the command allocator has been transferred to the ComPtr
+        // in the command allocator queue. It is safe to release the reference 
+        // in this temporary COM pointer here.
+        commandAllocators[i]->Release();
+    }
 
     return fenceValue;
 }
@@ -0,0 +1,187 @@
+#include "pch.hpp"
+
+#include "culling.hpp"
+
+#include "job_system.hpp"
+#include "frame_allocator.hpp"
+#include "profiler.hpp"
+
+#include <algorithm>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+using namespace DirectX;
+
+namespace
+{
+    // Below this many spheres per worker, threading overhead outweighs the culling work.
+    constexpr UINT MIN_SPHERES_PER_WORKER = 16384;
+
+#if defined(__AVX2__)
+    // For every 8-bit visibility mask, the indices of the set lanes packed to the front.
+    // Lets the vector path compact its output with a single table load and store.
+    struct CompactionTable
+    {
+        alignas(32) uint32_t lanes[256][8];
+
+        CompactionTable()
+        {
+            for (uint32_t mask = 0; mask < 256; ++mask)
+            {
+                uint32_t count = 0;
+                for (uint32_t lane = 0; lane < 8; ++lane)
+                {
+                    if (mask & (1u << lane))
+                    {
+                        lanes[mask][count++] = lane;
+                    }
+                }
+                while (count < 8)
+                {
+                    lanes[mask][count++] = 0;
+                }
+            }
+        }
+    };
+
+    const CompactionTable g_compactionTable;
+
+    // The vector path's distance, rounded once per multiply-add. The scalar loop culls the tail of every
+    // vector call, so a sphere right on a plane has to get the same answer from both.
+    float PlaneDistance(const XMFLOAT4& plane, float x, float y, float z)
+    {
+        __m128 distance = _mm_fmadd_ss(_mm_set_ss(plane.z), _mm_set_ss(z), _mm_set_ss(plane.w));
+        distance = _mm_fmadd_ss(_mm_set_ss(plane.y), _mm_set_ss(y), distance);
+        return _mm_cvtss_f32(_mm_fmadd_ss(_mm_set_ss(plane.x), _mm_set_ss(x), distance));
+    }
+#else
+    float PlaneDistance(const XMFLOAT4& plane, float x, float y, float z)
+    {
+        return plane.x * x + plane.y * y + plane.z * z + plane.w;
+    }
+#endif
+}
+
+Culling::Frustum Culling::ExtractFrustum(FXMMATRIX viewProjection)
+{
+    // Gribb/Hartmann: with row vectors, clip = v * M, so the planes are sums of the matrix columns.
+    XMMATRIX columns = XMMatrixTranspose(viewProjection);
+
+    XMVECTOR planes[6] = {
+        XMVectorAdd(columns.r[3], columns.r[0]),      // left
+        XMVectorSubtract(columns.r[3], columns.r[0]), // right
+        XMVectorAdd(columns.r[3], columns.r[1]),      // bottom
+        XMVectorSubtract(columns.r[3], columns.r[1]), // top
+        columns.r[2],                                 // near (D3D clip space z starts at 0)
+        XMVectorSubtract(columns.r[3], columns.r[2]), // far
+    };
+
+    Frustum frustum;
+    for (int i = 0; i < 6; ++i)
+    {
+        XMStoreFloat4(&frustum.planes[i], XMPlaneNormalize(planes[i]));
+    }
+    return frustum;
+}
+
+UINT Culling::CullSpheresScalar(const Frustum& frustum, const SphereSet& spheres, UINT begin, UINT end, UINT* visible)
+{
+    UINT count = 0;
+    for (UINT i = begin; i < end; ++i)
+    {
+        bool inside = true;
+        for (const XMFLOAT4& plane : frustum.planes)
+        {
+            float distance = PlaneDistance(plane, spheres.centerX[i], spheres.centerY[i], spheres.centerZ[i]);
+            inside &= distance >= -spheres.radius[i];
+        }
+
+        // Always write, only advance when visible: keeps the loop free of unpredictable branches.
+        visible[count] = i;
+        count += inside ? 1 : 0;
+    }
+    return count;
+}
+
+UINT Culling::CullSpheres(const Frustum& frustum, const SphereSet& spheres, UINT begin, UINT end, UINT* visible)
+{
+#if defined(__AVX2__)
+    __m256 planeX[6], planeY[6], planeZ[6], planeW[6];
+    for (int p = 0; p < 6; ++p)
+    {
+        planeX[p] = _mm256_set1_ps(frustum.planes[p].x);
+        planeY[p] = _mm256_set1_ps(frustum.planes[p].y);
+        planeZ[p] = _mm256_set1_ps(frustum.planes[p].z);
+        planeW[p] = _mm256_set1_ps(frustum.planes[p].w);
+    }
+
+    UINT count = 0;
+    UINT i = begin;
+    for (; i + 8 <= end; i += 8)
+    {
+        __m256 x = _mm256_loadu_ps(spheres.centerX + i);
+        __m256 y = _mm256_loadu_ps(spheres.centerY + i);
+        __m256 z = _mm256_loadu_ps(spheres.centerZ + i);
+        __m256 negativeRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(spheres.radius + i));
+
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int p = 0; p < 6; ++p)
+        {
+            __m256 distance = _mm256_fmadd_ps(planeX[p], x, _mm256_fmadd_ps(planeY[p], y, _mm256_fmadd_ps(planeZ[p], z, planeW[p])));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negativeRadius, _CMP_GE_OQ));
+        }
+
+        // Store all eight lanes (visible ones first), then advance by the number that passed.
+        int mask = _mm256_movemask_ps(inside);
+        __m256i lanes = _mm256_load_si256(reinterpret_cast<const __m256i*>(g_compactionTable.lanes[mask]));
+        __m256i indices = _mm256_add_epi32(lanes, _mm256_set1_epi32(static_cast<int>(i)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(visible + count), indices);
+        count += static_cast<UINT>(_mm_popcnt_u32(static_cast<unsigned int>(mask)));
+    }
+
+    return count + CullSpheresScalar(frustum, spheres, i, end, visible + count);
+#else
+    return CullSpheresScalar(frustum, spheres, begin, end, visible);
+#endif
+}
+
+void Culling::CullSpheresParallel(const Frustum& frustum, const SphereSet& spheres, std::vector<UINT>& visible)
+{
+    UINT workerCount = std::min(Jobs::GetThreadCount(), (spheres.count + MIN_SPHERES_PER_WORKER - 1) / MIN_SPHERES_PER_WORKER);
+
+    if (workerCount <= 1)
+    {
+        visible.resize(spheres.count + 8);
+        visible.resize(CullSpheres(frustum, spheres, 0, spheres.count, visible.data()));
+        return;
+    }
+
+    // Chunks are multiples of 8 so only the last one runs a scalar tail. Every chunk writes into
+    // its own region (with slack for the 8-wide stores) and the results get compacted afterwards.
+    UINT chunkSize = ((spheres.count + workerCount - 1) / workerCount + 7) & ~7u;
+    visible.resize(spheres.count + 8 * workerCount);
+
+    FrameVector<UINT> chunkCounts(workerCount, 0);
+    Jobs::ParallelFor(workerCount, 1, [&](UINT firstChunk, UINT endChunk)
+    {
+        PROFILE_ZONE("Cull chunk");
+        for (UINT chunk = firstChunk; chunk < endChunk; ++chunk)
+        {
+            UINT begin = std::min(spheres.count, chunk * chunkSize);
+            UINT end = std::min(spheres.count, begin + chunkSize);
+            chunkCounts[chunk] = CullSpheres(frustum, spheres, begin, end, visible.data() + begin + chunk * 8);
+        }
+    });
+
+    // Every region starts at or after the compacted write position, so moving front to back is safe.
+    UINT total = 0;
+    for (UINT chunk = 0; chunk < workerCount; ++chunk)
+    {
+        UINT source = std::min(spheres.count, chunk * chunkSize) + chunk * 8;
+        memmove(visible.data() + total, visible.data() + source, chunkCounts[chunk] * sizeof(UINT));
+        total += chunkCounts[chunk];
+    }
+    visible.resize(total);
+}
\ No newline at end of file
@@ -1,6 +1,64 @@
 #include "pch.hpp"
 
 #include "dx12_helpers.hpp"
+#include "shader_cache.hpp"
+#include "asset_archive.hpp"
+
+#ifndef _SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING
+#define _SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING
+#endif
+#include <experimental/filesystem>
+
+namespace fs = std::experimental::filesystem;
+
+namespace
+{
+    // Resolves #include like D3D_COMPILE_STANDARD_FILE_INCLUDE (relative to the including file, then
+    // as given), but through Util::ReadAsset() so shaders compile straight out of the asset archive.
+    class AssetInclude : public ID3DInclude
+    {
+    public:
+        explicit AssetInclude(const std::wstring& sourcePath)
+            : _sourceDirectory(fs::path(sourcePath).parent_path())
+        {
+        }
+
+        HRESULT __stdcall Open(D3D_INCLUDE_TYPE, LPCSTR fileName, LPCVOID parentData, LPCVOID* data, UINT* size) override
+        {
+            auto parent = _directories.find(parentData);
+            fs::path directory = parent != _directories.end() ? parent->second : _sourceDirectory;
+
+            fs::path filePath = directory / fileName;
+            auto storage = std::make_unique<std::vector<uint8_t>>();
+            AssetSpan span;
+            if (!Util::ReadAsset(filePath.wstring(), span, *storage))
+            {
+                filePath = fileName;
+                if (!Util::ReadAsset(filePath.wstring(), span, *storage))
+                {
+                    return E_FAIL;
+                }
+            }
+
+            *data = span.data;
+            *size = static_cast<UINT>(span.size);
+            _directories[span.data] = filePath.parent_path();
+            _storage.push_back(std::move(storage));
+            return S_OK;
+        }
+
+        // Everything is released with the handler, after compilation.
+        HRESULT __stdcall Close(LPCVOID) override
+        {
+            return S_OK;
+        }
+
+    private:
+        fs::path _sourceDirectory;
+        std::unordered_map<LPCVOID, fs::path> _directories;
+        std::vector<std::unique_ptr<std::vector<uint8_t>>> _storage;
+    };
+}
 
 void Util::GetHardwareAdapter(
     IDXGIFactory1* pFactory,
@@ -65,4 +123,41 @@ void Util::GetHardwareAdapter(
     }
 
     *ppAdapter = adapter.Detach();
+}
+
+bool Util::CompileShader(
+    const ShaderDesc& desc,
+    const std::string& source,
+    std::vector<uint8_t>& bytecode,
+    std::string& errors)
+{
+    std::vector<D3D_SHADER_MACRO> macros;
+    for (const ShaderDefine& define : desc.defines)
+    {
+        macros.push_back({ define.name.c_str(), define.value.c_str() });
+    }
+    macros.push_back({ nullptr, nullptr });
+
+    // The source name only shows up in error messages, includes resolve against desc.filePath.
+    std::string sourceName(desc.filePath.begin(), desc.filePath.end());
+    AssetInclude includeHandler(desc.filePath);
+
+    Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob;
+    Microsoft::WRL::ComPtr<ID3DBlob> errorBlob;
+    HRESULT hr = D3DCompile(source.data(), source.size(), sourceName.c_str(), macros.data(),
+        &includeHandler, desc.entryPoint.c_str(), desc.profile.c_str(),
+        desc.flags, 0, &shaderBlob, &errorBlob);
+
+    if (errorBlob)
+    {
+        errors.assign(static_cast<const char*>(errorBlob->GetBufferPointer()), errorBlob->GetBufferSize());
+    }
+    if (FAILED(hr))
+    {
+        return false;
+    }
+
+    const uint8_t* data = static_cast<const uint8_t*>(shaderBlob->GetBufferPointer());
+    bytecode.assign(data, data + shaderBlob->GetBufferSize());
+    return true;
 }
\ No newline at end of file
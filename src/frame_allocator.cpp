@@ -0,0 +1,155 @@
+#include "pch.hpp"
+
+#include "frame_allocator.hpp"
+
+#include <algorithm>
+#include <new>
+
+namespace
+{
+    constexpr size_t MIN_BLOCK_SIZE = 64 * 1024;
+
+    std::atomic<uint64_t> g_frame(0);
+    std::atomic<uint64_t> g_heapAllocationCount(0);
+
+    class Arena
+    {
+    public:
+        Arena()
+            : _block(nullptr)
+            , _capacity(0)
+            , _offset(0)
+            , _used(0)
+            , _frame(UINT64_MAX)
+        {
+        }
+
+        ~Arena()
+        {
+            Release();
+        }
+
+        uint64_t GetFrame() const { return _frame; }
+
+        void Rewind(uint64_t frame)
+        {
+            // Overflowing means the block was too small for this workload: replace it by one that fits it all.
+            if (!_retiredBlocks.empty())
+            {
+                size_t capacity = std::max(MIN_BLOCK_SIZE, (_used + MIN_BLOCK_SIZE - 1) & ~(MIN_BLOCK_SIZE - 1));
+                Release();
+                _block = static_cast<uint8_t*>(::operator new(capacity));
+                _capacity = capacity;
+            }
+            _offset = 0;
+            _used = 0;
+            _frame = frame;
+        }
+
+        void* Allocate(size_t size, size_t alignment)
+        {
+            size_t offset = (_offset + alignment - 1) & ~(alignment - 1);
+            if (!_block || offset + size > _capacity)
+            {
+                // Earlier allocations still point into the full block, it stays around until the rewind.
+                if (_block)
+                {
+                    _retiredBlocks.push_back(_block);
+                }
+                _capacity = std::max(std::max(MIN_BLOCK_SIZE, _capacity * 2), size + alignment);
+                _block = static_cast<uint8_t*>(::operator new(_capacity));
+                _offset = 0;
+                offset = ((reinterpret_cast<uintptr_t>(_block) + alignment - 1) & ~(alignment - 1)) - reinterpret_cast<uintptr_t>(_block);
+            }
+
+            _used += offset - _offset + size;
+            _offset = offset + size;
+            return _block + offset;
+        }
+
+    private:
+        uint8_t* _block;
+        size_t _capacity;
+        size_t _offset;
+        size_t _used; // over all blocks this frame, sizes the block after the rewind
+        uint64_t _frame;
+        std::vector<uint8_t*> _retiredBlocks;
+
+        void Release()
+        {
+            for (uint8_t* block : _retiredBlocks)
+            {
+                ::operator delete(block);
+            }
+            _retiredBlocks.clear();
+            ::operator delete(_block);
+            _block = nullptr;
+            _capacity = 0;
+        }
+    };
+
+    thread_local Arena t_arenas[FRAME_COUNT];
+}
+
+void FrameMemory::BeginFrame()
+{
+    g_frame.fetch_add(1, std::memory_order_relaxed);
+}
+
+void* FrameMemory::Allocate(size_t size, size_t alignment)
+{
+    uint64_t frame = g_frame.load(std::memory_order_relaxed);
+    Arena& arena = t_arenas[frame % FRAME_COUNT];
+    if (arena.GetFrame() != frame)
+    {
+        arena.Rewind(frame);
+    }
+    return arena.Allocate(size, alignment);
+}
+
+uint64_t Util::GetHeapAllocationCount()
+{
+    return g_heapAllocationCount.load(std::memory_order_relaxed);
+}
+
+bool Util::IsCountingHeapAllocations()
+{
+#ifdef COUNT_HEAP_ALLOCATIONS
+    return true;
+#else
+    return false;
+#endif
+}
+
+#ifdef COUNT_HEAP_ALLOCATIONS
+// Counting replacements of the global allocation functions. The array and nothrow versions
+// forward to these, over-aligned types keep the library's versions.
+void* operator new(size_t size)
+{
+    g_heapAllocationCount.fetch_add(1, std::memory_order_relaxed);
+    while (true)
+    {
+        if (void* memory = malloc(size > 0 ? size : 1))
+        {
+            return memory;
+        }
+
+        std::new_handler handler = std::get_new_handler();
+        if (!handler)
+        {
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+}
+
+void operator delete(void* memory) noexcept
+{
+    free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+    free(memory);
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,236 @@
+#include "pch.hpp"
+
+#include "frame_capture.hpp"
+
+#include "dx12_helpers.hpp"
+#include "command_context.hpp"
+#include "command_queue.hpp"
+#include "profiler.hpp"
+
+#ifndef _SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING
+#define _SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING
+#endif
+#include <experimental/filesystem>
+#include <algorithm>
+#include <chrono>
+
+namespace fs = std::experimental::filesystem;
+
+using namespace Microsoft::WRL;
+
+FrameCapture::FrameCapture(ComPtr<ID3D12Device2>& device, UINT width, UINT height, DXGI_FORMAT format)
+    : _nextSlot(0)
+    , _recordedSlot(RING_SIZE)
+    , _recording(false)
+    , _recordedFrameCount(0)
+    , _capturedCount(0)
+    , _failedCount(0)
+    , _encodeMicroseconds(0)
+    , _droppedCount(0)
+{
+    // Rows of the copy are padded to D3D12_TEXTURE_DATA_PITCH_ALIGNMENT, the footprint says by how much.
+    CD3DX12_RESOURCE_DESC textureDesc = CD3DX12_RESOURCE_DESC::Tex2D(format, width, height, 1, 1);
+    UINT64 totalBytes = 0;
+    device->GetCopyableFootprints(&textureDesc, 0, 1, 0, &_footprint, nullptr, nullptr, &totalBytes);
+
+    CD3DX12_HEAP_PROPERTIES heapProps(D3D12_HEAP_TYPE_READBACK);
+    CD3DX12_RESOURCE_DESC bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(totalBytes);
+    for (Slot& slot : _slots)
+    {
+        Util::ThrowIfFailed(device->CreateCommittedResource(
+            &heapProps,
+            D3D12_HEAP_FLAG_NONE,
+            &bufferDesc,
+            D3D12_RESOURCE_STATE_COPY_DEST,
+            nullptr,
+            IID_PPV_ARGS(&slot.buffer)));
+        slot.state = SlotState::Free;
+        slot.fenceValue = 0;
+    }
+}
+
+FrameCapture::~FrameCapture()
+{
+    WaitForEncodes();
+}
+
+void FrameCapture::Request(const std::wstring& filePath)
+{
+    _requestedPath = filePath;
+}
+
+void FrameCapture::StartRecording(const std::wstring& directory, const std::wstring& extension)
+{
+    fs::create_directories(fs::path(directory));
+    _recordingDirectory = directory;
+    _recordingExtension = extension;
+    _recordedFrameCount = 0;
+    _recording = true;
+}
+
+void FrameCapture::StopRecording()
+{
+    _recording = false;
+}
+
+bool FrameCapture::AcquireSlot(UINT& slot)
+{
+    // Slots are used round robin, so the oldest copy is the next one to become free.
+    if (_slots[_nextSlot].state.load(std::memory_order_acquire) != SlotState::Free)
+    {
+        return false;
+    }
+    slot = _nextSlot;
+    _nextSlot = (_nextSlot + 1) % RING_SIZE;
+    return true;
+}
+
+void FrameCapture::RecordCopy(CommandContext& context, ID3D12Resource* backBuffer, D3D12_RESOURCE_STATES state)
+{
+    if (_requestedPath.empty() && !_recording)
+    {
+        return;
+    }
+
+    UINT slot;
+    if (!AcquireSlot(slot))
+    {
+        // A single capture just goes into a later frame, a recording can't wait.
+        if (_recording)
+        {
+            _droppedCount++;
+        }
+        return;
+    }
+
+    if (!_requestedPath.empty())
+    {
+        _slots[slot].filePath.swap(_requestedPath);
+        _requestedPath.clear();
+    }
+    else
+    {
+        wchar_t fileName[32];
+        swprintf(fileName, _countof(fileName), L"frame_%06u", _recordedFrameCount++);
+        _slots[slot].filePath = (fs::path(_recordingDirectory) / fileName).wstring() + _recordingExtension;
+    }
+
+    D3D12_TEXTURE_COPY_LOCATION destination = {};
+    destination.pResource = _slots[slot].buffer.Get();
+    destination.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
+    destination.PlacedFootprint = _footprint;
+
+    D3D12_TEXTURE_COPY_LOCATION source = {};
+    source.pResource = backBuffer;
+    source.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
+    source.SubresourceIndex = 0;
+
+    context.TransitionResource(backBuffer, state, D3D12_RESOURCE_STATE_COPY_SOURCE);
+    context.CopyTextureRegion(destination, source);
+    context.TransitionResource(backBuffer, D3D12_RESOURCE_STATE_COPY_SOURCE, state);
+
+    _slots[slot].state.store(SlotState::Copying, std::memory_order_relaxed);
+    _recordedSlot = slot;
+}
+
+void FrameCapture::Submitted(uint64_t fenceValue)
+{
+    if (_recordedSlot != RING_SIZE)
+    {
+        _slots[_recordedSlot].fenceValue = fenceValue;
+        _recordedSlot = RING_SIZE;
+    }
+}
+
+void FrameCapture::Update(CommandQueue& queue)
+{
+    for (UINT index = 0; index < RING_SIZE; ++index)
+    {
+        Slot& slot = _slots[index];
+        if (slot.state.load(std::memory_order_relaxed) != SlotState::Copying || index == _recordedSlot ||
+            !queue.IsFenceComplete(slot.fenceValue))
+        {
+            continue;
+        }
+
+        slot.state.store(SlotState::Encoding, std::memory_order_relaxed);
+        Jobs::Run([this, &slot]()
+        {
+            PROFILE_ZONE("FrameCapture::Encode");
+            auto start = std::chrono::high_resolution_clock::now();
+
+            // Only the range that is read gets invalidated, nothing is written back.
+            uint8_t* data = nullptr;
+            D3D12_RANGE readRange = { 0, static_cast<SIZE_T>(_footprint.Offset +
+                static_cast<UINT64>(_footprint.Footprint.RowPitch) * _footprint.Footprint.Height) };
+            bool encoded = SUCCEEDED(slot.buffer->Map(0, &readRange, reinterpret_cast<void**>(&data)));
+            if (encoded)
+            {
+                encoded = EncodeReadback(data, _footprint, slot.filePath);
+                D3D12_RANGE writtenRange = { 0, 0 };
+                slot.buffer->Unmap(0, &writtenRange);
+            }
+
+            std::chrono::duration<double, std::micro> elapsed = std::chrono::high_resolution_clock::now() - start;
+            _encodeMicroseconds.fetch_add(static_cast<uint64_t>(elapsed.count()), std::memory_order_relaxed);
+            (encoded ? _capturedCount : _failedCount).fetch_add(1, std::memory_order_relaxed);
+            slot.state.store(SlotState::Free, std::memory_order_release);
+        }, &_encodes);
+    }
+}
+
+void FrameCapture::WaitForEncodes()
+{
+    Jobs::Wait(_encodes);
+}
+
+void FrameCapture::Report(FILE* file) const
+{
+    UINT captured = _capturedCount.load();
+    if (captured == 0 && _failedCount.load() == 0 && _droppedCount == 0)
+    {
+        return;
+    }
+    fprintf(file, "Frame capture: %u written, %u failed, %u dropped, %.2f ms per encode\n", captured, _failedCount.load(), _droppedCount,
+        captured > 0 ? _encodeMicroseconds.load() / 1000.0 / captured : 0.0);
+}
+
+bool FrameCapture::EncodeReadback(const uint8_t* data, const D3D12_PLACED_SUBRESOURCE_FOOTPRINT& footprint, const std::wstring& filePath)
+{
+    DirectX::ScratchImage image;
+    if (FAILED(image.Initialize2D(footprint.Footprint.Format, footprint.Footprint.Width, footprint.Footprint.Height, 1, 1)))
+    {
+        return false;
+    }
+
+    // DirectXTex rows are packed, the readback rows are padded.
+    const DirectX::Image& target = *image.GetImage(0, 0, 0);
+    const uint8_t* source = data + footprint.Offset;
+    for (size_t row = 0; row < target.height; ++row)
+    {
+        memcpy(target.pixels + row * target.rowPitch, source + row * footprint.Footprint.RowPitch, target.rowPitch);
+    }
+    return Encode(target, filePath);
+}
+
+bool FrameCapture::Encode(const DirectX::Image& image, const std::wstring& filePath)
+{
+    std::wstring extension = fs::path(filePath).extension().wstring();
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::towlower);
+
+    if (extension == L".tga")
+    {
+        return SUCCEEDED(DirectX::SaveToTGAFile(image, filePath.c_str()));
+    }
+    if (extension == L".hdr")
+    {
+        // Radiance files are float RGB, DirectXTex drops the alpha.
+        DirectX::ScratchImage converted;
+        if (FAILED(DirectX::Convert(image, DXGI_FORMAT_R32G32B32A32_FLOAT, DirectX::TEX_FILTER_DEFAULT, DirectX::TEX_THRESHOLD_DEFAULT, converted)))
+        {
+            return false;
+        }
+        return SUCCEEDED(DirectX::SaveToHDRFile(*converted.GetImage(0, 0, 0), filePath.c_str()));
+    }
+    return SUCCEEDED(DirectX::SaveToDDSFile(image, DirectX::DDS_FLAGS_NONE, filePath.c_str()));
+}
\ No newline at end of file
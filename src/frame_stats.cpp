@@ -0,0 +1,131 @@
+#include "pch.hpp"
+
+#include "frame_stats.hpp"
+
+#ifndef _SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING
+#define _SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING
+#endif
+#include <experimental/filesystem>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+namespace fs = std::experimental::filesystem;
+
+namespace
+{
+    // Nearest rank on sorted values: the smallest value at or above the given share of the frames.
+    double Percentile(const std::vector<double>& sorted, double percent)
+    {
+        size_t rank = static_cast<size_t>(std::ceil(percent / 100.0 * sorted.size()));
+        return sorted[std::min(std::max<size_t>(rank, 1), sorted.size()) - 1];
+    }
+
+    void WriteSummary(std::ofstream& file, const FrameStats::Summary& summary)
+    {
+        char line[256];
+        snprintf(line, sizeof(line), "{ \"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f }",
+            summary.mean, summary.p50, summary.p95, summary.p99, summary.max);
+        file << line;
+    }
+}
+
+FrameStats::FrameStats(const std::vector<std::string>& stageNames, UINT expectedFrameCount)
+    : _stageNames(stageNames)
+    , _stageMilliseconds(stageNames.size())
+{
+    for (std::vector<double>& stage : _stageMilliseconds)
+    {
+        stage.reserve(expectedFrameCount);
+    }
+    _frameMilliseconds.reserve(expectedFrameCount);
+}
+
+void FrameStats::AddFrame(const double* stageMilliseconds, double frameMilliseconds)
+{
+    for (size_t stage = 0; stage < _stageMilliseconds.size(); ++stage)
+    {
+        _stageMilliseconds[stage].push_back(stageMilliseconds[stage]);
+    }
+    _frameMilliseconds.push_back(frameMilliseconds);
+}
+
+FrameStats::Summary FrameStats::SummarizeFrames() const
+{
+    return Summarize(_frameMilliseconds);
+}
+
+FrameStats::Summary FrameStats::SummarizeStage(UINT stage) const
+{
+    return Summarize(_stageMilliseconds[stage]);
+}
+
+FrameStats::Summary FrameStats::Summarize(std::vector<double> milliseconds)
+{
+    Summary summary;
+    if (milliseconds.empty())
+    {
+        return summary;
+    }
+
+    std::sort(milliseconds.begin(), milliseconds.end());
+    double total = 0.0;
+    for (double value : milliseconds)
+    {
+        total += value;
+    }
+    summary.mean = total / milliseconds.size();
+    summary.p50 = Percentile(milliseconds, 50.0);
+    summary.p95 = Percentile(milliseconds, 95.0);
+    summary.p99 = Percentile(milliseconds, 99.0);
+    summary.max = milliseconds.back();
+    return summary;
+}
+
+void FrameStats::Report(FILE* file) const
+{
+    fprintf(file, "%u frames, milliseconds\n", GetFrameCount());
+    fprintf(file, "%28s %10s %10s %10s %10s %10s\n", "", "mean", "p50", "p95", "p99", "max");
+
+    auto print = [file](const char* name, const Summary& summary)
+    {
+        fprintf(file, "%28s %10.4f %10.4f %10.4f %10.4f %10.4f\n", name, summary.mean, summary.p50, summary.p95, summary.p99, summary.max);
+    };
+    for (UINT stage = 0; stage < _stageNames.size(); ++stage)
+    {
+        print(_stageNames[stage].c_str(), SummarizeStage(stage));
+    }
+    print("frame", SummarizeFrames());
+}
+
+bool FrameStats::WriteJson(const std::wstring& filePath, const std::string& scenario) const
+{
+    // Same as the caches: write a temporary and rename, whatever reads the stats never sees half a file.
+    fs::path tempPath(filePath);
+    tempPath += L".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::trunc);
+        if (!file)
+        {
+            return false;
+        }
+
+        file << "{\n  \"scenario\": \"" << scenario << "\",\n  \"frames\": " << GetFrameCount() << ",\n  \"frame\": ";
+        WriteSummary(file, SummarizeFrames());
+        file << ",\n  \"stages\": {";
+        for (UINT stage = 0; stage < _stageNames.size(); ++stage)
+        {
+            file << (stage == 0 ? "\n" : ",\n") << "    \"" << _stageNames[stage] << "\": ";
+            WriteSummary(file, SummarizeStage(stage));
+        }
+        file << "\n  }\n}\n";
+        if (!file)
+        {
+            return false;
+        }
+    }
+
+    std::error_code error;
+    fs::rename(tempPath, fs::path(filePath), error);
+    return !error;
+}
\ No newline at end of file
@@ -0,0 +1,165 @@
+#include "pch.hpp"
+
+#include "geometry_scene.hpp"
+
+#include "resource_util.hpp"
+#include "camera.hpp"
+#include "instance_transforms.hpp"
+#include "culling.hpp"
+#include "transform_hierarchy.hpp"
+#include "frame_allocator.hpp"
+#include "command_context.hpp"
+
+#include <algorithm>
+
+using namespace Util;
+
+GeometryScene::GeometryScene()
+    : _nearestVisibleDepth(0.0f)
+    , _root(0)
+{
+    _hierarchy = std::make_unique<TransformHierarchy>();
+    _root = _hierarchy->AddNode(TransformHierarchy::INVALID_NODE, XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f), 1.0f);
+    _hierarchy->SortByDepth();
+
+    _instances = std::make_unique<InstanceTransforms>();
+    _instances->SetRotationAxis(XMVectorSet(0, 1, 1, 0));
+}
+
+GeometryScene::~GeometryScene()
+{
+}
+
+void GeometryScene::CreateMesh(MeshData& mesh)
+{
+    // Meshes loaded with LoadMesh() come out of the same optimization path as the generated cube.
+    std::vector<uint16_t> cubeIndices;
+    CreateCube(mesh.vertices, cubeIndices, 1.0f);
+    mesh.indices.assign(cubeIndices.begin(), cubeIndices.end());
+    OptimizeMesh(mesh);
+
+    // All levels share the vertex buffer and go back to back into the index buffer.
+    // The cube is all UV seams and hard edges, so its chain ends at the full mesh.
+    LodChain lodChain;
+    GenerateLodChain(mesh, lodChain);
+    _lods = lodChain.lods;
+    _lodInstanceCounts.assign(_lods.size(), 0);
+    mesh.indices.swap(lodChain.indices);
+}
+
+void GeometryScene::CreateInstances(UINT gridSize)
+{
+    const int size = static_cast<int>(gridSize);
+    const float spacing = 2.0f;
+    const XMFLOAT4 identity(0.0f, 0.0f, 0.0f, 1.0f);
+    _instances->Clear();
+
+    // The cubes are placed through the scene graph: moving a layer node moves every cube in it.
+    // The grid isn't below the root, the shader already applies the root's matrix on top.
+    _hierarchy = std::make_unique<TransformHierarchy>();
+    _root = _hierarchy->AddNode(TransformHierarchy::INVALID_NODE, XMFLOAT3(0.0f, 0.0f, 0.0f), identity, 1.0f);
+    UINT grid = _hierarchy->AddNode(TransformHierarchy::INVALID_NODE, XMFLOAT3(0.0f, 0.0f, 10.0f), identity, 1.0f);
+    _nodeInstances.assign(2, TransformHierarchy::INVALID_NODE);
+    for (int z = 0; z < size; ++z)
+    {
+        UINT layer = _hierarchy->AddNode(grid, XMFLOAT3(0.0f, 0.0f, z * spacing), identity, 1.0f);
+        _nodeInstances.push_back(TransformHierarchy::INVALID_NODE);
+        for (int y = 0; y < size; ++y)
+        {
+            for (int x = 0; x < size; ++x)
+            {
+                XMFLOAT3 offset((x - size / 2) * spacing, (y - size / 2) * spacing, 0.0f);
+                _hierarchy->AddNode(layer, offset, identity, 1.0f);
+
+                // The position is set from the node's world matrix on the first update.
+                float phase = static_cast<float>(x + y + z) * 0.3f;
+                _nodeInstances.push_back(_instances->Add(XMFLOAT3(0.0f, 0.0f, 0.0f), 1.0f, phase, XMConvertToRadians(90.0f)));
+            }
+        }
+    }
+    _hierarchy->SortByDepth();
+}
+
+UINT GeometryScene::GetInstanceCount() const
+{
+    return _instances->GetCount();
+}
+
+void GeometryScene::Update(float deltaTime, Camera& camera, float aspectRatio, UINT viewportHeight, XMFLOAT4X4* instanceData)
+{
+    // The model matrix comes from the scene root. The instances take their position from their node,
+    // only the nodes below something that moved are recomputed and copied over. The spin is their own.
+    _hierarchy->Update();
+    for (UINT node : _hierarchy->GetUpdatedNodes())
+    {
+        UINT instance = _nodeInstances[node];
+        if (instance != TransformHierarchy::INVALID_NODE)
+        {
+            const XMFLOAT4X4& world = _hierarchy->GetWorld(node);
+            _instances->SetPosition(instance, XMFLOAT3(world._41, world._42, world._43));
+        }
+    }
+    camera.model = XMLoadFloat4x4(&_hierarchy->GetWorld(_root));
+    _instances->Update(deltaTime);
+
+    // Update the view matrix.
+    camera.view = XMMatrixLookAtLH(camera.position, camera.position + camera.front, camera.up);
+
+    // Update the projection matrix.
+    camera.projection = XMMatrixPerspectiveFovLH(XMConvertToRadians(camera.fov), aspectRatio, 0.1f, 100.0f);
+
+    // Cull against the same matrix the vertex shader uses, so the spheres stay in instance space.
+    XMMATRIX viewProjectionMatrix = XMMatrixMultiply(XMMatrixMultiply(camera.model, camera.view), camera.projection);
+    Culling::SphereSet spheres = _instances->GetBoundingSpheres();
+    Culling::CullSpheresParallel(Culling::ExtractFrustum(viewProjectionMatrix), spheres, _visibleInstances);
+
+    // Select a LOD per visible instance from its view depth. The instances aren't scaled,
+    // so the chain's mesh space errors are world space errors as well.
+    XMFLOAT4X4 modelView;
+    XMStoreFloat4x4(&modelView, XMMatrixMultiply(camera.model, camera.view));
+    const float projectionScale = XMVectorGetY(camera.projection.r[1]) * viewportHeight * 0.5f;
+
+    _visibleInstanceLods.resize(_visibleInstances.size());
+    std::fill(_lodInstanceCounts.begin(), _lodInstanceCounts.end(), 0);
+    _nearestVisibleDepth = FLT_MAX;
+    for (size_t i = 0; i < _visibleInstances.size(); ++i)
+    {
+        UINT instance = _visibleInstances[i];
+        float viewDepth = spheres.centerX[instance] * modelView._13 + spheres.centerY[instance] * modelView._23 +
+            spheres.centerZ[instance] * modelView._33 + modelView._43;
+        _nearestVisibleDepth = std::min(_nearestVisibleDepth, viewDepth);
+        UINT level = SelectLod(_lods, viewDepth, projectionScale);
+        _visibleInstanceLods[i] = level;
+        _lodInstanceCounts[level]++;
+    }
+
+    // Gather the visible world matrices, grouped by LOD.
+    FrameVector<UINT> lodOffsets(_lods.size(), 0);
+    for (size_t level = 1; level < _lods.size(); ++level)
+    {
+        lodOffsets[level] = lodOffsets[level - 1] + _lodInstanceCounts[level - 1];
+    }
+
+    const XMFLOAT4X4* worldMatrices = _instances->GetWorldMatrices();
+    for (size_t i = 0; i < _visibleInstances.size(); ++i)
+    {
+        instanceData[lodOffsets[_visibleInstanceLods[i]]++] = worldMatrices[_visibleInstances[i]];
+    }
+}
+
+void GeometryScene::RecordDraws(CommandContext& context, UINT instanceRootParameter, D3D12_GPU_VIRTUAL_ADDRESS instanceData) const
+{
+    UINT firstInstance = 0;
+    for (size_t level = 0; level < _lods.size(); ++level)
+    {
+        UINT instanceCount = _lodInstanceCounts[level];
+        if (instanceCount == 0)
+        {
+            continue;
+        }
+
+        context.SetGraphicsRootShaderResourceView(instanceRootParameter, instanceData + static_cast<UINT64>(firstInstance) * sizeof(XMFLOAT4X4));
+        context.DrawIndexedInstanced(_lods[level].indexCount, instanceCount, _lods[level].indexOffset, 0, 0);
+        firstInstance += instanceCount;
+    }
+}
\ No newline at end of file
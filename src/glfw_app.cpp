@@ -30,7 +30,7 @@ static void OnResizeFrame(GLFWwindow* window, int width, int height)
 	// TODO: implement
 }
 
-Application::Application(UINT width, UINT height, std::string name) :
+Application::Application(UINT width, UINT height, std::string name, bool visible) :
 	_width(width),
 	_height(height),
 	_name(name)
@@ -49,6 +49,7 @@ Application::Application(UINT width, UINT height, std::string name) :
 	// set window hints
 	glfwWindowHint(GLFW_DOUBLEBUFFER, GLFW_TRUE); // we prefer double buffering
 	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API); // since we're only working with DX12, no context is needed
+	glfwWindowHint(GLFW_VISIBLE, visible ? GLFW_TRUE : GLFW_FALSE);
 
 	// create window according to preference
 #ifdef FULL_SCREEN
@@ -0,0 +1,151 @@
+#include "pch.hpp"
+
+#include "instance_transforms.hpp"
+
+using namespace DirectX;
+
+InstanceTransforms::InstanceTransforms()
+    : _count(0)
+    , _rotationAxis(0.0f, 0.70710678f, 0.70710678f)
+    , _localBoundingRadius(0.8660254f)
+{
+
+}
+
+InstanceTransforms::~InstanceTransforms()
+{
+
+}
+
+UINT InstanceTransforms::Add(const XMFLOAT3& position, float scale, float angle, float angularVelocity)
+{
+    // Grow in blocks of four, the unused lanes stay zeroed and are simply computed along.
+    if (_count % 4 == 0)
+    {
+        size_t paddedCount = _count + 4;
+        _positionX.resize(paddedCount, 0.0f);
+        _positionY.resize(paddedCount, 0.0f);
+        _positionZ.resize(paddedCount, 0.0f);
+        _scale.resize(paddedCount, 0.0f);
+        _boundingRadius.resize(paddedCount, 0.0f);
+        _angle.resize(paddedCount, 0.0f);
+        _angularVelocity.resize(paddedCount, 0.0f);
+        _worldMatrices.resize(paddedCount);
+    }
+
+    UINT index = _count++;
+    _positionX[index] = position.x;
+    _positionY[index] = position.y;
+    _positionZ[index] = position.z;
+    _scale[index] = scale;
+    _boundingRadius[index] = scale * _localBoundingRadius;
+    _angle[index] = angle;
+    _angularVelocity[index] = angularVelocity;
+
+    return index;
+}
+
+void InstanceTransforms::Clear()
+{
+    _count = 0;
+    _positionX.clear();
+    _positionY.clear();
+    _positionZ.clear();
+    _scale.clear();
+    _boundingRadius.clear();
+    _angle.clear();
+    _angularVelocity.clear();
+    _worldMatrices.clear();
+}
+
+void InstanceTransforms::SetPosition(UINT instance, const XMFLOAT3& position)
+{
+    _positionX[instance] = position.x;
+    _positionY[instance] = position.y;
+    _positionZ[instance] = position.z;
+}
+
+Culling::SphereSet InstanceTransforms::GetBoundingSpheres() const
+{
+    // Spinning around the center doesn't move a bounding sphere, so the positions double as centers.
+    return { _positionX.data(), _positionY.data(), _positionZ.data(), _boundingRadius.data(), _count };
+}
+
+void InstanceTransforms::SetRotationAxis(FXMVECTOR axis)
+{
+    XMStoreFloat3(&_rotationAxis, XMVector3Normalize(axis));
+}
+
+void InstanceTransforms::Update(float deltaTime)
+{
+    // For a fixed unit axis a, every element of the rotation matrix is linear in sin and cos:
+    //   R[i][j] = a[i]a[j] + cos * (delta(i,j) - a[i]a[j]) + sin * E[i][j]
+    // (same layout as XMMatrixRotationNormal), so the per-element constants are computed once
+    // and each lane of a register holds the same element for four different instances.
+    const float a[3] = { _rotationAxis.x, _rotationAxis.y, _rotationAxis.z };
+    const float e[3][3] = {
+        { 0.0f,  a[2], -a[1] },
+        { -a[2], 0.0f,  a[0] },
+        { a[1], -a[0],  0.0f },
+    };
+
+    XMVECTOR constantTerm[3][3];
+    XMVECTOR cosTerm[3][3];
+    XMVECTOR sinTerm[3][3];
+    for (int i = 0; i < 3; ++i)
+    {
+        for (int j = 0; j < 3; ++j)
+        {
+            constantTerm[i][j] = XMVectorReplicate(a[i] * a[j]);
+            cosTerm[i][j] = XMVectorReplicate((i == j ? 1.0f : 0.0f) - a[i] * a[j]);
+            sinTerm[i][j] = XMVectorReplicate(e[i][j]);
+        }
+    }
+
+    const XMVECTOR time = XMVectorReplicate(deltaTime);
+    const XMVECTOR zero = XMVectorZero();
+    const XMVECTOR one = XMVectorSplatOne();
+
+    for (UINT i = 0; i < _count; i += 4)
+    {
+        XMVECTOR angle = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&_angle[i]));
+        XMVECTOR angularVelocity = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&_angularVelocity[i]));
+
+        // Wrap to [-pi, pi) so the sin/cos approximation stays accurate over long runs.
+        angle = XMVectorModAngles(XMVectorMultiplyAdd(angularVelocity, time, angle));
+        XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&_angle[i]), angle);
+
+        XMVECTOR sin, cos;
+        XMVectorSinCos(&sin, &cos, angle);
+        XMVECTOR scale = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&_scale[i]));
+
+        XMVECTOR m[3][3];
+        for (int r = 0; r < 3; ++r)
+        {
+            for (int c = 0; c < 3; ++c)
+            {
+                m[r][c] = XMVectorMultiplyAdd(cos, cosTerm[r][c], XMVectorMultiplyAdd(sin, sinTerm[r][c], constantTerm[r][c]));
+                m[r][c] = XMVectorMultiply(m[r][c], scale);
+            }
+        }
+
+        XMVECTOR positionX = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&_positionX[i]));
+        XMVECTOR positionY = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&_positionY[i]));
+        XMVECTOR positionZ = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&_positionZ[i]));
+
+        // Transposing a register of "element per instance" gives "row per instance" (AoS) again.
+        XMMATRIX row0 = XMMatrixTranspose(XMMATRIX(m[0][0], m[0][1], m[0][2], zero));
+        XMMATRIX row1 = XMMatrixTranspose(XMMATRIX(m[1][0], m[1][1], m[1][2], zero));
+        XMMATRIX row2 = XMMatrixTranspose(XMMATRIX(m[2][0], m[2][1], m[2][2], zero));
+        XMMATRIX row3 = XMMatrixTranspose(XMMATRIX(positionX, positionY, positionZ, one));
+
+        for (UINT k = 0; k < 4; ++k)
+        {
+            XMFLOAT4X4& world = _worldMatrices[i + k];
+            XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&world._11), row0.r[k]);
+            XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&world._21), row1.r[k]);
+            XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&world._31), row2.r[k]);
+            XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&world._41), row3.r[k]);
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,242 @@
+#include "pch.hpp"
+
+#include "job_system.hpp"
+
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <deque>
+
+namespace Jobs
+{
+    struct Job
+    {
+        std::function<void()> function;
+        Counter* counter;
+    };
+
+    class Scheduler
+    {
+    public:
+        Scheduler();
+
+        void Push(Job&& job);
+        // With a counter, only jobs started with it are taken.
+        bool TryPop(Job& job, const Counter* counter = nullptr);
+        void Execute(Job& job);
+
+        UINT GetThreadCount() const { return static_cast<UINT>(_threads.size()) + 1; }
+
+        static void AddPending(Counter& counter) { counter._pending.fetch_add(1, std::memory_order_relaxed); }
+
+    private:
+        // A plain lock per deque: the owner and a thief only meet when the deque is nearly empty,
+        // so it is hardly ever contended and keeps std::function jobs simple to move around.
+        struct WorkerQueue
+        {
+            std::mutex mutex;
+            std::deque<Job> jobs;
+        };
+
+        // One per worker plus a last one shared by the threads outside the pool.
+        std::vector<std::unique_ptr<WorkerQueue>> _queues;
+        std::vector<std::thread> _threads;
+
+        // Counted before the job is in a deque, so a worker going to sleep can't miss it.
+        std::atomic<int> _queuedCount;
+        std::atomic<int> _sleepingCount;
+        std::mutex _sleepMutex;
+        std::condition_variable _wake;
+
+        void WorkerLoop(UINT index);
+    };
+
+    namespace
+    {
+        // Deque of the calling thread, threads outside the pool use the shared one.
+        thread_local UINT t_queueIndex = UINT_MAX;
+
+        // Never destroyed: objects with static lifetime (the renderer in main.cpp) can still wait on
+        // jobs while statics are torn down, the workers end with the process.
+        Scheduler& GetScheduler()
+        {
+            static Scheduler* scheduler = new Scheduler();
+            return *scheduler;
+        }
+
+        void SplitRange(UINT begin, UINT end, UINT grainSize, const std::function<void(UINT, UINT)>& function, Counter& counter)
+        {
+            // Hand off the upper half and keep splitting the lower one, the children join the same counter.
+            while (end - begin > grainSize)
+            {
+                UINT middle = begin + (end - begin) / 2;
+                Run([middle, end, grainSize, &function, &counter]() { SplitRange(middle, end, grainSize, function, counter); }, &counter);
+                end = middle;
+            }
+            function(begin, end);
+        }
+    }
+}
+
+Jobs::Scheduler::Scheduler()
+    : _queuedCount(0)
+    , _sleepingCount(0)
+{
+    UINT workerCount = std::max(1u, std::thread::hardware_concurrency()) - 1;
+    workerCount = std::max(workerCount, 1u);
+
+    for (UINT i = 0; i <= workerCount; ++i)
+    {
+        _queues.push_back(std::make_unique<WorkerQueue>());
+    }
+    for (UINT i = 0; i < workerCount; ++i)
+    {
+        _threads.emplace_back(&Scheduler::WorkerLoop, this, i);
+    }
+}
+
+void Jobs::Scheduler::Push(Job&& job)
+{
+    UINT index = std::min<UINT>(t_queueIndex, static_cast<UINT>(_queues.size() - 1));
+
+    _queuedCount.fetch_add(1);
+    {
+        std::lock_guard<std::mutex> lock(_queues[index]->mutex);
+        _queues[index]->jobs.push_back(std::move(job));
+    }
+
+    // Taking the lock orders the notify after a sleeper's check of _queuedCount.
+    if (_sleepingCount.load() > 0)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_sleepMutex);
+        }
+        _wake.notify_one();
+    }
+}
+
+bool Jobs::Scheduler::TryPop(Job& job, const Counter* counter)
+{
+    const UINT queueCount = static_cast<UINT>(_queues.size());
+    const UINT own = std::min(t_queueIndex, queueCount - 1);
+    auto matches = [counter](const Job& queued) { return !counter || queued.counter == counter; };
+
+    // Newest from the own deque, then the oldest from everybody else's. Without a counter that's
+    // always the back or the front, a waiter looks further for its own jobs.
+    {
+        WorkerQueue& queue = *_queues[own];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        auto found = std::find_if(queue.jobs.rbegin(), queue.jobs.rend(), matches);
+        if (found != queue.jobs.rend())
+        {
+            job = std::move(*found);
+            queue.jobs.erase(std::next(found).base());
+            _queuedCount.fetch_sub(1);
+            return true;
+        }
+    }
+
+    for (UINT i = 1; i < queueCount; ++i)
+    {
+        WorkerQueue& queue = *_queues[(own + i) % queueCount];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        auto found = std::find_if(queue.jobs.begin(), queue.jobs.end(), matches);
+        if (found != queue.jobs.end())
+        {
+            job = std::move(*found);
+            queue.jobs.erase(found);
+            _queuedCount.fetch_sub(1);
+            return true;
+        }
+    }
+    return false;
+}
+
+void Jobs::Scheduler::Execute(Job& job)
+{
+    job.function();
+    if (job.counter)
+    {
+        job.counter->_pending.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+void Jobs::Scheduler::WorkerLoop(UINT index)
+{
+    t_queueIndex = index;
+    Profiler::SetThreadName("Job worker");
+
+    // Jobs decode images with WIC, which goes through COM.
+    CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+
+    while (true)
+    {
+        Job job;
+        if (TryPop(job))
+        {
+            Execute(job);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(_sleepMutex);
+        _sleepingCount.fetch_add(1);
+        _wake.wait(lock, [this]() { return _queuedCount.load() > 0; });
+        _sleepingCount.fetch_sub(1);
+    }
+}
+
+void Jobs::Run(std::function<void()> function, Counter* counter)
+{
+    Scheduler& scheduler = GetScheduler();
+    if (counter)
+    {
+        Scheduler::AddPending(*counter);
+    }
+    scheduler.Push(Job{ std::move(function), counter });
+}
+
+void Jobs::Wait(const Counter& counter)
+{
+    while (!counter.IsDone())
+    {
+        if (!RunPending(counter))
+        {
+            // Whatever is left runs on other threads already.
+            std::this_thread::yield();
+        }
+    }
+}
+
+bool Jobs::RunPending(const Counter& counter)
+{
+    Scheduler& scheduler = GetScheduler();
+    Job job;
+    if (!scheduler.TryPop(job, &counter))
+    {
+        return false;
+    }
+    scheduler.Execute(job);
+    return true;
+}
+
+void Jobs::ParallelFor(UINT count, UINT grainSize, const std::function<void(UINT begin, UINT end)>& function)
+{
+    grainSize = std::max(grainSize, 1u);
+    if (count <= grainSize)
+    {
+        if (count > 0)
+        {
+            function(0, count);
+        }
+        return;
+    }
+
+    Counter counter;
+    SplitRange(0, count, grainSize, function, counter);
+    Wait(counter);
+}
+
+UINT Jobs::GetThreadCount()
+{
+    return GetScheduler().GetThreadCount();
+}
\ No newline at end of file
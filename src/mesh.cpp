@@ -0,0 +1,657 @@
+#include "pch.hpp"
+
+#include "mesh.hpp"
+
+#include "hash_util.hpp"
+
+#ifndef _SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING
+#define _SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING
+#endif
+#include <experimental/filesystem>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <numeric>
+
+namespace fs = std::experimental::filesystem;
+
+using namespace DirectX;
+
+namespace
+{
+    constexpr uint32_t COOKED_MESH_MAGIC = 0x48534D44; // "DMSH"
+    constexpr uint32_t COOKED_MESH_VERSION = 1;
+
+    struct CookedMeshHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t vertexCount;
+        uint32_t indexCount;
+        uint32_t indexSize;
+    };
+
+    // Position/uv/normal indices of one OBJ face corner, 0 when absent.
+    struct ObjCorner
+    {
+        int position;
+        int uv;
+        int normal;
+
+        bool operator==(const ObjCorner& other) const
+        {
+            return position == other.position && uv == other.uv && normal == other.normal;
+        }
+    };
+
+    struct ObjCornerHasher
+    {
+        size_t operator()(const ObjCorner& corner) const
+        {
+            return static_cast<size_t>(Util::HashValue(corner));
+        }
+    };
+
+    // OBJ indices are 1-based, negative values count back from the end of the list.
+    int ResolveObjIndex(long index, size_t count)
+    {
+        if (index < 0)
+        {
+            return static_cast<int>(count) + static_cast<int>(index) + 1;
+        }
+        return static_cast<int>(index);
+    }
+
+    const char* ParseCorner(const char* cursor, ObjCorner& corner, size_t positionCount, size_t uvCount, size_t normalCount)
+    {
+        char* end = nullptr;
+        corner = { 0, 0, 0 };
+        corner.position = ResolveObjIndex(strtol(cursor, &end, 10), positionCount);
+        cursor = end;
+        if (*cursor == '/')
+        {
+            cursor++;
+            if (*cursor != '/')
+            {
+                corner.uv = ResolveObjIndex(strtol(cursor, &end, 10), uvCount);
+                cursor = end;
+            }
+            if (*cursor == '/')
+            {
+                cursor++;
+                corner.normal = ResolveObjIndex(strtol(cursor, &end, 10), normalCount);
+                cursor = end;
+            }
+        }
+        return cursor;
+    }
+
+    void GenerateNormals(Util::MeshData& mesh)
+    {
+        for (Util::Vertex& vertex : mesh.vertices)
+        {
+            vertex.normals = XMFLOAT3(0.0f, 0.0f, 0.0f);
+        }
+
+        // Unnormalized cross products weigh every face by its area.
+        for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+        {
+            Util::Vertex& v0 = mesh.vertices[mesh.indices[i + 0]];
+            Util::Vertex& v1 = mesh.vertices[mesh.indices[i + 1]];
+            Util::Vertex& v2 = mesh.vertices[mesh.indices[i + 2]];
+            XMVECTOR p0 = XMLoadFloat3(&v0.position);
+            XMVECTOR faceNormal = XMVector3Cross(XMVectorSubtract(XMLoadFloat3(&v1.position), p0), XMVectorSubtract(XMLoadFloat3(&v2.position), p0));
+            for (Util::Vertex* vertex : { &v0, &v1, &v2 })
+            {
+                XMStoreFloat3(&vertex->normals, XMVectorAdd(XMLoadFloat3(&vertex->normals), faceNormal));
+            }
+        }
+
+        for (Util::Vertex& vertex : mesh.vertices)
+        {
+            XMStoreFloat3(&vertex.normals, XMVector3Normalize(XMLoadFloat3(&vertex.normals)));
+        }
+    }
+
+    // Tom Forsyth's scoring: recently used vertices score high, and so do vertices with few triangles
+    // left, so that lone triangles get picked up before they are evicted for good.
+    constexpr int FORSYTH_CACHE_SIZE = 32;
+
+    float ForsythVertexScore(int cachePosition, UINT remainingValence)
+    {
+        if (remainingValence == 0)
+        {
+            return -1.0f;
+        }
+
+        float score = 0.0f;
+        if (cachePosition >= 0)
+        {
+            // The three vertices of the last triangle get a fixed score, so the next triangle doesn't simply reuse them.
+            score = cachePosition < 3 ? 0.75f :
+                powf(1.0f - (cachePosition - 3) / static_cast<float>(FORSYTH_CACHE_SIZE - 3), 1.5f);
+        }
+        return score + 2.0f / sqrtf(static_cast<float>(remainingValence));
+    }
+}
+
+std::vector<uint8_t> Util::MeshData::GetIndexData() const
+{
+    std::vector<uint8_t> data(indices.size() * GetIndexSize());
+    if (Needs32BitIndices())
+    {
+        memcpy(data.data(), indices.data(), data.size());
+    }
+    else
+    {
+        uint16_t* narrow = reinterpret_cast<uint16_t*>(data.data());
+        for (size_t i = 0; i < indices.size(); ++i)
+        {
+            narrow[i] = static_cast<uint16_t>(indices[i]);
+        }
+    }
+    return data;
+}
+
+bool Util::LoadMesh(const std::wstring& filePath, MeshData& mesh)
+{
+    fs::path sourcePath(filePath);
+    std::string cookedName = sourcePath.stem().string() + "-" + HashToString(HashBytes(filePath.data(), filePath.size() * sizeof(wchar_t))) + ".mesh";
+    fs::path cookedPath = fs::path(L"cache/meshes") / cookedName;
+
+    bool sourceExists = fs::exists(sourcePath);
+    if (fs::exists(cookedPath) && (!sourceExists || fs::last_write_time(cookedPath) >= fs::last_write_time(sourcePath)))
+    {
+        if (LoadCookedMesh(cookedPath.wstring(), mesh))
+        {
+            return true;
+        }
+    }
+
+    if (!sourceExists || !ImportObj(filePath, mesh))
+    {
+        return false;
+    }
+
+    OptimizeMesh(mesh);
+
+    fs::create_directories(cookedPath.parent_path());
+    SaveCookedMesh(cookedPath.wstring(), mesh);
+    return true;
+}
+
+bool Util::ImportObj(const std::wstring& filePath, MeshData& mesh)
+{
+    std::ifstream file(fs::path(filePath), std::ios::binary);
+    if (!file)
+    {
+        return false;
+    }
+
+    // Read in large blocks instead of relying on the (small) default stream buffer.
+    std::vector<char> streamBuffer(1 << 20);
+    file.rdbuf()->pubsetbuf(streamBuffer.data(), streamBuffer.size());
+
+    std::vector<XMFLOAT3> positions;
+    std::vector<XMFLOAT2> uvs;
+    std::vector<XMFLOAT3> normals;
+    std::unordered_map<ObjCorner, uint32_t, ObjCornerHasher> vertexLookup;
+    std::vector<uint32_t> polygon;
+
+    mesh.vertices.clear();
+    mesh.indices.clear();
+
+    std::string line;
+    while (std::getline(file, line))
+    {
+        const char* cursor = line.c_str();
+        while (*cursor == ' ' || *cursor == '\t')
+        {
+            cursor++;
+        }
+
+        char* end = nullptr;
+        if (cursor[0] == 'v' && cursor[1] == ' ')
+        {
+            XMFLOAT3 position;
+            position.x = strtof(cursor + 2, &end);
+            position.y = strtof(end, &end);
+            position.z = strtof(end, &end);
+            positions.push_back(position);
+        }
+        else if (cursor[0] == 'v' && cursor[1] == 't')
+        {
+            XMFLOAT2 uv;
+            uv.x = strtof(cursor + 2, &end);
+            uv.y = 1.0f - strtof(end, &end); // OBJ has v pointing up, D3D down
+            uvs.push_back(uv);
+        }
+        else if (cursor[0] == 'v' && cursor[1] == 'n')
+        {
+            XMFLOAT3 normal;
+            normal.x = strtof(cursor + 2, &end);
+            normal.y = strtof(end, &end);
+            normal.z = strtof(end, &end);
+            normals.push_back(normal);
+        }
+        else if (cursor[0] == 'f' && cursor[1] == ' ')
+        {
+            polygon.clear();
+            cursor += 2;
+            while (*cursor)
+            {
+                while (*cursor == ' ' || *cursor == '\t' || *cursor == '\r')
+                {
+                    cursor++;
+                }
+                if (!*cursor)
+                {
+                    break;
+                }
+
+                ObjCorner corner;
+                const char* next = ParseCorner(cursor, corner, positions.size(), uvs.size(), normals.size());
+                if (next == cursor || corner.position <= 0 || corner.position > static_cast<int>(positions.size()))
+                {
+                    return false;
+                }
+                cursor = next;
+
+                auto inserted = vertexLookup.emplace(corner, static_cast<uint32_t>(mesh.vertices.size()));
+                if (inserted.second)
+                {
+                    bool hasUv = corner.uv > 0 && corner.uv <= static_cast<int>(uvs.size());
+                    bool hasNormal = corner.normal > 0 && corner.normal <= static_cast<int>(normals.size());
+                    mesh.vertices.emplace_back(
+                        positions[corner.position - 1],
+                        hasNormal ? normals[corner.normal - 1] : XMFLOAT3(0.0f, 0.0f, 0.0f),
+                        hasUv ? uvs[corner.uv - 1] : XMFLOAT2(0.0f, 0.0f));
+                }
+                polygon.push_back(inserted.first->second);
+            }
+
+            // Fan triangulation, OBJ polygons are convex.
+            for (size_t i = 2; i < polygon.size(); ++i)
+            {
+                mesh.indices.push_back(polygon[0]);
+                mesh.indices.push_back(polygon[i - 1]);
+                mesh.indices.push_back(polygon[i]);
+            }
+        }
+    }
+
+    if (normals.empty())
+    {
+        GenerateNormals(mesh);
+    }
+
+    return !mesh.indices.empty();
+}
+
+bool Util::SaveCookedMesh(const std::wstring& filePath, const MeshData& mesh)
+{
+    std::ofstream file(fs::path(filePath), std::ios::binary | std::ios::trunc);
+    if (!file)
+    {
+        return false;
+    }
+
+    CookedMeshHeader header = {
+        COOKED_MESH_MAGIC, COOKED_MESH_VERSION,
+        static_cast<uint32_t>(mesh.vertices.size()), static_cast<uint32_t>(mesh.indices.size()), mesh.GetIndexSize()
+    };
+    std::vector<uint8_t> indexData = mesh.GetIndexData();
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(mesh.vertices.data()), mesh.vertices.size() * sizeof(Vertex));
+    file.write(reinterpret_cast<const char*>(indexData.data()), indexData.size());
+    return static_cast<bool>(file);
+}
+
+bool Util::LoadCookedMesh(const std::wstring& filePath, MeshData& mesh)
+{
+    std::ifstream file(fs::path(filePath), std::ios::binary);
+    CookedMeshHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        header.magic != COOKED_MESH_MAGIC || header.version != COOKED_MESH_VERSION ||
+        (header.indexSize != sizeof(uint16_t) && header.indexSize != sizeof(uint32_t)))
+    {
+        return false;
+    }
+
+    // The file is a straight dump of what gets uploaded, so this is two reads and (for 16-bit) a widening copy.
+    mesh.vertices.resize(header.vertexCount);
+    std::vector<uint8_t> indexData(static_cast<size_t>(header.indexCount) * header.indexSize);
+    if (!file.read(reinterpret_cast<char*>(mesh.vertices.data()), mesh.vertices.size() * sizeof(Vertex)) ||
+        !file.read(reinterpret_cast<char*>(indexData.data()), indexData.size()))
+    {
+        return false;
+    }
+
+    mesh.indices.resize(header.indexCount);
+    if (header.indexSize == sizeof(uint32_t))
+    {
+        memcpy(mesh.indices.data(), indexData.data(), indexData.size());
+    }
+    else
+    {
+        const uint16_t* narrow = reinterpret_cast<const uint16_t*>(indexData.data());
+        std::copy(narrow, narrow + header.indexCount, mesh.indices.begin());
+    }
+    return true;
+}
+
+void Util::OptimizeMesh(MeshData& mesh)
+{
+    OptimizeVertexCache(mesh.indices, mesh.vertices.size());
+    OptimizeOverdraw(mesh.indices, mesh.vertices);
+    OptimizeVertexFetch(mesh.indices, mesh.vertices);
+}
+
+void Util::OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount)
+{
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+    {
+        return;
+    }
+
+    // Vertex -> triangle adjacency, stored as one flat array with per-vertex offsets.
+    std::vector<UINT> remainingValence(vertexCount, 0);
+    for (uint32_t index : indices)
+    {
+        remainingValence[index]++;
+    }
+    std::vector<UINT> adjacencyOffset(vertexCount + 1, 0);
+    for (size_t vertex = 0; vertex < vertexCount; ++vertex)
+    {
+        adjacencyOffset[vertex + 1] = adjacencyOffset[vertex] + remainingValence[vertex];
+    }
+    std::vector<UINT> adjacency(indices.size());
+    {
+        std::vector<UINT> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+        for (size_t triangle = 0; triangle < triangleCount; ++triangle)
+        {
+            for (int corner = 0; corner < 3; ++corner)
+            {
+                adjacency[fill[indices[triangle * 3 + corner]]++] = static_cast<UINT>(triangle);
+            }
+        }
+    }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount);
+    for (size_t vertex = 0; vertex < vertexCount; ++vertex)
+    {
+        vertexScore[vertex] = ForsythVertexScore(-1, remainingValence[vertex]);
+    }
+
+    std::vector<float> triangleScore(triangleCount);
+    std::vector<uint8_t> emitted(triangleCount, 0);
+    for (size_t triangle = 0; triangle < triangleCount; ++triangle)
+    {
+        triangleScore[triangle] = vertexScore[indices[triangle * 3 + 0]] + vertexScore[indices[triangle * 3 + 1]] + vertexScore[indices[triangle * 3 + 2]];
+    }
+
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+
+    // Room for the full cache plus the three vertices that get pushed in front of it.
+    uint32_t cache[FORSYTH_CACHE_SIZE + 3];
+    uint32_t newCache[FORSYTH_CACHE_SIZE + 3];
+    int cacheCount = 0;
+
+    size_t scanCursor = 0;
+    size_t bestTriangle = 0;
+    float bestScore = triangleScore[0];
+    for (size_t triangle = 1; triangle < triangleCount; ++triangle)
+    {
+        if (triangleScore[triangle] > bestScore)
+        {
+            bestScore = triangleScore[triangle];
+            bestTriangle = triangle;
+        }
+    }
+
+    for (size_t emittedCount = 0; emittedCount < triangleCount; ++emittedCount)
+    {
+        if (bestScore < 0.0f)
+        {
+            // Nothing in the cache touches a remaining triangle, continue with the next unused one in input order.
+            while (emitted[scanCursor])
+            {
+                scanCursor++;
+            }
+            bestTriangle = scanCursor;
+        }
+
+        emitted[bestTriangle] = 1;
+        const uint32_t* triangleIndices = &indices[bestTriangle * 3];
+        output.insert(output.end(), triangleIndices, triangleIndices + 3);
+
+        // Detach the triangle from its vertices.
+        for (int corner = 0; corner < 3; ++corner)
+        {
+            uint32_t vertex = triangleIndices[corner];
+            UINT begin = adjacencyOffset[vertex];
+            UINT end = begin + remainingValence[vertex];
+            for (UINT i = begin; i < end; ++i)
+            {
+                if (adjacency[i] == bestTriangle)
+                {
+                    std::swap(adjacency[i], adjacency[end - 1]);
+                    break;
+                }
+            }
+            remainingValence[vertex]--;
+        }
+
+        // Move the triangle's vertices to the front of the cache (LRU).
+        int newCount = 0;
+        for (int corner = 0; corner < 3; ++corner)
+        {
+            newCache[newCount++] = triangleIndices[corner];
+        }
+        for (int i = 0; i < cacheCount; ++i)
+        {
+            uint32_t vertex = cache[i];
+            if (vertex != triangleIndices[0] && vertex != triangleIndices[1] && vertex != triangleIndices[2])
+            {
+                newCache[newCount++] = vertex;
+            }
+        }
+
+        // Rescore every vertex that is (or just fell out of) the cache, then the triangles around them.
+        for (int i = 0; i < newCount; ++i)
+        {
+            uint32_t vertex = newCache[i];
+            cachePosition[vertex] = i < FORSYTH_CACHE_SIZE ? i : -1;
+            vertexScore[vertex] = ForsythVertexScore(cachePosition[vertex], remainingValence[vertex]);
+        }
+
+        bestScore = -1.0f;
+        for (int i = 0; i < newCount; ++i)
+        {
+            uint32_t vertex = newCache[i];
+            UINT begin = adjacencyOffset[vertex];
+            UINT end = begin + remainingValence[vertex];
+            for (UINT a = begin; a < end; ++a)
+            {
+                UINT triangle = adjacency[a];
+                float score = vertexScore[indices[triangle * 3 + 0]] + vertexScore[indices[triangle * 3 + 1]] + vertexScore[indices[triangle * 3 + 2]];
+                triangleScore[triangle] = score;
+                if (score > bestScore)
+                {
+                    bestScore = score;
+                    bestTriangle = triangle;
+                }
+            }
+        }
+
+        cacheCount = std::min(newCount, FORSYTH_CACHE_SIZE);
+        memcpy(cache, newCache, cacheCount * sizeof(uint32_t));
+    }
+
+    indices.swap(output);
+}
+
+void Util::OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices)
+{
+    const size_t triangleCount = indices.size() / 3;
+    const size_t minClusterSize = 16;
+    if (triangleCount < minClusterSize * 2)
+    {
+        return;
+    }
+
+    // Split where the cache order "restarts": a triangle that misses on all three vertices begins
+    // a new strip-like run, so cutting there costs little vertex reuse.
+    const UINT cacheSize = 16;
+    std::vector<uint32_t> fifo(cacheSize, UINT_MAX);
+    std::vector<size_t> clusterStart = { 0 };
+    size_t fifoHead = 0;
+    for (size_t triangle = 0; triangle < triangleCount; ++triangle)
+    {
+        int misses = 0;
+        for (int corner = 0; corner < 3; ++corner)
+        {
+            uint32_t vertex = indices[triangle * 3 + corner];
+            if (std::find(fifo.begin(), fifo.end(), vertex) == fifo.end())
+            {
+                fifo[fifoHead] = vertex;
+                fifoHead = (fifoHead + 1) % cacheSize;
+                misses++;
+            }
+        }
+        if (misses == 3 && triangle - clusterStart.back() >= minClusterSize)
+        {
+            clusterStart.push_back(triangle);
+        }
+    }
+    clusterStart.push_back(triangleCount);
+
+    size_t clusterCount = clusterStart.size() - 1;
+    if (clusterCount < 2)
+    {
+        return;
+    }
+
+    // Area weighted centroid and normal per cluster.
+    std::vector<XMFLOAT3> clusterCentroid(clusterCount);
+    std::vector<XMFLOAT3> clusterNormal(clusterCount);
+    XMVECTOR meshCentroid = XMVectorZero();
+    float meshArea = 0.0f;
+    for (size_t cluster = 0; cluster < clusterCount; ++cluster)
+    {
+        XMVECTOR centroid = XMVectorZero();
+        XMVECTOR normal = XMVectorZero();
+        float area = 0.0f;
+        for (size_t triangle = clusterStart[cluster]; triangle < clusterStart[cluster + 1]; ++triangle)
+        {
+            XMVECTOR p0 = XMLoadFloat3(&vertices[indices[triangle * 3 + 0]].position);
+            XMVECTOR p1 = XMLoadFloat3(&vertices[indices[triangle * 3 + 1]].position);
+            XMVECTOR p2 = XMLoadFloat3(&vertices[indices[triangle * 3 + 2]].position);
+            XMVECTOR faceNormal = XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0));
+            float faceArea = XMVectorGetX(XMVector3Length(faceNormal));
+            XMVECTOR faceCentroid = XMVectorScale(XMVectorAdd(XMVectorAdd(p0, p1), p2), 1.0f / 3.0f);
+
+            centroid = XMVectorAdd(centroid, XMVectorScale(faceCentroid, faceArea));
+            normal = XMVectorAdd(normal, faceNormal);
+            area += faceArea;
+        }
+
+        meshCentroid = XMVectorAdd(meshCentroid, centroid);
+        meshArea += area;
+        XMStoreFloat3(&clusterCentroid[cluster], area > 0.0f ? XMVectorScale(centroid, 1.0f / area) : centroid);
+        XMStoreFloat3(&clusterNormal[cluster], XMVector3Normalize(normal));
+    }
+    if (meshArea > 0.0f)
+    {
+        meshCentroid = XMVectorScale(meshCentroid, 1.0f / meshArea);
+    }
+
+    // Clusters that face away from the center are likely in front of the rest: draw them first.
+    std::vector<float> sortKey(clusterCount);
+    for (size_t cluster = 0; cluster < clusterCount; ++cluster)
+    {
+        XMVECTOR offset = XMVectorSubtract(XMLoadFloat3(&clusterCentroid[cluster]), meshCentroid);
+        sortKey[cluster] = XMVectorGetX(XMVector3Dot(offset, XMLoadFloat3(&clusterNormal[cluster])));
+    }
+
+    std::vector<size_t> order(clusterCount);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&sortKey](size_t a, size_t b) { return sortKey[a] > sortKey[b]; });
+
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+    for (size_t cluster : order)
+    {
+        output.insert(output.end(), indices.begin() + clusterStart[cluster] * 3, indices.begin() + clusterStart[cluster + 1] * 3);
+    }
+    indices.swap(output);
+}
+
+void Util::OptimizeVertexFetch(std::vector<uint32_t>& indices, std::vector<Vertex>& vertices)
+{
+    std::vector<uint32_t> remap(vertices.size(), UINT_MAX);
+    std::vector<Vertex> output;
+    output.reserve(vertices.size());
+
+    for (uint32_t& index : indices)
+    {
+        if (remap[index] == UINT_MAX)
+        {
+            remap[index] = static_cast<uint32_t>(output.size());
+            output.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+
+    // Unreferenced vertices are dropped.
+    vertices.swap(output);
+}
+
+float Util::ComputeACMR(const std::vector<uint32_t>& indices, size_t vertexCount, UINT cacheSize)
+{
+    if (indices.size() < 3)
+    {
+        return 0.0f;
+    }
+
+    // FIFO cache as most hardware implements it; the timestamp trick avoids searching the cache.
+    std::vector<size_t> insertedAt(vertexCount, 0);
+    size_t timestamp = cacheSize + 1;
+    size_t misses = 0;
+    for (uint32_t index : indices)
+    {
+        if (timestamp - insertedAt[index] > cacheSize)
+        {
+            insertedAt[index] = timestamp++;
+            misses++;
+        }
+    }
+
+    return static_cast<float>(misses) / (indices.size() / 3);
+}
+
+float Util::ComputeUvDensity(const MeshData& mesh)
+{
+    double surfaceArea = 0.0;
+    double uvArea = 0.0;
+    for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+    {
+        const Vertex& v0 = mesh.vertices[mesh.indices[i + 0]];
+        const Vertex& v1 = mesh.vertices[mesh.indices[i + 1]];
+        const Vertex& v2 = mesh.vertices[mesh.indices[i + 2]];
+
+        XMVECTOR p0 = XMLoadFloat3(&v0.position);
+        XMVECTOR cross = XMVector3Cross(XMVectorSubtract(XMLoadFloat3(&v1.position), p0), XMVectorSubtract(XMLoadFloat3(&v2.position), p0));
+        surfaceArea += 0.5 * XMVectorGetX(XMVector3Length(cross));
+
+        float du1 = v1.uv.x - v0.uv.x, dv1 = v1.uv.y - v0.uv.y;
+        float du2 = v2.uv.x - v0.uv.x, dv2 = v2.uv.y - v0.uv.y;
+        uvArea += 0.5 * fabs(du1 * dv2 - du2 * dv1);
+    }
+
+    return surfaceArea > 0.0 ? static_cast<float>(sqrt(uvArea / surfaceArea)) : 0.0f;
+}
\ No newline at end of file
@@ -0,0 +1,874 @@
+#include "pch.hpp"
+
+#include "mesh_lod.hpp"
+
+#include "hash_util.hpp"
+#include "job_system.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+    // Sum of the squared distances to the planes around a vertex, stored as the symmetric 4x4
+    // quadric. Planes are weighted by triangle area and the error is divided by the total weight,
+    // so it stays a squared distance no matter how finely the surface is tessellated.
+    struct Quadric
+    {
+        double a00, a01, a02, a11, a12, a22;
+        double b0, b1, b2;
+        double c;
+        double weight;
+
+        void AddPlane(double nx, double ny, double nz, double d, double w)
+        {
+            a00 += w * nx * nx; a01 += w * nx * ny; a02 += w * nx * nz;
+            a11 += w * ny * ny; a12 += w * ny * nz; a22 += w * nz * nz;
+            b0 += w * nx * d; b1 += w * ny * d; b2 += w * nz * d;
+            c += w * d * d;
+            weight += w;
+        }
+
+        void Add(const Quadric& other)
+        {
+            a00 += other.a00; a01 += other.a01; a02 += other.a02;
+            a11 += other.a11; a12 += other.a12; a22 += other.a22;
+            b0 += other.b0; b1 += other.b1; b2 += other.b2;
+            c += other.c;
+            weight += other.weight;
+        }
+
+        double Evaluate(const XMFLOAT3& position) const
+        {
+            double x = position.x, y = position.y, z = position.z;
+            double error = a00 * x * x + a11 * y * y + a22 * z * z +
+                2.0 * (a01 * x * y + a02 * x * z + a12 * y * z) +
+                2.0 * (b0 * x + b1 * y + b2 * z) + c;
+            return weight > 0.0 ? std::max(error, 0.0) / weight : 0.0;
+        }
+    };
+
+    struct PositionHasher
+    {
+        size_t operator()(const XMFLOAT3& position) const
+        {
+            return static_cast<size_t>(Util::HashValue(position));
+        }
+    };
+
+    // Bitwise, to stay consistent with the hash (0.0f and -0.0f are different keys).
+    struct PositionEqual
+    {
+        bool operator()(const XMFLOAT3& a, const XMFLOAT3& b) const
+        {
+            return memcmp(&a, &b, sizeof(XMFLOAT3)) == 0;
+        }
+    };
+
+    struct Collapse
+    {
+        uint32_t from;
+        uint32_t to;
+        double error;
+    };
+
+    float ComputeExtent(const std::vector<Util::Vertex>& vertices)
+    {
+        if (vertices.empty())
+        {
+            return 0.0f;
+        }
+
+        XMVECTOR minimum = XMLoadFloat3(&vertices[0].position);
+        XMVECTOR maximum = minimum;
+        for (const Util::Vertex& vertex : vertices)
+        {
+            XMVECTOR position = XMLoadFloat3(&vertex.position);
+            minimum = XMVectorMin(minimum, position);
+            maximum = XMVectorMax(maximum, position);
+        }
+
+        XMFLOAT3 extent;
+        XMStoreFloat3(&extent, XMVectorSubtract(maximum, minimum));
+        return std::max(extent.x, std::max(extent.y, extent.z));
+    }
+
+    void ComputeMeshletBounds(Util::Meshlet& meshlet, const Util::MeshletData& data, const std::vector<Util::Vertex>& vertices)
+    {
+        const uint32_t* meshletVertices = &data.vertices[meshlet.vertexOffset];
+        const uint8_t* meshletTriangles = &data.triangles[meshlet.triangleOffset];
+
+        // Sphere around the bounding box center, tight enough for meshlets of a few dozen triangles.
+        XMVECTOR minimum = XMLoadFloat3(&vertices[meshletVertices[0]].position);
+        XMVECTOR maximum = minimum;
+        for (uint32_t i = 1; i < meshlet.vertexCount; ++i)
+        {
+            XMVECTOR position = XMLoadFloat3(&vertices[meshletVertices[i]].position);
+            minimum = XMVectorMin(minimum, position);
+            maximum = XMVectorMax(maximum, position);
+        }
+        XMVECTOR center = XMVectorScale(XMVectorAdd(minimum, maximum), 0.5f);
+        XMVECTOR radiusSquared = XMVectorZero();
+        for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+        {
+            radiusSquared = XMVectorMax(radiusSquared, XMVector3LengthSq(XMVectorSubtract(XMLoadFloat3(&vertices[meshletVertices[i]].position), center)));
+        }
+        XMStoreFloat3(&meshlet.center, center);
+        meshlet.radius = sqrtf(XMVectorGetX(radiusSquared));
+
+        // Normal cone around the average face normal. The cutoff is the sine of the cone's spread,
+        // a cone of more than 90 degrees can't ever be entirely backfacing.
+        XMFLOAT3 faceNormals[Util::MESHLET_MAX_TRIANGLES];
+        XMVECTOR axis = XMVectorZero();
+        for (uint32_t triangle = 0; triangle < meshlet.triangleCount; ++triangle)
+        {
+            XMVECTOR p0 = XMLoadFloat3(&vertices[meshletVertices[meshletTriangles[triangle * 3 + 0]]].position);
+            XMVECTOR p1 = XMLoadFloat3(&vertices[meshletVertices[meshletTriangles[triangle * 3 + 1]]].position);
+            XMVECTOR p2 = XMLoadFloat3(&vertices[meshletVertices[meshletTriangles[triangle * 3 + 2]]].position);
+            XMVECTOR normal = XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0));
+            normal = XMVectorGetX(XMVector3LengthSq(normal)) > 0.0f ? XMVector3Normalize(normal) : XMVectorZero();
+            XMStoreFloat3(&faceNormals[triangle], normal);
+            axis = XMVectorAdd(axis, normal);
+        }
+
+        meshlet.coneCutoff = 1.0f;
+        if (XMVectorGetX(XMVector3LengthSq(axis)) < 1e-12f)
+        {
+            meshlet.coneAxis = XMFLOAT3(0.0f, 0.0f, 1.0f);
+            return;
+        }
+
+        axis = XMVector3Normalize(axis);
+        XMStoreFloat3(&meshlet.coneAxis, axis);
+
+        float minimumDot = 1.0f;
+        for (uint32_t triangle = 0; triangle < meshlet.triangleCount; ++triangle)
+        {
+            XMVECTOR normal = XMLoadFloat3(&faceNormals[triangle]);
+            if (XMVectorGetX(XMVector3LengthSq(normal)) > 0.0f)
+            {
+                minimumDot = std::min(minimumDot, XMVectorGetX(XMVector3Dot(normal, axis)));
+            }
+        }
+        if (minimumDot > 0.0f)
+        {
+            meshlet.coneCutoff = sqrtf(1.0f - minimumDot * minimumDot);
+        }
+    }
+
+    // Ericson, Real-Time Collision Detection 5.1.5, squared to skip the root.
+    float DistanceSquaredToTriangle(FXMVECTOR point, FXMVECTOR a, FXMVECTOR b, GXMVECTOR c)
+    {
+        XMVECTOR ab = XMVectorSubtract(b, a);
+        XMVECTOR ac = XMVectorSubtract(c, a);
+        XMVECTOR ap = XMVectorSubtract(point, a);
+        float d1 = XMVectorGetX(XMVector3Dot(ab, ap));
+        float d2 = XMVectorGetX(XMVector3Dot(ac, ap));
+        if (d1 <= 0.0f && d2 <= 0.0f)
+        {
+            return XMVectorGetX(XMVector3LengthSq(ap));
+        }
+
+        XMVECTOR bp = XMVectorSubtract(point, b);
+        float d3 = XMVectorGetX(XMVector3Dot(ab, bp));
+        float d4 = XMVectorGetX(XMVector3Dot(ac, bp));
+        if (d3 >= 0.0f && d4 <= d3)
+        {
+            return XMVectorGetX(XMVector3LengthSq(bp));
+        }
+
+        float vc = d1 * d4 - d3 * d2;
+        if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+        {
+            return XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(ap, XMVectorScale(ab, d1 / (d1 - d3)))));
+        }
+
+        XMVECTOR cp = XMVectorSubtract(point, c);
+        float d5 = XMVectorGetX(XMVector3Dot(ab, cp));
+        float d6 = XMVectorGetX(XMVector3Dot(ac, cp));
+        if (d6 >= 0.0f && d5 <= d6)
+        {
+            return XMVectorGetX(XMVector3LengthSq(cp));
+        }
+
+        float vb = d5 * d2 - d1 * d6;
+        if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+        {
+            return XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(ap, XMVectorScale(ac, d2 / (d2 - d6)))));
+        }
+
+        float va = d3 * d6 - d5 * d4;
+        if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f)
+        {
+            float w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+            return XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(bp, XMVectorScale(XMVectorSubtract(c, b), w))));
+        }
+
+        // A degenerate triangle can end up here, any of its corners still gives an upper bound.
+        float area = va + vb + vc;
+        if (!(area > 0.0f))
+        {
+            return std::min(XMVectorGetX(XMVector3LengthSq(ap)), std::min(XMVectorGetX(XMVector3LengthSq(bp)), XMVectorGetX(XMVector3LengthSq(cp))));
+        }
+        XMVECTOR offset = XMVectorAdd(XMVectorScale(ab, vb / area), XMVectorScale(ac, vc / area));
+        return XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(ap, offset)));
+    }
+
+    // The full mesh's triangles bucketed in a uniform grid, for nearest triangle queries.
+    class TriangleGrid
+    {
+    public:
+        TriangleGrid(const std::vector<uint32_t>& indices, const std::vector<Util::Vertex>& vertices)
+        {
+            const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+            _corners.resize(triangleCount * 3);
+            _spheres.resize(triangleCount);
+
+            XMVECTOR minimum = XMVectorReplicate(FLT_MAX);
+            XMVECTOR maximum = XMVectorReplicate(-FLT_MAX);
+            float area = 0.0f;
+            for (uint32_t triangle = 0; triangle < triangleCount; ++triangle)
+            {
+                XMVECTOR p0 = XMLoadFloat3(&vertices[indices[triangle * 3 + 0]].position);
+                XMVECTOR p1 = XMLoadFloat3(&vertices[indices[triangle * 3 + 1]].position);
+                XMVECTOR p2 = XMLoadFloat3(&vertices[indices[triangle * 3 + 2]].position);
+                XMStoreFloat3(&_corners[triangle * 3 + 0], p0);
+                XMStoreFloat3(&_corners[triangle * 3 + 1], p1);
+                XMStoreFloat3(&_corners[triangle * 3 + 2], p2);
+
+                // Centroid sphere, for rejecting triangles without the full distance test.
+                XMVECTOR center = XMVectorScale(XMVectorAdd(p0, XMVectorAdd(p1, p2)), 1.0f / 3.0f);
+                float radiusSquared = std::max(XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(p0, center))),
+                    std::max(XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(p1, center))), XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(p2, center)))));
+                XMStoreFloat3(&_spheres[triangle].center, center);
+                _spheres[triangle].radius = sqrtf(radiusSquared);
+
+                minimum = XMVectorMin(minimum, XMVectorMin(p0, XMVectorMin(p1, p2)));
+                maximum = XMVectorMax(maximum, XMVectorMax(p0, XMVectorMax(p1, p2)));
+                area += 0.5f * XMVectorGetX(XMVector3Length(XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0))));
+            }
+            if (triangleCount == 0)
+            {
+                minimum = maximum = XMVectorZero();
+            }
+            XMStoreFloat3(&_minimum, minimum);
+            XMFLOAT3 size;
+            XMStoreFloat3(&size, XMVectorSubtract(maximum, minimum));
+
+            // A few triangles per cell on a surface, coarser when that would be a lot of empty cells.
+            _spacing = sqrtf(2.0f * area / std::max(triangleCount, 1u));
+            _cellSize = std::max(2.0f * _spacing, 1e-6f);
+            for (;;)
+            {
+                _dimensions[0] = static_cast<int>(size.x / _cellSize) + 1;
+                _dimensions[1] = static_cast<int>(size.y / _cellSize) + 1;
+                _dimensions[2] = static_cast<int>(size.z / _cellSize) + 1;
+                if (static_cast<double>(_dimensions[0]) * _dimensions[1] * _dimensions[2] <= 4.0 * triangleCount + 64.0)
+                {
+                    break;
+                }
+                _cellSize *= 1.5f;
+            }
+
+            // Counting pass then fill, every triangle goes into all the cells its bounds touch.
+            _cellStart.assign(static_cast<size_t>(_dimensions[0]) * _dimensions[1] * _dimensions[2] + 1, 0);
+            std::vector<uint32_t> cellFill;
+            for (int pass = 0; pass < 2; ++pass)
+            {
+                for (uint32_t triangle = 0; triangle < triangleCount; ++triangle)
+                {
+                    XMVECTOR p0 = XMLoadFloat3(&_corners[triangle * 3 + 0]);
+                    XMVECTOR p1 = XMLoadFloat3(&_corners[triangle * 3 + 1]);
+                    XMVECTOR p2 = XMLoadFloat3(&_corners[triangle * 3 + 2]);
+                    int low[3], high[3];
+                    GetCell(XMVectorMin(p0, XMVectorMin(p1, p2)), low);
+                    GetCell(XMVectorMax(p0, XMVectorMax(p1, p2)), high);
+                    for (int z = low[2]; z <= high[2]; ++z)
+                    {
+                        for (int y = low[1]; y <= high[1]; ++y)
+                        {
+                            for (int x = low[0]; x <= high[0]; ++x)
+                            {
+                                size_t cell = GetCellIndex(x, y, z);
+                                if (pass == 0)
+                                {
+                                    _cellStart[cell + 1]++;
+                                }
+                                else
+                                {
+                                    _cellTriangles[cellFill[cell]++] = triangle;
+                                }
+                            }
+                        }
+                    }
+                }
+                if (pass == 0)
+                {
+                    for (size_t cell = 1; cell < _cellStart.size(); ++cell)
+                    {
+                        _cellStart[cell] += _cellStart[cell - 1];
+                    }
+                    _cellTriangles.resize(_cellStart.back());
+                    cellFill.assign(_cellStart.begin(), _cellStart.end() - 1);
+                }
+            }
+        }
+
+        // Typical edge length of the full mesh.
+        float GetSpacing() const { return _spacing; }
+
+        // Searches rings of cells outwards until nothing further out can be closer. Starting from the
+        // triangle nearest to a point close by lets the sphere test skip most of the others.
+        float FindNearest(FXMVECTOR point, uint32_t& nearestTriangle) const
+        {
+            int center[3];
+            GetCell(point, center);
+            XMFLOAT3 position;
+            XMStoreFloat3(&position, point);
+            const float local[3] = { position.x - _minimum.x, position.y - _minimum.y, position.z - _minimum.z };
+            const int maxRing = std::max(_dimensions[0], std::max(_dimensions[1], _dimensions[2]));
+
+            float bestSquared = FLT_MAX;
+            if (nearestTriangle < _spheres.size())
+            {
+                bestSquared = DistanceSquaredToTriangle(point, XMLoadFloat3(&_corners[nearestTriangle * 3 + 0]),
+                    XMLoadFloat3(&_corners[nearestTriangle * 3 + 1]), XMLoadFloat3(&_corners[nearestTriangle * 3 + 2]));
+            }
+            float best = sqrtf(bestSquared);
+            for (int ring = 0; ring <= maxRing; ++ring)
+            {
+                for (int z = std::max(center[2] - ring, 0); z <= std::min(center[2] + ring, _dimensions[2] - 1); ++z)
+                {
+                    for (int y = std::max(center[1] - ring, 0); y <= std::min(center[1] + ring, _dimensions[1] - 1); ++y)
+                    {
+                        // Only the shell of the box is new, the inside was searched by the rings before.
+                        bool shell = abs(z - center[2]) == ring || abs(y - center[1]) == ring;
+                        int step = shell ? 1 : std::max(2 * ring, 1);
+                        for (int x = std::max(center[0] - ring, 0); x <= std::min(center[0] + ring, _dimensions[0] - 1); x += step)
+                        {
+                            if (!shell && abs(x - center[0]) != ring)
+                            {
+                                continue;
+                            }
+                            size_t cell = GetCellIndex(x, y, z);
+                            for (uint32_t i = _cellStart[cell]; i < _cellStart[cell + 1]; ++i)
+                            {
+                                uint32_t triangle = _cellTriangles[i];
+                                const Sphere& sphere = _spheres[triangle];
+                                float dx = position.x - sphere.center.x, dy = position.y - sphere.center.y, dz = position.z - sphere.center.z;
+                                float reach = best + sphere.radius;
+                                if (dx * dx + dy * dy + dz * dz >= reach * reach)
+                                {
+                                    continue;
+                                }
+
+                                float distanceSquared = DistanceSquaredToTriangle(point, XMLoadFloat3(&_corners[triangle * 3 + 0]),
+                                    XMLoadFloat3(&_corners[triangle * 3 + 1]), XMLoadFloat3(&_corners[triangle * 3 + 2]));
+                                if (distanceSquared < bestSquared)
+                                {
+                                    bestSquared = distanceSquared;
+                                    best = sqrtf(distanceSquared);
+                                    nearestTriangle = triangle;
+                                }
+                            }
+                        }
+                    }
+                }
+
+                // Anything not searched yet is outside the box of cells around the point, and at least
+                // as far away as the nearest of its sides that still has cells beyond it.
+                float searched = FLT_MAX;
+                for (int axis = 0; axis < 3; ++axis)
+                {
+                    if (center[axis] - ring > 0)
+                    {
+                        searched = std::min(searched, std::max(local[axis] - (center[axis] - ring) * _cellSize, 0.0f));
+                    }
+                    if (center[axis] + ring < _dimensions[axis] - 1)
+                    {
+                        searched = std::min(searched, std::max((center[axis] + ring + 1) * _cellSize - local[axis], 0.0f));
+                    }
+                }
+                if (best <= searched)
+                {
+                    break;
+                }
+            }
+            return best;
+        }
+
+    private:
+        struct Sphere
+        {
+            XMFLOAT3 center;
+            float radius;
+        };
+
+        void GetCell(FXMVECTOR point, int cell[3]) const
+        {
+            XMFLOAT3 local;
+            XMStoreFloat3(&local, XMVectorScale(XMVectorSubtract(point, XMLoadFloat3(&_minimum)), 1.0f / _cellSize));
+            const float coordinates[3] = { local.x, local.y, local.z };
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                cell[axis] = std::min(std::max(static_cast<int>(coordinates[axis]), 0), _dimensions[axis] - 1);
+            }
+        }
+
+        size_t GetCellIndex(int x, int y, int z) const
+        {
+            return (static_cast<size_t>(z) * _dimensions[1] + y) * _dimensions[0] + x;
+        }
+
+        std::vector<XMFLOAT3> _corners;
+        std::vector<Sphere> _spheres;
+        XMFLOAT3 _minimum;
+        float _spacing;
+        float _cellSize;
+        int _dimensions[3];
+        std::vector<uint32_t> _cellStart;
+        std::vector<uint32_t> _cellTriangles;
+    };
+
+    // Largest distance from the simplified triangles to the full mesh, at points spread over each
+    // triangle about as densely as the full mesh's vertices. The step count stays a multiple of four,
+    // so the quarter points of every edge and of the interior are always among the samples.
+    float MeasureDistance(const TriangleGrid& grid, const std::vector<uint32_t>& indices, const std::vector<Util::Vertex>& vertices)
+    {
+        const int MAX_STEPS = 16;
+        const UINT triangleCount = static_cast<UINT>(indices.size() / 3);
+        std::vector<float> triangleDistances(triangleCount, 0.0f);
+
+        Jobs::ParallelFor(triangleCount, 256, [&](UINT begin, UINT end)
+        {
+            uint32_t nearestTriangle = UINT_MAX;
+            for (UINT triangle = begin; triangle < end; ++triangle)
+            {
+                XMVECTOR a = XMLoadFloat3(&vertices[indices[triangle * 3 + 0]].position);
+                XMVECTOR b = XMLoadFloat3(&vertices[indices[triangle * 3 + 1]].position);
+                XMVECTOR c = XMLoadFloat3(&vertices[indices[triangle * 3 + 2]].position);
+                float longest = std::max(XMVectorGetX(XMVector3Length(XMVectorSubtract(b, a))),
+                    std::max(XMVectorGetX(XMVector3Length(XMVectorSubtract(c, b))), XMVectorGetX(XMVector3Length(XMVectorSubtract(a, c)))));
+                int steps = std::min(4 * static_cast<int>(ceilf(longest / (4.0f * grid.GetSpacing()))), MAX_STEPS);
+                steps = std::max(steps, 4);
+
+                // The corners are vertices of the full mesh, nothing to measure there.
+                float distance = 0.0f;
+                for (int u = 0; u <= steps; ++u)
+                {
+                    for (int v = 0; u + v <= steps; ++v)
+                    {
+                        int w = steps - u - v;
+                        if (u == steps || v == steps || w == steps)
+                        {
+                            continue;
+                        }
+                        XMVECTOR point = XMVectorScale(XMVectorAdd(XMVectorAdd(XMVectorScale(a, static_cast<float>(u)), XMVectorScale(b, static_cast<float>(v))),
+                            XMVectorScale(c, static_cast<float>(w))), 1.0f / steps);
+                        distance = std::max(distance, grid.FindNearest(point, nearestTriangle));
+                    }
+                }
+                triangleDistances[triangle] = distance;
+            }
+        });
+
+        float maxDistance = 0.0f;
+        for (float distance : triangleDistances)
+        {
+            maxDistance = std::max(maxDistance, distance);
+        }
+        return maxDistance;
+    }
+}
+
+void Util::BuildMeshlets(const uint32_t* indices, size_t indexCount, const std::vector<Vertex>& vertices, MeshletData& meshlets)
+{
+    const uint8_t NOT_IN_MESHLET = 0xFF;
+    std::vector<uint8_t> localIndex(vertices.size(), NOT_IN_MESHLET);
+
+    meshlets.meshlets.clear();
+    meshlets.vertices.clear();
+    meshlets.triangles.clear();
+
+    Meshlet meshlet = {};
+    auto finishMeshlet = [&]()
+    {
+        if (meshlet.triangleCount == 0)
+        {
+            return;
+        }
+
+        ComputeMeshletBounds(meshlet, meshlets, vertices);
+        for (size_t i = meshlet.vertexOffset; i < meshlets.vertices.size(); ++i)
+        {
+            localIndex[meshlets.vertices[i]] = NOT_IN_MESHLET;
+        }
+        meshlets.meshlets.push_back(meshlet);
+
+        meshlet = {};
+        meshlet.vertexOffset = static_cast<uint32_t>(meshlets.vertices.size());
+        meshlet.triangleOffset = static_cast<uint32_t>(meshlets.triangles.size());
+    };
+
+    for (size_t i = 0; i + 2 < indexCount; i += 3)
+    {
+        uint32_t a = indices[i + 0];
+        uint32_t b = indices[i + 1];
+        uint32_t c = indices[i + 2];
+        uint32_t newVertices = (localIndex[a] == NOT_IN_MESHLET) +
+            (localIndex[b] == NOT_IN_MESHLET && b != a) +
+            (localIndex[c] == NOT_IN_MESHLET && c != a && c != b);
+
+        if (meshlet.vertexCount + newVertices > MESHLET_MAX_VERTICES || meshlet.triangleCount + 1 > MESHLET_MAX_TRIANGLES)
+        {
+            finishMeshlet();
+        }
+
+        for (uint32_t vertex : { a, b, c })
+        {
+            if (localIndex[vertex] == NOT_IN_MESHLET)
+            {
+                localIndex[vertex] = static_cast<uint8_t>(meshlet.vertexCount++);
+                meshlets.vertices.push_back(vertex);
+            }
+            meshlets.triangles.push_back(localIndex[vertex]);
+        }
+        meshlet.triangleCount++;
+    }
+    finishMeshlet();
+}
+
+bool Util::IsMeshletBackfacing(const Meshlet& meshlet, FXMVECTOR viewPosition)
+{
+    // The radius term keeps the test conservative for triangles away from the center.
+    XMVECTOR offset = XMVectorSubtract(XMLoadFloat3(&meshlet.center), viewPosition);
+    float distance = XMVectorGetX(XMVector3Length(offset));
+    return XMVectorGetX(XMVector3Dot(offset, XMLoadFloat3(&meshlet.coneAxis))) >= meshlet.coneCutoff * distance + meshlet.radius;
+}
+
+std::vector<uint32_t> Util::SimplifyMesh(const std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices,
+    size_t targetIndexCount, float targetError, float* resultError)
+{
+    const uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+    std::vector<uint32_t> result = indices;
+    if (resultError)
+    {
+        *resultError = 0.0f;
+    }
+    if (result.size() <= targetIndexCount || vertexCount == 0)
+    {
+        return result;
+    }
+
+    // Topology is position based: vertices that only differ in normal or uv are welded. A welded
+    // position with differing attributes is a seam, collapsing into or out of it would smear them.
+    std::vector<uint32_t> weld(vertexCount);
+    std::vector<uint8_t> locked(vertexCount, 0);
+    std::vector<uint8_t> seam(vertexCount, 0);
+    {
+        std::unordered_map<XMFLOAT3, uint32_t, PositionHasher, PositionEqual> firstVertex;
+        firstVertex.reserve(vertexCount);
+        for (uint32_t vertex = 0; vertex < vertexCount; ++vertex)
+        {
+            auto inserted = firstVertex.emplace(vertices[vertex].position, vertex);
+            uint32_t canonical = inserted.first->second;
+            weld[vertex] = canonical;
+            if (!inserted.second && memcmp(&vertices[vertex], &vertices[canonical], sizeof(Vertex)) != 0)
+            {
+                seam[canonical] = 1;
+                locked[canonical] = 1;
+            }
+        }
+    }
+
+    // Edges used by a single triangle are open borders, which stay put as well.
+    {
+        std::unordered_map<uint64_t, uint32_t> edgeUse;
+        edgeUse.reserve(result.size());
+        for (size_t i = 0; i < result.size(); i += 3)
+        {
+            for (int edge = 0; edge < 3; ++edge)
+            {
+                uint32_t a = weld[result[i + edge]];
+                uint32_t b = weld[result[i + (edge + 1) % 3]];
+                edgeUse[(static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b)]++;
+            }
+        }
+        for (const auto& edge : edgeUse)
+        {
+            if (edge.second == 1)
+            {
+                locked[static_cast<uint32_t>(edge.first >> 32)] = 1;
+                locked[static_cast<uint32_t>(edge.first)] = 1;
+            }
+        }
+    }
+
+    std::vector<Quadric> quadrics(vertexCount, Quadric{});
+    for (size_t i = 0; i < result.size(); i += 3)
+    {
+        XMVECTOR p0 = XMLoadFloat3(&vertices[weld[result[i + 0]]].position);
+        XMVECTOR p1 = XMLoadFloat3(&vertices[weld[result[i + 1]]].position);
+        XMVECTOR p2 = XMLoadFloat3(&vertices[weld[result[i + 2]]].position);
+        XMVECTOR normal = XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0));
+        float length = XMVectorGetX(XMVector3Length(normal));
+        if (length <= 0.0f)
+        {
+            continue;
+        }
+
+        XMFLOAT3 n;
+        XMStoreFloat3(&n, XMVectorScale(normal, 1.0f / length));
+        double distance = -XMVectorGetX(XMVector3Dot(XMLoadFloat3(&n), p0));
+        for (int corner = 0; corner < 3; ++corner)
+        {
+            quadrics[weld[result[i + corner]]].AddPlane(n.x, n.y, n.z, distance, length * 0.5);
+        }
+    }
+
+    const float extent = ComputeExtent(vertices);
+    const double errorLimit = static_cast<double>(targetError) * extent * targetError * extent;
+    double maxError = 0.0;
+
+    std::vector<uint32_t> adjacencyOffset(vertexCount + 1);
+    std::vector<uint32_t> adjacency;
+    std::vector<uint32_t> collapseTarget(vertexCount);
+    std::vector<uint8_t> touched(vertexCount);
+    std::vector<Collapse> candidates;
+
+    // Moving from onto to must not turn any of from's remaining triangles around. Anything that
+    // rotates by more than ~75 degrees is rejected too, those end up as slivers standing on edge.
+    auto flipsTriangle = [&](uint32_t from, uint32_t to)
+    {
+        XMVECTOR target = XMLoadFloat3(&vertices[to].position);
+        for (uint32_t a = adjacencyOffset[from]; a < adjacencyOffset[from + 1]; ++a)
+        {
+            const uint32_t* triangle = &result[adjacency[a] * 3];
+            uint32_t corners[3] = { weld[triangle[0]], weld[triangle[1]], weld[triangle[2]] };
+            if (corners[0] == to || corners[1] == to || corners[2] == to)
+            {
+                continue; // collapses away
+            }
+
+            XMVECTOR before[3], after[3];
+            for (int corner = 0; corner < 3; ++corner)
+            {
+                before[corner] = XMLoadFloat3(&vertices[corners[corner]].position);
+                after[corner] = corners[corner] == from ? target : before[corner];
+            }
+            XMVECTOR normalBefore = XMVector3Cross(XMVectorSubtract(before[1], before[0]), XMVectorSubtract(before[2], before[0]));
+            XMVECTOR normalAfter = XMVector3Cross(XMVectorSubtract(after[1], after[0]), XMVectorSubtract(after[2], after[0]));
+            float lengths = XMVectorGetX(XMVector3Length(normalBefore)) * XMVectorGetX(XMVector3Length(normalAfter));
+            if (XMVectorGetX(XMVector3Dot(normalBefore, normalAfter)) < 0.25f * lengths)
+            {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    // Every pass collapses the cheapest edges that don't share a neighbourhood, then rebuilds.
+    while (result.size() > targetIndexCount)
+    {
+        const uint32_t triangleCount = static_cast<uint32_t>(result.size() / 3);
+
+        std::fill(adjacencyOffset.begin(), adjacencyOffset.end(), 0);
+        for (uint32_t index : result)
+        {
+            adjacencyOffset[weld[index] + 1]++;
+        }
+        for (uint32_t vertex = 0; vertex < vertexCount; ++vertex)
+        {
+            adjacencyOffset[vertex + 1] += adjacencyOffset[vertex];
+        }
+        adjacency.resize(result.size());
+        {
+            std::vector<uint32_t> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+            for (uint32_t triangle = 0; triangle < triangleCount; ++triangle)
+            {
+                for (int corner = 0; corner < 3; ++corner)
+                {
+                    adjacency[fill[weld[result[triangle * 3 + corner]]]++] = triangle;
+                }
+            }
+        }
+
+        candidates.clear();
+        for (uint32_t triangle = 0; triangle < triangleCount; ++triangle)
+        {
+            for (int edge = 0; edge < 3; ++edge)
+            {
+                uint32_t a = weld[result[triangle * 3 + edge]];
+                uint32_t b = weld[result[triangle * 3 + (edge + 1) % 3]];
+                // Interior edges show up in both of their triangles, borders are locked anyway.
+                if (a >= b)
+                {
+                    continue;
+                }
+
+                Quadric quadric = quadrics[a];
+                quadric.Add(quadrics[b]);
+                Collapse collapse = { 0, 0, DBL_MAX };
+                if (!locked[a] && !seam[b])
+                {
+                    collapse = { a, b, quadric.Evaluate(vertices[b].position) };
+                }
+                if (!locked[b] && !seam[a])
+                {
+                    double error = quadric.Evaluate(vertices[a].position);
+                    if (error < collapse.error)
+                    {
+                        collapse = { b, a, error };
+                    }
+                }
+                if (collapse.error <= errorLimit)
+                {
+                    candidates.push_back(collapse);
+                }
+            }
+        }
+        if (candidates.empty())
+        {
+            break;
+        }
+        std::sort(candidates.begin(), candidates.end(), [](const Collapse& a, const Collapse& b) { return a.error < b.error; });
+
+        // A collapse removes about two triangles, don't overshoot the target by much.
+        const size_t collapseBudget = (triangleCount - targetIndexCount / 3) / 2 + 1;
+        size_t collapseCount = 0;
+        std::fill(collapseTarget.begin(), collapseTarget.end(), UINT_MAX);
+        std::fill(touched.begin(), touched.end(), static_cast<uint8_t>(0));
+        for (const Collapse& collapse : candidates)
+        {
+            if (collapseCount >= collapseBudget)
+            {
+                break;
+            }
+            if (touched[collapse.from] || touched[collapse.to] || flipsTriangle(collapse.from, collapse.to))
+            {
+                continue;
+            }
+
+            // The flip test assumed the neighbours stay where they are, so they can't move this pass.
+            for (uint32_t a = adjacencyOffset[collapse.from]; a < adjacencyOffset[collapse.from + 1]; ++a)
+            {
+                for (int corner = 0; corner < 3; ++corner)
+                {
+                    touched[weld[result[adjacency[a] * 3 + corner]]] = 1;
+                }
+            }
+            touched[collapse.to] = 1;
+
+            collapseTarget[collapse.from] = collapse.to;
+            quadrics[collapse.to].Add(quadrics[collapse.from]);
+            maxError = std::max(maxError, collapse.error);
+            collapseCount++;
+        }
+        if (collapseCount == 0)
+        {
+            break;
+        }
+
+        // Redirect the collapsed vertices and drop the triangles that became degenerate.
+        size_t write = 0;
+        for (size_t i = 0; i < result.size(); i += 3)
+        {
+            uint32_t triangle[3];
+            for (int corner = 0; corner < 3; ++corner)
+            {
+                uint32_t index = result[i + corner];
+                uint32_t target = collapseTarget[weld[index]];
+                triangle[corner] = target != UINT_MAX ? target : index;
+            }
+            if (weld[triangle[0]] == weld[triangle[1]] || weld[triangle[1]] == weld[triangle[2]] || weld[triangle[0]] == weld[triangle[2]])
+            {
+                continue;
+            }
+            result[write++] = triangle[0];
+            result[write++] = triangle[1];
+            result[write++] = triangle[2];
+        }
+        result.resize(write);
+    }
+
+    if (resultError)
+    {
+        *resultError = extent > 0.0f ? static_cast<float>(sqrt(maxError)) / extent : 0.0f;
+    }
+    return result;
+}
+
+void Util::GenerateLodChain(const MeshData& mesh, LodChain& chain, UINT maxLods)
+{
+    // Per level limit, the coarse levels only get picked once their error is below a pixel anyway.
+    const float maxLevelError = 0.1f;
+
+    chain.indices = mesh.indices;
+    chain.lods.assign(1, MeshLod{ 0, static_cast<uint32_t>(mesh.indices.size()), 0.0f });
+
+    const TriangleGrid grid(mesh.indices, mesh.vertices);
+    std::vector<uint32_t> current = mesh.indices;
+    float error = 0.0f;
+    while (chain.lods.size() < maxLods)
+    {
+        std::vector<uint32_t> simplified = SimplifyMesh(current, mesh.vertices, current.size() / 6 * 3, maxLevelError);
+
+        // A level that saves less than a quarter of the triangles isn't worth its memory.
+        if (simplified.empty() || simplified.size() > current.size() * 3 / 4)
+        {
+            break;
+        }
+        OptimizeVertexCache(simplified, mesh.vertices.size());
+
+        // The quadric error is an area weighted average, it doesn't bound how far the triangles get
+        // from the full mesh. Measure that instead, clamped so coarser levels never report less.
+        error = std::max(error, MeasureDistance(grid, simplified, mesh.vertices));
+        chain.lods.push_back(MeshLod{ static_cast<uint32_t>(chain.indices.size()), static_cast<uint32_t>(simplified.size()), error });
+        chain.indices.insert(chain.indices.end(), simplified.begin(), simplified.end());
+        current.swap(simplified);
+    }
+
+    chain.meshlets.resize(chain.lods.size());
+    for (size_t level = 0; level < chain.lods.size(); ++level)
+    {
+        const MeshLod& lod = chain.lods[level];
+        BuildMeshlets(chain.indices.data() + lod.indexOffset, lod.indexCount, mesh.vertices, chain.meshlets[level]);
+    }
+}
+
+void Util::GenerateLodChains(const std::vector<const MeshData*>& meshes, std::vector<LodChain>& chains, UINT maxLods)
+{
+    chains.resize(meshes.size());
+
+    // Meshes vary a lot in size, one job each lets idle threads steal the ones that are still queued.
+    Jobs::ParallelFor(static_cast<UINT>(meshes.size()), 1, [&](UINT begin, UINT end)
+    {
+        for (UINT mesh = begin; mesh < end; ++mesh)
+        {
+            GenerateLodChain(*meshes[mesh], chains[mesh], maxLods);
+        }
+    });
+}
+
+UINT Util::SelectLod(const std::vector<MeshLod>& lods, float viewDepth, float projectionScale, float pixelThreshold)
+{
+    if (viewDepth <= 0.0f)
+    {
+        return 0;
+    }
+
+    // Errors grow with each level, so the first one that is too coarse ends the search.
+    UINT level = 0;
+    for (UINT i = 1; i < lods.size(); ++i)
+    {
+        if (lods[i].error * projectionScale / viewDepth > pixelThreshold)
+        {
+            break;
+        }
+        level = i;
+    }
+    return level;
+}
\ No newline at end of file
@@ -0,0 +1,350 @@
+#include "pch.hpp"
+
+#include "pipeline_cache.hpp"
+
+#include "dx12_helpers.hpp"
+#include "hash_util.hpp"
+
+#ifndef _SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING
+#define _SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING
+#endif
+#include <experimental/filesystem>
+#include <fstream>
+
+namespace fs = std::experimental::filesystem;
+
+using namespace Util;
+using namespace Microsoft::WRL;
+
+namespace
+{
+    // Walks a pipeline state stream and folds the contents of every subobject into a hash.
+    // Pointers are followed so that two streams built from separate (but identical) allocations hash the same.
+    struct PipelineStreamHasher : public ID3DX12PipelineParserCallbacks
+    {
+        const std::unordered_map<ID3D12RootSignature*, uint64_t>& rootSignatureHashes;
+        uint64_t hash = HASH_SEED;
+        bool valid = true;
+
+        explicit PipelineStreamHasher(const std::unordered_map<ID3D12RootSignature*, uint64_t>& hashes)
+            : rootSignatureHashes(hashes)
+        {}
+
+        void Tag(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE type) { hash = HashValue(type, hash); }
+        void Bytecode(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE type, const D3D12_SHADER_BYTECODE& bytecode)
+        {
+            Tag(type);
+            hash = HashValue(bytecode.BytecodeLength, hash);
+            hash = HashBytes(bytecode.pShaderBytecode, bytecode.BytecodeLength, hash);
+        }
+
+        void FlagsCb(D3D12_PIPELINE_STATE_FLAGS flags) override { Tag(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_FLAGS); hash = HashValue(flags, hash); }
+        void NodeMaskCb(UINT nodeMask) override { Tag(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_NODE_MASK); hash = HashValue(nodeMask, hash); }
+        void RootSignatureCb(ID3D12RootSignature* rootSignature) override
+        {
+            Tag(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_ROOT_SIGNATURE);
+            auto it = rootSignatureHashes.find(rootSignature);
+            if (it == rootSignatureHashes.end())
+            {
+                // A root signature that didn't come from the cache has no stable identity.
+                valid = false;
+                return;
+            }
+            hash = HashValue(it->second, hash);
+        }
+        void InputLayoutCb(const D3D12_INPUT_LAYOUT_DESC& inputLayout) override
+        {
+            Tag(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_INPUT_LAYOUT);
+            hash = HashValue(inputLayout.NumElements, hash);
+            for (UINT i = 0; i < inputLayout.NumElements; ++i)
+            {
+                const D3D12_INPUT_ELEMENT_DESC& element = inputLayout.pInputElementDescs[i];
+                hash = HashString(element.SemanticName, hash);
+                hash = HashValue(element.SemanticIndex, hash);
+                hash = HashValue(element.Format, hash);
+                hash = HashValue(element.InputSlot, hash);
+                hash = HashValue(element.AlignedByteOffset, hash);
+                hash = HashValue(element.InputSlotClass, hash);
+                hash = HashValue(element.InstanceDataStepRate, hash);
+            }
+        }
+        void IBStripCutValueCb(D3D12_INDEX_BUFFER_STRIP_CUT_VALUE value) override { Tag(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_IB_STRIP_CUT_VALUE); hash = HashValue(value, hash); }
+        void PrimitiveTopologyTypeCb(D3D12_PRIMITIVE_TOPOLOGY_TYPE type) override { Tag(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_PRIMITIVE_TOPOLOGY); hash = HashValue(type, hash); }
+        void VSCb(const D3D12_SHADER_BYTECODE& bytecode) override { Bytecode(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_VS, bytecode); }
+        void GSCb(const D3D12_SHADER_BYTECODE& bytecode) override { Bytecode(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_GS, bytecode); }
+        void HSCb(const D3D12_SHADER_BYTECODE& bytecode) override { Bytecode(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_HS, bytecode); }
+        void DSCb(const D3D12_SHADER_BYTECODE& bytecode) override { Bytecode(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_DS, bytecode); }
+        void PSCb(const D3D12_SHADER_BYTECODE& bytecode) override { Bytecode(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_PS, bytecode); }
+        void CSCb(const D3D12_SHADER_BYTECODE& bytecode) override { Bytecode(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_CS, bytecode); }
+        void StreamOutputCb(const D3D12_STREAM_OUTPUT_DESC& streamOutput) override
+        {
+            Tag(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_STREAM_OUTPUT);
+            hash = HashValue(streamOutput.NumEntries, hash);
+            for (UINT i = 0; i < streamOutput.NumEntries; ++i)
+            {
+                const D3D12_SO_DECLARATION_ENTRY& entry = streamOutput.pSODeclaration[i];
+                hash = HashValue(entry.Stream, hash);
+                hash = HashString(entry.SemanticName, hash);
+                hash = HashValue(entry.SemanticIndex, hash);
+                hash = HashValue(entry.StartComponent, hash);
+                hash = HashValue(entry.ComponentCount, hash);
+                hash = HashValue(entry.OutputSlot, hash);
+            }
+            hash = HashBytes(streamOutput.pBufferStrides, streamOutput.NumStrides * sizeof(UINT), hash);
+            hash = HashValue(streamOutput.RasterizedStream, hash);
+        }
+        void BlendStateCb(const D3D12_BLEND_DESC& blendState) override
+        {
+            // Hashed per field: RenderTargetWriteMask is a UINT8, so every render target entry ends in padding.
+            Tag(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_BLEND);
+            hash = HashValue(blendState.AlphaToCoverageEnable, hash);
+            hash = HashValue(blendState.IndependentBlendEnable, hash);
+
+            // Without independent blending only the first entry is used, the others may hold anything.
+            UINT renderTargetCount = blendState.IndependentBlendEnable ? D3D12_SIMULTANEOUS_RENDER_TARGET_COUNT : 1;
+            for (UINT i = 0; i < renderTargetCount; ++i)
+            {
+                const D3D12_RENDER_TARGET_BLEND_DESC& renderTarget = blendState.RenderTarget[i];
+                hash = HashValue(renderTarget.BlendEnable, hash);
+                hash = HashValue(renderTarget.LogicOpEnable, hash);
+                hash = HashValue(renderTarget.SrcBlend, hash);
+                hash = HashValue(renderTarget.DestBlend, hash);
+                hash = HashValue(renderTarget.BlendOp, hash);
+                hash = HashValue(renderTarget.SrcBlendAlpha, hash);
+                hash = HashValue(renderTarget.DestBlendAlpha, hash);
+                hash = HashValue(renderTarget.BlendOpAlpha, hash);
+                hash = HashValue(renderTarget.LogicOp, hash);
+                hash = HashValue(renderTarget.RenderTargetWriteMask, hash);
+            }
+        }
+        void DepthStencilStateCb(const D3D12_DEPTH_STENCIL_DESC& depthStencil) override
+        {
+            DepthStencilState1Cb(CD3DX12_DEPTH_STENCIL_DESC1(depthStencil));
+        }
+        void DepthStencilState1Cb(const D3D12_DEPTH_STENCIL_DESC1& depthStencil) override
+        {
+            // Hashed per field: the UINT8 stencil masks leave padding that isn't guaranteed to be zeroed.
+            Tag(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_DEPTH_STENCIL1);
+            hash = HashValue(depthStencil.DepthEnable, hash);
+            hash = HashValue(depthStencil.DepthWriteMask, hash);
+            hash = HashValue(depthStencil.DepthFunc, hash);
+            hash = HashValue(depthStencil.StencilEnable, hash);
+            hash = HashValue(depthStencil.StencilReadMask, hash);
+            hash = HashValue(depthStencil.StencilWriteMask, hash);
+            hash = HashValue(depthStencil.FrontFace, hash);
+            hash = HashValue(depthStencil.BackFace, hash);
+            hash = HashValue(depthStencil.DepthBoundsTestEnable, hash);
+        }
+        void DSVFormatCb(DXGI_FORMAT format) override { Tag(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_DEPTH_STENCIL_FORMAT); hash = HashValue(format, hash); }
+        void RasterizerStateCb(const D3D12_RASTERIZER_DESC& rasterizer) override { Tag(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_RASTERIZER); hash = HashValue(rasterizer, hash); }
+        void RTVFormatsCb(const D3D12_RT_FORMAT_ARRAY& formats) override
+        {
+            // Unused slots are left as they are by the caller, so only hash the active ones.
+            Tag(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_RENDER_TARGET_FORMATS);
+            hash = HashValue(formats.NumRenderTargets, hash);
+            hash = HashBytes(formats.RTFormats, formats.NumRenderTargets * sizeof(DXGI_FORMAT), hash);
+        }
+        void SampleDescCb(const DXGI_SAMPLE_DESC& sampleDesc) override { Tag(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_SAMPLE_DESC); hash = HashValue(sampleDesc, hash); }
+        void SampleMaskCb(UINT sampleMask) override { Tag(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_SAMPLE_MASK); hash = HashValue(sampleMask, hash); }
+        // A cached blob is an input to compilation, not part of the pipeline's identity.
+        void CachedPSOCb(const D3D12_CACHED_PIPELINE_STATE&) override {}
+
+        void ErrorBadInputParameter(UINT) override { valid = false; }
+        void ErrorDuplicateSubobject(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE) override { valid = false; }
+        void ErrorUnknownSubobject(UINT) override { valid = false; }
+    };
+
+    std::wstring PipelineName(uint64_t hash)
+    {
+        std::string name = HashToString(hash);
+        return std::wstring(name.begin(), name.end());
+    }
+}
+
+PipelineCache::PipelineCache(ComPtr<ID3D12Device2>& device, const std::wstring& libraryPath)
+    : _device(device)
+    , _libraryPath(libraryPath)
+    , _libraryDirty(false)
+    , _hitCount(0)
+    , _libraryHitCount(0)
+    , _missCount(0)
+{
+    OpenLibrary();
+}
+
+PipelineCache::~PipelineCache()
+{
+    Save();
+}
+
+uint64_t PipelineCache::HashPipelineStream(const D3D12_PIPELINE_STATE_STREAM_DESC& desc,
+    const std::unordered_map<ID3D12RootSignature*, uint64_t>& rootSignatureHashes)
+{
+    PipelineStreamHasher hasher(rootSignatureHashes);
+    ThrowIfFailed(D3DX12ParsePipelineStream(desc, &hasher));
+    if (!hasher.valid)
+    {
+        throw std::exception("Pipeline state stream can't be hashed.");
+    }
+
+    return hasher.hash;
+}
+
+ComPtr<ID3D12RootSignature> PipelineCache::GetRootSignature(const ComPtr<ID3DBlob>& serializedSignature)
+{
+    uint64_t hash = HashBytes(serializedSignature->GetBufferPointer(), serializedSignature->GetBufferSize());
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _rootSignatures.find(hash);
+    if (it != _rootSignatures.end())
+    {
+        return it->second;
+    }
+
+    ComPtr<ID3D12RootSignature> rootSignature;
+    ThrowIfFailed(_device->CreateRootSignature(0, serializedSignature->GetBufferPointer(), serializedSignature->GetBufferSize(), IID_PPV_ARGS(&rootSignature)));
+
+    _rootSignatures.emplace(hash, rootSignature);
+    _rootSignatureHashes.emplace(rootSignature.Get(), hash);
+    return rootSignature;
+}
+
+ComPtr<ID3D12PipelineState> PipelineCache::GetPipelineState(const D3D12_PIPELINE_STATE_STREAM_DESC& desc)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    uint64_t hash = HashPipelineStream(desc, _rootSignatureHashes);
+    auto it = _pipelineStates.find(hash);
+    if (it != _pipelineStates.end())
+    {
+        _hitCount++;
+        return it->second;
+    }
+
+    // Another thread is already creating this pipeline, wait for it instead of compiling it twice.
+    auto pending = _pendingPipelineStates.find(hash);
+    if (pending != _pendingPipelineStates.end())
+    {
+        _hitCount++;
+        std::shared_future<ComPtr<ID3D12PipelineState>> creation = pending->second;
+        lock.unlock();
+        return creation.get();
+    }
+
+    std::promise<ComPtr<ID3D12PipelineState>> promise;
+    _pendingPipelineStates.emplace(hash, promise.get_future().share());
+    lock.unlock();
+
+    // Loading and compiling happen outside the lock, so unrelated pipelines are created in parallel.
+    // The pending entry makes this the only thread touching this name in the library, which is the one
+    // case ID3D12PipelineLibrary leaves to the caller to synchronize.
+    ComPtr<ID3D12PipelineState> pipelineState;
+    std::wstring name = PipelineName(hash);
+    bool loaded = false;
+    try
+    {
+        // Try the library first, only compile when the pipeline has never been stored before.
+        // E_INVALIDARG means it isn't in the library (or the description doesn't match what was stored).
+        loaded = _library && SUCCEEDED(_library->LoadPipeline(name.c_str(), &desc, IID_PPV_ARGS(&pipelineState)));
+        if (!loaded)
+        {
+            ThrowIfFailed(_device->CreatePipelineState(&desc, IID_PPV_ARGS(&pipelineState)));
+        }
+    }
+    catch (...)
+    {
+        // Waiters get the same exception, a later call tries again.
+        lock.lock();
+        _pendingPipelineStates.erase(hash);
+        lock.unlock();
+        promise.set_exception(std::current_exception());
+        throw;
+    }
+
+    lock.lock();
+    if (loaded)
+    {
+        _libraryHitCount++;
+    }
+    else
+    {
+        _missCount++;
+
+        // Serialize() in Save() runs under the same lock, it never sees a half stored pipeline.
+        if (_library && SUCCEEDED(_library->StorePipeline(name.c_str(), pipelineState.Get())))
+        {
+            _libraryDirty = true;
+        }
+    }
+    _pipelineStates.emplace(hash, pipelineState);
+    _pendingPipelineStates.erase(hash);
+    lock.unlock();
+
+    promise.set_value(pipelineState);
+    return pipelineState;
+}
+
+void PipelineCache::Save()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_library || !_libraryDirty)
+    {
+        return;
+    }
+
+    std::vector<char> data(_library->GetSerializedSize());
+    if (FAILED(_library->Serialize(data.data(), data.size())))
+    {
+        return;
+    }
+
+    fs::path filePath(_libraryPath);
+    if (filePath.has_parent_path())
+    {
+        fs::create_directories(filePath.parent_path());
+    }
+
+    // Write next to the old file first, a crash halfway through shouldn't leave a corrupt library behind.
+    fs::path tempPath = filePath;
+    tempPath += L".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file.write(data.data(), data.size()))
+        {
+            return;
+        }
+    }
+    std::error_code error;
+    fs::rename(tempPath, filePath, error);
+
+    _libraryDirty = false;
+}
+
+void PipelineCache::OpenLibrary()
+{
+    fs::path filePath(_libraryPath);
+    if (fs::exists(filePath))
+    {
+        std::ifstream file(filePath, std::ios::binary);
+        _libraryData.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    HRESULT hr = E_FAIL;
+    if (!_libraryData.empty())
+    {
+        hr = _device->CreatePipelineLibrary(_libraryData.data(), _libraryData.size(), IID_PPV_ARGS(&_library));
+    }
+
+    // A driver or adapter change invalidates the blob (D3D12_ERROR_DRIVER_VERSION_MISMATCH / D3D12_ERROR_ADAPTER_NOT_FOUND),
+    // in that case start over with an empty library that gets rewritten on Save().
+    if (FAILED(hr))
+    {
+        _libraryData.clear();
+        _library.Reset();
+        if (FAILED(_device->CreatePipelineLibrary(nullptr, 0, IID_PPV_ARGS(&_library))))
+        {
+            // Pipeline libraries are optional (e.g. some older drivers), runtime deduplication still works without one.
+            _library.Reset();
+        }
+    }
+}
\ No newline at end of file
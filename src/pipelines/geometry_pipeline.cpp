@@ -8,6 +8,13 @@
 #include "command_queue.hpp"
 #include "renderer.hpp"
 #include "camera.hpp"
+#include "pipeline_cache.hpp"
+#include "shader_permutations.hpp"
+#include "texture_streamer.hpp"
+#include "job_system.hpp"
+#include "command_context.hpp"
+
+#include <algorithm>
 
 using namespace Util;
 using namespace Microsoft::WRL;
@@ -15,55 +22,91 @@ using namespace Microsoft::WRL;
 GeometryPipeline::GeometryPipeline(Renderer& renderer, std::shared_ptr<Camera>& camera)
     : _renderer(renderer)
     , _camera(camera)
+    , _instanceBufferData(nullptr)
+    , _maxInstanceCount(0)
+    , _albedoTexture(TextureStreamer::INVALID_TEXTURE)
+    , _albedoUvDensity(0.0f)
 {
-    CreatePipeline();
-    InitializeAssets();
+    std::fill(std::begin(_albedoViewVersions), std::end(_albedoViewVersions), UINT_MAX);
+
+    // Nothing touches the device here, the renderer runs the initialization steps once the
+    // objects they need exist.
+    _scene = std::make_unique<GeometryScene>();
 }
 
 GeometryPipeline::~GeometryPipeline()
 {
+    if (_instanceBuffer)
+    {
+        _instanceBuffer->Unmap(0, nullptr);
+    }
+}
 
+void GeometryPipeline::PopulateCommandlist(CommandContext& context)
+{
+    // Update() pointed this frame's albedo view at the resident mips.
+    DrawBindings bindings;
+    bindings.pipelineState = _albedoViewVersions[_renderer._frameIndex] != UINT_MAX ? _albedoPipelineState.Get() : _pipelineState.Get();
+    bindings.rootSignature = _rootSignature.Get();
+    bindings.vertexBufferView = _vertexBufferView;
+    bindings.indexBufferView = _indexBufferView;
+    bindings.positionQuantization = _positionQuantization;
+    bindings.srvHeap = _renderer._srvHeap.Get();
+    bindings.textureTable = CD3DX12_GPU_DESCRIPTOR_HANDLE(_renderer._srvHeap->GetGPUDescriptorHandleForHeapStart(),
+        _renderer._frameIndex * 2, _renderer._srvDescriptorSize);
+    bindings.instanceData = _instanceBuffer->GetGPUVirtualAddress() +
+        static_cast<UINT64>(_renderer._frameIndex) * _maxInstanceCount * sizeof(XMFLOAT4X4);
+    RecordDraws(context, bindings, *_scene, *_camera);
 }
 
-void GeometryPipeline::PopulateCommandlist(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2>& commandList)
+void GeometryPipeline::RecordDraws(CommandContext& context, const DrawBindings& bindings, const GeometryScene& scene, const Camera& camera)
 {
     // Set necessary stuff.
-    commandList->SetPipelineState(_pipelineState.Get());
-    commandList->SetGraphicsRootSignature(_rootSignature.Get());
+    context.SetPipelineState(bindings.pipelineState);
+    context.SetGraphicsRootSignature(bindings.rootSignature);
 
     // Start recording.
-    commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-    commandList->IASetVertexBuffers(0, 1, &_vertexBufferView);
-    commandList->IASetIndexBuffer(&_indexBufferView);
-    //commandList->SetGraphicsRootDescriptorTable(1, _renderer._srvHeap->GetGPUDescriptorHandleForHeapStart());
+    context.SetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    context.SetVertexBuffer(bindings.vertexBufferView);
+    context.SetIndexBuffer(bindings.indexBufferView);
+
+    context.SetDescriptorHeap(bindings.srvHeap);
+    context.SetGraphicsRootDescriptorTable(1, bindings.textureTable);
 
-    // Update the MVP matrix
-    XMMATRIX mvpMatrix = XMMatrixMultiply(_camera->model, _camera->view);
-    mvpMatrix = XMMatrixMultiply(mvpMatrix, _camera->projection);
-    commandList->SetGraphicsRoot32BitConstants(0, sizeof(XMMATRIX) / 4, &mvpMatrix, 0);
+    // Update the view projection matrix, the model part comes from each instance's world matrix.
+    XMMATRIX viewProjectionMatrix = XMMatrixMultiply(camera.model, camera.view);
+    viewProjectionMatrix = XMMatrixMultiply(viewProjectionMatrix, camera.projection);
+    context.SetGraphicsRoot32BitConstants(0, sizeof(XMMATRIX) / 4, &viewProjectionMatrix, 0);
+    context.SetGraphicsRoot32BitConstants(3, sizeof(PositionQuantization) / 4, &bindings.positionQuantization, 0);
 
-    commandList->DrawIndexedInstanced(_indexCount, 1, 0, 0, 0);
+    // One instanced draw per LOD, each reading its own range of this frame's instance slice.
+    scene.RecordDraws(context, 2, bindings.instanceData);
 }
 
 void GeometryPipeline::Update(float deltaTime)
 {
-    static double totalTime = 0.0f;
-    totalTime += deltaTime;
-    if (totalTime > 4.0f)
+    // The frame this slice belongs to was waited on at the end of the previous Render().
+    XMFLOAT4X4* instanceData = reinterpret_cast<XMFLOAT4X4*>(_instanceBufferData) + static_cast<size_t>(_renderer._frameIndex) * _maxInstanceCount;
+    _scene->Update(deltaTime, *_camera, _renderer._aspectRatio, _renderer._height, instanceData);
+
+    // The nearest visible cube decides how sharp the albedo texture has to be.
+    TextureStreamer& textureStreamer = *_renderer._textureStreamer;
+    if (_scene->GetVisibleCount() > 0)
     {
-        totalTime = 0.0f;
+        float projectionScale = XMVectorGetY(_camera->projection.r[1]) * _renderer._height * 0.5f;
+        textureStreamer.RequestForObject(_albedoTexture, _albedoUvDensity, _scene->GetNearestVisibleDepth(), projectionScale);
     }
 
-    // Update the model matrix.
-    float angle = static_cast<float>(totalTime * 90.0);
-    const XMVECTOR rotationAxis = XMVectorSet(0, 1, 1, 0);
-    _camera->model = XMMatrixRotationAxis(rotationAxis, XMConvertToRadians(angle));
-
-    // Update the view matrix.
-    _camera->view = XMMatrixLookAtLH(_camera->position, _camera->position + _camera->front, _camera->up);
-
-    // Update the projection matrix.
-    _camera->projection = XMMatrixPerspectiveFovLH(XMConvertToRadians(_camera->fov), _renderer._aspectRatio, 0.1f, 100.0f);
+    // Mips stream in smallest first. Move this frame's albedo view to the ones that are resident now,
+    // its table was last read by the same frame, which is done as well.
+    UINT& viewVersion = _albedoViewVersions[_renderer._frameIndex];
+    if (textureStreamer.IsResident(_albedoTexture) && textureStreamer.GetViewVersion(_albedoTexture) != viewVersion)
+    {
+        CD3DX12_CPU_DESCRIPTOR_HANDLE srvHandle(_renderer._srvHeap->GetCPUDescriptorHandleForHeapStart(), _renderer._frameIndex * 2,
+            _renderer._srvDescriptorSize);
+        textureStreamer.CreateShaderResourceView(_albedoTexture, srvHandle);
+        viewVersion = textureStreamer.GetViewVersion(_albedoTexture);
+    }
 }
 
 void GeometryPipeline::CreatePipeline()
@@ -78,11 +121,14 @@ void GeometryPipeline::CreatePipeline()
         D3D12_ROOT_SIGNATURE_FLAG_DENY_DOMAIN_SHADER_ROOT_ACCESS |
         D3D12_ROOT_SIGNATURE_FLAG_DENY_GEOMETRY_SHADER_ROOT_ACCESS;
 
-    CD3DX12_DESCRIPTOR_RANGE textureDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 0, D3D12_DESCRIPTOR_RANGE_FLAG_DESCRIPTORS_VOLATILE);
+    // Albedo (t0) and normal map (t1), only sampled by the permutations that enable them.
+    CD3DX12_DESCRIPTOR_RANGE textureDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 2, 0, 0, 0);
 
-    CD3DX12_ROOT_PARAMETER rootParameters[2];
+    CD3DX12_ROOT_PARAMETER rootParameters[4];
     rootParameters[0].InitAsConstants(sizeof(DirectX::XMMATRIX) / 4, 0, 0, D3D12_SHADER_VISIBILITY_VERTEX);
     rootParameters[1].InitAsDescriptorTable(1, &textureDescriptorRange, D3D12_SHADER_VISIBILITY_PIXEL);
+    rootParameters[2].InitAsShaderResourceView(0, 1, D3D12_SHADER_VISIBILITY_VERTEX); // instance transforms
+    rootParameters[3].InitAsConstants(sizeof(PositionQuantization) / 4, 1, 0, D3D12_SHADER_VISIBILITY_VERTEX);
 
     CD3DX12_STATIC_SAMPLER_DESC albedoSampler;
     albedoSampler.Init(0);
@@ -94,13 +140,9 @@ void GeometryPipeline::CreatePipeline()
     ComPtr<ID3DBlob> signature;
     ComPtr<ID3DBlob> error;
     ThrowIfFailed(D3D12SerializeRootSignature(&rootSignatureDesc, D3D_ROOT_SIGNATURE_VERSION_1, &signature, &error));
-    ThrowIfFailed(_renderer._device->CreateRootSignature(0, signature->GetBufferPointer(), signature->GetBufferSize(), IID_PPV_ARGS(&_rootSignature)));
-
-
-    // Create the pipeline state, which includes compiling and loading shaders.
-    ComPtr<ID3DBlob> vertexShader;
-    ComPtr<ID3DBlob> pixelShader;
+    _rootSignature = _renderer._pipelineCache->GetRootSignature(signature);
 
+    // Set up the uber shader permutations, nothing gets compiled until a material requests a variant.
 #if defined(_DEBUG)
     // Enable better shader debugging with the graphics debugging tools.
     UINT compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
@@ -108,16 +150,57 @@ void GeometryPipeline::CreatePipeline()
     UINT compileFlags = 0;
 #endif
 
-    ThrowIfFailed(D3DCompileFromFile(L"assets/shaders/uber_vs.hlsl", nullptr, nullptr, "main", "vs_5_0", compileFlags, 0, &vertexShader, nullptr));
-    ThrowIfFailed(D3DCompileFromFile(L"assets/shaders/uber_ps.hlsl", nullptr, nullptr, "main", "ps_5_0", compileFlags, 0, &pixelShader, nullptr));
+    _vertexShaders = std::make_unique<ShaderPermutations>(*_renderer._shaderCache,
+        ShaderDesc{ L"assets/shaders/uber_vs.hlsl", "main", "vs_5_0", {}, compileFlags },
+        SHADER_FEATURE_NORMAL_MAP);
+    _pixelShaders = std::make_unique<ShaderPermutations>(*_renderer._shaderCache,
+        ShaderDesc{ L"assets/shaders/uber_ps.hlsl", "main", "ps_5_0", {}, compileFlags },
+        SHADER_FEATURE_ALBEDO_TEXTURE | SHADER_FEATURE_NORMAL_MAP | SHADER_FEATURE_ALPHA_TEST);
+}
+
+ComPtr<ID3D12PipelineState> GeometryPipeline::GetPipelineState(uint32_t features)
+{
+    features = _pixelShaders->Resolve(features);
+    auto it = _pipelineStates.find(features);
+    if (it != _pipelineStates.end())
+    {
+        return it->second;
+    }
 
-    // Define the vertex input layout.
-    D3D12_INPUT_ELEMENT_DESC inputElementDescs[] =
+    // Compile (or fetch) both stages of this permutation concurrently.
+    ShaderBytecode vertexShader;
+    std::exception_ptr vertexShaderError;
+    Jobs::Counter vertexShaderDone;
+    Jobs::Run([this, features, &vertexShader, &vertexShaderError]()
     {
-        { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-        { "NORMAL",   0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-        { "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT,    0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-    };
+        try
+        {
+            vertexShader = _vertexShaders->Get(features);
+        }
+        catch (...)
+        {
+            vertexShaderError = std::current_exception();
+        }
+    }, &vertexShaderDone);
+    ShaderBytecode pixelShader;
+    try
+    {
+        pixelShader = _pixelShaders->Get(features);
+    }
+    catch (...)
+    {
+        // The job writes into this frame, it has to finish before the exception leaves.
+        Jobs::Wait(vertexShaderDone);
+        throw;
+    }
+    Jobs::Wait(vertexShaderDone);
+    if (vertexShaderError)
+    {
+        std::rethrow_exception(vertexShaderError);
+    }
+
+    // Vertices are stored quantized, see Util::QuantizedVertex.
+    const D3D12_INPUT_ELEMENT_DESC* inputElementDescs = QUANTIZED_VERTEX_INPUT_LAYOUT;
 
     // Describe and create the graphics pipeline state object (PSO).
     struct PipelineStateStream
@@ -136,62 +219,110 @@ void GeometryPipeline::CreatePipeline()
     rtvFormats.RTFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
 
     pipelineStateStream.pRootSignature = _rootSignature.Get();
-    pipelineStateStream.InputLayout = { inputElementDescs, _countof(inputElementDescs) };
+    pipelineStateStream.InputLayout = { inputElementDescs, _countof(QUANTIZED_VERTEX_INPUT_LAYOUT) };
     pipelineStateStream.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
-    pipelineStateStream.VS = CD3DX12_SHADER_BYTECODE(vertexShader.Get());
-    pipelineStateStream.PS = CD3DX12_SHADER_BYTECODE(pixelShader.Get());
+    pipelineStateStream.VS = CD3DX12_SHADER_BYTECODE(vertexShader->data(), vertexShader->size());
+    pipelineStateStream.PS = CD3DX12_SHADER_BYTECODE(pixelShader->data(), pixelShader->size());
     pipelineStateStream.DSVFormat = DXGI_FORMAT_D32_FLOAT;
     pipelineStateStream.RTVFormats = rtvFormats;
 
     D3D12_PIPELINE_STATE_STREAM_DESC pipelineStateStreamDesc = {
         sizeof(PipelineStateStream), &pipelineStateStream
     };
-    ThrowIfFailed(_renderer._device->CreatePipelineState(&pipelineStateStreamDesc, IID_PPV_ARGS(&_pipelineState)));
+    ComPtr<ID3D12PipelineState> pipelineState = _renderer._pipelineCache->GetPipelineState(pipelineStateStreamDesc);
+    _pipelineStates.emplace(features, pipelineState);
+
+    return pipelineState;
+}
+
+void GeometryPipeline::CreatePipelineStates()
+{
+    // Resolve the material's shader variants up front: the base permutation draws until the albedo
+    // texture's first mip arrives, so the switch doesn't stall a frame on a pipeline compile.
+    Material material;
+    material.features = SHADER_FEATURE_NONE;
+    _pipelineState = GetPipelineState(material.features);
+    _albedoPipelineState = GetPipelineState(material.features | SHADER_FEATURE_ALBEDO_TEXTURE);
+
+    _vertexShaders->Report(stdout);
+    _pixelShaders->Report(stdout);
 }
 
-void GeometryPipeline::InitializeAssets()
+void GeometryPipeline::UploadMesh()
 {
     auto commandList = _renderer._copyCommandQueue->GetCommandList();
 
-    std::vector<Vertex> cubeVertices;
-    std::vector<uint16_t> cubeIndices;
-    CreateCube(cubeVertices, cubeIndices, 1.0f);
-    
-    // Create the vertex buffer.
+    // The cube with all its LOD levels back to back in the index buffer.
+    MeshData mesh;
+    _scene->CreateMesh(mesh);
+    _albedoUvDensity = ComputeUvDensity(mesh);
+
+    // Create the vertex buffer, at half the size of the float vertices.
+    _positionQuantization = ComputePositionQuantization(mesh.vertices);
+    std::vector<QuantizedVertex> vertices = QuantizeVertices(mesh.vertices, _positionQuantization);
     ComPtr<ID3D12Resource> intermediateVertexBuffer;
     LoadBufferResource(_renderer._device, commandList,
         &_vertexBuffer, &intermediateVertexBuffer,
-        cubeVertices.size(), sizeof(Vertex), cubeVertices.data());
+        vertices.size(), sizeof(QuantizedVertex), vertices.data());
 
     _vertexBufferView.BufferLocation = _vertexBuffer->GetGPUVirtualAddress();
-    _vertexBufferView.StrideInBytes = sizeof(Vertex);
-    _vertexBufferView.SizeInBytes = sizeof(Vertex) * cubeVertices.size();
+    _vertexBufferView.StrideInBytes = sizeof(QuantizedVertex);
+    _vertexBufferView.SizeInBytes = static_cast<UINT>(sizeof(QuantizedVertex) * vertices.size());
 
-    // Create the index buffer.
+    // Create the index buffer, 16-bit unless the mesh has too many vertices.
+    std::vector<uint8_t> indexData = mesh.GetIndexData();
     ComPtr<ID3D12Resource> intermediateIndexBuffer;
     LoadBufferResource(_renderer._device, commandList,
         &_IndexBuffer, &intermediateIndexBuffer,
-        cubeIndices.size(), sizeof(uint16_t), cubeIndices.data());
-    _indexCount = static_cast<int>(cubeIndices.size());
+        mesh.indices.size(), mesh.GetIndexSize(), indexData.data());
+    _indexCount = static_cast<int>(mesh.indices.size());
 
     _indexBufferView.BufferLocation = _IndexBuffer->GetGPUVirtualAddress();
-    _indexBufferView.Format = DXGI_FORMAT_R16_UINT;
-    _indexBufferView.SizeInBytes = _indexCount * sizeof(uint16_t);
-
-    // Create the texture.
-    ComPtr<ID3D12Resource> intermediateAlbedoBuffer;
-    _albedoTextureHandle = _renderer._srvHeap->GetCPUDescriptorHandleForHeapStart();
-    /*LoadTextureFromFile(_renderer._device, commandList,
-        &_albedoTexture, &intermediateAlbedoBuffer,
-        L"Utila.jpeg");*/
-    _albedoTextureView.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
-    _albedoTextureView.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-    _albedoTextureView.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-    _albedoTextureView.Texture2D.MipLevels = 1;
-    //_renderer._device->CreateShaderResourceView(_albedoTexture.Get(), &_albedoTextureView, _albedoTextureHandle);
-    //_renderer._device->CopyDescriptorsSimple(1, _renderer._srvHeap->GetCPUDescriptorHandleForHeapStart(), _albedoTextureHandle, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+    _indexBufferView.Format = mesh.GetIndexFormat();
+    _indexBufferView.SizeInBytes = static_cast<UINT>(indexData.size());
 
     // Execute list
     uint64_t fenceValue = _renderer._copyCommandQueue->ExecuteCommandList(commandList);
     _renderer._copyCommandQueue->WaitForFenceValue(fenceValue);
+}
+
+void GeometryPipeline::RequestTextures()
+{
+    // The albedo texture goes into the first slot of each frame's table once it is resident (see Update()),
+    // until then both slots hold null views.
+    _albedoTexture = _renderer._textureStreamer->Request(L"assets/cooked/textures/Utila.dds");
+
+    D3D12_SHADER_RESOURCE_VIEW_DESC nullView = {};
+    nullView.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    nullView.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+    nullView.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+    nullView.Texture2D.MipLevels = 1;
+    CD3DX12_CPU_DESCRIPTOR_HANDLE srvHandle(_renderer._srvHeap->GetCPUDescriptorHandleForHeapStart());
+    for (UINT slot = 0; slot < FRAME_COUNT * 2; ++slot)
+    {
+        _renderer._device->CreateShaderResourceView(nullptr, &nullView, srvHandle);
+        srvHandle.Offset(1, _renderer._srvDescriptorSize);
+    }
+}
+
+void GeometryPipeline::CreateInstances()
+{
+    // A block of 10x10x10 spinning cubes in front of the camera.
+    _scene->CreateInstances(10);
+    _maxInstanceCount = _scene->GetInstanceCount();
+
+    // Persistently mapped upload buffer with one slice per frame in flight.
+    CD3DX12_HEAP_PROPERTIES heapProps(D3D12_HEAP_TYPE_UPLOAD);
+    CD3DX12_RESOURCE_DESC resourceDesc = CD3DX12_RESOURCE_DESC::Buffer(
+        static_cast<UINT64>(FRAME_COUNT) * _maxInstanceCount * sizeof(XMFLOAT4X4));
+    ThrowIfFailed(_renderer._device->CreateCommittedResource(
+        &heapProps,
+        D3D12_HEAP_FLAG_NONE,
+        &resourceDesc,
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        IID_PPV_ARGS(&_instanceBuffer)));
+
+    CD3DX12_RANGE readRange(0, 0); // never read on the CPU
+    ThrowIfFailed(_instanceBuffer->Map(0, &readRange, reinterpret_cast<void**>(&_instanceBufferData)));
 }
\ No newline at end of file
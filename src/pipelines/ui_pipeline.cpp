@@ -18,7 +18,7 @@ UIPipeline::~UIPipeline()
 
 }
 
-void UIPipeline::PopulateCommandlist(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2>& commandList)
+void UIPipeline::PopulateCommandlist(CommandContext& context)
 {
 
 }
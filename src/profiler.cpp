@@ -0,0 +1,317 @@
+#include "pch.hpp"
+
+#include "profiler.hpp"
+
+#ifndef _SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING
+#define _SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING
+#endif
+#include <experimental/filesystem>
+#include <algorithm>
+#include <fstream>
+#include <intrin.h>
+
+namespace fs = std::experimental::filesystem;
+
+namespace
+{
+    constexpr uint32_t BINARY_VERSION = 1;
+    constexpr UINT MAX_DEPTH = 64;
+
+    struct ZoneEvent
+    {
+        const char* name;
+        uint64_t start;
+        uint64_t end;
+        UINT depth;
+    };
+
+    struct ThreadRing
+    {
+        DWORD threadId;
+        std::string name; // guarded by g_registryMutex
+
+        // Written by the owning thread only, the index is published after the event.
+        std::atomic<uint64_t> writeIndex;
+        ZoneEvent events[Profiler::RING_SIZE];
+
+        // Zones that are still open, deeper ones are counted but not recorded.
+        UINT depth;
+        const char* openNames[MAX_DEPTH];
+        uint64_t openStarts[MAX_DEPTH];
+    };
+
+    struct ThreadSnapshot
+    {
+        DWORD threadId;
+        std::string name;
+        std::vector<ZoneEvent> events;
+    };
+
+    // Rings are never freed, threads may exit before the export.
+    std::mutex g_registryMutex;
+    std::vector<std::unique_ptr<ThreadRing>> g_rings;
+    thread_local ThreadRing* t_ring = nullptr;
+
+    // The time stamp counter is far cheaper to read than QueryPerformanceCounter, its rate is
+    // measured against it between the first zone and the export.
+    struct Calibration
+    {
+        uint64_t ticks;
+        LARGE_INTEGER counter;
+    };
+    Calibration g_calibrationStart;
+
+    Calibration Calibrate()
+    {
+        Calibration calibration;
+        QueryPerformanceCounter(&calibration.counter);
+        calibration.ticks = __rdtsc();
+        return calibration;
+    }
+
+    double GetTicksPerSecond()
+    {
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+
+        Calibration now = Calibrate();
+        if (now.counter.QuadPart - g_calibrationStart.counter.QuadPart < frequency.QuadPart / 100)
+        {
+            // Too close to the start for a stable rate.
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            now = Calibrate();
+        }
+        double seconds = static_cast<double>(now.counter.QuadPart - g_calibrationStart.counter.QuadPart) / frequency.QuadPart;
+        return (now.ticks - g_calibrationStart.ticks) / seconds;
+    }
+
+    ThreadRing& RegisterThread()
+    {
+        auto ring = std::make_unique<ThreadRing>();
+        ring->threadId = GetCurrentThreadId();
+        ring->writeIndex = 0;
+        ring->depth = 0;
+
+        std::lock_guard<std::mutex> lock(g_registryMutex);
+        if (g_rings.empty())
+        {
+            g_calibrationStart = Calibrate();
+        }
+        g_rings.push_back(std::move(ring));
+        t_ring = g_rings.back().get();
+        return *t_ring;
+    }
+
+    std::vector<ThreadSnapshot> TakeSnapshot()
+    {
+        std::lock_guard<std::mutex> lock(g_registryMutex);
+
+        std::vector<ThreadSnapshot> snapshots;
+        for (const std::unique_ptr<ThreadRing>& ring : g_rings)
+        {
+            ThreadSnapshot snapshot = { ring->threadId, ring->name, {} };
+            uint64_t end = ring->writeIndex.load(std::memory_order_acquire);
+            uint64_t begin = end > Profiler::RING_SIZE ? end - Profiler::RING_SIZE : 0;
+            for (uint64_t index = begin; index < end; ++index)
+            {
+                snapshot.events.push_back(ring->events[index & (Profiler::RING_SIZE - 1)]);
+            }
+
+            // The owner kept going meanwhile, drop what it may have overwritten (including the slot it
+            // could be writing right now).
+            uint64_t written = ring->writeIndex.load(std::memory_order_acquire) + 1;
+            if (written > begin + Profiler::RING_SIZE)
+            {
+                size_t overwritten = static_cast<size_t>(std::min(written - Profiler::RING_SIZE - begin, end - begin));
+                snapshot.events.erase(snapshot.events.begin(), snapshot.events.begin() + overwritten);
+            }
+
+            if (!snapshot.events.empty() || !snapshot.name.empty())
+            {
+                snapshots.push_back(std::move(snapshot));
+            }
+        }
+        return snapshots;
+    }
+
+    // Same as the caches: write a temporary and rename, readers never see half a file.
+    bool ReplaceFile(const fs::path& tempPath, const fs::path& filePath)
+    {
+        std::error_code error;
+        fs::rename(tempPath, filePath, error);
+        return !error;
+    }
+
+    std::string EscapeJson(const char* text)
+    {
+        std::string escaped;
+        for (const char* character = text; *character; ++character)
+        {
+            if (*character == '"' || *character == '\\')
+            {
+                escaped += '\\';
+            }
+            escaped += *character;
+        }
+        return escaped;
+    }
+
+    template<typename T>
+    void WriteValue(std::ofstream& file, const T& value)
+    {
+        file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    void WriteString(std::ofstream& file, const std::string& text)
+    {
+        WriteValue(file, static_cast<uint16_t>(text.size()));
+        file.write(text.data(), text.size());
+    }
+}
+
+void Profiler::BeginZone(const char* name)
+{
+    ThreadRing& ring = t_ring ? *t_ring : RegisterThread();
+    if (ring.depth < MAX_DEPTH)
+    {
+        ring.openNames[ring.depth] = name;
+        ring.openStarts[ring.depth] = __rdtsc();
+    }
+    ring.depth++;
+}
+
+void Profiler::EndZone()
+{
+    uint64_t end = __rdtsc();
+    ThreadRing& ring = *t_ring;
+    UINT depth = --ring.depth;
+    if (depth >= MAX_DEPTH)
+    {
+        return;
+    }
+
+    uint64_t index = ring.writeIndex.load(std::memory_order_relaxed);
+    ring.events[index & (RING_SIZE - 1)] = ZoneEvent{ ring.openNames[depth], ring.openStarts[depth], end, depth };
+    ring.writeIndex.store(index + 1, std::memory_order_release);
+}
+
+void Profiler::SetThreadName(const char* name)
+{
+    ThreadRing& ring = t_ring ? *t_ring : RegisterThread();
+    std::lock_guard<std::mutex> lock(g_registryMutex);
+    ring.name = name;
+}
+
+bool Profiler::WriteChromeTrace(const std::wstring& filePath)
+{
+    std::vector<ThreadSnapshot> snapshots = TakeSnapshot();
+    const double ticksPerMicrosecond = GetTicksPerSecond() * 1e-6;
+
+    // Timestamps start at the earliest zone, the viewer doesn't need absolute tick values.
+    uint64_t origin = UINT64_MAX;
+    for (const ThreadSnapshot& snapshot : snapshots)
+    {
+        for (const ZoneEvent& event : snapshot.events)
+        {
+            origin = std::min(origin, event.start);
+        }
+    }
+
+    fs::path tempPath(filePath);
+    tempPath += L".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::trunc);
+        if (!file)
+        {
+            return false;
+        }
+
+        file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        bool first = true;
+        char line[512];
+        for (const ThreadSnapshot& snapshot : snapshots)
+        {
+            if (!snapshot.name.empty())
+            {
+                snprintf(line, sizeof(line), "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%lu,\"args\":{\"name\":\"%s\"}}",
+                    first ? "" : ",\n", snapshot.threadId, EscapeJson(snapshot.name.c_str()).c_str());
+                file << line;
+                first = false;
+            }
+            for (const ZoneEvent& event : snapshot.events)
+            {
+                snprintf(line, sizeof(line), "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%lu,\"ts\":%.3f,\"dur\":%.3f}",
+                    first ? "" : ",\n", EscapeJson(event.name).c_str(), snapshot.threadId,
+                    (event.start - origin) / ticksPerMicrosecond, (event.end - event.start) / ticksPerMicrosecond);
+                file << line;
+                first = false;
+            }
+        }
+        file << "\n]}\n";
+        if (!file)
+        {
+            return false;
+        }
+    }
+    return ReplaceFile(tempPath, fs::path(filePath));
+}
+
+bool Profiler::WriteBinary(const std::wstring& filePath)
+{
+    std::vector<ThreadSnapshot> snapshots = TakeSnapshot();
+    const double ticksPerSecond = GetTicksPerSecond();
+
+    // Zones repeat every frame, their names are stored once.
+    std::vector<std::string> names;
+    std::unordered_map<std::string, uint32_t> nameIndices;
+    for (const ThreadSnapshot& snapshot : snapshots)
+    {
+        for (const ZoneEvent& event : snapshot.events)
+        {
+            if (nameIndices.emplace(event.name, static_cast<uint32_t>(names.size())).second)
+            {
+                names.push_back(event.name);
+            }
+        }
+    }
+
+    fs::path tempPath(filePath);
+    tempPath += L".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file)
+        {
+            return false;
+        }
+
+        file.write("DBPF", 4);
+        WriteValue(file, BINARY_VERSION);
+        WriteValue(file, ticksPerSecond);
+
+        WriteValue(file, static_cast<uint32_t>(names.size()));
+        for (const std::string& name : names)
+        {
+            WriteString(file, name);
+        }
+
+        WriteValue(file, static_cast<uint32_t>(snapshots.size()));
+        for (const ThreadSnapshot& snapshot : snapshots)
+        {
+            WriteValue(file, static_cast<uint32_t>(snapshot.threadId));
+            WriteString(file, snapshot.name);
+            WriteValue(file, static_cast<uint32_t>(snapshot.events.size()));
+            for (const ZoneEvent& event : snapshot.events)
+            {
+                WriteValue(file, nameIndices[event.name]);
+                WriteValue(file, static_cast<uint32_t>(event.depth));
+                WriteValue(file, event.start);
+                WriteValue(file, event.end - event.start);
+            }
+        }
+        if (!file)
+        {
+            return false;
+        }
+    }
+    return ReplaceFile(tempPath, fs::path(filePath));
+}
\ No newline at end of file
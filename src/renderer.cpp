@@ -13,30 +13,81 @@
 #include "glfw_app.hpp"
 #include "command_queue.hpp"
 #include "camera.hpp"
+#include "pipeline_cache.hpp"
+#include "shader_cache.hpp"
+#include "texture_streamer.hpp"
+#include "frame_allocator.hpp"
+#include "profiler.hpp"
+#include "task_graph.hpp"
+#include "job_system.hpp"
+#include "command_context.hpp"
+#include "frame_capture.hpp"
 
 #include "pipelines/geometry_pipeline.hpp"
 #include "pipelines/ui_pipeline.hpp"
 
 
-Renderer::Renderer(std::shared_ptr<Application> app) :
+Renderer::Renderer(std::shared_ptr<Application> app, bool useWarpDevice) :
 	_app(app),
     _width(_app->GetWidth()),
     _height(_app->GetHeight()),
 	_viewport(0.0f, 0.0f, static_cast<float>(_width), static_cast<float>(_height)),
 	_scissorRect(0, 0, static_cast<LONG>(_width), static_cast<LONG>(_height)),
 	_rtvDescriptorSize(0),
-    _useWarpDevice(false)
+    _useWarpDevice(useWarpDevice)
 {
     _aspectRatio = static_cast<float>(_width) / static_cast<float>(_height);
     _camera = std::make_shared<Camera>();
+    _geometryPipeline = std::make_unique<GeometryPipeline>(*this, _camera);
 
-    InitializeGraphics();
+    // Everything after device creation only waits for what it uses, so shader compiles and pipeline
+    // states overlap with the mesh upload, the swap chain and the other device objects.
+    TaskGraph startup;
+    UINT shaderCache = startup.Add("Shader cache", [this]()
+    {
+        _shaderCache = std::make_unique<ShaderCache>(L"cache/shaders", Util::CompileShader);
+    });
+    UINT device = startup.Add("Device", [this]() { CreateDevice(); });
+    UINT commandQueues = startup.Add("Command queues", [this]()
+    {
+        _directCommandQueue = std::make_unique<CommandQueue>(_device, D3D12_COMMAND_LIST_TYPE_DIRECT);
+        _copyCommandQueue = std::make_unique<CommandQueue>(_device, D3D12_COMMAND_LIST_TYPE_COPY);
+    }, { device });
+    UINT pipelineCache = startup.Add("Pipeline cache", [this]()
+    {
+        // Pipelines compiled in earlier runs are loaded from disk instead of being recompiled.
+        _pipelineCache = std::make_unique<PipelineCache>(_device, L"cache/pipelines.bin");
+    }, { device });
+
+    // DXGI may send messages to the window while creating the swap chain, it has to be created on
+    // the thread that pumps them.
+    UINT swapChain = startup.AddOnCallingThread("Swap chain", [this]() { CreateSwapChain(); }, { commandQueues });
+    UINT descriptorHeaps = startup.Add("Descriptor heaps", [this]() { CreateDescriptorHeaps(); }, { device });
+    startup.Add("Render targets", [this]() { CreateRenderTargets(); }, { swapChain, descriptorHeaps });
+    startup.Add("Depth buffer", [this]() { CreateDepthBuffer(); }, { descriptorHeaps });
+    UINT textureStreamer = startup.Add("Texture streamer", [this]()
+    {
+        // Textures load in the background and upload over the copy queue while frames keep going.
+        _textureStreamer = std::make_unique<TextureStreamer>(_device, *_copyCommandQueue);
+    }, { commandQueues });
+    startup.Add("Frame capture", [this]()
+    {
+        _frameCapture = std::make_unique<FrameCapture>(_device, _width, _height, DXGI_FORMAT_R8G8B8A8_UNORM);
+    }, { device });
 
     // Create pipelines
-    _geometryPipeline = std::make_unique<GeometryPipeline>(*this, _camera);
-    _uiPipeline = std::make_unique<UIPipeline>(*this);
-
-    CreateDepthBuffer();
+    UINT geometryPipeline = startup.Add("Geometry pipeline", [this]() { _geometryPipeline->CreatePipeline(); }, { pipelineCache, shaderCache });
+    startup.Add("Pipeline states", [this]() { _geometryPipeline->CreatePipelineStates(); }, { geometryPipeline });
+    startup.Add("Mesh upload", [this]() { _geometryPipeline->UploadMesh(); }, { commandQueues });
+    startup.Add("Texture requests", [this]() { _geometryPipeline->RequestTextures(); }, { textureStreamer, descriptorHeaps });
+    startup.Add("Instance buffer", [this]() { _geometryPipeline->CreateInstances(); }, { device });
+    startup.Add("UI pipeline", [this]() { _uiPipeline = std::make_unique<UIPipeline>(*this); }, { device });
+
+    startup.Run();
+    startup.Report(stdout, "Renderer startup");
+
+    // Persist right away, so a crash later on doesn't throw away this run's compiled pipelines.
+    _pipelineCache->Save();
 }
 
 Renderer::~Renderer()
@@ -44,43 +95,115 @@ Renderer::~Renderer()
     // Ensure that the GPU is no longer referencing resources that are about to be
     // cleaned up by the destructor.
     Flush();
+
+    // Everything is copied by now, write out what is left.
+    _frameCapture->Update(*_directCommandQueue);
+    _frameCapture->WaitForEncodes();
+    _frameCapture->Report(stdout);
+    _textureStreamer->Report(stdout);
 }
 
 void Renderer::Update(float deltaTime)
 {
-    _geometryPipeline->Update(deltaTime);
+    // Per-frame scratch containers below use FrameVector, nothing in here should hit the heap.
+    FrameMemory::BeginFrame();
+
+    {
+        PROFILE_ZONE("TextureStreamer::Update");
+        _textureStreamer->Update();
+    }
+    {
+        PROFILE_ZONE("GeometryPipeline::Update");
+        _geometryPipeline->Update(deltaTime);
+    }
 }
 
 void Renderer::Render()
 {
-    auto commandList = _directCommandQueue->GetCommandList();
+    // Captures of earlier frames that the GPU is done with go to encode jobs.
+    _frameCapture->Update(*_directCommandQueue);
+
+    // One list for the clears, one for the geometry and one for the capture copy and present transition.
+    // The geometry is recorded on a job while this thread records the other two, every list sets up
+    // its own state. The queue isn't thread safe, so all three are taken from it here.
+    Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandLists[] = {
+        _directCommandQueue->GetCommandList(),
+        _directCommandQueue->GetCommandList(),
+        _directCommandQueue->GetCommandList()
+    };
     CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle = CD3DX12_CPU_DESCRIPTOR_HANDLE(_rtvHeap->GetCPUDescriptorHandleForHeapStart(), _frameIndex, _rtvDescriptorSize);;
     auto dsvHandle = _dsvHeap->GetCPUDescriptorHandleForHeapStart();
-    
+
+    Jobs::Counter geometryRecorded;
+    Jobs::Run([this, &commandLists, rtvHandle, dsvHandle]()
+    {
+        PROFILE_ZONE("GeometryPipeline::PopulateCommandlist");
+        D3D12CommandContext context(commandLists[1].Get());
+        RecordPassSetup(context, rtvHandle, dsvHandle, _viewport, _scissorRect);
+        _geometryPipeline->PopulateCommandlist(context);
+    }, &geometryRecorded);
+
     // Clear targets.
-    Util::TransitionResource(commandList, _renderTargets[_frameIndex].Get(), D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET);
-    commandList->ClearRenderTargetView(rtvHandle, clearColor, 0, nullptr);
-    commandList->ClearDepthStencilView(dsvHandle, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
+    {
+        D3D12CommandContext context(commandLists[0].Get());
+        RecordClear(context, _renderTargets[_frameIndex].Get(), rtvHandle, dsvHandle);
+    }
+    {
+        D3D12CommandContext context(commandLists[2].Get());
 
-    // Record command lists.
-    commandList->OMSetRenderTargets(1, &rtvHandle, FALSE, &dsvHandle);
-    commandList->RSSetViewports(1, &_viewport);
-    commandList->RSSetScissorRects(1, &_scissorRect);
-    _geometryPipeline->PopulateCommandlist(commandList);
+        // Copied into a readback buffer when a capture is due, the copy runs with the rest of the frame.
+        _frameCapture->RecordCopy(context, _renderTargets[_frameIndex].Get(), D3D12_RESOURCE_STATE_RENDER_TARGET);
 
-    // Sync up resource(s) (might need this inbetween some stages later)
-    Util::TransitionResource(commandList, _renderTargets[_frameIndex].Get(), D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT);
+        RecordPresentTransition(context, _renderTargets[_frameIndex].Get());
+    }
 
-    // Execute commandlist.
-    uint64_t fenceValue = _directCommandQueue->ExecuteCommandList(commandList);
-    _fenceValues[_frameIndex] = fenceValue;
+    // Runs the geometry job here if no worker has taken it yet.
+    Jobs::Wait(geometryRecorded);
 
-    // Present the frame.
-    Util::ThrowIfFailed(_swapChain->Present(1, 0));
+    // Execute the command lists.
+    {
+        PROFILE_ZONE("Submit");
+        uint64_t fenceValue = _directCommandQueue->ExecuteCommandLists(commandLists, _countof(commandLists));
+        _fenceValues[_frameIndex] = fenceValue;
+        _frameCapture->Submitted(fenceValue);
+    }
+
+    // Present the frame. With vsync (not on WARP) this blocks when the swap chain is full.
+    {
+        PROFILE_ZONE("Present");
+        Util::ThrowIfFailed(_swapChain->Present(_useWarpDevice ? 0 : 1, 0));
+    }
 
     // Wait for new back buffer to be done.
-    _frameIndex = _swapChain->GetCurrentBackBufferIndex();
-    _directCommandQueue->WaitForFenceValue(_fenceValues[_frameIndex]);
+    {
+        PROFILE_ZONE("Wait for back buffer");
+        _frameIndex = _swapChain->GetCurrentBackBufferIndex();
+        _directCommandQueue->WaitForFenceValue(_fenceValues[_frameIndex]);
+    }
+}
+
+void Renderer::RecordClear(CommandContext& context, ID3D12Resource* renderTarget, D3D12_CPU_DESCRIPTOR_HANDLE rtvHandle,
+    D3D12_CPU_DESCRIPTOR_HANDLE dsvHandle)
+{
+    const float clearColor[4] = { 255.0f / 255.0f, 182.0f / 255.0f, 193.0f / 255.0f, 1.0f }; // pink :)
+    context.TransitionResource(renderTarget, D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET);
+    context.ClearRenderTarget(rtvHandle, clearColor);
+    context.ClearDepth(dsvHandle, 1.0f);
+}
+
+void Renderer::RecordPassSetup(CommandContext& context, D3D12_CPU_DESCRIPTOR_HANDLE rtvHandle, D3D12_CPU_DESCRIPTOR_HANDLE dsvHandle,
+    const D3D12_VIEWPORT& viewport, const D3D12_RECT& scissorRect)
+{
+    // Command lists don't inherit state, every pass's list starts with this.
+    context.SetRenderTarget(rtvHandle, dsvHandle);
+    context.SetViewport(viewport);
+    context.SetScissorRect(scissorRect);
+}
+
+void Renderer::RecordPresentTransition(CommandContext& context, ID3D12Resource* renderTarget)
+{
+    // Sync up resource(s) (might need this inbetween some stages later)
+    context.TransitionResource(renderTarget, D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT);
 }
 
 void Renderer::Flush()
@@ -89,7 +212,7 @@ void Renderer::Flush()
     _copyCommandQueue->Flush();
 }
 
-void Renderer::InitializeGraphics()
+void Renderer::CreateDevice()
 {
     UINT dxgiFactoryFlags = 0;
 
@@ -113,13 +236,12 @@ void Renderer::InitializeGraphics()
     // The DirectX 12 device is used to create resources (such as textures and buffers,
     // command lists, command queues, fences, heaps, etc). It's not directly used for issuing draw or dispatch commands.
     // It can be considered a memory context that tracks allocations in GPU memory.
-    Microsoft::WRL::ComPtr<IDXGIFactory4> factory;
-    Util::ThrowIfFailed(CreateDXGIFactory2(dxgiFactoryFlags, IID_PPV_ARGS(&factory)));
+    Util::ThrowIfFailed(CreateDXGIFactory2(dxgiFactoryFlags, IID_PPV_ARGS(&_factory)));
 
     if (_useWarpDevice)
     {
         Microsoft::WRL::ComPtr<IDXGIAdapter> warpAdapter;
-        Util::ThrowIfFailed(factory->EnumWarpAdapter(IID_PPV_ARGS(&warpAdapter)));
+        Util::ThrowIfFailed(_factory->EnumWarpAdapter(IID_PPV_ARGS(&warpAdapter)));
 
         Util::ThrowIfFailed(D3D12CreateDevice(
             warpAdapter.Get(),
@@ -130,7 +252,7 @@ void Renderer::InitializeGraphics()
     else
     {
         Microsoft::WRL::ComPtr<IDXGIAdapter1> hardwareAdapter;
-        Util::GetHardwareAdapter(factory.Get(), &hardwareAdapter, false); // bool: request for high performance adapter or not?
+        Util::GetHardwareAdapter(_factory.Get(), &hardwareAdapter, false); // bool: request for high performance adapter or not?
 
         Util::ThrowIfFailed(D3D12CreateDevice(
             hardwareAdapter.Get(),
@@ -138,11 +260,10 @@ void Renderer::InitializeGraphics()
             IID_PPV_ARGS(&_device)
         ));
     }
+}
 
-    // Create command queues
-    _directCommandQueue = std::make_unique<CommandQueue>(_device, D3D12_COMMAND_LIST_TYPE_DIRECT);
-    _copyCommandQueue = std::make_unique<CommandQueue>(_device, D3D12_COMMAND_LIST_TYPE_COPY);
-
+void Renderer::CreateSwapChain()
+{
     // Describe and create the swap chain.
     // https://www.3dgep.com/learning-directx-12-1/#Create_the_Swap_Chain
     // The primary purpose of the swap chain is to present the rendered image to the screen.
@@ -158,7 +279,7 @@ void Renderer::InitializeGraphics()
     swapChainDesc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
 
     Microsoft::WRL::ComPtr<IDXGISwapChain1> swapChain;
-    Util::ThrowIfFailed(factory->CreateSwapChainForHwnd(
+    Util::ThrowIfFailed(_factory->CreateSwapChainForHwnd(
         _directCommandQueue->GetCommandQueue().Get(),        // Swap chain needs the queue so that it can force a flush on it.
         _app->GetHWND(),
         &swapChainDesc,
@@ -168,11 +289,14 @@ void Renderer::InitializeGraphics()
     ));
 
     // This sample does not support fullscreen transitions.
-    Util::ThrowIfFailed(factory->MakeWindowAssociation(_app->GetHWND(), DXGI_MWA_NO_ALT_ENTER));
+    Util::ThrowIfFailed(_factory->MakeWindowAssociation(_app->GetHWND(), DXGI_MWA_NO_ALT_ENTER));
 
     Util::ThrowIfFailed(swapChain.As(&_swapChain));
     _frameIndex = _swapChain->GetCurrentBackBufferIndex();
+}
 
+void Renderer::CreateDescriptorHeaps()
+{
     // Create descriptor heaps.
     // https://www.3dgep.com/learning-directx-12-1/#Create_a_Descriptor_Heap
     // Descriptor heap can be considered an array of resource views such as:
@@ -206,7 +330,10 @@ void Renderer::InitializeGraphics()
 
         _srvDescriptorSize = _device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
     }
+}
 
+void Renderer::CreateRenderTargets()
+{
     // Create frame resources.
     {
         CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(_rtvHeap->GetCPUDescriptorHandleForHeapStart());
@@ -2,11 +2,14 @@
 #include "resource_util.hpp"
 
 #include "dx12_helpers.hpp"
+#include "asset_archive.hpp"
 
 #ifndef _SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING
 #define _SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING
 #endif
 #include <experimental/filesystem>
+#include <algorithm>
+#include <cwctype>
 
 namespace fs = std::experimental::filesystem;
 
@@ -102,117 +105,89 @@ void Util::LoadBufferResource(
     }
 }
 
-void Util::LoadTextureFromFile(
-    Microsoft::WRL::ComPtr<ID3D12Device> device,
-    Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList,
-    ID3D12Resource** pDestinationResource, ID3D12Resource** pIntermediateResource,
-    const std::wstring& fileName)
+void Util::LoadScratchImage(const std::wstring& fileName, DirectX::TexMetadata& metadata, DirectX::ScratchImage& scratchImage)
 {
-    fs::path filePath(fileName);
-    if (!fs::exists(filePath))
+    // Straight out of the mounted archive's mapping when it has the file, a single read otherwise.
+    AssetSpan data;
+    std::vector<uint8_t> storage;
+    if (!ReadAsset(fileName, data, storage))
     {
         throw std::exception("File not found.");
     }
 
-    /*DirectX::TexMetadata metadata;
-    DirectX::ScratchImage scratchImage;*/
+    LoadScratchImage(fileName, data.data, data.size, metadata, scratchImage);
+}
+
+void Util::LoadScratchImage(const std::wstring& fileName, const uint8_t* data, size_t size,
+    DirectX::TexMetadata& metadata, DirectX::ScratchImage& scratchImage)
+{
+    std::wstring extension = fs::path(fileName).extension().wstring();
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::towlower);
 
-    /*if (filePath.extension() == ".dds")
+    if (extension == L".dds")
     {
-        ThrowIfFailed(DirectX::LoadFromDDSFile(
-            fileName.c_str(),
+        ThrowIfFailed(DirectX::LoadFromDDSMemory(
+            data, size,
             DirectX::DDS_FLAGS_NONE,
             &metadata,
             scratchImage));
     }
-    else if (filePath.extension() == ".hdr")
+    else if (extension == L".hdr")
     {
-        ThrowIfFailed(DirectX::LoadFromHDRFile(
-            fileName.c_str(),
+        ThrowIfFailed(DirectX::LoadFromHDRMemory(
+            data, size,
             &metadata,
             scratchImage));
     }
-    else if (filePath.extension() == ".tga")
+    else if (extension == L".tga")
     {
-        ThrowIfFailed(DirectX::LoadFromTGAFile(
-            fileName.c_str(),
+        ThrowIfFailed(DirectX::LoadFromTGAMemory(
+            data, size,
+            DirectX::TGA_FLAGS_NONE,
             &metadata,
             scratchImage));
     }
     else
     {
-        ThrowIfFailed(DirectX::LoadFromWICFile(
-            fileName.c_str(),
+        ThrowIfFailed(DirectX::LoadFromWICMemory(
+            data, size,
             DirectX::WIC_FLAGS_NONE,
             &metadata,
             scratchImage));
-    }*/
+    }
+}
 
-    D3D12_RESOURCE_DESC textureDesc = {};
-    /*switch (metadata.dimension)
-    {
-    case DirectX::TEX_DIMENSION_TEXTURE1D:
-        textureDesc = CD3DX12_RESOURCE_DESC::Tex1D(
-            metadata.format,
-            static_cast<UINT64>(metadata.width),
-            static_cast<UINT16>(metadata.arraySize));
-        break;
-    case DirectX::TEX_DIMENSION_TEXTURE2D:
-        textureDesc = CD3DX12_RESOURCE_DESC::Tex2D(
-            metadata.format,
-            static_cast<UINT64>(metadata.width),
-            static_cast<UINT>(metadata.height),
-            static_cast<UINT16>(metadata.arraySize));
-        break;
-    case DirectX::TEX_DIMENSION_TEXTURE3D:
-        textureDesc = CD3DX12_RESOURCE_DESC::Tex3D(
-            metadata.format,
-            static_cast<UINT64>(metadata.width),
-            static_cast<UINT>(metadata.height),
-            static_cast<UINT16>(metadata.depth));
-        break;
-    default:
-        throw std::exception("Invalid texture dimension.");
-        break;
-    }*/
-    
-    CD3DX12_HEAP_PROPERTIES textureHeapProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
-    ThrowIfFailed(device->CreateCommittedResource(
-        &textureHeapProps,
-        D3D12_HEAP_FLAG_NONE,
-        &textureDesc,
-        D3D12_RESOURCE_STATE_COMMON,
-        nullptr,
-        IID_PPV_ARGS(pDestinationResource)));
+void Util::LoadTextureFromFile(
+    Microsoft::WRL::ComPtr<ID3D12Device> device,
+    Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList,
+    ID3D12Resource** pDestinationResource, ID3D12Resource** pIntermediateResource,
+    const std::wstring& fileName)
+{
+    DirectX::TexMetadata metadata;
+    DirectX::ScratchImage scratchImage;
+    LoadScratchImage(fileName, metadata, scratchImage);
 
-    /*std::vector<D3D12_SUBRESOURCE_DATA> subresources(scratchImage.GetImageCount());
-    const DirectX::Image* pImages = scratchImage.GetImages();
-    for (int i = 0; i < scratchImage.GetImageCount(); ++i)
-    {
-        auto& subresource = subresources[i];
-        subresource.RowPitch = pImages[i].rowPitch;
-        subresource.SlicePitch = pImages[i].slicePitch;
-        subresource.pData = pImages[i].pixels;
-    }*/
+    // Created in the common state, so it can be used on a copy queue.
+    ThrowIfFailed(DirectX::CreateTexture(device.Get(), metadata, pDestinationResource));
 
-    if (pDestinationResource)
-    {
-        TransitionResource(commandList, *pDestinationResource, D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_COPY_DEST);
+    std::vector<D3D12_SUBRESOURCE_DATA> subresources;
+    ThrowIfFailed(DirectX::PrepareUpload(device.Get(), scratchImage.GetImages(), scratchImage.GetImageCount(), metadata, subresources));
 
-        /*UINT64 requiredSize = GetRequiredIntermediateSize(*pDestinationResource, 0, static_cast<uint32_t>(subresources.size()));
+    TransitionResource(commandList, *pDestinationResource, D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_COPY_DEST);
 
-        D3D12_RESOURCE_DESC bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(requiredSize);
-        CD3DX12_HEAP_PROPERTIES bufferHeapProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
-        ThrowIfFailed(device->CreateCommittedResource(
-            &bufferHeapProps,
-            D3D12_HEAP_FLAG_NONE,
-            &bufferDesc,
-            D3D12_RESOURCE_STATE_GENERIC_READ,
-            nullptr,
-            IID_PPV_ARGS(pIntermediateResource)
-        ));*/
-        //UpdateSubresources(commandList.Get(), *pDestinationResource, *pIntermediateResource, 0, 0, static_cast<UINT>(subresources.size()), subresources.data());
-    }
+    UINT64 requiredSize = GetRequiredIntermediateSize(*pDestinationResource, 0, static_cast<UINT>(subresources.size()));
+
+    D3D12_RESOURCE_DESC bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(requiredSize);
+    CD3DX12_HEAP_PROPERTIES bufferHeapProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
+    ThrowIfFailed(device->CreateCommittedResource(
+        &bufferHeapProps,
+        D3D12_HEAP_FLAG_NONE,
+        &bufferDesc,
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        IID_PPV_ARGS(pIntermediateResource)
+    ));
+    UpdateSubresources(commandList.Get(), *pDestinationResource, *pIntermediateResource, 0, 0, static_cast<UINT>(subresources.size()), subresources.data());
 }
 
 void Util::TransitionResource(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList,
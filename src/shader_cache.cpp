@@ -0,0 +1,223 @@
+#include "pch.hpp"
+
+#include "shader_cache.hpp"
+
+#include "hash_util.hpp"
+#include "asset_archive.hpp"
+#include "job_system.hpp"
+
+#ifndef _SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING
+#define _SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING
+#endif
+#include <experimental/filesystem>
+#include <fstream>
+#include <unordered_set>
+
+namespace fs = std::experimental::filesystem;
+
+using namespace Util;
+
+namespace
+{
+    // Bump when the on-disk format or the key layout changes, so stale entries are never picked up.
+    constexpr uint64_t SHADER_CACHE_VERSION = 1;
+
+    // Sources come out of the mounted asset archive when there is one.
+    bool ReadFile(const fs::path& filePath, std::string& contents)
+    {
+        AssetSpan data;
+        std::vector<uint8_t> storage;
+        if (!ReadAsset(filePath.wstring(), data, storage))
+        {
+            return false;
+        }
+        contents.assign(reinterpret_cast<const char*>(data.data), data.size);
+        return true;
+    }
+
+    // Folds every file reachable through #include into the hash, so touching a shared header invalidates its users.
+    uint64_t HashIncludes(const fs::path& filePath, const std::string& source, std::unordered_set<std::string>& visited, uint64_t hash)
+    {
+        size_t position = 0;
+        while ((position = source.find("#include", position)) != std::string::npos)
+        {
+            position += sizeof("#include") - 1;
+            size_t open = source.find_first_of("\"<\n", position);
+            if (open == std::string::npos || source[open] == '\n')
+            {
+                continue;
+            }
+            size_t close = source.find_first_of(source[open] == '"' ? "\"\n" : ">\n", open + 1);
+            if (close == std::string::npos || source[close] == '\n')
+            {
+                continue;
+            }
+
+            std::string includeName = source.substr(open + 1, close - open - 1);
+            hash = HashString(includeName.c_str(), hash);
+
+            // Relative to the including file first, then as given. Same order as the compiler's include handler.
+            fs::path includePath = filePath.parent_path() / includeName;
+            std::string includeSource;
+            bool found = ReadFile(includePath, includeSource);
+            if (!found)
+            {
+                includePath = includeName;
+                found = ReadFile(includePath, includeSource);
+            }
+
+            if (!visited.insert(includePath.string()).second)
+            {
+                continue;
+            }
+
+            // A missing include still changes the key by name, the compiler will report the actual error.
+            if (found)
+            {
+                hash = HashBytes(includeSource.data(), includeSource.size(), hash);
+                hash = HashIncludes(includePath, includeSource, visited, hash);
+            }
+        }
+        return hash;
+    }
+}
+
+ShaderCache::ShaderCache(const std::wstring& cacheDirectory, ShaderCompiler compiler)
+    : _cacheDirectory(cacheDirectory)
+    , _compiler(compiler)
+    , _memoryHitCount(0)
+    , _diskHitCount(0)
+    , _compileCount(0)
+{
+    fs::create_directories(fs::path(_cacheDirectory));
+}
+
+ShaderCache::~ShaderCache()
+{
+
+}
+
+uint64_t ShaderCache::HashShader(const ShaderDesc& desc, const std::string& source) const
+{
+    uint64_t hash = HashValue(SHADER_CACHE_VERSION);
+    hash = HashBytes(source.data(), source.size(), hash);
+    hash = HashString(desc.entryPoint.c_str(), hash);
+    hash = HashString(desc.profile.c_str(), hash);
+    hash = HashValue(desc.flags, hash);
+    hash = HashValue(desc.defines.size(), hash);
+    for (const ShaderDefine& define : desc.defines)
+    {
+        hash = HashString(define.name.c_str(), hash);
+        hash = HashString(define.value.c_str(), hash);
+    }
+
+    std::unordered_set<std::string> visited;
+    return HashIncludes(fs::path(desc.filePath), source, visited, hash);
+}
+
+ShaderBytecode ShaderCache::GetShader(const ShaderDesc& desc)
+{
+    return GetShaders({ desc }).front();
+}
+
+std::vector<ShaderBytecode> ShaderCache::GetShaders(const std::vector<ShaderDesc>& descs)
+{
+    std::vector<ShaderBytecode> shaders(descs.size());
+    Jobs::Counter compiles;
+
+    for (size_t i = 0; i < descs.size(); ++i)
+    {
+        std::string source;
+        if (!ReadFile(fs::path(descs[i].filePath), source))
+        {
+            throw std::exception("Shader file not found.");
+        }
+
+        uint64_t hash = HashShader(descs[i], source);
+        shaders[i] = FindShader(hash);
+        if (!shaders[i])
+        {
+            // Kick off every miss before waiting on any of them.
+            Jobs::Run([this, &descs, &shaders, i, hash, source = std::move(source)]()
+            {
+                shaders[i] = CompileShader(descs[i], source, hash);
+            }, &compiles);
+        }
+    }
+    Jobs::Wait(compiles);
+
+    bool failed = false;
+    for (size_t i = 0; i < descs.size(); ++i)
+    {
+        failed |= !shaders[i];
+    }
+
+    if (failed)
+    {
+        throw std::exception("Shader compilation failed.");
+    }
+
+    return shaders;
+}
+
+ShaderBytecode ShaderCache::FindShader(uint64_t hash)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto it = _shaders.find(hash);
+        if (it != _shaders.end())
+        {
+            _memoryHitCount++;
+            return it->second;
+        }
+    }
+
+    std::ifstream file(fs::path(GetCachePath(hash)), std::ios::binary);
+    if (!file)
+    {
+        return nullptr;
+    }
+
+    auto bytecode = std::make_shared<std::vector<uint8_t>>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    if (bytecode->empty())
+    {
+        return nullptr;
+    }
+
+    _diskHitCount++;
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _shaders.emplace(hash, std::move(bytecode)).first->second;
+}
+
+ShaderBytecode ShaderCache::CompileShader(const ShaderDesc& desc, const std::string& source, uint64_t hash)
+{
+    auto bytecode = std::make_shared<std::vector<uint8_t>>();
+    std::string errors;
+    if (!_compiler(desc, source, *bytecode, errors))
+    {
+        std::string message = std::string(desc.filePath.begin(), desc.filePath.end()) + ": " + errors + "\n";
+        fputs(message.c_str(), stderr);
+        return nullptr;
+    }
+    _compileCount++;
+
+    // Write to a temporary first, another process reading half a file would treat it as valid bytecode.
+    fs::path cachePath(GetCachePath(hash));
+    fs::path tempPath = cachePath;
+    tempPath += L".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(bytecode->data()), bytecode->size());
+    }
+    std::error_code error;
+    fs::rename(tempPath, cachePath, error);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _shaders.emplace(hash, std::move(bytecode)).first->second;
+}
+
+std::wstring ShaderCache::GetCachePath(uint64_t hash) const
+{
+    std::string name = HashToString(hash) + ".cso";
+    return (fs::path(_cacheDirectory) / fs::path(std::wstring(name.begin(), name.end()))).wstring();
+}
\ No newline at end of file
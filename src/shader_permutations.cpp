@@ -0,0 +1,96 @@
+#include "pch.hpp"
+
+#include "shader_permutations.hpp"
+
+ShaderPermutations::ShaderPermutations(ShaderCache& shaderCache, const ShaderDesc& baseDesc, ShaderFeatures supportedFeatures)
+    : _shaderCache(shaderCache)
+    , _baseDesc(baseDesc)
+    , _supportedFeatures(supportedFeatures)
+{
+
+}
+
+ShaderPermutations::~ShaderPermutations()
+{
+
+}
+
+ShaderBytecode ShaderPermutations::Get(ShaderFeatures features)
+{
+    features = Resolve(features);
+
+    auto it = _permutations.find(features);
+    if (it != _permutations.end())
+    {
+        return it->second;
+    }
+
+    ShaderDesc desc = _baseDesc;
+    std::vector<ShaderDefine> defines = GetDefines(features);
+    desc.defines.insert(desc.defines.end(), defines.begin(), defines.end());
+
+    ShaderBytecode bytecode = _shaderCache.GetShader(desc);
+    _permutations.emplace(features, bytecode);
+    return bytecode;
+}
+
+size_t ShaderPermutations::GetPossibleCount() const
+{
+    size_t count = 1;
+    for (uint32_t bit = 0; bit < SHADER_FEATURE_COUNT; ++bit)
+    {
+        if (_supportedFeatures & (1u << bit))
+        {
+            count *= 2;
+        }
+    }
+    return count;
+}
+
+void ShaderPermutations::Report(FILE* stream) const
+{
+    std::string name(_baseDesc.filePath.begin(), _baseDesc.filePath.end());
+    fprintf(stream, "%s: %zu of %zu permutations live\n", name.c_str(), GetLiveCount(), GetPossibleCount());
+
+    for (const auto& permutation : _permutations)
+    {
+        fprintf(stream, "  [");
+        bool first = true;
+        for (uint32_t bit = 0; bit < SHADER_FEATURE_COUNT; ++bit)
+        {
+            if (permutation.first & (1u << bit))
+            {
+                fprintf(stream, first ? "%s" : " | %s", GetFeatureName(static_cast<ShaderFeature>(1u << bit)));
+                first = false;
+            }
+        }
+        fprintf(stream, "%s] %zu bytes\n", first ? "base" : "", permutation.second->size());
+    }
+}
+
+std::vector<ShaderDefine> ShaderPermutations::GetDefines(ShaderFeatures features)
+{
+    // Every feature is always defined (as 0 or 1) so the shaders can use plain #if.
+    std::vector<ShaderDefine> defines;
+    for (uint32_t bit = 0; bit < SHADER_FEATURE_COUNT; ++bit)
+    {
+        ShaderFeature feature = static_cast<ShaderFeature>(1u << bit);
+        defines.push_back({ GetFeatureName(feature), (features & feature) ? "1" : "0" });
+    }
+    return defines;
+}
+
+const char* ShaderPermutations::GetFeatureName(ShaderFeature feature)
+{
+    switch (feature)
+    {
+    case SHADER_FEATURE_ALBEDO_TEXTURE:
+        return "FEATURE_ALBEDO_TEXTURE";
+    case SHADER_FEATURE_NORMAL_MAP:
+        return "FEATURE_NORMAL_MAP";
+    case SHADER_FEATURE_ALPHA_TEST:
+        return "FEATURE_ALPHA_TEST";
+    default:
+        return "FEATURE_UNKNOWN";
+    }
+}
\ No newline at end of file
@@ -0,0 +1,192 @@
+#include "pch.hpp"
+
+#include "task_graph.hpp"
+
+#include "job_system.hpp"
+#include "profiler.hpp"
+
+#include <algorithm>
+
+namespace
+{
+    double MillisecondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+TaskGraph::TaskGraph()
+    : _totalMilliseconds(0.0)
+    , _unfinishedTasks(0)
+    , _failed(false)
+{
+}
+
+TaskGraph::~TaskGraph()
+{
+}
+
+UINT TaskGraph::Add(const char* name, std::function<void()> function, std::initializer_list<UINT> dependencies)
+{
+    return AddTask(name, std::move(function), dependencies, false);
+}
+
+UINT TaskGraph::AddOnCallingThread(const char* name, std::function<void()> function, std::initializer_list<UINT> dependencies)
+{
+    return AddTask(name, std::move(function), dependencies, true);
+}
+
+UINT TaskGraph::AddTask(const char* name, std::function<void()>&& function, std::initializer_list<UINT> dependencies, bool onCallingThread)
+{
+    UINT id = static_cast<UINT>(_tasks.size());
+    std::unique_ptr<Task> task = std::make_unique<Task>();
+    task->name = name;
+    task->function = std::move(function);
+    task->onCallingThread = onCallingThread;
+    task->dependencyCount = 0;
+    task->remainingDependencies = 0;
+    task->skipped = false;
+    task->startMilliseconds = 0.0;
+    task->endMilliseconds = 0.0;
+
+    for (UINT dependency : dependencies)
+    {
+        if (dependency >= id)
+        {
+            throw std::exception("Task graph dependency has to be added before the task depending on it.");
+        }
+        _tasks[dependency]->dependents.push_back(id);
+        task->dependencyCount++;
+    }
+
+    _tasks.push_back(std::move(task));
+    return id;
+}
+
+void TaskGraph::Run()
+{
+    _start = std::chrono::steady_clock::now();
+    _failed = false;
+    _exception = nullptr;
+    _unfinishedTasks = static_cast<UINT>(_tasks.size());
+    for (std::unique_ptr<Task>& task : _tasks)
+    {
+        task->remainingDependencies = task->dependencyCount;
+    }
+
+    for (UINT task = 0; task < _tasks.size(); ++task)
+    {
+        if (_tasks[task]->dependencyCount == 0)
+        {
+            Schedule(task);
+        }
+    }
+
+    // Help out with the jobs while waiting, and take the tasks that belong to this thread.
+    while (_unfinishedTasks.load(std::memory_order_acquire) != 0)
+    {
+        UINT task = UINT_MAX;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (!_callingThreadTasks.empty())
+            {
+                task = _callingThreadTasks.back();
+                _callingThreadTasks.pop_back();
+            }
+        }
+
+        if (task != UINT_MAX)
+        {
+            Execute(task);
+        }
+        else if (!Jobs::RunPending(_jobs))
+        {
+            std::this_thread::yield();
+        }
+    }
+    _totalMilliseconds = MillisecondsSince(_start);
+
+    // The last task's job can still be between Execute() and releasing the counter.
+    Jobs::Wait(_jobs);
+
+    if (_exception)
+    {
+        std::rethrow_exception(_exception);
+    }
+}
+
+void TaskGraph::Schedule(UINT task)
+{
+    if (_tasks[task]->onCallingThread)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _callingThreadTasks.push_back(task);
+    }
+    else
+    {
+        Jobs::Run([this, task]() { Execute(task); }, &_jobs);
+    }
+}
+
+void TaskGraph::Execute(UINT id)
+{
+    Task& task = *_tasks[id];
+    task.startMilliseconds = MillisecondsSince(_start);
+
+    // Once something failed, the rest is skipped: the tasks depending on it can't run and the
+    // exception ends the initialization anyway. Dependents are still released to finish the graph.
+    task.skipped = _failed.load(std::memory_order_relaxed);
+    if (!task.skipped)
+    {
+        try
+        {
+            ProfileZone zone(task.name);
+            task.function();
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (!_exception)
+            {
+                _exception = std::current_exception();
+            }
+            _failed = true;
+        }
+    }
+    task.endMilliseconds = MillisecondsSince(_start);
+
+    for (UINT dependent : task.dependents)
+    {
+        if (_tasks[dependent]->remainingDependencies.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            Schedule(dependent);
+        }
+    }
+    _unfinishedTasks.fetch_sub(1, std::memory_order_release);
+}
+
+void TaskGraph::Report(FILE* file, const char* title) const
+{
+    double serialMilliseconds = 0.0;
+    for (const std::unique_ptr<Task>& task : _tasks)
+    {
+        serialMilliseconds += task->endMilliseconds - task->startMilliseconds;
+    }
+    fprintf(file, "%s: %.2f ms, %.2f ms of work (%.2fx parallel on %u threads)\n", title, _totalMilliseconds, serialMilliseconds,
+        _totalMilliseconds > 0.0 ? serialMilliseconds / _totalMilliseconds : 0.0, Jobs::GetThreadCount());
+
+    // In start order, which reads like a timeline.
+    std::vector<const Task*> tasks;
+    for (const std::unique_ptr<Task>& task : _tasks)
+    {
+        tasks.push_back(task.get());
+    }
+    std::sort(tasks.begin(), tasks.end(), [](const Task* a, const Task* b) { return a->startMilliseconds < b->startMilliseconds; });
+
+    fprintf(file, "%10s %10s  %s\n", "start", "ms", "task");
+    for (const Task* task : tasks)
+    {
+        fprintf(file, "%10.2f %10.2f  %s%s\n", task->startMilliseconds, task->endMilliseconds - task->startMilliseconds, task->name,
+            task->skipped ? " (skipped)" : "");
+    }
+}
\ No newline at end of file
@@ -0,0 +1,331 @@
+#include "pch.hpp"
+
+#include "texture_cooker.hpp"
+
+#include "dx12_helpers.hpp"
+#include "resource_util.hpp"
+#include "asset_archive.hpp"
+#include "hash_util.hpp"
+#include "job_system.hpp"
+#include "profiler.hpp"
+
+#ifndef _SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING
+#define _SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING
+#endif
+#include <experimental/filesystem>
+#include <algorithm>
+#include <fstream>
+
+namespace fs = std::experimental::filesystem;
+
+namespace
+{
+    // Bump when the cooked output changes (formats, filters, flags), so everything gets cooked again.
+    constexpr uint64_t TEXTURE_COOK_VERSION = 1;
+    const wchar_t* const COOK_MANIFEST_NAME = L"manifest.txt";
+
+    // Relative source path (forward slashes) to the content hash it was last cooked from.
+    using CookManifest = std::unordered_map<std::string, uint64_t>;
+
+    bool IsSourceTexture(const fs::path& filePath)
+    {
+        std::string extension = AssetArchive::NormalizeName(filePath.extension().wstring());
+        for (const char* sourceExtension : { ".png", ".jpg", ".jpeg", ".bmp", ".tga", ".hdr", ".tif", ".tiff", ".dds" })
+        {
+            if (extension == sourceExtension)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    CookManifest LoadManifest(const fs::path& manifestPath)
+    {
+        CookManifest manifest;
+        std::ifstream file(manifestPath);
+        std::string line;
+        while (std::getline(file, line))
+        {
+            size_t separator = line.find(' ');
+            if (separator == 16)
+            {
+                manifest[line.substr(separator + 1)] = std::stoull(line.substr(0, separator), nullptr, 16);
+            }
+        }
+        return manifest;
+    }
+
+    void SaveManifest(const fs::path& manifestPath, const CookManifest& manifest)
+    {
+        std::vector<std::string> lines;
+        for (const auto& entry : manifest)
+        {
+            lines.push_back(Util::HashToString(entry.second) + " " + entry.first);
+        }
+        std::sort(lines.begin(), lines.end());
+
+        fs::path tempPath = manifestPath;
+        tempPath += L".tmp";
+        {
+            std::ofstream file(tempPath, std::ios::trunc);
+            for (const std::string& line : lines)
+            {
+                file << line << "\n";
+            }
+        }
+        std::error_code error;
+        fs::rename(tempPath, manifestPath, error);
+    }
+
+    // Pixel rows per compression job, whole blocks. Small enough that even a single large texture keeps
+    // every thread busy, large enough that DirectXTex's per call setup doesn't show.
+    constexpr size_t COMPRESS_BAND_ROWS = 64;
+
+    struct CompressBand
+    {
+        size_t mip;
+        size_t firstRow;
+        size_t rowCount;
+    };
+
+    // Block compresses every mip in bands of rows, one job each. Replaces DirectXTex's OpenMP path, which
+    // would start its own threads next to the job system's and fight them for the cores.
+    void CompressMipChain(const DirectX::ScratchImage& mipChain, DXGI_FORMAT format, DirectX::ScratchImage& compressed)
+    {
+        DirectX::TexMetadata metadata = mipChain.GetMetadata();
+        metadata.format = format;
+        Util::ThrowIfFailed(compressed.Initialize(metadata));
+
+        std::vector<CompressBand> bands;
+        for (size_t mip = 0; mip < metadata.mipLevels; ++mip)
+        {
+            const size_t height = mipChain.GetImage(mip, 0, 0)->height;
+            for (size_t row = 0; row < height; row += COMPRESS_BAND_ROWS)
+            {
+                bands.push_back({ mip, row, std::min(COMPRESS_BAND_ROWS, height - row) });
+            }
+        }
+
+        // Jobs must not throw, failures are collected and thrown on this thread.
+        std::atomic<HRESULT> result(S_OK);
+        Jobs::ParallelFor(static_cast<UINT>(bands.size()), 1, [&](UINT begin, UINT end)
+        {
+            for (UINT index = begin; index < end && SUCCEEDED(result.load()); ++index)
+            {
+                const CompressBand& band = bands[index];
+                const DirectX::Image& source = *mipChain.GetImage(band.mip, 0, 0);
+                const DirectX::Image& destination = *compressed.GetImage(band.mip, 0, 0);
+
+                DirectX::Image sourceBand = source;
+                sourceBand.height = band.rowCount;
+                sourceBand.slicePitch = source.rowPitch * band.rowCount;
+                sourceBand.pixels = source.pixels + source.rowPitch * band.firstRow;
+
+                DirectX::ScratchImage compressedBand;
+                HRESULT hr = DirectX::Compress(sourceBand, format, DirectX::TEX_COMPRESS_DEFAULT, DirectX::TEX_THRESHOLD_DEFAULT, compressedBand);
+                if (FAILED(hr))
+                {
+                    result = hr;
+                    break;
+                }
+                const DirectX::Image& blocks = *compressedBand.GetImage(0, 0, 0);
+                memcpy(destination.pixels + destination.rowPitch * (band.firstRow / 4), blocks.pixels, blocks.slicePitch);
+            }
+        });
+        Util::ThrowIfFailed(result.load());
+    }
+
+    struct CookJob
+    {
+        fs::path sourcePath;
+        fs::path cookedPath;
+        std::string name; // manifest key
+        uint64_t hash;
+        double megapixels;
+        bool skipped;
+        bool failed;
+    };
+}
+
+DXGI_FORMAT Util::SelectCookedFormat(const std::wstring& sourcePath, const DirectX::ScratchImage& image)
+{
+    DXGI_FORMAT format = image.GetMetadata().format;
+    if (DirectX::FormatDataType(format) == DirectX::FORMAT_TYPE_FLOAT)
+    {
+        return DXGI_FORMAT_BC6H_UF16;
+    }
+
+    std::string stem = AssetArchive::NormalizeName(fs::path(sourcePath).stem().wstring());
+    auto endsWith = [&stem](const std::string& suffix)
+    {
+        return stem.size() >= suffix.size() && stem.compare(stem.size() - suffix.size(), suffix.size(), suffix) == 0;
+    };
+    if (endsWith("_n") || endsWith("_normal"))
+    {
+        return DXGI_FORMAT_BC5_UNORM;
+    }
+
+    return DirectX::HasAlpha(format) && !image.IsAlphaAllOpaque() ? DXGI_FORMAT_BC3_UNORM : DXGI_FORMAT_BC1_UNORM;
+}
+
+DirectX::TexMetadata Util::CookTexture(const std::wstring& sourcePath, const uint8_t* data, size_t size, const std::wstring& cookedPath)
+{
+    PROFILE_ZONE("CookTexture");
+    DirectX::TexMetadata metadata;
+    DirectX::ScratchImage image;
+    LoadScratchImage(sourcePath, data, size, metadata, image);
+
+    if (metadata.dimension != DirectX::TEX_DIMENSION_TEXTURE2D || metadata.arraySize != 1)
+    {
+        throw std::exception("Only single 2D textures can be cooked.");
+    }
+
+    // Already compressed sources (DDS) get recompressed from their top mip.
+    if (DirectX::IsCompressed(metadata.format))
+    {
+        DirectX::ScratchImage decompressed;
+        ThrowIfFailed(DirectX::Decompress(*image.GetImage(0, 0, 0), DXGI_FORMAT_UNKNOWN, decompressed));
+        image = std::move(decompressed);
+    }
+    else if (metadata.mipLevels > 1)
+    {
+        DirectX::ScratchImage topMip;
+        ThrowIfFailed(topMip.InitializeFromImage(*image.GetImage(0, 0, 0)));
+        image = std::move(topMip);
+    }
+
+    // D3D12 wants the top mip of block compressed textures in whole 4x4 blocks.
+    metadata = image.GetMetadata();
+    size_t width = (metadata.width + 3) & ~size_t(3);
+    size_t height = (metadata.height + 3) & ~size_t(3);
+    if (width != metadata.width || height != metadata.height)
+    {
+        DirectX::ScratchImage resized;
+        ThrowIfFailed(DirectX::Resize(*image.GetImage(0, 0, 0), width, height, DirectX::TEX_FILTER_DEFAULT, resized));
+        image = std::move(resized);
+    }
+
+    DirectX::ScratchImage mipChain;
+    ThrowIfFailed(DirectX::GenerateMipMaps(*image.GetImage(0, 0, 0), DirectX::TEX_FILTER_DEFAULT, 0, mipChain));
+
+    DirectX::ScratchImage compressed;
+    CompressMipChain(mipChain, SelectCookedFormat(sourcePath, mipChain), compressed);
+
+    // Same as the other caches: write a temporary first, the runtime must never see half a texture.
+    fs::path outputPath(cookedPath);
+    if (outputPath.has_parent_path())
+    {
+        fs::create_directories(outputPath.parent_path());
+    }
+    fs::path tempPath = outputPath;
+    tempPath += L".tmp";
+    ThrowIfFailed(DirectX::SaveToDDSFile(compressed.GetImages(), compressed.GetImageCount(), compressed.GetMetadata(),
+        DirectX::DDS_FLAGS_NONE, tempPath.wstring().c_str()));
+
+    std::error_code error;
+    fs::rename(tempPath, outputPath, error);
+    if (error)
+    {
+        throw std::exception("Failed to write the cooked texture.");
+    }
+    return compressed.GetMetadata();
+}
+
+Util::TextureCookStats Util::CookTextures(const std::wstring& sourceDirectory, const std::wstring& outputDirectory)
+{
+    TextureCookStats stats;
+    auto start = std::chrono::steady_clock::now();
+
+    fs::path sourceRoot(sourceDirectory);
+    fs::path outputRoot(outputDirectory);
+    fs::path manifestPath = outputRoot / COOK_MANIFEST_NAME;
+    CookManifest manifest = LoadManifest(manifestPath);
+
+    std::vector<CookJob> jobs;
+    const size_t rootLength = sourceRoot.wstring().size();
+    for (const fs::directory_entry& entry : fs::recursive_directory_iterator(sourceRoot))
+    {
+        if (!fs::is_regular_file(entry.status()) || !IsSourceTexture(entry.path()))
+        {
+            continue;
+        }
+
+        std::wstring relativePath = entry.path().wstring().substr(rootLength + 1);
+        CookJob job = {};
+        job.sourcePath = entry.path();
+        job.cookedPath = (outputRoot / relativePath).replace_extension(L".dds");
+        job.name = AssetArchive::NormalizeName(relativePath);
+        jobs.push_back(job);
+    }
+
+    // WIC decoding goes through COM, the pool's workers have it already but this thread runs jobs too.
+    HRESULT comResult = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+
+    // Textures vary a lot in size, one job each lets idle threads steal the ones that are still queued.
+    // Their compression is split into jobs again, so a few large textures still spread over all cores.
+    Jobs::ParallelFor(static_cast<UINT>(jobs.size()), 1, [&](UINT begin, UINT end)
+    {
+        std::vector<uint8_t> storage;
+        for (UINT index = begin; index < end; ++index)
+        {
+            CookJob& job = jobs[index];
+            try
+            {
+                AssetSpan data;
+                if (!ReadAsset(job.sourcePath.wstring(), data, storage))
+                {
+                    throw std::exception("File not found.");
+                }
+
+                job.hash = HashBytes(data.data, data.size, HashValue(TEXTURE_COOK_VERSION));
+                auto cooked = manifest.find(job.name);
+                if (cooked != manifest.end() && cooked->second == job.hash && fs::exists(job.cookedPath))
+                {
+                    job.skipped = true;
+                    continue;
+                }
+
+                DirectX::TexMetadata metadata = CookTexture(job.sourcePath.wstring(), data.data, data.size, job.cookedPath.wstring());
+                job.megapixels = metadata.width * metadata.height * 1e-6;
+            }
+            catch (const std::exception& exception)
+            {
+                fprintf(stderr, "Failed to cook %s: %s\n", job.sourcePath.string().c_str(), exception.what());
+                job.failed = true;
+            }
+        }
+    });
+
+    if (SUCCEEDED(comResult))
+    {
+        CoUninitialize();
+    }
+
+    // Failed textures drop out of the manifest, so the next run tries them again.
+    for (const CookJob& job : jobs)
+    {
+        if (job.failed)
+        {
+            manifest.erase(job.name);
+            stats.failed++;
+        }
+        else if (job.skipped)
+        {
+            stats.skipped++;
+        }
+        else
+        {
+            manifest[job.name] = job.hash;
+            stats.cooked++;
+            stats.megapixels += job.megapixels;
+        }
+    }
+
+    fs::create_directories(outputRoot);
+    SaveManifest(manifestPath, manifest);
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    stats.seconds = elapsed.count();
+    return stats;
+}
\ No newline at end of file
@@ -0,0 +1,165 @@
+#include "pch.hpp"
+
+#include "texture_residency.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    struct EvictionCandidate
+    {
+        bool needed; // the mip is what this frame requested, or coarser
+        UINT64 lastUsedFrame;
+        UINT64 size;
+        UINT texture;
+    };
+
+    // Surplus mips go before needed ones, then least recently used, then the biggest.
+    struct EvictionOrder
+    {
+        bool operator()(const EvictionCandidate& a, const EvictionCandidate& b) const
+        {
+            if (a.needed != b.needed)
+            {
+                return a.needed;
+            }
+            if (a.lastUsedFrame != b.lastUsedFrame)
+            {
+                return a.lastUsedFrame > b.lastUsedFrame;
+            }
+            return a.size < b.size;
+        }
+    };
+}
+
+TextureResidency::TextureResidency(UINT64 memoryBudget)
+    : _budget(memoryBudget)
+    , _residentBytes(0)
+    , _frame(0)
+{
+}
+
+TextureResidency::~TextureResidency()
+{
+}
+
+UINT TextureResidency::AddTexture(UINT width, UINT height, const std::vector<UINT64>& mipSizes)
+{
+    if (mipSizes.empty())
+    {
+        throw std::exception("A texture needs at least one mip.");
+    }
+
+    Texture texture = {};
+    texture.size = std::max(width, height);
+    texture.mipCount = static_cast<UINT>(mipSizes.size());
+    texture.chainSizes.resize(mipSizes.size() + 1, 0);
+    for (size_t mip = mipSizes.size(); mip-- > 0;)
+    {
+        texture.chainSizes[mip] = texture.chainSizes[mip + 1] + mipSizes[mip];
+    }
+    texture.residentMip = texture.mipCount;
+    texture.requestedMip = texture.mipCount;
+    texture.targetMip = texture.mipCount;
+    texture.lastUsedFrame = 0;
+
+    _textures.push_back(std::move(texture));
+    return static_cast<UINT>(_textures.size() - 1);
+}
+
+UINT TextureResidency::EstimateMip(UINT textureSize, UINT mipCount, float uvDensity, float viewDepth, float projectionScale)
+{
+    float texelsPerPixel = textureSize * uvDensity * viewDepth / projectionScale;
+    if (!(texelsPerPixel > 1.0f))
+    {
+        return 0; // magnified, also catches depths behind the near plane
+    }
+
+    // Rounding down keeps the estimate on the sharp side, surfaces at an angle sample coarser mips.
+    UINT mip = static_cast<UINT>(log2f(texelsPerPixel));
+    return std::min(mip, mipCount - 1);
+}
+
+void TextureResidency::BeginFrame()
+{
+    _frame++;
+    for (Texture& texture : _textures)
+    {
+        texture.requestedMip = texture.mipCount;
+    }
+}
+
+void TextureResidency::RequestMip(UINT texture, UINT mip)
+{
+    Texture& entry = _textures[texture];
+    entry.requestedMip = std::min(entry.requestedMip, std::min(mip, entry.mipCount - 1));
+    entry.lastUsedFrame = _frame;
+}
+
+void TextureResidency::RequestForObject(UINT texture, float uvDensity, float viewDepth, float projectionScale)
+{
+    const Texture& entry = _textures[texture];
+    RequestMip(texture, EstimateMip(entry.size, entry.mipCount, uvDensity, viewDepth, projectionScale));
+}
+
+void TextureResidency::Update(std::vector<Change>& changes)
+{
+    changes.clear();
+
+    // Requested textures get what they asked for, but keep finer mips they already have until
+    // memory runs short: the camera coming back shouldn't load them again.
+    UINT64 targetBytes = 0;
+    for (Texture& texture : _textures)
+    {
+        texture.targetMip = texture.lastUsedFrame == _frame ? std::min(texture.requestedMip, texture.residentMip) : texture.residentMip;
+        targetBytes += texture.chainSizes[texture.targetMip];
+    }
+
+    // Over budget, drop one mip at a time from the front of the eviction order.
+    if (targetBytes > _budget)
+    {
+        auto makeCandidate = [this](UINT index)
+        {
+            const Texture& texture = _textures[index];
+            UINT64 size = texture.chainSizes[texture.targetMip] - texture.chainSizes[texture.targetMip + 1];
+            bool needed = texture.lastUsedFrame == _frame && texture.targetMip >= texture.requestedMip;
+            return EvictionCandidate{ needed, texture.lastUsedFrame, size, index };
+        };
+
+        std::vector<EvictionCandidate> candidates;
+        for (UINT index = 0; index < _textures.size(); ++index)
+        {
+            if (_textures[index].targetMip + 1 < _textures[index].mipCount)
+            {
+                candidates.push_back(makeCandidate(index));
+            }
+        }
+
+        std::priority_queue<EvictionCandidate, std::vector<EvictionCandidate>, EvictionOrder> queue(EvictionOrder(), std::move(candidates));
+        while (targetBytes > _budget && !queue.empty())
+        {
+            EvictionCandidate candidate = queue.top();
+            queue.pop();
+
+            Texture& texture = _textures[candidate.texture];
+            targetBytes -= candidate.size;
+            texture.targetMip++;
+            if (texture.targetMip + 1 < texture.mipCount)
+            {
+                queue.push(makeCandidate(candidate.texture));
+            }
+        }
+    }
+
+    for (UINT index = 0; index < _textures.size(); ++index)
+    {
+        Texture& texture = _textures[index];
+        if (texture.targetMip != texture.residentMip)
+        {
+            changes.push_back(Change{ index, texture.residentMip, texture.targetMip });
+            texture.residentMip = texture.targetMip;
+        }
+    }
+    _residentBytes = targetBytes;
+}
\ No newline at end of file
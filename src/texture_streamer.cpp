@@ -0,0 +1,415 @@
+#include "pch.hpp"
+
+#include "texture_streamer.hpp"
+
+#include "command_queue.hpp"
+#include "dx12_helpers.hpp"
+#include "resource_util.hpp"
+#include "asset_archive.hpp"
+#include "frame_allocator.hpp"
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace Microsoft::WRL;
+
+TextureStreamer::TextureStreamer(ComPtr<ID3D12Device2>& device, CommandQueue& copyCommandQueue, UINT64 memoryBudget)
+    : _device(device)
+    , _copyCommandQueue(copyCommandQueue)
+    , _residency(memoryBudget)
+    , _updateCount(0)
+{
+}
+
+TextureStreamer::~TextureStreamer()
+{
+    // Loads write into this object.
+    Jobs::Wait(_pendingLoads);
+
+    // The upload buffers have to outlive the copies reading from them.
+    if (!_batchesInFlight.empty())
+    {
+        _copyCommandQueue.WaitForFenceValue(_batchesInFlight.back().fenceValue);
+    }
+}
+
+UINT TextureStreamer::Request(const std::wstring& filePath)
+{
+    UINT texture = static_cast<UINT>(_textures.size());
+
+    Texture entry = {};
+    entry.filePath = filePath;
+    entry.residencyTexture = TextureResidency::INVALID_TEXTURE;
+    entry.requestTime = std::chrono::steady_clock::now();
+    _textures.push_back(entry);
+
+    // Only the coarsest mips until the residency asks for more, so there's something to sample quickly.
+    StartLoad(texture, UINT_MAX);
+    return texture;
+}
+
+void TextureStreamer::RequestMip(UINT texture, UINT mip)
+{
+    // Requests for textures that are still being parsed are dropped, the next frame asks again.
+    UINT residencyTexture = _textures[texture].residencyTexture;
+    if (residencyTexture != TextureResidency::INVALID_TEXTURE)
+    {
+        _residency.RequestMip(residencyTexture, mip);
+    }
+}
+
+void TextureStreamer::RequestForObject(UINT texture, float uvDensity, float viewDepth, float projectionScale)
+{
+    UINT residencyTexture = _textures[texture].residencyTexture;
+    if (residencyTexture != TextureResidency::INVALID_TEXTURE)
+    {
+        _residency.RequestForObject(residencyTexture, uvDensity, viewDepth, projectionScale);
+    }
+}
+
+void TextureStreamer::StartLoad(UINT texture, UINT firstMip)
+{
+    Texture& entry = _textures[texture];
+    entry.loading = true;
+    Jobs::Run([this, request = LoadRequest{ texture, entry.filePath, firstMip }]()
+    {
+        Load(request);
+    }, &_pendingLoads);
+}
+
+UINT TextureStreamer::ClampFirstMip(UINT firstMip, UINT width, UINT height, UINT mipCount, DXGI_FORMAT format)
+{
+    // The first mip of a block compressed texture has to be a whole number of blocks, the tail below
+    // the last such mip always comes along.
+    firstMip = std::min(firstMip, mipCount - 1);
+    if (DirectX::IsCompressed(format))
+    {
+        while (firstMip > 0 && (std::max(width >> firstMip, 1u) % 4 != 0 || std::max(height >> firstMip, 1u) % 4 != 0))
+        {
+            firstMip--;
+        }
+    }
+    return firstMip;
+}
+
+void TextureStreamer::Update(UINT64 uploadBudget)
+{
+    auto now = std::chrono::steady_clock::now();
+    _updateCount++;
+
+    // Retire the copies the GPU has finished. The queue executes in order, so a resource's mips
+    // always become resident from the smallest one up without gaps.
+    while (!_batchesInFlight.empty() && _copyCommandQueue.IsFenceComplete(_batchesInFlight.front().fenceValue))
+    {
+        for (const MipUpload& upload : _batchesInFlight.front().uploads)
+        {
+            Texture& texture = _textures[upload.texture];
+            if (upload.resource == texture.resource)
+            {
+                texture.residentMip = std::min(texture.residentMip, upload.mip);
+                texture.viewVersion++;
+            }
+            else if (upload.resource == texture.pendingResource)
+            {
+                texture.pendingResidentMip = std::min(texture.pendingResidentMip, upload.mip);
+            }
+        }
+        _batchesInFlight.pop();
+    }
+
+    // Replaced resources were last sampled by frames that are done by now.
+    while (!_retiredResources.empty() && _retiredResources.front().releaseUpdate <= _updateCount)
+    {
+        _retiredResources.pop();
+    }
+
+    // Grab what the jobs finished, at least one mip even when it's over budget. Mips of loads that were
+    // replaced by a newer one before their copy was recorded are dropped.
+    std::vector<LoadedTexture> loadedTextures;
+    FrameVector<MipUpload> uploads;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        loadedTextures.swap(_loadedTextures);
+        for (const LoadedTexture& loaded : loadedTextures)
+        {
+            Texture& texture = _textures[loaded.texture];
+            texture.loading = false;
+            if (loaded.resource)
+            {
+                texture.pendingResource = loaded.resource;
+                texture.pendingFirstMip = loaded.firstMip;
+                texture.pendingResidentMip = static_cast<UINT>(loaded.metadata.mipLevels);
+            }
+        }
+
+        UINT64 uploadSize = 0;
+        while (!_uploadQueue.empty() && (uploads.empty() || uploadSize + _uploadQueue.top().size <= uploadBudget))
+        {
+            const MipUpload& upload = _uploadQueue.top();
+            const Texture& texture = _textures[upload.texture];
+            if (upload.resource == texture.resource || upload.resource == texture.pendingResource)
+            {
+                uploadSize += upload.size;
+                uploads.push_back(upload);
+            }
+            _uploadQueue.pop();
+        }
+    }
+
+    for (const LoadedTexture& loaded : loadedTextures)
+    {
+        Texture& texture = _textures[loaded.texture];
+        if (!loaded.resource)
+        {
+            texture.failed = true;
+            continue;
+        }
+
+        // The first load parsed the file, from here on the residency decides what stays.
+        if (texture.residencyTexture == TextureResidency::INVALID_TEXTURE)
+        {
+            texture.mipCount = static_cast<UINT>(loaded.metadata.mipLevels);
+            texture.residentMip = texture.mipCount;
+            texture.width = static_cast<UINT>(loaded.metadata.width);
+            texture.height = static_cast<UINT>(loaded.metadata.height);
+            texture.format = loaded.metadata.format;
+            texture.residencyTexture = _residency.AddTexture(texture.width, texture.height, loaded.mipSizes);
+            _residencyTextures.push_back(loaded.texture);
+        }
+    }
+
+    // A pending resource takes over once it has the mips the current one has, or all of its own when it
+    // holds fewer (mips were evicted). Frames still reading the old one through their views are done
+    // FRAME_COUNT updates later, the renderer waits for each frame before reusing its index.
+    for (Texture& texture : _textures)
+    {
+        if (texture.pendingResource && texture.pendingResidentMip <= std::max(texture.residentMip, texture.pendingFirstMip))
+        {
+            if (texture.resource)
+            {
+                _retiredResources.push(RetiredResource{ _updateCount + FRAME_COUNT, texture.resource });
+            }
+            texture.resource = std::move(texture.pendingResource);
+            texture.firstMip = texture.pendingFirstMip;
+            texture.residentMip = texture.pendingResidentMip;
+            texture.viewVersion++;
+        }
+
+        if (texture.residentMip < texture.mipCount)
+        {
+            std::chrono::duration<double, std::milli> latency = now - texture.requestTime;
+            if (!texture.firstMipReported)
+            {
+                _firstMipLatency.Add(latency.count());
+                texture.firstMipReported = true;
+            }
+            if (!texture.allMipsReported && texture.residentMip == 0)
+            {
+                _fullLatency.Add(latency.count());
+                texture.allMipsReported = true;
+            }
+        }
+    }
+
+    // Apply the requests made since the last update. Loading finer mips or dropping some both load the
+    // texture again with the mips it should keep, one load per texture at a time.
+    _residency.Update(_residencyChanges);
+    _residency.BeginFrame();
+    for (UINT residencyTexture = 0; residencyTexture < _residency.GetCount(); ++residencyTexture)
+    {
+        UINT index = _residencyTextures[residencyTexture];
+        Texture& texture = _textures[index];
+        UINT targetMip = std::min(_residency.GetResidentMip(residencyTexture), texture.mipCount - 1);
+        UINT firstMip = ClampFirstMip(targetMip, texture.width, texture.height, texture.mipCount, texture.format);
+        UINT currentFirstMip = texture.pendingResource ? texture.pendingFirstMip : texture.firstMip;
+        if (!texture.loading && !texture.failed && firstMip != currentFirstMip)
+        {
+            StartLoad(index, firstMip);
+        }
+    }
+
+    if (uploads.empty())
+    {
+        return;
+    }
+
+    // Textures start out in the common state, which copy queues promote to copy dest and
+    // which they decay back to once the copy finished, ready for the direct queue to sample.
+    auto commandList = _copyCommandQueue.GetCommandList();
+    for (const MipUpload& upload : uploads)
+    {
+        CD3DX12_TEXTURE_COPY_LOCATION destination(upload.resource.Get(), upload.mip - upload.firstMip);
+        CD3DX12_TEXTURE_COPY_LOCATION source(upload.uploadBuffer.Get(), upload.footprint);
+        commandList->CopyTextureRegion(&destination, 0, 0, 0, &source, nullptr);
+    }
+
+    // The batch lives until its fence completes, possibly frames later, so it gets its own copy.
+    uint64_t fenceValue = _copyCommandQueue.ExecuteCommandList(commandList);
+    _batchesInFlight.push(UploadBatch{ fenceValue, std::vector<MipUpload>(uploads.begin(), uploads.end()) });
+}
+
+bool TextureStreamer::IsResident(UINT texture) const
+{
+    return texture < _textures.size() && _textures[texture].residentMip < _textures[texture].mipCount;
+}
+
+UINT TextureStreamer::GetResidentMip(UINT texture) const
+{
+    return _textures[texture].residentMip;
+}
+
+bool TextureStreamer::IsFullyResident(UINT texture) const
+{
+    return IsResident(texture) && _textures[texture].residentMip == 0;
+}
+
+void TextureStreamer::CreateShaderResourceView(UINT texture, D3D12_CPU_DESCRIPTOR_HANDLE srvHandle) const
+{
+    // Mips only count as resident once their copy's fence completed, see Update().
+    const Texture& entry = _textures[texture];
+    D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+    srvDesc.Format = entry.format;
+    srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+    srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+    srvDesc.Texture2D.MostDetailedMip = entry.residentMip - entry.firstMip;
+    srvDesc.Texture2D.MipLevels = entry.mipCount - entry.residentMip;
+    _device->CreateShaderResourceView(entry.resource.Get(), &srvDesc, srvHandle);
+}
+
+void TextureStreamer::Report(FILE* file) const
+{
+    fprintf(file, "Texture streaming latency (%zu textures requested)\n", _textures.size());
+    _firstMipLatency.Report(file, "first mip");
+    _fullLatency.Report(file, "all mips");
+}
+
+void TextureStreamer::Load(const LoadRequest& request)
+{
+    PROFILE_ZONE("TextureStreamer::Load");
+    LoadedTexture loaded = {};
+    loaded.texture = request.texture;
+    std::vector<MipUpload> uploads;
+
+    try
+    {
+        // Only cooked textures (see Util::CookTextures()) are streamed: block compressed with all mips,
+        // so loading is a read and a parse without any decoding or mip generation at runtime.
+        AssetSpan data;
+        std::vector<uint8_t> storage;
+        if (!Util::ReadAsset(request.filePath, data, storage))
+        {
+            throw std::exception("Cooked texture not found, build the project or run DiaBolic --cook.");
+        }
+
+        DirectX::ScratchImage image;
+        Util::ThrowIfFailed(DirectX::LoadFromDDSMemory(data.data, data.size, DirectX::DDS_FLAGS_NONE, &loaded.metadata, image));
+
+        const DirectX::TexMetadata& metadata = loaded.metadata;
+        if (metadata.dimension != DirectX::TEX_DIMENSION_TEXTURE2D || metadata.arraySize != 1 || metadata.depth != 1)
+        {
+            throw std::exception("Only single 2D textures can be streamed.");
+        }
+
+        UINT mipCount = static_cast<UINT>(metadata.mipLevels);
+        for (UINT mip = 0; mip < mipCount; ++mip)
+        {
+            loaded.mipSizes.push_back(image.GetImage(mip, 0, 0)->slicePitch);
+        }
+
+        // The resource only holds the mips the residency keeps. All of them are staged again, the
+        // coarse ones are small and it keeps the resource independent of the one it replaces.
+        loaded.firstMip = ClampFirstMip(request.firstMip, static_cast<UINT>(metadata.width), static_cast<UINT>(metadata.height),
+            mipCount, metadata.format);
+        DirectX::TexMetadata resourceMetadata = metadata;
+        resourceMetadata.width = std::max<size_t>(metadata.width >> loaded.firstMip, 1);
+        resourceMetadata.height = std::max<size_t>(metadata.height >> loaded.firstMip, 1);
+        resourceMetadata.mipLevels = mipCount - loaded.firstMip;
+
+        // The device is free threaded, creating the resource here keeps it off the frame.
+        Util::ThrowIfFailed(DirectX::CreateTexture(_device.Get(), resourceMetadata, &loaded.resource));
+
+        // Stage the mips in one upload buffer, laid out the way CopyTextureRegion wants it.
+        UINT resourceMipCount = static_cast<UINT>(resourceMetadata.mipLevels);
+        D3D12_RESOURCE_DESC desc = loaded.resource->GetDesc();
+        std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> footprints(resourceMipCount);
+        std::vector<UINT> rowCounts(resourceMipCount);
+        std::vector<UINT64> rowSizes(resourceMipCount);
+        UINT64 totalSize = 0;
+        _device->GetCopyableFootprints(&desc, 0, resourceMipCount, 0, footprints.data(), rowCounts.data(), rowSizes.data(), &totalSize);
+
+        ComPtr<ID3D12Resource> uploadBuffer;
+        CD3DX12_HEAP_PROPERTIES heapProps(D3D12_HEAP_TYPE_UPLOAD);
+        CD3DX12_RESOURCE_DESC bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(totalSize);
+        Util::ThrowIfFailed(_device->CreateCommittedResource(
+            &heapProps,
+            D3D12_HEAP_FLAG_NONE,
+            &bufferDesc,
+            D3D12_RESOURCE_STATE_GENERIC_READ,
+            nullptr,
+            IID_PPV_ARGS(&uploadBuffer)));
+
+        uint8_t* uploadData = nullptr;
+        CD3DX12_RANGE readRange(0, 0);
+        Util::ThrowIfFailed(uploadBuffer->Map(0, &readRange, reinterpret_cast<void**>(&uploadData)));
+        for (UINT subresource = 0; subresource < resourceMipCount; ++subresource)
+        {
+            UINT mip = loaded.firstMip + subresource;
+            const DirectX::Image* mipImage = image.GetImage(mip, 0, 0);
+            const D3D12_PLACED_SUBRESOURCE_FOOTPRINT& footprint = footprints[subresource];
+            for (UINT row = 0; row < rowCounts[subresource]; ++row)
+            {
+                memcpy(uploadData + footprint.Offset + static_cast<UINT64>(row) * footprint.Footprint.RowPitch,
+                    mipImage->pixels + row * mipImage->rowPitch, static_cast<size_t>(rowSizes[subresource]));
+            }
+
+            uploads.push_back(MipUpload{ request.texture, mip, static_cast<UINT64>(rowCounts[subresource]) * rowSizes[subresource],
+                loaded.resource, loaded.firstMip, uploadBuffer, footprint });
+        }
+        uploadBuffer->Unmap(0, nullptr);
+    }
+    catch (const std::exception& exception)
+    {
+        fprintf(stderr, "Failed to stream %ls: %s\n", request.filePath.c_str(), exception.what());
+        loaded.resource.Reset();
+        uploads.clear();
+    }
+
+    // Both under one lock, so Update() never sees a mip before its resource.
+    std::lock_guard<std::mutex> lock(_mutex);
+    _loadedTextures.push_back(std::move(loaded));
+    for (MipUpload& upload : uploads)
+    {
+        _uploadQueue.push(std::move(upload));
+    }
+}
+
+void TextureStreamer::LatencyHistogram::Add(double milliseconds)
+{
+    UINT bucket = milliseconds < 1.0 ? 0 : 1 + static_cast<UINT>(log2(milliseconds));
+    buckets[std::min(bucket, BUCKET_COUNT - 1)]++;
+    count++;
+    totalMilliseconds += milliseconds;
+}
+
+void TextureStreamer::LatencyHistogram::Report(FILE* file, const char* name) const
+{
+    fprintf(file, "  %s: %u loads, %.2f ms average\n", name, count, count > 0 ? totalMilliseconds / count : 0.0);
+    for (UINT bucket = 0; bucket < BUCKET_COUNT; ++bucket)
+    {
+        if (buckets[bucket] == 0)
+        {
+            continue;
+        }
+
+        UINT low = bucket == 0 ? 0 : 1u << (bucket - 1);
+        if (bucket == BUCKET_COUNT - 1)
+        {
+            fprintf(file, "    >= %5u ms: %u\n", low, buckets[bucket]);
+        }
+        else
+        {
+            fprintf(file, "    %5u-%5u ms: %u\n", low, 1u << bucket, buckets[bucket]);
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,233 @@
+#include "pch.hpp"
+
+#include "transform_hierarchy.hpp"
+
+#include <algorithm>
+
+using namespace DirectX;
+
+TransformHierarchy::TransformHierarchy()
+    : _childrenValid(true)
+{
+
+}
+
+TransformHierarchy::~TransformHierarchy()
+{
+
+}
+
+UINT TransformHierarchy::AddNode(UINT parent, const XMFLOAT3& translation, const XMFLOAT4& rotation, float scale)
+{
+    assert((parent == INVALID_NODE || parent < _handleToIndex.size()) && "Parent has to be added before its children.");
+
+    UINT index = static_cast<UINT>(_parent.size());
+    UINT parentIndex = parent == INVALID_NODE ? INVALID_NODE : _handleToIndex[parent];
+
+    _translationX.push_back(translation.x);
+    _translationY.push_back(translation.y);
+    _translationZ.push_back(translation.z);
+    _rotation.push_back(rotation);
+    _scale.push_back(scale);
+    _parent.push_back(parentIndex);
+    _depth.push_back(parentIndex == INVALID_NODE ? 0 : static_cast<uint16_t>(_depth[parentIndex] + 1));
+    _dirty.push_back(0);
+    _world.emplace_back();
+
+    UINT handle = static_cast<UINT>(_handleToIndex.size());
+    _handleToIndex.push_back(index);
+    _indexToHandle.push_back(handle);
+    _childrenValid = false;
+
+    MarkDirty(index);
+    return handle;
+}
+
+void TransformHierarchy::SortByDepth()
+{
+    // Stable counting sort on depth, which keeps siblings together and parents in front of children.
+    UINT count = GetCount();
+    uint16_t maxDepth = 0;
+    for (uint16_t depth : _depth)
+    {
+        maxDepth = std::max(maxDepth, depth);
+    }
+
+    std::vector<UINT> levelStart(maxDepth + 2, 0);
+    for (uint16_t depth : _depth)
+    {
+        levelStart[depth + 1]++;
+    }
+    for (size_t level = 1; level < levelStart.size(); ++level)
+    {
+        levelStart[level] += levelStart[level - 1];
+    }
+
+    std::vector<UINT> newIndex(count);
+    for (UINT index = 0; index < count; ++index)
+    {
+        newIndex[index] = levelStart[_depth[index]]++;
+    }
+
+    auto reorder = [&](auto& values)
+    {
+        std::remove_reference_t<decltype(values)> sorted(values.size());
+        for (UINT index = 0; index < count; ++index)
+        {
+            sorted[newIndex[index]] = values[index];
+        }
+        values.swap(sorted);
+    };
+
+    for (UINT& parent : _parent)
+    {
+        parent = parent == INVALID_NODE ? INVALID_NODE : newIndex[parent];
+    }
+
+    reorder(_translationX);
+    reorder(_translationY);
+    reorder(_translationZ);
+    reorder(_rotation);
+    reorder(_scale);
+    reorder(_parent);
+    reorder(_depth);
+    reorder(_dirty);
+    reorder(_world);
+    reorder(_indexToHandle);
+
+    for (UINT index = 0; index < count; ++index)
+    {
+        _handleToIndex[_indexToHandle[index]] = index;
+    }
+
+    // Positions moved around, simply recompute everything once.
+    std::fill(_dirty.begin(), _dirty.end(), static_cast<uint8_t>(1));
+    _dirtyNodes.resize(count);
+    for (UINT index = 0; index < count; ++index)
+    {
+        _dirtyNodes[index] = index;
+    }
+    _childrenValid = false;
+}
+
+void TransformHierarchy::SetLocalTranslation(UINT node, const XMFLOAT3& translation)
+{
+    UINT index = _handleToIndex[node];
+    _translationX[index] = translation.x;
+    _translationY[index] = translation.y;
+    _translationZ[index] = translation.z;
+    MarkDirty(index);
+}
+
+void TransformHierarchy::SetLocalRotation(UINT node, const XMFLOAT4& rotation)
+{
+    UINT index = _handleToIndex[node];
+    _rotation[index] = rotation;
+    MarkDirty(index);
+}
+
+void TransformHierarchy::SetLocalScale(UINT node, float scale)
+{
+    UINT index = _handleToIndex[node];
+    _scale[index] = scale;
+    MarkDirty(index);
+}
+
+void TransformHierarchy::MarkDirty(UINT index)
+{
+    if (!_dirty[index])
+    {
+        _dirty[index] = 1;
+        _dirtyNodes.push_back(index);
+    }
+}
+
+void TransformHierarchy::BuildChildren()
+{
+    // Children grouped per parent, in storage order: _children[_childStart[i] .. _childStart[i + 1]) belong to node i.
+    UINT count = GetCount();
+    _childStart.assign(count + 1, 0);
+    for (UINT parent : _parent)
+    {
+        if (parent != INVALID_NODE)
+        {
+            _childStart[parent + 1]++;
+        }
+    }
+    for (UINT index = 0; index < count; ++index)
+    {
+        _childStart[index + 1] += _childStart[index];
+    }
+
+    _children.resize(_childStart[count]);
+    std::vector<UINT> next(_childStart.begin(), _childStart.end() - 1);
+    for (UINT index = 0; index < count; ++index)
+    {
+        if (_parent[index] != INVALID_NODE)
+        {
+            _children[next[_parent[index]]++] = index;
+        }
+    }
+    _childrenValid = true;
+}
+
+UINT TransformHierarchy::Update()
+{
+    _updatedNodes.clear();
+    if (_dirtyNodes.empty())
+    {
+        return 0;
+    }
+
+    if (!_childrenValid)
+    {
+        BuildChildren();
+    }
+
+    // Pass 1: grow the changed nodes into their subtrees. Only those are visited, clean parts of the
+    // hierarchy cost nothing no matter where they are stored. A node inside a subtree that is already
+    // dirty is skipped, so every node is added once.
+    for (size_t i = 0; i < _dirtyNodes.size(); ++i)
+    {
+        UINT index = _dirtyNodes[i];
+        for (UINT child = _childStart[index]; child < _childStart[index + 1]; ++child)
+        {
+            UINT childIndex = _children[child];
+            if (!_dirty[childIndex])
+            {
+                _dirty[childIndex] = 1;
+                _dirtyNodes.push_back(childIndex);
+            }
+        }
+    }
+
+    // Parents are always stored before their children, so storage order is a valid update order.
+    std::sort(_dirtyNodes.begin(), _dirtyNodes.end());
+
+    // Pass 2: rebuild local * parent world for the collected nodes, in storage (and therefore depth) order.
+    for (UINT index : _dirtyNodes)
+    {
+        XMVECTOR scale = XMVectorReplicate(_scale[index]);
+        XMMATRIX local = XMMatrixRotationQuaternion(XMLoadFloat4(&_rotation[index]));
+        local.r[0] = XMVectorMultiply(local.r[0], scale);
+        local.r[1] = XMVectorMultiply(local.r[1], scale);
+        local.r[2] = XMVectorMultiply(local.r[2], scale);
+        local.r[3] = XMVectorSet(_translationX[index], _translationY[index], _translationZ[index], 1.0f);
+
+        UINT parent = _parent[index];
+        if (parent != INVALID_NODE)
+        {
+            local = XMMatrixMultiply(local, XMLoadFloat4x4(&_world[parent]));
+        }
+        XMStoreFloat4x4(&_world[index], local);
+    }
+
+    for (UINT index : _dirtyNodes)
+    {
+        _dirty[index] = 0;
+        _updatedNodes.push_back(_indexToHandle[index]);
+    }
+    _dirtyNodes.clear();
+
+    return static_cast<UINT>(_updatedNodes.size());
+}
\ No newline at end of file
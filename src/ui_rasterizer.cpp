@@ -0,0 +1,271 @@
+#include "pch.hpp"
+
+#include "ui_rasterizer.hpp"
+
+#include "job_system.hpp"
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    // Pixels whose centers lie inside the quad, clipped to [clipX0, clipX1) x [clipY0, clipY1).
+    struct PixelRect
+    {
+        int x0, y0, x1, y1;
+
+        bool IsEmpty() const { return x0 >= x1 || y0 >= y1; }
+    };
+
+    PixelRect GetPixelRect(const UIQuad& quad, int clipX0, int clipY0, int clipX1, int clipY1)
+    {
+        PixelRect rect;
+        rect.x0 = std::max(clipX0, static_cast<int>(std::ceil(quad.x0 - 0.5f)));
+        rect.y0 = std::max(clipY0, static_cast<int>(std::ceil(quad.y0 - 0.5f)));
+        rect.x1 = std::min(clipX1, static_cast<int>(std::ceil(quad.x1 - 0.5f)));
+        rect.y1 = std::min(clipY1, static_cast<int>(std::ceil(quad.y1 - 0.5f)));
+        return rect;
+    }
+
+    // Exact x / 255 rounded, for x up to 255 * 255.
+    uint32_t Div255(uint32_t x)
+    {
+        x += 128;
+        return (x + (x >> 8)) >> 8;
+    }
+
+    // Maps pixel centers to atlas texels, texel = base + (center - start) * step. The scalar and the
+    // vector path evaluate it with the same operations, so they pick the same texels.
+    struct TexelMapping
+    {
+        float base;
+        float start;
+        float step;
+    };
+
+    TexelMapping GetTexelMapping(float position0, float position1, float uv0, float uv1, size_t atlasSize)
+    {
+        TexelMapping mapping;
+        mapping.base = uv0 * atlasSize;
+        mapping.start = position0;
+        mapping.step = (uv1 - uv0) * atlasSize / (position1 - position0);
+        return mapping;
+    }
+
+    int MapTexel(const TexelMapping& mapping, int pixel, int atlasSize)
+    {
+        float texel = mapping.base + ((static_cast<float>(pixel) + 0.5f) - mapping.start) * mapping.step;
+        return std::min(std::max(static_cast<int>(texel), 0), atlasSize - 1);
+    }
+
+    void BlendSpanScalar(uint32_t* pixels, int x0, int x1, const uint8_t* atlasRow, const TexelMapping& mapping, int atlasWidth,
+        uint32_t color)
+    {
+        const uint32_t tintAlpha = color >> 24;
+        for (int x = x0; x < x1; ++x)
+        {
+            uint32_t alpha = Div255(tintAlpha * atlasRow[MapTexel(mapping, x, atlasWidth)]);
+            uint32_t source = color | 0xFF000000u;
+            uint32_t destination = pixels[x];
+            uint32_t result = 0;
+            for (uint32_t shift = 0; shift < 32; shift += 8)
+            {
+                uint32_t s = (source >> shift) & 0xFF;
+                uint32_t d = (destination >> shift) & 0xFF;
+                result |= Div255(s * alpha + d * (255 - alpha)) << shift;
+            }
+            pixels[x] = result;
+        }
+    }
+
+#if defined(__AVX2__)
+    __m256i Div255(__m256i x)
+    {
+        x = _mm256_add_epi16(x, _mm256_set1_epi16(128));
+        return _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), 8);
+    }
+
+    // Eight pixels at a time. Lanes past x1 are neither read nor written, which keeps the spans of
+    // neighbouring tiles apart.
+    void BlendSpan(uint32_t* pixels, int x0, int x1, const uint8_t* atlasRow, const TexelMapping& mapping, int atlasWidth,
+        uint32_t color)
+    {
+        const __m256i laneOffsets = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        const __m256 base = _mm256_set1_ps(mapping.base);
+        const __m256 start = _mm256_set1_ps(mapping.start);
+        const __m256 step = _mm256_set1_ps(mapping.step);
+        const __m256i maxTexel = _mm256_set1_epi32(atlasWidth - 1);
+        const __m256i end = _mm256_set1_epi32(x1);
+        const __m256i tintAlpha = _mm256_set1_epi32(static_cast<int>(color >> 24));
+        const __m256i zero = _mm256_setzero_si256();
+
+        // The source is the same for every pixel, only the blend factor changes.
+        const __m256i source = _mm256_set1_epi32(static_cast<int>(color | 0xFF000000u));
+        const __m256i sourceLow = _mm256_unpacklo_epi8(source, zero);
+        const __m256i sourceHigh = _mm256_unpackhi_epi8(source, zero);
+
+        alignas(32) int texels[8];
+        alignas(32) int coverage[8];
+        for (int x = x0; x < x1; x += 8)
+        {
+            __m256i pixel = _mm256_add_epi32(_mm256_set1_epi32(x), laneOffsets);
+            __m256i mask = _mm256_cmpgt_epi32(end, pixel);
+
+            __m256 center = _mm256_add_ps(_mm256_cvtepi32_ps(pixel), _mm256_set1_ps(0.5f));
+            __m256i texel = _mm256_cvttps_epi32(_mm256_add_ps(base, _mm256_mul_ps(_mm256_sub_ps(center, start), step)));
+            texel = _mm256_min_epi32(_mm256_max_epi32(texel, zero), maxTexel);
+            _mm256_store_si256(reinterpret_cast<__m256i*>(texels), texel);
+            for (int lane = 0; lane < 8; ++lane)
+            {
+                coverage[lane] = atlasRow[texels[lane]];
+            }
+
+            // alpha = tint alpha * coverage / 255, spread over the four bytes of its pixel.
+            __m256i alpha = _mm256_mullo_epi32(tintAlpha, _mm256_load_si256(reinterpret_cast<const __m256i*>(coverage)));
+            alpha = _mm256_add_epi32(alpha, _mm256_set1_epi32(128));
+            alpha = _mm256_srli_epi32(_mm256_add_epi32(alpha, _mm256_srli_epi32(alpha, 8)), 8);
+            __m256i alphaBytes = _mm256_mullo_epi32(alpha, _mm256_set1_epi32(0x01010101));
+            __m256i inverseAlphaBytes = _mm256_xor_si256(alphaBytes, _mm256_set1_epi32(-1));
+
+            int* destination = reinterpret_cast<int*>(pixels + x);
+            __m256i target = _mm256_maskload_epi32(destination, mask);
+
+            __m256i low = _mm256_add_epi16(_mm256_mullo_epi16(sourceLow, _mm256_unpacklo_epi8(alphaBytes, zero)),
+                _mm256_mullo_epi16(_mm256_unpacklo_epi8(target, zero), _mm256_unpacklo_epi8(inverseAlphaBytes, zero)));
+            __m256i high = _mm256_add_epi16(_mm256_mullo_epi16(sourceHigh, _mm256_unpackhi_epi8(alphaBytes, zero)),
+                _mm256_mullo_epi16(_mm256_unpackhi_epi8(target, zero), _mm256_unpackhi_epi8(inverseAlphaBytes, zero)));
+            __m256i result = _mm256_packus_epi16(Div255(low), Div255(high));
+
+            _mm256_maskstore_epi32(destination, mask, result);
+        }
+    }
+#endif
+}
+
+UIRasterizer::UIRasterizer(UINT width, UINT height)
+    : _tileCountX((width + TILE_SIZE - 1) / TILE_SIZE)
+    , _tileCountY((height + TILE_SIZE - 1) / TILE_SIZE)
+{
+    if (FAILED(_image.Initialize2D(DXGI_FORMAT_R8G8B8A8_UNORM, width, height, 1, 1)))
+    {
+        throw std::exception("Failed to create the UI rasterizer's target.");
+    }
+    _tileQuads.resize(_tileCountX * _tileCountY);
+}
+
+UIRasterizer::~UIRasterizer()
+{
+}
+
+void UIRasterizer::Rasterize(const UIQuad* quads, UINT quadCount, const DirectX::Image& atlas, uint32_t clearColor)
+{
+    if (atlas.format != DXGI_FORMAT_R8_UNORM)
+    {
+        throw std::exception("The UI atlas has to be R8_UNORM.");
+    }
+
+    BinQuads(quads, quadCount);
+    Jobs::ParallelFor(static_cast<UINT>(_tileQuads.size()), 4, [&](UINT begin, UINT end)
+    {
+        PROFILE_ZONE("UI tiles");
+        for (UINT tile = begin; tile < end; ++tile)
+        {
+            RasterizeTile(tile, quads, atlas, clearColor, true);
+        }
+    });
+}
+
+void UIRasterizer::RasterizeScalar(const UIQuad* quads, UINT quadCount, const DirectX::Image& atlas, uint32_t clearColor)
+{
+    if (atlas.format != DXGI_FORMAT_R8_UNORM)
+    {
+        throw std::exception("The UI atlas has to be R8_UNORM.");
+    }
+
+    BinQuads(quads, quadCount);
+    for (UINT tile = 0; tile < _tileQuads.size(); ++tile)
+    {
+        RasterizeTile(tile, quads, atlas, clearColor, false);
+    }
+}
+
+void UIRasterizer::BinQuads(const UIQuad* quads, UINT quadCount)
+{
+    // The lists keep their memory, after the first frame binning doesn't allocate.
+    for (std::vector<UINT>& tileQuads : _tileQuads)
+    {
+        tileQuads.clear();
+    }
+
+    const DirectX::Image& target = *_image.GetImage(0, 0, 0);
+    const int tileSize = static_cast<int>(TILE_SIZE);
+    for (UINT quad = 0; quad < quadCount; ++quad)
+    {
+        PixelRect rect = GetPixelRect(quads[quad], 0, 0, static_cast<int>(target.width), static_cast<int>(target.height));
+        if (rect.IsEmpty())
+        {
+            continue;
+        }
+
+        for (int tileY = rect.y0 / tileSize; tileY <= (rect.y1 - 1) / tileSize; ++tileY)
+        {
+            for (int tileX = rect.x0 / tileSize; tileX <= (rect.x1 - 1) / tileSize; ++tileX)
+            {
+                _tileQuads[tileY * _tileCountX + tileX].push_back(quad);
+            }
+        }
+    }
+}
+
+void UIRasterizer::RasterizeTile(UINT tile, const UIQuad* quads, const DirectX::Image& atlas, uint32_t clearColor, bool vectorized)
+{
+    const DirectX::Image& target = *_image.GetImage(0, 0, 0);
+    const int tileX0 = static_cast<int>((tile % _tileCountX) * TILE_SIZE);
+    const int tileY0 = static_cast<int>((tile / _tileCountX) * TILE_SIZE);
+    const int tileX1 = std::min(tileX0 + static_cast<int>(TILE_SIZE), static_cast<int>(target.width));
+    const int tileY1 = std::min(tileY0 + static_cast<int>(TILE_SIZE), static_cast<int>(target.height));
+
+    for (int y = tileY0; y < tileY1; ++y)
+    {
+        uint32_t* pixels = reinterpret_cast<uint32_t*>(target.pixels + y * target.rowPitch);
+        std::fill(pixels + tileX0, pixels + tileX1, clearColor);
+    }
+
+    const int atlasWidth = static_cast<int>(atlas.width);
+    const int atlasHeight = static_cast<int>(atlas.height);
+    for (UINT index : _tileQuads[tile])
+    {
+        const UIQuad& quad = quads[index];
+        PixelRect rect = GetPixelRect(quad, tileX0, tileY0, tileX1, tileY1);
+        TexelMapping columns = GetTexelMapping(quad.x0, quad.x1, quad.u0, quad.u1, atlas.width);
+        TexelMapping rows = GetTexelMapping(quad.y0, quad.y1, quad.v0, quad.v1, atlas.height);
+
+        for (int y = rect.y0; y < rect.y1; ++y)
+        {
+            uint32_t* pixels = reinterpret_cast<uint32_t*>(target.pixels + y * target.rowPitch);
+            const uint8_t* atlasRow = atlas.pixels + MapTexel(rows, y, atlasHeight) * atlas.rowPitch;
+#if defined(__AVX2__)
+            if (vectorized)
+            {
+                BlendSpan(pixels, rect.x0, rect.x1, atlasRow, columns, atlasWidth, quad.color);
+                continue;
+            }
+#endif
+            BlendSpanScalar(pixels, rect.x0, rect.x1, atlasRow, columns, atlasWidth, quad.color);
+        }
+    }
+}
+
+bool UIRasterizer::Save(const std::wstring& filePath) const
+{
+    const DirectX::Image& target = *_image.GetImage(0, 0, 0);
+    bool tga = filePath.size() >= 4 && _wcsicmp(filePath.c_str() + filePath.size() - 4, L".tga") == 0;
+    HRESULT result = tga ? DirectX::SaveToTGAFile(target, filePath.c_str())
+        : DirectX::SaveToDDSFile(target, DirectX::DDS_FLAGS_NONE, filePath.c_str());
+    return SUCCEEDED(result);
+}
\ No newline at end of file
@@ -0,0 +1,155 @@
+#include "pch.hpp"
+
+#include "vertex_quantization.hpp"
+
+#include <DirectXPackedVector.h>
+#include <algorithm>
+#include <cfloat>
+
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+const D3D12_INPUT_ELEMENT_DESC Util::QUANTIZED_VERTEX_INPUT_LAYOUT[3] =
+{
+    { "POSITION", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+    { "NORMAL",   0, DXGI_FORMAT_R16G16_SNORM,       0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+    { "TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT,       0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+};
+
+namespace
+{
+    // Octahedral encoding of four unit normals given as structure-of-arrays: project onto the
+    // octahedron |x|+|y|+|z| = 1 and fold the lower hemisphere over the diagonals.
+    void EncodeOctahedral4(FXMVECTOR x, FXMVECTOR y, FXMVECTOR z, XMVECTOR& encodedX, XMVECTOR& encodedY)
+    {
+        const XMVECTOR zero = XMVectorZero();
+        const XMVECTOR one = XMVectorSplatOne();
+        const XMVECTOR negativeOne = XMVectorNegate(one);
+
+        XMVECTOR l1 = XMVectorAdd(XMVectorAdd(XMVectorAbs(x), XMVectorAbs(y)), XMVectorAbs(z));
+        XMVECTOR inverseL1 = XMVectorReciprocal(XMVectorMax(l1, XMVectorReplicate(FLT_MIN)));
+        XMVECTOR px = XMVectorMultiply(x, inverseL1);
+        XMVECTOR py = XMVectorMultiply(y, inverseL1);
+
+        // sign() that maps 0 to +1, otherwise normals on the fold would collapse to the center.
+        XMVECTOR signX = XMVectorSelect(one, negativeOne, XMVectorLess(px, zero));
+        XMVECTOR signY = XMVectorSelect(one, negativeOne, XMVectorLess(py, zero));
+        XMVECTOR foldedX = XMVectorMultiply(XMVectorSubtract(one, XMVectorAbs(py)), signX);
+        XMVECTOR foldedY = XMVectorMultiply(XMVectorSubtract(one, XMVectorAbs(px)), signY);
+
+        XMVECTOR lowerHemisphere = XMVectorLess(z, zero);
+        encodedX = XMVectorSelect(px, foldedX, lowerHemisphere);
+        encodedY = XMVectorSelect(py, foldedY, lowerHemisphere);
+    }
+
+    void QuantizeNormals4(const XMFLOAT3* normals[4], Util::QuantizedVertex* output[4])
+    {
+        XMMATRIX aos(
+            XMLoadFloat3(normals[0]), XMLoadFloat3(normals[1]),
+            XMLoadFloat3(normals[2]), XMLoadFloat3(normals[3]));
+        XMMATRIX soa = XMMatrixTranspose(aos);
+
+        XMVECTOR encodedX, encodedY;
+        EncodeOctahedral4(soa.r[0], soa.r[1], soa.r[2], encodedX, encodedY);
+
+        // Back to (x, y) pairs, two vertices per register.
+        XMSHORTN4 packed[2];
+        XMStoreShortN4(&packed[0], XMVectorMergeXY(encodedX, encodedY));
+        XMStoreShortN4(&packed[1], XMVectorMergeZW(encodedX, encodedY));
+        for (int i = 0; i < 4; ++i)
+        {
+            const XMSHORTN4& pair = packed[i / 2];
+            output[i]->normal[0] = (i % 2 == 0) ? pair.x : pair.z;
+            output[i]->normal[1] = (i % 2 == 0) ? pair.y : pair.w;
+        }
+    }
+}
+
+Util::PositionQuantization Util::ComputePositionQuantization(const std::vector<Vertex>& vertices)
+{
+    PositionQuantization quantization = {};
+    if (vertices.empty())
+    {
+        quantization.scale = XMFLOAT3(1.0f, 1.0f, 1.0f);
+        return quantization;
+    }
+
+    XMVECTOR minimum = XMLoadFloat3(&vertices[0].position);
+    XMVECTOR maximum = minimum;
+    for (const Vertex& vertex : vertices)
+    {
+        XMVECTOR position = XMLoadFloat3(&vertex.position);
+        minimum = XMVectorMin(minimum, position);
+        maximum = XMVectorMax(maximum, position);
+    }
+
+    // A flat axis still needs a non-zero scale to divide by.
+    XMVECTOR extent = XMVectorSubtract(maximum, minimum);
+    extent = XMVectorSelect(extent, XMVectorSplatOne(), XMVectorLessOrEqual(extent, XMVectorZero()));
+
+    XMStoreFloat3(&quantization.offset, minimum);
+    XMStoreFloat3(&quantization.scale, extent);
+    return quantization;
+}
+
+void Util::QuantizeVertices(const Vertex* vertices, size_t count, const PositionQuantization& quantization, QuantizedVertex* output)
+{
+    const XMVECTOR offset = XMLoadFloat3(&quantization.offset);
+    const XMVECTOR inverseScale = XMVectorReciprocal(XMVectorSetW(XMLoadFloat3(&quantization.scale), 1.0f));
+
+    // Positions: one vertex per register, XMStoreUShortN4 saturates and rounds to 16 bits.
+    for (size_t i = 0; i < count; ++i)
+    {
+        XMVECTOR normalized = XMVectorMultiply(XMVectorSubtract(XMLoadFloat3(&vertices[i].position), offset), inverseScale);
+        XMStoreUShortN4(reinterpret_cast<XMUSHORTN4*>(output[i].position), XMVectorSetW(normalized, 0.0f));
+    }
+
+    // Normals: four vertices per register. The tail reuses the last vertex for the unused lanes.
+    for (size_t i = 0; i < count; i += 4)
+    {
+        const XMFLOAT3* normals[4];
+        QuantizedVertex* normalOutput[4];
+        for (size_t lane = 0; lane < 4; ++lane)
+        {
+            size_t index = std::min(i + lane, count - 1);
+            normals[lane] = &vertices[index].normals;
+            normalOutput[lane] = &output[index];
+        }
+        QuantizeNormals4(normals, normalOutput);
+    }
+
+    // UVs: the stream converter uses F16C when the build enables it.
+    XMConvertFloatToHalfStream(&output[0].uv[0], sizeof(QuantizedVertex), &vertices[0].uv.x, sizeof(Vertex), count);
+    XMConvertFloatToHalfStream(&output[0].uv[1], sizeof(QuantizedVertex), &vertices[0].uv.y, sizeof(Vertex), count);
+}
+
+std::vector<Util::QuantizedVertex> Util::QuantizeVertices(const std::vector<Vertex>& vertices, const PositionQuantization& quantization)
+{
+    std::vector<QuantizedVertex> output(vertices.size());
+    if (!vertices.empty())
+    {
+        QuantizeVertices(vertices.data(), vertices.size(), quantization, output.data());
+    }
+    return output;
+}
+
+Util::Vertex Util::DequantizeVertex(const QuantizedVertex& vertex, const PositionQuantization& quantization)
+{
+    Vertex result;
+
+    XMVECTOR normalized = XMLoadUShortN4(reinterpret_cast<const XMUSHORTN4*>(vertex.position));
+    XMStoreFloat3(&result.position, XMVectorMultiplyAdd(normalized, XMLoadFloat3(&quantization.scale), XMLoadFloat3(&quantization.offset)));
+
+    // Same as DecodeOctahedral() in uber_vs.hlsl.
+    XMSHORTN2 packedNormal(vertex.normal[0], vertex.normal[1]);
+    XMFLOAT2 encoded;
+    XMStoreFloat2(&encoded, XMLoadShortN2(&packedNormal));
+    XMFLOAT3 normal(encoded.x, encoded.y, 1.0f - fabsf(encoded.x) - fabsf(encoded.y));
+    float fold = std::max(-normal.z, 0.0f);
+    normal.x += normal.x >= 0.0f ? -fold : fold;
+    normal.y += normal.y >= 0.0f ? -fold : fold;
+    XMStoreFloat3(&result.normals, XMVector3Normalize(XMLoadFloat3(&normal)));
+
+    result.uv = XMFLOAT2(XMConvertHalfToFloat(vertex.uv[0]), XMConvertHalfToFloat(vertex.uv[1]));
+    return result;
+}
\ No newline at end of file